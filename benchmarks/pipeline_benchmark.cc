@@ -0,0 +1,240 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "xpano/algorithm/algorithm.h"
+#include "xpano/algorithm/auto_crop.h"
+#include "xpano/algorithm/blenders.h"
+#include "xpano/algorithm/image.h"
+#include "xpano/algorithm/options.h"
+#include "xpano/constants.h"
+#include "xpano/pipeline/stitcher_pipeline.h"
+#include "xpano/utils/threadpool.h"
+
+namespace {
+
+using xpano::algorithm::Image;
+
+// The first pano of the test data
+const std::vector<std::filesystem::path> kPanoInputs = {
+    "data/image01.jpg", "data/image02.jpg", "data/image03.jpg",
+    "data/image04.jpg", "data/image05.jpg"};
+
+const std::array<std::string, 3> kExportExtensions = {".jpg", ".png", ".tif"};
+
+// Loaded once and shared by the benchmarks that start from loaded images
+const std::vector<Image>& LoadedImages() {
+  static const std::vector<Image> images = []() {
+    std::vector<Image> result;
+    for (const auto& path : kPanoInputs) {
+      auto& image = result.emplace_back(path);
+      image.Load({.preview_longer_side = xpano::kDefaultPreviewLongerSide});
+    }
+    return result;
+  }();
+  return images;
+}
+
+std::vector<cv::Mat> Previews() {
+  std::vector<cv::Mat> previews;
+  for (const auto& image : LoadedImages()) {
+    previews.push_back(image.GetPreview());
+  }
+  return previews;
+}
+
+std::vector<cv::Mat> FullResImages() {
+  std::vector<cv::Mat> images;
+  for (const auto& image : LoadedImages()) {
+    images.push_back(image.GetFullRes());
+  }
+  return images;
+}
+
+const xpano::algorithm::StitchResult& StitchedPreview() {
+  static xpano::utils::mt::Threadpool multiblend_pool;
+  static const xpano::algorithm::StitchResult result = xpano::algorithm::Stitch(
+      Previews(), {}, {},
+      {.return_pano_mask = true, .threads_for_multiblend = &multiblend_pool});
+  return result;
+}
+
+// A chain of images where each image overlaps with the next one, every
+// tenth link is too weak so that the chain splits into panos of 10 images
+std::vector<xpano::algorithm::Match> SyntheticMatches(int num_images) {
+  std::vector<xpano::algorithm::Match> matches;
+  for (int i = 0; i + 1 < num_images; i++) {
+    const int num_matches =
+        (i % 10 == 9) ? 0 : 2 * xpano::kDefaultMatchThreshold;
+    matches.push_back({.id1 = i,
+                       .id2 = i + 1,
+                       .matches = std::vector<cv::DMatch>(num_matches),
+                       .avg_shift = 2 * xpano::kDefaultShiftInPano});
+  }
+  return matches;
+}
+
+void BM_ImageLoad(benchmark::State& state) {
+  const bool compute_keypoints = state.range(0) != 0;
+  for (auto _ : state) {
+    Image image(kPanoInputs[0]);
+    image.Load({.preview_longer_side = xpano::kDefaultPreviewLongerSide,
+                .compute_keypoints = compute_keypoints});
+    benchmark::DoNotOptimize(image);
+  }
+}
+BENCHMARK(BM_ImageLoad)->ArgName("keypoints")->Arg(0)->Arg(1);
+
+void BM_MatchImages(benchmark::State& state) {
+  const auto& images = LoadedImages();
+  for (auto _ : state) {
+    auto match = xpano::algorithm::MatchImages(0, 1, images[0], images[1],
+                                               xpano::kDefaultMatchConf);
+    benchmark::DoNotOptimize(match);
+  }
+}
+BENCHMARK(BM_MatchImages);
+
+void BM_FindPanos(benchmark::State& state) {
+  const auto matches = SyntheticMatches(static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    auto panos = xpano::algorithm::FindPanos(
+        matches, xpano::kDefaultMatchThreshold, xpano::kDefaultShiftInPano);
+    benchmark::DoNotOptimize(panos);
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_FindPanos)->RangeMultiplier(10)->Range(10, 10000)->Complexity();
+
+void BM_StitchPreview(benchmark::State& state) {
+  const auto previews = Previews();
+  xpano::utils::mt::Threadpool multiblend_pool;
+  for (auto _ : state) {
+    auto result = xpano::algorithm::Stitch(
+        previews, {}, {},
+        {.return_pano_mask = true, .threads_for_multiblend = &multiblend_pool});
+    benchmark::DoNotOptimize(result);
+  }
+}
+BENCHMARK(BM_StitchPreview)->Unit(benchmark::kMillisecond);
+
+void BM_StitchFullRes(benchmark::State& state) {
+  const auto images = FullResImages();
+  xpano::utils::mt::Threadpool multiblend_pool;
+  for (auto _ : state) {
+    auto result = xpano::algorithm::Stitch(
+        images, {}, {},
+        {.return_pano_mask = true, .threads_for_multiblend = &multiblend_pool});
+    benchmark::DoNotOptimize(result);
+  }
+}
+BENCHMARK(BM_StitchFullRes)->Unit(benchmark::kMillisecond)->Iterations(3);
+
+void BM_FindLargestCrop(benchmark::State& state) {
+  const cv::Mat mask = cv::imread("data/mask.png", cv::IMREAD_GRAYSCALE);
+  if (mask.empty()) {
+    state.SkipWithError("Failed to read data/mask.png");
+    return;
+  }
+  for (auto _ : state) {
+    auto crop = xpano::algorithm::crop::FindLargestCrop(mask);
+    benchmark::DoNotOptimize(crop);
+  }
+}
+BENCHMARK(BM_FindLargestCrop)->Unit(benchmark::kMillisecond);
+
+void BM_Inpaint(benchmark::State& state) {
+  const auto& stitched = StitchedPreview();
+  cv::Mat inpaint_mask;
+  cv::bitwise_not(stitched.mask, inpaint_mask);
+  const auto method =
+      static_cast<xpano::algorithm::InpaintingMethod>(state.range(0));
+  for (auto _ : state) {
+    auto result = xpano::algorithm::Inpaint(stitched.pano, inpaint_mask,
+                                            {.method = method});
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetLabel(xpano::algorithm::Label(method));
+}
+BENCHMARK(BM_Inpaint)
+    ->Unit(benchmark::kMillisecond)
+    ->Arg(static_cast<int>(xpano::algorithm::InpaintingMethod::kTelea))
+    ->Arg(static_cast<int>(xpano::algorithm::InpaintingMethod::kPyramid));
+
+// Two overlapping synthetic images, exercises the conversions around the
+// blending itself
+template <typename TBlender>
+void FeedAndBlend(TBlender* blender, int size) {
+  cv::Mat image(size, size, CV_8UC3);
+  cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+  const cv::Mat mask(size, size, CV_8U, cv::Scalar(255));
+  blender->prepare(cv::Rect(0, 0, size + size / 2, size));
+  blender->feed(image, mask, cv::Point(0, 0));
+  blender->feed(image, mask, cv::Point(size / 2, 0));
+  cv::UMat result;
+  cv::UMat result_mask;
+  blender->blend(result, result_mask);
+  benchmark::DoNotOptimize(result);
+}
+
+void BM_BlendOpenCV(benchmark::State& state) {
+  for (auto _ : state) {
+    xpano::algorithm::blenders::MultiBandOpenCV blender;
+    FeedAndBlend(&blender, static_cast<int>(state.range(0)));
+  }
+}
+BENCHMARK(BM_BlendOpenCV)->Unit(benchmark::kMillisecond)->Arg(1024)->Arg(2048);
+
+void BM_BlendMultiblend(benchmark::State& state) {
+  if constexpr (!xpano::algorithm::blenders::MultiblendEnabled()) {
+    state.SkipWithError("Multiblend support not compiled in");
+    return;
+  }
+  xpano::utils::mt::Threadpool pool;
+  for (auto _ : state) {
+    xpano::algorithm::blenders::Multiblend blender(&pool);
+    FeedAndBlend(&blender, static_cast<int>(state.range(0)));
+  }
+}
+BENCHMARK(BM_BlendMultiblend)
+    ->Unit(benchmark::kMillisecond)
+    ->Arg(1024)
+    ->Arg(2048);
+
+void BM_Export(benchmark::State& state) {
+  const auto& extension =
+      kExportExtensions.at(static_cast<std::size_t>(state.range(0)));
+  const auto export_path =
+      std::filesystem::temp_directory_path() / ("xpano_benchmark" + extension);
+  const auto& pano = StitchedPreview().pano;
+  xpano::pipeline::StitcherPipeline<xpano::pipeline::RunTraits::kReturnFuture>
+      pipeline;
+  for (auto _ : state) {
+    auto result =
+        pipeline.RunExport(pano, {.export_path = export_path}).future.get();
+    if (!result.export_path) {
+      state.SkipWithError("Export failed");
+      break;
+    }
+  }
+  state.SetLabel(extension);
+  std::filesystem::remove(export_path);
+}
+BENCHMARK(BM_Export)
+    ->Unit(benchmark::kMillisecond)
+    ->DenseRange(0, static_cast<int>(kExportExtensions.size()) - 1);
+
+}  // namespace
+
+BENCHMARK_MAIN();
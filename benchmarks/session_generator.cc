@@ -0,0 +1,330 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Renders a synthetic photo session from an equirectangular image. The
+// cameras sweep the yaw in steps given by the overlap, every pano_size images
+// the sweep restarts looking the opposite way, so that consecutive panos don't
+// overlap. The ground truth grouping is written to ground_truth.json.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <spdlog/spdlog.h>
+
+#include "xpano/utils/fmt.h"
+#include "xpano/utils/json.h"
+
+namespace {
+
+struct Options {
+  std::optional<std::filesystem::path> input_path;
+  std::filesystem::path output_dir = "session";
+  int count = 100;
+  int pano_size = 10;
+  int width = 1024;
+  int height = 768;
+  double fov_degrees = 60.0;
+  double overlap = 0.4;
+  // Standard deviation of the pixel noise
+  double noise = 2.0;
+  // Standard deviation of the camera angles around the path, in degrees
+  double jitter_degrees = 1.0;
+  unsigned seed = 0;
+};
+
+struct Camera {
+  double yaw;
+  double pitch;
+  double roll;
+};
+
+const std::string kInputFlag = "--input=";
+const std::string kOutputFlag = "--output=";
+const std::string kCountFlag = "--count=";
+const std::string kPanoSizeFlag = "--pano-size=";
+const std::string kWidthFlag = "--width=";
+const std::string kHeightFlag = "--height=";
+const std::string kFovFlag = "--fov=";
+const std::string kOverlapFlag = "--overlap=";
+const std::string kNoiseFlag = "--noise=";
+const std::string kJitterFlag = "--jitter=";
+const std::string kSeedFlag = "--seed=";
+
+constexpr int kProceduralWidth = 8192;
+constexpr int kProceduralShapes = 20000;
+constexpr int kJpegQuality = 90;
+
+void PrintHelp() {
+  spdlog::info("Usage: XpanoSessionGenerator [--input=<equirectangular>]");
+  spdlog::info("\t[--output=<dir>] [--count=<images>] [--pano-size=<images>]");
+  spdlog::info("\t[--width=<px>] [--height=<px>] [--fov=<degrees>]");
+  spdlog::info("\t[--overlap=<0..1>] [--noise=<stddev>] [--jitter=<degrees>]");
+  spdlog::info("\t[--seed=<int>]");
+  spdlog::info("Without an input a procedural texture is rendered instead.");
+}
+
+std::optional<Options> ParseArgs(int argc, char** argv) {
+  Options options;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      auto value = [&arg](const std::string& flag) {
+        return arg.substr(flag.size());
+      };
+      if (arg.starts_with(kInputFlag)) {
+        options.input_path = std::filesystem::path(value(kInputFlag));
+      } else if (arg.starts_with(kOutputFlag)) {
+        options.output_dir = std::filesystem::path(value(kOutputFlag));
+      } else if (arg.starts_with(kCountFlag)) {
+        options.count = std::stoi(value(kCountFlag));
+      } else if (arg.starts_with(kPanoSizeFlag)) {
+        options.pano_size = std::stoi(value(kPanoSizeFlag));
+      } else if (arg.starts_with(kWidthFlag)) {
+        options.width = std::stoi(value(kWidthFlag));
+      } else if (arg.starts_with(kHeightFlag)) {
+        options.height = std::stoi(value(kHeightFlag));
+      } else if (arg.starts_with(kFovFlag)) {
+        options.fov_degrees = std::stod(value(kFovFlag));
+      } else if (arg.starts_with(kOverlapFlag)) {
+        options.overlap = std::stod(value(kOverlapFlag));
+      } else if (arg.starts_with(kNoiseFlag)) {
+        options.noise = std::stod(value(kNoiseFlag));
+      } else if (arg.starts_with(kJitterFlag)) {
+        options.jitter_degrees = std::stod(value(kJitterFlag));
+      } else if (arg.starts_with(kSeedFlag)) {
+        options.seed = static_cast<unsigned>(std::stoul(value(kSeedFlag)));
+      } else {
+        spdlog::error("Unknown argument: {}", arg);
+        return {};
+      }
+    }
+  } catch (const std::exception& e) {
+    spdlog::error("Error parsing arguments: {}", e.what());
+    return {};
+  }
+
+  if (options.count <= 0 || options.pano_size <= 0 || options.width <= 0 ||
+      options.height <= 0) {
+    spdlog::error("The counts and sizes have to be positive");
+    return {};
+  }
+  if (options.fov_degrees <= 0.0 || options.fov_degrees >= 180.0) {
+    spdlog::error("The field of view has to be between 0 and 180 degrees");
+    return {};
+  }
+  if (options.overlap < 0.0 || options.overlap >= 1.0) {
+    spdlog::error("The overlap has to be in the [0, 1) range");
+    return {};
+  }
+  return options;
+}
+
+// Random shapes over a smooth gradient, enough texture for the features
+cv::Mat RenderProceduralSource(std::mt19937* generator) {
+  cv::Mat source(kProceduralWidth / 2, kProceduralWidth, CV_8UC3);
+  for (int row = 0; row < source.rows; row++) {
+    for (int col = 0; col < source.cols; col++) {
+      source.at<cv::Vec3b>(row, col) =
+          cv::Vec3b(static_cast<uchar>(col * 255 / source.cols),
+                    static_cast<uchar>(row * 255 / source.rows), 128);
+    }
+  }
+  std::uniform_int_distribution<int> col_dist(0, source.cols - 1);
+  std::uniform_int_distribution<int> row_dist(0, source.rows - 1);
+  std::uniform_int_distribution<int> size_dist(4, 64);
+  std::uniform_int_distribution<int> color_dist(0, 255);
+  for (int i = 0; i < kProceduralShapes; i++) {
+    const cv::Point center(col_dist(*generator), row_dist(*generator));
+    const int size = size_dist(*generator);
+    const cv::Scalar color(color_dist(*generator), color_dist(*generator),
+                           color_dist(*generator));
+    if (i % 2 == 0) {
+      cv::circle(source, center, size, color, cv::FILLED);
+    } else {
+      cv::rectangle(source, center, center + cv::Point(size, size / 2), color,
+                    cv::FILLED);
+    }
+  }
+  return source;
+}
+
+cv::Matx33d RotationMatrix(const Camera& camera) {
+  const double cy = std::cos(camera.yaw);
+  const double sy = std::sin(camera.yaw);
+  const double cp = std::cos(camera.pitch);
+  const double sp = std::sin(camera.pitch);
+  const double cr = std::cos(camera.roll);
+  const double sr = std::sin(camera.roll);
+  const cv::Matx33d yaw(cy, 0, sy, 0, 1, 0, -sy, 0, cy);
+  const cv::Matx33d pitch(1, 0, 0, 0, cp, -sp, 0, sp, cp);
+  const cv::Matx33d roll(cr, -sr, 0, sr, cr, 0, 0, 0, 1);
+  return yaw * pitch * roll;
+}
+
+// Pinhole camera looking along +z, x to the right, y down
+cv::Mat Render(const cv::Mat& source, const Camera& camera,
+               const Options& options) {
+  const double focal =
+      0.5 * options.width /
+      std::tan(0.5 * options.fov_degrees * std::numbers::pi / 180.0);
+  const auto rotation = RotationMatrix(camera);
+  cv::Mat map_x(options.height, options.width, CV_32F);
+  cv::Mat map_y(options.height, options.width, CV_32F);
+  for (int row = 0; row < options.height; row++) {
+    for (int col = 0; col < options.width; col++) {
+      const cv::Vec3d ray = rotation * cv::Vec3d(col - 0.5 * options.width,
+                                                 row - 0.5 * options.height,
+                                                 focal);
+      const double longitude = std::atan2(ray[0], ray[2]);
+      const double latitude =
+          std::atan2(ray[1], std::hypot(ray[0], ray[2]));
+      map_x.at<float>(row, col) = static_cast<float>(
+          (longitude / (2 * std::numbers::pi) + 0.5) * source.cols);
+      map_y.at<float>(row, col) = static_cast<float>(
+          (latitude / std::numbers::pi + 0.5) * source.rows);
+    }
+  }
+  cv::Mat image;
+  cv::remap(source, image, map_x, map_y, cv::INTER_LINEAR,
+            cv::BORDER_WRAP);
+  return image;
+}
+
+// Consecutive panos start half a turn apart and alternate the pitch
+std::vector<Camera> CameraPath(const Options& options,
+                               std::mt19937* generator) {
+  const double to_radians = std::numbers::pi / 180.0;
+  const double step =
+      options.fov_degrees * (1.0 - options.overlap) * to_radians;
+  std::normal_distribution<double> jitter(
+      0.0, options.jitter_degrees * to_radians);
+  std::vector<Camera> cameras;
+  for (int i = 0; i < options.count; i++) {
+    const int pano_id = i / options.pano_size;
+    const int position = i % options.pano_size;
+    const double start = pano_id * std::numbers::pi;
+    const double pitch = (pano_id % 4 - 1.5) * 10.0 * to_radians;
+    cameras.push_back({.yaw = start + position * step + jitter(*generator),
+                       .pitch = pitch + jitter(*generator),
+                       .roll = jitter(*generator)});
+  }
+  return cameras;
+}
+
+xpano::utils::json::Value GroundTruth(const Options& options,
+                                      const std::vector<Camera>& cameras,
+                                      const std::vector<std::string>& files) {
+  using xpano::utils::json::Value;
+  const double to_degrees = 180.0 / std::numbers::pi;
+  Value::Array images;
+  for (std::size_t i = 0; i < cameras.size(); i++) {
+    images.emplace_back(Value::Object{
+        {"file", files[i]},
+        {"yaw", std::fmod(cameras[i].yaw * to_degrees, 360.0)},
+        {"pitch", cameras[i].pitch * to_degrees},
+        {"roll", cameras[i].roll * to_degrees}});
+  }
+  // A pano of a single image is not detected by the pipeline
+  Value::Array panos;
+  for (int begin = 0; begin < options.count; begin += options.pano_size) {
+    const int end = std::min(begin + options.pano_size, options.count);
+    if (end - begin < 2) {
+      continue;
+    }
+    Value::Array ids;
+    for (int id = begin; id < end; id++) {
+      ids.emplace_back(id);
+    }
+    panos.emplace_back(std::move(ids));
+  }
+  return Value::Object{
+      {"source", options.input_path ? options.input_path->string()
+                                    : std::string("procedural")},
+      {"seed", static_cast<double>(options.seed)},
+      {"fov", options.fov_degrees},
+      {"overlap", options.overlap},
+      {"images", std::move(images)},
+      {"panos", std::move(panos)}};
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto options = ParseArgs(argc, argv);
+  if (!options) {
+    PrintHelp();
+    return -1;
+  }
+
+  std::mt19937 generator(options->seed);
+  cv::Mat source;
+  if (options->input_path) {
+    source = cv::imread(options->input_path->string(), cv::IMREAD_COLOR);
+    if (source.empty()) {
+      spdlog::error("Failed to read {}", options->input_path->string());
+      return -1;
+    }
+  } else {
+    source = RenderProceduralSource(&generator);
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(options->output_dir, error);
+  if (error) {
+    spdlog::error("Failed to create {}: {}", options->output_dir.string(),
+                  error.message());
+    return -1;
+  }
+
+  const auto cameras = CameraPath(*options, &generator);
+  std::vector<std::string> files;
+  const std::vector<int> jpeg_params = {cv::IMWRITE_JPEG_QUALITY,
+                                        kJpegQuality};
+  for (std::size_t i = 0; i < cameras.size(); i++) {
+    auto image = Render(source, cameras[i], *options);
+    if (options->noise > 0.0) {
+      cv::Mat noise(image.size(), CV_16SC3);
+      cv::randn(noise, 0.0, options->noise);
+      cv::Mat noisy;
+      image.convertTo(noisy, CV_16SC3);
+      noisy += noise;
+      noisy.convertTo(image, CV_8UC3);
+    }
+    auto file = fmt::format("image{:05d}.jpg", i);
+    if (!cv::imwrite((options->output_dir / file).string(), image,
+                     jpeg_params)) {
+      spdlog::error("Failed to write {}", file);
+      return -1;
+    }
+    files.push_back(std::move(file));
+    if ((i + 1) % 100 == 0) {
+      spdlog::info("Rendered {} of {} images", i + 1, cameras.size());
+    }
+  }
+
+  const auto ground_truth_path = options->output_dir / "ground_truth.json";
+  std::ofstream ground_truth(ground_truth_path);
+  ground_truth << xpano::utils::json::Dump(
+      GroundTruth(*options, cameras, files));
+  if (!ground_truth) {
+    spdlog::error("Failed to write {}", ground_truth_path.string());
+    return -1;
+  }
+  spdlog::info("Rendered {} images into {}", files.size(),
+               options->output_dir.string());
+  return 0;
+}
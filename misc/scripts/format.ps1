@@ -1,4 +1,5 @@
 $xpano_sources = @(Get-ChildItem -Recurse -Path xpano/ -Include *.cc,*.h).fullname
 $test_sources = @(Get-ChildItem -Recurse -Path tests/ -Include *.cc,*.h).fullname
+$benchmark_sources = @(Get-ChildItem -Recurse -Path benchmarks/ -Include *.cc,*.h).fullname
 
-clang-format -i @($xpano_sources + $test_sources)
+clang-format -i @($xpano_sources + $test_sources + $benchmark_sources)
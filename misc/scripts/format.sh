@@ -1,2 +1,3 @@
 clang-format-18 -i `find xpano -name *.cc -or -name *.h`
-clang-format-18 -i `find tests -name *.cc -or -name *.h`
\ No newline at end of file
+clang-format-18 -i `find tests -name *.cc -or -name *.h`
+clang-format-18 -i `find benchmarks -name *.cc -or -name *.h`
\ No newline at end of file
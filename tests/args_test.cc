@@ -103,3 +103,136 @@ TEST_CASE("Args parse gui and output incompatible") {
   auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
   REQUIRE(!args);
 }
+
+TEST_CASE("Args parse batch") {
+  auto test_args =
+      xpano::tests::Args("xpano", "input1.jpg", "input2.jpg",
+                         "--output-dir=panos", "--max-memory=2048");
+
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(args);
+  REQUIRE(args->input_paths.size() == 2);
+  REQUIRE(!args->output_path);
+  REQUIRE(args->output_dir);
+  REQUIRE(*args->output_dir == "panos");
+  REQUIRE(args->max_memory_mib);
+  REQUIRE(*args->max_memory_mib == 2048);
+}
+
+TEST_CASE("Args parse batch with output") {
+  auto test_args =
+      xpano::tests::Args("xpano", "input1.jpg", "input2.jpg",
+                         "--output-dir=panos", "--output=output.jpg");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(!args);
+}
+
+TEST_CASE("Args parse batch invalid memory") {
+  auto test_args = xpano::tests::Args("xpano", "input1.jpg",
+                                      "--output-dir=panos", "--max-memory=0");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(!args);
+}
+
+TEST_CASE("Args parse batch junk memory") {
+  auto test_args = xpano::tests::Args(
+      "xpano", "input1.jpg", "--output-dir=panos", "--max-memory=12abc");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(!args);
+}
+
+TEST_CASE("Args parse batch manifest") {
+  auto test_args = xpano::tests::Args("xpano", "--batch=jobs.json",
+                                      "--max-memory=4096");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(args);
+  REQUIRE(args->input_paths.empty());
+  REQUIRE(args->batch_manifest);
+  REQUIRE(*args->batch_manifest == "jobs.json");
+  REQUIRE(args->max_memory_mib);
+  REQUIRE(*args->max_memory_mib == 4096);
+}
+
+TEST_CASE("Args parse batch manifest with inputs") {
+  auto test_args =
+      xpano::tests::Args("xpano", "input1.jpg", "--batch=jobs.json");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(!args);
+}
+
+TEST_CASE("Args parse watch") {
+  auto test_args =
+      xpano::tests::Args("xpano", "--watch=spool", "--output-dir=panos");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(args);
+  REQUIRE(args->input_paths.empty());
+  REQUIRE(args->watch_dir);
+  REQUIRE(*args->watch_dir == "spool");
+  REQUIRE(args->output_dir);
+  REQUIRE(*args->output_dir == "panos");
+}
+
+TEST_CASE("Args parse watch without output dir") {
+  auto test_args = xpano::tests::Args("xpano", "--watch=spool");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(!args);
+}
+
+TEST_CASE("Args parse watch with output dir inside") {
+  for (const auto* output_dir :
+       {"--output-dir=spool", "--output-dir=spool/", "--output-dir=./spool",
+        "--output-dir=spool/panos"}) {
+    auto test_args = xpano::tests::Args("xpano", "--watch=spool", output_dir);
+    auto args =
+        xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+    CHECK(!args);
+  }
+
+  auto test_args = xpano::tests::Args("xpano", "--watch=spool",
+                                      "--output-dir=spool_panos");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  CHECK(args);
+}
+
+TEST_CASE("Args parse watch with inputs") {
+  auto test_args = xpano::tests::Args("xpano", "input1.jpg", "--watch=spool",
+                                      "--output-dir=panos");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(!args);
+}
+
+TEST_CASE("Args parse stats") {
+  auto test_args = xpano::tests::Args("xpano", "input1.jpg", "input2.jpg",
+                                      "--output=output.jpg", "--stats=json");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(args);
+  REQUIRE(args->print_stats);
+}
+
+TEST_CASE("Args parse stats unsupported format") {
+  auto test_args = xpano::tests::Args("xpano", "input1.jpg", "--stats=csv");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(!args);
+}
+
+TEST_CASE("Args parse stats without inputs") {
+  auto test_args = xpano::tests::Args("xpano", "--stats=json");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(!args);
+}
+
+TEST_CASE("Args parse trace") {
+  auto test_args = xpano::tests::Args("xpano", "input1.jpg", "--output=out.jpg",
+                                      "--trace=trace.json");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(args);
+  REQUIRE(args->trace_path);
+  REQUIRE(*args->trace_path == "trace.json");
+}
+
+TEST_CASE("Args parse trace with gui") {
+  auto test_args =
+      xpano::tests::Args("xpano", "input1.jpg", "--gui", "--trace=trace.json");
+  auto args = xpano::cli::ParseArgs(test_args.GetArgc(), test_args.GetArgv());
+  REQUIRE(!args);
+}
@@ -0,0 +1,102 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/budget.h"
+
+#include <chrono>
+#include <future>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include <catch2/catch_test_macros.hpp>
+
+using xpano::utils::mt::Budget;
+using xpano::utils::mt::Lease;
+
+constexpr auto kNoWait = std::chrono::milliseconds(0);
+
+TEST_CASE("Budget max jobs") {
+  Budget budget(2, 100);
+
+  auto first = budget.Acquire(10, kNoWait);
+  auto second = budget.Acquire(10, kNoWait);
+  REQUIRE(first);
+  REQUIRE(second);
+  CHECK(budget.RunningJobs() == 2);
+  CHECK_FALSE(budget.Acquire(10, kNoWait));
+
+  second.reset();
+  CHECK(budget.RunningJobs() == 1);
+  CHECK(budget.Acquire(10, kNoWait));
+}
+
+TEST_CASE("Budget max cost") {
+  Budget budget(4, 100);
+
+  auto first = budget.Acquire(60, kNoWait);
+  REQUIRE(first);
+  CHECK_FALSE(budget.Acquire(60, kNoWait));
+  CHECK(budget.Acquire(40, kNoWait));
+  CHECK(budget.RunningJobs() == 1);
+}
+
+TEST_CASE("Budget oversized job") {
+  Budget budget(4, 100);
+
+  auto oversized = budget.Acquire(500, kNoWait);
+  REQUIRE(oversized);
+  CHECK_FALSE(budget.Acquire(1, kNoWait));
+
+  oversized.reset();
+  CHECK(budget.Acquire(500, kNoWait));
+}
+
+TEST_CASE("Budget wait for release") {
+  Budget budget(1, 100);
+
+  auto lease = budget.Acquire(10, kNoWait);
+  REQUIRE(lease);
+
+  auto waiting = std::async(std::launch::async, [&budget]() {
+    return budget.Acquire(10, std::chrono::seconds(10)).has_value();
+  });
+  auto release =
+      std::async(std::launch::async, [lease = std::move(lease)]() mutable {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        lease.reset();
+      });
+  release.wait();
+  CHECK(waiting.get());
+}
+
+TEST_CASE("Budget lease move") {
+  Budget budget(1, 100);
+  {
+    auto lease = budget.Acquire(10, kNoWait);
+    REQUIRE(lease);
+    const Lease moved = std::move(*lease);
+    lease.reset();
+    CHECK(budget.RunningJobs() == 1);
+  }
+  CHECK(budget.RunningJobs() == 0);
+}
+
+TEST_CASE("Budget lease move assignment") {
+  Budget budget(2, 100);
+
+  std::optional<Lease> lease;
+  lease = budget.Acquire(10, kNoWait);
+  REQUIRE(lease);
+  auto other = budget.Acquire(20, kNoWait);
+  REQUIRE(other);
+  CHECK(budget.RunningJobs() == 2);
+
+  *lease = std::move(*other);
+  CHECK(budget.RunningJobs() == 1);
+  other.reset();
+  CHECK(budget.RunningJobs() == 1);
+  CHECK_FALSE(budget.Acquire(90, kNoWait));
+  lease.reset();
+  CHECK(budget.RunningJobs() == 0);
+}
@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/server/http.h"
+
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace xpano::server;
+
+TEST_CASE("Http header end") {
+  CHECK_FALSE(http::HeaderEnd("GET / HTTP/1.1\r\nHost: x\r\n"));
+  const std::string data = "GET / HTTP/1.1\r\nHost: x\r\n\r\nbody";
+  auto end = http::HeaderEnd(data);
+  REQUIRE(end);
+  CHECK(data.substr(*end) == "body");
+}
+
+TEST_CASE("Http parse head") {
+  auto request = http::ParseHead(
+      "POST /uploads/a%20b/?name=img+1.jpg&flag HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "Content-Length:  12 \r\n\r\n");
+  REQUIRE(request);
+  CHECK(request->method == "POST");
+  CHECK(request->path == std::vector<std::string>{"uploads", "a b"});
+  CHECK(request->query.at("name") == "img 1.jpg");
+  CHECK(request->query.at("flag").empty());
+  CHECK(request->headers.at("host") == "localhost");
+  CHECK(http::ContentLength(*request) == 12);
+}
+
+TEST_CASE("Http parse head errors") {
+  CHECK_FALSE(http::ParseHead("GET /\r\n\r\n"));
+  CHECK_FALSE(http::ParseHead("GET jobs HTTP/1.1\r\n\r\n"));
+  CHECK_FALSE(http::ParseHead("GET / SPDY/3\r\n\r\n"));
+  CHECK_FALSE(http::ParseHead("GET / HTTP/1.1\r\nno colon\r\n\r\n"));
+
+  auto request = http::ParseHead("GET / HTTP/1.1\r\nContent-Length: x\r\n\r\n");
+  REQUIRE(request);
+  CHECK_FALSE(http::ContentLength(*request));
+}
+
+TEST_CASE("Http no content length") {
+  auto request = http::ParseHead("GET /jobs HTTP/1.1\r\n\r\n");
+  REQUIRE(request);
+  CHECK(request->path == std::vector<std::string>{"jobs"});
+  CHECK(http::ContentLength(*request) == 0);
+}
+
+TEST_CASE("Http format") {
+  const http::Response response{.status = 404, .body = "{}"};
+  CHECK(http::Format(response) ==
+        "HTTP/1.1 404 Not Found\r\nContent-Type: application/json\r\n"
+        "Content-Length: 2\r\nConnection: close\r\n\r\n{}");
+}
+
+TEST_CASE("Http chunks") {
+  CHECK(http::FormatChunkedHead(200, "text/plain").ends_with(
+      "Transfer-Encoding: chunked\r\nConnection: close\r\n\r\n"));
+  CHECK(http::FormatChunk(std::string(26, 'a')) ==
+        "1a\r\n" + std::string(26, 'a') + "\r\n");
+  CHECK(http::FormatChunk("") == "0\r\n\r\n");
+}
+
+TEST_CASE("Http percent decode") {
+  CHECK(http::PercentDecode("a%2Fb%20c") == "a/b c");
+  CHECK(http::PercentDecode("100%") == "100%");
+  CHECK(http::PercentDecode("%zz") == "%zz");
+}
@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/json.h"
+
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+using xpano::utils::json::Dump;
+using xpano::utils::json::Parse;
+using xpano::utils::json::Value;
+
+TEST_CASE("Json parse") {
+  auto result = Parse(R"({
+    "name": "pano \"1\"",
+    "count": 3,
+    "scale": -1.5e2,
+    "enabled": true,
+    "parent": null,
+    "inputs": ["a.jpg", "b.jpg"],
+    "nested": {"unicode": "\u00e9\ud83d\ude00"}
+  })");
+  REQUIRE(result);
+  const auto& root = *result;
+  REQUIRE(root.IsObject());
+  CHECK(root.AsObject().size() == 7);
+
+  CHECK(root.Find("name")->AsString() == "pano \"1\"");
+  CHECK(root.Find("count")->AsNumber() == 3.0);
+  CHECK(root.Find("scale")->AsNumber() == -150.0);
+  CHECK(root.Find("enabled")->AsBool());
+  CHECK(root.Find("parent")->IsNull());
+  CHECK(root.Find("missing") == nullptr);
+
+  const auto& inputs = root.Find("inputs")->AsArray();
+  REQUIRE(inputs.size() == 2);
+  CHECK(inputs[1].AsString() == "b.jpg");
+
+  const auto* unicode = root.Find("nested")->Find("unicode");
+  REQUIRE(unicode != nullptr);
+  CHECK(unicode->AsString() == "\xc3\xa9\xf0\x9f\x98\x80");
+}
+
+TEST_CASE("Json parse errors") {
+  CHECK_FALSE(Parse(""));
+  CHECK_FALSE(Parse("{"));
+  CHECK_FALSE(Parse("[1, 2,]"));
+  CHECK_FALSE(Parse("{\"a\" 1}"));
+  CHECK_FALSE(Parse("\"unterminated"));
+  CHECK_FALSE(Parse("tru"));
+  CHECK_FALSE(Parse("1 2"));
+  CHECK_FALSE(Parse("\"\\ud83d\""));
+
+  auto result = Parse("{\n  \"a\": 1,\n  \"b\": ?\n}");
+  REQUIRE_FALSE(result);
+  CHECK(result.error().find("line 3") == 0);
+}
+
+TEST_CASE("Json dump") {
+  Value value = Value::Object{
+      {"status", "ok"},
+      {"seconds", 1.5},
+      {"images", 4},
+      {"output", nullptr},
+      {"flags", Value::Array{true, false}},
+      {"empty", Value::Object{}},
+      {"path", "C:\\pano\n"},
+  };
+
+  auto text = Dump(value);
+  CHECK(text ==
+        "{\n"
+        "  \"status\": \"ok\",\n"
+        "  \"seconds\": 1.5,\n"
+        "  \"images\": 4,\n"
+        "  \"output\": null,\n"
+        "  \"flags\": [\n"
+        "    true,\n"
+        "    false\n"
+        "  ],\n"
+        "  \"empty\": {},\n"
+        "  \"path\": \"C:\\\\pano\\n\"\n"
+        "}\n");
+
+  auto parsed = Parse(text);
+  REQUIRE(parsed);
+  CHECK(parsed->Find("path")->AsString() == "C:\\pano\n");
+  CHECK(parsed->Find("images")->AsNumber() == 4.0);
+}
@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/lru_cache.h"
+
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+using xpano::utils::LruCache;
+
+TEST_CASE("LruCache find") {
+  LruCache<int, std::string> cache(100);
+  CHECK_FALSE(cache.Find(1));
+
+  cache.Insert(1, "one", 10);
+  cache.Insert(2, "two", 10);
+  CHECK(cache.Find(1) == "one");
+  CHECK(cache.Find(2) == "two");
+  CHECK(cache.Cost() == 20);
+
+  // Replaced
+  cache.Insert(1, "uno", 30);
+  CHECK(cache.Find(1) == "uno");
+  CHECK(cache.Cost() == 40);
+}
+
+TEST_CASE("LruCache evicts least recently used") {
+  LruCache<int, std::string> cache(30);
+  cache.Insert(1, "one", 10);
+  cache.Insert(2, "two", 10);
+  cache.Insert(3, "three", 10);
+
+  // 2 is now the least recently used
+  CHECK(cache.Find(1));
+  cache.Insert(4, "four", 10);
+  CHECK_FALSE(cache.Find(2));
+  CHECK(cache.Find(1));
+  CHECK(cache.Find(3));
+  CHECK(cache.Find(4));
+  CHECK(cache.Cost() == 30);
+
+  cache.Insert(5, "five", 25);
+  CHECK(cache.Find(5));
+  CHECK(cache.Cost() <= 30);
+}
+
+TEST_CASE("LruCache too expensive") {
+  LruCache<int, std::string> cache(30);
+  cache.Insert(1, "one", 10);
+  cache.Insert(2, "two", 40);
+  CHECK_FALSE(cache.Find(2));
+  CHECK(cache.Find(1));
+  CHECK(cache.Cost() == 10);
+}
+
+TEST_CASE("LruCache erase") {
+  LruCache<int, std::string> cache(100);
+  cache.Insert(1, "one", 10);
+  cache.Insert(2, "two", 10);
+  cache.Insert(3, "three", 10);
+
+  cache.EraseIf([](int key) { return key % 2 == 1; });
+  CHECK_FALSE(cache.Find(1));
+  CHECK(cache.Find(2));
+  CHECK_FALSE(cache.Find(3));
+  CHECK(cache.Cost() == 10);
+
+  cache.Clear();
+  CHECK_FALSE(cache.Find(2));
+  CHECK(cache.Cost() == 0);
+}
@@ -0,0 +1,109 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/cli/manifest.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "xpano/algorithm/options.h"
+#include "xpano/pipeline/stitcher_pipeline.h"
+
+using xpano::cli::manifest::Parse;
+using xpano::cli::manifest::ResultsToJson;
+
+TEST_CASE("Manifest parse") {
+  const std::filesystem::path base_dir = "batch";
+  auto manifest = Parse(R"({
+    "max_jobs": 2,
+    "max_memory": 4096,
+    "results": "out/results.json",
+    "defaults": {"full_res": true, "projection": "cylindrical"},
+    "jobs": [
+      {"inputs": ["a1.jpg", "a2.jpg"], "output": "out/a.jpg"},
+      {
+        "inputs": ["b1.jpg", "b2.jpg", "b3.jpg"],
+        "output": "out/b.tif",
+        "options": {
+          "projection": "fisheye",
+          "wave_correction": "OFF",
+          "jpeg_quality": 80
+        }
+      }
+    ]
+  })",
+                        base_dir);
+  REQUIRE(manifest);
+  CHECK(manifest->batch.max_jobs == 2);
+  CHECK(manifest->batch.memory_budget_mib == 4096);
+  CHECK(manifest->results_path == base_dir / "out/results.json");
+  REQUIRE(manifest->jobs.size() == 2);
+
+  const auto& first = manifest->jobs[0];
+  REQUIRE(first.inputs.size() == 2);
+  CHECK(first.inputs[0] == base_dir / "a1.jpg");
+  CHECK(first.stitching.export_path == base_dir / "out/a.jpg");
+  CHECK(first.stitching.full_res);
+  CHECK(first.stitching.stitch_algorithm.projection.type ==
+        xpano::algorithm::ProjectionType::kCylindrical);
+
+  const auto& second = manifest->jobs[1];
+  CHECK(second.inputs.size() == 3);
+  CHECK(second.stitching.full_res);
+  CHECK(second.stitching.stitch_algorithm.projection.type ==
+        xpano::algorithm::ProjectionType::kFisheye);
+  CHECK(second.stitching.stitch_algorithm.wave_correction ==
+        xpano::algorithm::WaveCorrectionType::kOff);
+  CHECK(second.stitching.compression.jpeg_quality == 80);
+}
+
+TEST_CASE("Manifest parse errors") {
+  CHECK_FALSE(Parse("{", ""));
+  CHECK_FALSE(Parse("{}", ""));
+  CHECK_FALSE(Parse(R"({"jobs": [{"output": "a.jpg"}]})", ""));
+  CHECK_FALSE(Parse(R"({"jobs": [{"inputs": ["a.jpg"]}]})", ""));
+  CHECK_FALSE(
+      Parse(R"({"jobs": [{"inputs": ["a.jpg"], "output": "a.txt"}]})", ""));
+  CHECK_FALSE(Parse(R"({"jobs": [], "max_memory": 0})", ""));
+  CHECK_FALSE(Parse(R"({"jobs": [], "unknown": 1})", ""));
+  CHECK_FALSE(Parse(R"({"jobs": [], "defaults": {"jpeg_quality": 101}})", ""));
+  CHECK_FALSE(
+      Parse(R"({"jobs": [], "defaults": {"projection": "unknown"}})", ""));
+
+  auto manifest = Parse(
+      R"({"jobs": [{"inputs": ["a.jpg"], "output": "a.jpg", "x": 1}]})", "");
+  REQUIRE_FALSE(manifest);
+  CHECK(manifest.error() == "Job 0: Unknown job key \"x\"");
+}
+
+TEST_CASE("Manifest results") {
+  auto manifest = Parse(R"({"jobs": [
+    {"inputs": ["a1.jpg", "a2.jpg"], "output": "a.jpg"},
+    {"inputs": ["b1.jpg", "b2.jpg"], "output": "b.jpg"}
+  ]})",
+                        "");
+  REQUIRE(manifest);
+
+  std::vector<xpano::pipeline::BatchJobResult> results(2);
+  results[0].job_id = 0;
+  results[0].num_images = 2;
+  results[1].job_id = 1;
+  results[1].error = "Failed to load 1 of 2 images";
+
+  auto json = ResultsToJson(*manifest, results, 1.5);
+  CHECK(json.Find("total_seconds")->AsNumber() == 1.5);
+  CHECK(json.Find("succeeded")->AsNumber() == 1);
+  CHECK(json.Find("failed")->AsNumber() == 1);
+
+  const auto& jobs = json.Find("jobs")->AsArray();
+  REQUIRE(jobs.size() == 2);
+  CHECK(jobs[0].Find("status")->AsString() == "ok");
+  CHECK(jobs[0].Find("output")->AsString() == "a.jpg");
+  CHECK(jobs[0].Find("images")->AsNumber() == 2);
+  CHECK(jobs[0].Find("error") == nullptr);
+  CHECK(jobs[1].Find("status")->AsString() == "failed");
+  CHECK(jobs[1].Find("error")->AsString() == "Failed to load 1 of 2 images");
+}
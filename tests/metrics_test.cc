@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/metrics.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using xpano::utils::metrics::Recorder;
+using xpano::utils::metrics::ScopedStage;
+
+TEST_CASE("Metrics scoped stage") {
+  Recorder recorder;
+  {
+    const ScopedStage stage(&recorder, "sleep");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+
+  auto stages = recorder.Snapshot();
+  REQUIRE(stages.size() == 1);
+  CHECK(stages[0].name == "sleep");
+  CHECK(stages[0].count == 1);
+  CHECK(stages[0].wall_seconds >= 0.015);
+  CHECK(stages[0].cpu_seconds >= 0.0);
+  CHECK(stages[0].peak_rss_bytes >= 0);
+}
+
+TEST_CASE("Metrics next stage") {
+  Recorder recorder;
+  {
+    ScopedStage stage(&recorder, "first");
+    stage.Next("second");
+    stage.Next("third");
+    stage.End();
+    stage.End();
+  }
+
+  auto stages = recorder.Snapshot();
+  REQUIRE(stages.size() == 3);
+  CHECK(stages[0].name == "first");
+  CHECK(stages[1].name == "second");
+  CHECK(stages[2].name == "third");
+  CHECK(stages[2].count == 1);
+}
+
+TEST_CASE("Metrics aggregate by name") {
+  Recorder recorder;
+  std::vector<std::thread> threads;
+  threads.reserve(4);
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&recorder]() {
+      const ScopedStage first(&recorder, "match");
+      const ScopedStage second(&recorder, "other");
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto stages = recorder.Snapshot();
+  REQUIRE(stages.size() == 2);
+  for (const auto& stage : stages) {
+    CHECK(stage.count == 4);
+  }
+}
+
+TEST_CASE("Metrics labeled occurrences") {
+  Recorder recorder;
+  {
+    const ScopedStage first(&recorder, "match", "0-1");
+    const ScopedStage second(&recorder, "match", "1-2");
+    ScopedStage unlabeled(&recorder, "match");
+    unlabeled.End();
+    ScopedStage image(&recorder, "decode", "2");
+    image.Next("keypoints");
+  }
+
+  auto stages = recorder.Snapshot();
+  REQUIRE(stages.size() == 3);
+  CHECK(stages[0].name == "match");
+  CHECK(stages[0].count == 3);
+  REQUIRE(stages[0].occurrences.size() == 2);
+  // In the order they ended
+  CHECK(stages[0].occurrences[0].name == "1-2");
+  CHECK(stages[0].occurrences[1].name == "0-1");
+  CHECK(stages[0].occurrences[0].count == 1);
+  CHECK(stages[0].occurrences[0].occurrences.empty());
+  CHECK(stages[1].name == "decode");
+  REQUIRE(stages[1].occurrences.size() == 1);
+  CHECK(stages[1].occurrences[0].name == "2");
+  CHECK(stages[2].name == "keypoints");
+  REQUIRE(stages[2].occurrences.size() == 1);
+  CHECK(stages[2].occurrences[0].name == "2");
+}
+
+TEST_CASE("Metrics without recorder") {
+  ScopedStage stage(nullptr, "ignored");
+  stage.Next("ignored too");
+  stage.End();
+  SUCCEED();
+}
@@ -0,0 +1,284 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Compares the wall time and peak memory of a fixed part of the pipeline with
+// data/perf_baseline.json. Every test case runs in its own process, so that
+// the peak memory isn't shared between them.
+//
+// The peak RSS of the process can't be reset, so the stitching cases, which
+// have to load the images first, record how much the stitching raised the
+// peak above the one after loading. 0 means the stitching fit under the
+// memory used by the loading.
+//
+// The baseline is machine specific, the committed one pins the number of
+// threads and the tolerances. A missing baseline or a missing case fails the
+// test. To record the cases on the reference machine, run the tests in a
+// Release build with XPANO_PERF_RECORD set to the output path, e.g.
+// XPANO_PERF_RECORD=$PWD/perf_baseline.json ctest -L perf, and copy the file
+// to tests/data/perf_baseline.json.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include <catch2/catch_test_macros.hpp>
+#include <opencv2/core.hpp>
+
+#include "tests/pipeline_fixtures.h"
+#include "xpano/pipeline/stitcher_pipeline.h"
+#include "xpano/utils/json.h"
+#include "xpano/utils/metrics.h"
+
+using xpano::tests::kInputs;
+using xpano::utils::json::Value;
+
+constexpr auto kReturnFuture = xpano::pipeline::RunTraits::kReturnFuture;
+
+const std::filesystem::path kBaselinePath = "data/perf_baseline.json";
+constexpr char kRecordVariable[] = "XPANO_PERF_RECORD";
+
+// Used when recording a baseline from scratch
+constexpr int kDefaultThreads = 4;
+constexpr double kDefaultWallTolerance = 0.25;
+constexpr double kDefaultWallSlackSeconds = 0.05;
+constexpr double kDefaultMemoryTolerance = 0.15;
+constexpr double kDefaultMemorySlackBytes = 16.0 * 1024 * 1024;
+
+struct Tolerances {
+  // Relative to the baseline
+  double wall = kDefaultWallTolerance;
+  // Added on top, keeps the very short stages from failing on noise
+  double wall_slack_seconds = kDefaultWallSlackSeconds;
+  double memory = kDefaultMemoryTolerance;
+  // Added on top, a stitching case may fit under the loading peak with 0
+  double memory_slack_bytes = kDefaultMemorySlackBytes;
+};
+
+struct Measurement {
+  double wall_seconds = 0.0;
+  std::int64_t peak_rss_bytes = 0;
+  xpano::utils::metrics::Stages stages;
+};
+
+// The growth of the process peak RSS since base_rss_bytes, for the whole
+// case and for each stage
+Measurement AboveBase(Measurement measurement, std::int64_t base_rss_bytes) {
+  auto above_base = [base_rss_bytes](std::int64_t peak_rss_bytes) {
+    return std::max<std::int64_t>(peak_rss_bytes - base_rss_bytes, 0);
+  };
+  measurement.peak_rss_bytes = above_base(measurement.peak_rss_bytes);
+  for (auto& stage : measurement.stages) {
+    stage.peak_rss_bytes = above_base(stage.peak_rss_bytes);
+  }
+  return measurement;
+}
+
+std::optional<Value> ReadJson(const std::filesystem::path& path) {
+  std::ifstream file(path);
+  if (!file) {
+    return {};
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  auto value = xpano::utils::json::Parse(buffer.str());
+  if (!value) {
+    return {};
+  }
+  return *value;
+}
+
+double Number(const Value& object, const char* key, double fallback) {
+  const auto* value = object.Find(key);
+  return value != nullptr && value->IsNumber() ? value->AsNumber() : fallback;
+}
+
+Value::Object ToJson(double wall_seconds, std::int64_t peak_rss_bytes) {
+  return {{"wall_seconds", wall_seconds},
+          {"peak_rss_bytes", static_cast<double>(peak_rss_bytes)}};
+}
+
+// Replaces the case in the file at path, keeping the rest
+void Record(const std::filesystem::path& path, const std::string& name,
+            const Measurement& measurement) {
+  // A new file starts with the committed settings
+  auto previous = ReadJson(path);
+  if (!previous) {
+    previous = ReadJson(kBaselinePath);
+  }
+  const auto settings = previous.value_or(Value::Object{});
+
+  Value::Object stages;
+  for (const auto& stage : measurement.stages) {
+    stages.emplace_back(stage.name,
+                        ToJson(stage.wall_seconds, stage.peak_rss_bytes));
+  }
+  auto entry =
+      ToJson(measurement.wall_seconds, measurement.peak_rss_bytes);
+  entry.emplace_back("stages", std::move(stages));
+
+  Value::Object cases;
+  if (const auto* previous_cases = settings.Find("cases");
+      previous_cases != nullptr && previous_cases->IsObject()) {
+    for (const auto& member : previous_cases->AsObject()) {
+      if (member.first != name) {
+        cases.push_back(member);
+      }
+    }
+  }
+  cases.emplace_back(name, std::move(entry));
+
+  const Value baseline = Value::Object{
+      {"threads", Number(settings, "threads", kDefaultThreads)},
+      {"wall_tolerance",
+       Number(settings, "wall_tolerance", kDefaultWallTolerance)},
+      {"wall_slack_seconds",
+       Number(settings, "wall_slack_seconds", kDefaultWallSlackSeconds)},
+      {"memory_tolerance",
+       Number(settings, "memory_tolerance", kDefaultMemoryTolerance)},
+      {"memory_slack_bytes",
+       Number(settings, "memory_slack_bytes", kDefaultMemorySlackBytes)},
+      {"cases", std::move(cases)}};
+  std::ofstream file(path);
+  file << xpano::utils::json::Dump(baseline);
+  REQUIRE(file);
+}
+
+void CheckAgainst(const std::string& label, double wall_seconds,
+                  std::int64_t peak_rss_bytes, const Value& baseline,
+                  const Tolerances& tolerances) {
+  const double baseline_wall = Number(baseline, "wall_seconds", 0.0);
+  const double baseline_rss = Number(baseline, "peak_rss_bytes", 0.0);
+  INFO(label << ": " << wall_seconds << " s (baseline " << baseline_wall
+             << " s), " << peak_rss_bytes << " B (baseline " << baseline_rss
+             << " B)");
+  CHECK(wall_seconds <= baseline_wall * (1.0 + tolerances.wall) +
+                            tolerances.wall_slack_seconds);
+  // Not available on every platform
+  if (xpano::utils::metrics::PeakRssBytes() > 0) {
+    CHECK(static_cast<double>(peak_rss_bytes) <=
+          baseline_rss * (1.0 + tolerances.memory) +
+              tolerances.memory_slack_bytes);
+  }
+}
+
+void Compare(const std::string& name, const Measurement& measurement) {
+  if (const char* record_path = std::getenv(kRecordVariable)) {
+    Record(record_path, name, measurement);
+    return;
+  }
+
+  const auto baseline = ReadJson(kBaselinePath);
+  if (!baseline) {
+    FAIL("No baseline in " << kBaselinePath.string() << ", record one with "
+                           << kRecordVariable << "=<path>");
+  }
+  const Tolerances tolerances = {
+      .wall = Number(*baseline, "wall_tolerance", kDefaultWallTolerance),
+      .wall_slack_seconds = Number(*baseline, "wall_slack_seconds",
+                                   kDefaultWallSlackSeconds),
+      .memory = Number(*baseline, "memory_tolerance", kDefaultMemoryTolerance),
+      .memory_slack_bytes = Number(*baseline, "memory_slack_bytes",
+                                   kDefaultMemorySlackBytes),
+  };
+  const auto* cases = baseline->Find("cases");
+  const auto* entry = cases != nullptr ? cases->Find(name) : nullptr;
+  if (entry == nullptr) {
+    FAIL("No baseline for " << name << " in " << kBaselinePath.string()
+                            << ", record it with " << kRecordVariable
+                            << "=<path>");
+  }
+
+  CheckAgainst(name, measurement.wall_seconds, measurement.peak_rss_bytes,
+               *entry, tolerances);
+
+  const auto* baseline_stages = entry->Find("stages");
+  for (const auto& stage : measurement.stages) {
+    const auto* baseline_stage = baseline_stages != nullptr
+                                     ? baseline_stages->Find(stage.name)
+                                     : nullptr;
+    if (baseline_stage == nullptr) {
+      WARN("Stage " << name << "/" << stage.name << " is not in the baseline");
+      continue;
+    }
+    CheckAgainst(name + "/" + stage.name, stage.wall_seconds,
+                 stage.peak_rss_bytes, *baseline_stage, tolerances);
+  }
+}
+
+// The pipeline and OpenCV get the same number of threads as the baseline
+unsigned PinnedThreads() {
+  const auto baseline = ReadJson(kBaselinePath);
+  const auto threads = static_cast<int>(
+      baseline ? Number(*baseline, "threads", kDefaultThreads)
+               : kDefaultThreads);
+  cv::setNumThreads(threads);
+  return static_cast<unsigned>(threads);
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// Clang-tidy doesn't like the macros
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+TEST_CASE("Perf loading") {
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher(PinnedThreads());
+
+  const auto start = std::chrono::steady_clock::now();
+  auto data = stitcher.RunLoading(kInputs, {}, {}).future.get();
+  const double wall_seconds = SecondsSince(start);
+  REQUIRE(data.panos.size() == 2);
+
+  Compare("loading", {.wall_seconds = wall_seconds,
+                      .peak_rss_bytes = xpano::utils::metrics::PeakRssBytes(),
+                      .stages = data.metrics});
+}
+
+TEST_CASE("Perf preview stitching") {
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher(PinnedThreads());
+  auto data = stitcher.RunLoading(kInputs, {}, {}).future.get();
+  REQUIRE(data.panos.size() == 2);
+  const auto loaded_rss = xpano::utils::metrics::PeakRssBytes();
+
+  const auto start = std::chrono::steady_clock::now();
+  auto result = stitcher.RunStitching(data, {.pano_id = 0}).future.get();
+  const double wall_seconds = SecondsSince(start);
+  REQUIRE(result.pano.has_value());
+
+  Compare("stitch_preview",
+          AboveBase({.wall_seconds = wall_seconds,
+                     .peak_rss_bytes = xpano::utils::metrics::PeakRssBytes(),
+                     .stages = result.metrics},
+                    loaded_rss));
+}
+
+TEST_CASE("Perf full resolution stitching") {
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher(PinnedThreads());
+  auto data = stitcher.RunLoading(kInputs, {}, {}).future.get();
+  REQUIRE(data.panos.size() == 2);
+  const auto loaded_rss = xpano::utils::metrics::PeakRssBytes();
+
+  const auto start = std::chrono::steady_clock::now();
+  auto result = stitcher.RunStitching(data, {.pano_id = 1, .full_res = true})
+                    .future.get();
+  const double wall_seconds = SecondsSince(start);
+  REQUIRE(result.pano.has_value());
+
+  Compare("stitch_full_res",
+          AboveBase({.wall_seconds = wall_seconds,
+                     .peak_rss_bytes = xpano::utils::metrics::PeakRssBytes(),
+                     .stages = result.metrics},
+                    loaded_rss));
+}
+
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,19 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+namespace xpano::tests {
+
+// Two panos: images 1-5 and 6-8
+inline const std::vector<std::filesystem::path> kInputs = {
+    "data/image00.jpg", "data/image01.jpg", "data/image02.jpg",
+    "data/image03.jpg", "data/image04.jpg", "data/image05.jpg",
+    "data/image06.jpg", "data/image07.jpg", "data/image08.jpg",
+    "data/image09.jpg",
+};
+
+}  // namespace xpano::tests
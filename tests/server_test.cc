@@ -0,0 +1,201 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/server/job_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "xpano/server/http.h"
+#include "xpano/server/socket.h"
+#include "xpano/utils/fmt.h"
+#include "xpano/utils/json.h"
+
+using namespace xpano::server;
+using xpano::utils::json::Value;
+
+namespace {
+
+struct Reply {
+  int status = 0;
+  std::string body;
+};
+
+Reply Send(int port, const std::string& method, const std::string& target,
+           const std::string& body = "") {
+  const Socket client(socket(AF_INET, SOCK_STREAM, 0));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(static_cast<std::uint16_t>(port));
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (connect(client.Fd(), reinterpret_cast<sockaddr*>(&address),
+              sizeof(address)) != 0) {
+    return {};
+  }
+  SendAll(client, fmt::format("{} {} HTTP/1.1\r\nContent-Length: {}\r\n\r\n{}",
+                              method, target, body.size(), body));
+
+  std::string response;
+  std::string buffer(4096, '\0');
+  for (auto size = recv(client.Fd(), buffer.data(), buffer.size(), 0); size > 0;
+       size = recv(client.Fd(), buffer.data(), buffer.size(), 0)) {
+    response.append(buffer.data(), size);
+  }
+  auto head_end = http::HeaderEnd(response);
+  if (!head_end) {
+    return {};
+  }
+  // "HTTP/1.1 200 OK"
+  return {.status = std::stoi(response.substr(9, 3)),
+          .body = response.substr(*head_end)};
+}
+
+Value SendJson(int port, const std::string& method, const std::string& target,
+               const std::string& body = "") {
+  auto reply = Send(port, method, target, body);
+  auto json = xpano::utils::json::Parse(reply.body);
+  REQUIRE(json);
+  return *json;
+}
+
+std::string ReadFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+class RunningServer {
+ public:
+  RunningServer() : server_({.port = 0, .batch = {.max_jobs = 2}}) {
+    REQUIRE(server_.Start());
+    thread_ = std::thread([this]() { server_.Serve(stop_); });
+  }
+
+  ~RunningServer() {
+    stop_ = true;
+    thread_.join();
+  }
+
+  RunningServer(const RunningServer&) = delete;
+  RunningServer& operator=(const RunningServer&) = delete;
+  RunningServer(RunningServer&&) = delete;
+  RunningServer& operator=(RunningServer&&) = delete;
+
+  [[nodiscard]] int Port() const { return server_.Port(); }
+
+ private:
+  JobServer server_;
+  std::atomic_bool stop_ = false;
+  std::thread thread_;
+};
+
+std::string WaitForJob(int port, int job_id) {
+  const auto target = fmt::format("/jobs/{}", job_id);
+  for (int i = 0; i < 600; i++) {
+    auto status = SendJson(port, "GET", target);
+    const auto& state = status.Find("state")->AsString();
+    if (state != "running") {
+      return state;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  return "timeout";
+}
+
+}  // namespace
+
+TEST_CASE("Server job") {
+  const RunningServer server;
+  const int port = server.Port();
+
+  auto upload = SendJson(port, "POST", "/uploads?name=image08.jpg",
+                         ReadFile("data/image08.jpg"));
+  REQUIRE(upload.Find("id") != nullptr);
+  const auto upload_id = upload.Find("id")->AsNumber();
+
+  const auto request = xpano::utils::json::Dump(Value::Object{
+      {"inputs", Value::Array{"data/image06.jpg", "data/image07.jpg"}},
+      {"uploads", Value::Array{upload_id}},
+      {"format", "png"},
+      {"options", Value::Object{{"projection", "spherical"}}}});
+  auto submitted = SendJson(port, "POST", "/jobs", request);
+  REQUIRE(submitted.Find("id") != nullptr);
+  const int job_id = static_cast<int>(submitted.Find("id")->AsNumber());
+  // Taken by the first job
+  CHECK(Send(port, "POST", "/jobs", request).status == 400);
+
+  auto progress = Send(port, "GET", fmt::format("/jobs/{}/progress", job_id));
+  CHECK(progress.status == 200);
+  CHECK(progress.body.ends_with("0\r\n\r\n"));
+  CHECK(progress.body.find(R"("state": "done")") != std::string::npos);
+
+  CHECK(WaitForJob(port, job_id) == "done");
+  auto result = Send(port, "GET", fmt::format("/jobs/{}/result", job_id));
+  CHECK(result.status == 200);
+  CHECK(result.body.starts_with("\x89PNG"));
+
+  auto jobs = SendJson(port, "GET", "/jobs");
+  CHECK(jobs.AsArray().size() == 1);
+
+  CHECK(Send(port, "DELETE", fmt::format("/jobs/{}", job_id)).status == 200);
+  CHECK(Send(port, "GET", fmt::format("/jobs/{}", job_id)).status == 404);
+}
+
+TEST_CASE("Server failed job") {
+  const RunningServer server;
+  const int port = server.Port();
+
+  auto submitted = SendJson(port, "POST", "/jobs",
+                            R"({"inputs": ["data/missing.jpg"]})");
+  REQUIRE(submitted.Find("id") != nullptr);
+  const int job_id = static_cast<int>(submitted.Find("id")->AsNumber());
+  CHECK(WaitForJob(port, job_id) == "failed");
+  CHECK(Send(port, "GET", fmt::format("/jobs/{}/result", job_id)).status ==
+        409);
+}
+
+TEST_CASE("Server bad requests") {
+  const RunningServer server;
+  const int port = server.Port();
+
+  CHECK(Send(port, "GET", "/nothing").status == 404);
+  CHECK(Send(port, "GET", "/jobs/7").status == 404);
+  CHECK(Send(port, "PUT", "/jobs").status == 405);
+  CHECK(Send(port, "POST", "/jobs", "{").status == 400);
+  CHECK(Send(port, "POST", "/jobs", R"({"inputs": []})").status == 400);
+  CHECK(Send(port, "POST", "/jobs", R"({"uploads": [7]})").status == 400);
+  CHECK(Send(port, "POST", "/jobs", R"({"uploads": [-1]})").status == 400);
+  CHECK(Send(port, "POST", "/jobs",
+             R"({"inputs": ["a.jpg"], "format": "dzi"})")
+            .status == 400);
+  CHECK(Send(port, "POST", "/jobs",
+             R"({"inputs": ["a.jpg"], "format": "ptif"})")
+            .status == 400);
+  CHECK(Send(port, "POST", "/jobs",
+             R"({"inputs": ["a.jpg"], "format": "/../../escaped.jpg"})")
+            .status == 400);
+  CHECK(Send(port, "POST", "/jobs",
+             R"({"inputs": ["a.jpg"], "format": "jpg/../../x.png"})")
+            .status == 400);
+  CHECK(SendJson(port, "GET", "/jobs").AsArray().empty());
+  CHECK(Send(port, "POST", "/jobs",
+             R"({"inputs": ["a.jpg"], "options": {"unknown": 1}})")
+            .status == 400);
+  CHECK(Send(port, "POST", "/uploads?name=notes.txt", "text").status == 400);
+  CHECK(Send(port, "POST", "/uploads", "text").status == 400);
+}
@@ -6,7 +6,9 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <cstddef>
 #include <filesystem>
+#include <fstream>
 #include <future>
 #include <iterator>
 #include <optional>
@@ -24,6 +26,7 @@
 
 #include "xpano/algorithm/algorithm.h"
 #include "xpano/pipeline/options.h"
+#include "xpano/pipeline/session.h"
 #include "xpano/utils/vec.h"
 
 #ifdef XPANO_WITH_EXIV2
@@ -33,27 +36,25 @@
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include "tests/pipeline_fixtures.h"
 #include "tests/utils.h"
 #include "xpano/algorithm/options.h"
 #include "xpano/algorithm/stitcher.h"
 #include "xpano/constants.h"
+#include "xpano/utils/fmt.h"
 #include "xpano/utils/opencv.h"
 #include "xpano/utils/rect.h"
 #include "xpano/utils/vec_opencv.h"
 
+using Catch::Matchers::ContainsSubstring;
 using Catch::Matchers::Equals;
+using Catch::Matchers::VectorContains;
 using Catch::Matchers::WithinAbs;
 using Catch::Matchers::WithinRel;
+using xpano::tests::kInputs;
 
 constexpr auto kReturnFuture = xpano::pipeline::RunTraits::kReturnFuture;
 
-const std::vector<std::filesystem::path> kInputs = {
-    "data/image00.jpg", "data/image01.jpg", "data/image02.jpg",
-    "data/image03.jpg", "data/image04.jpg", "data/image05.jpg",
-    "data/image06.jpg", "data/image07.jpg", "data/image08.jpg",
-    "data/image09.jpg",
-};
-
 int CountNonZero(const cv::Mat& image) {
   cv::Mat image_gray;
   cv::cvtColor(image, image_gray, cv::COLOR_BGR2GRAY);
@@ -159,6 +160,254 @@ TEST_CASE("Stitcher pipeline defaults [extra results]") {
   CHECK(stitch_result1.cameras->cameras.size() == 3);
 }
 
+TEST_CASE("Pyramid inpainting") {
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+
+  auto loading_task = stitcher.RunLoading(kInputs, {}, {});
+  auto result = loading_task.future.get();
+  REQUIRE(result.panos.size() == 2);
+
+  auto stitching_task = stitcher.RunStitching(result, {.pano_id = 0});
+  auto stitch_result = stitching_task.future.get();
+  REQUIRE(stitch_result.pano.has_value());
+  REQUIRE(stitch_result.mask.has_value());
+  auto total_pixels = stitch_result.pano->rows * stitch_result.pano->cols;
+
+  auto inpaint_task = stitcher.RunInpainting(
+      *stitch_result.pano, *stitch_result.mask,
+      {.method = xpano::algorithm::InpaintingMethod::kPyramid});
+  auto inpaint_result = inpaint_task.future.get();
+  auto progress = inpaint_task.progress->Report();
+  CHECK(progress.tasks_done == progress.num_tasks);
+
+  auto pano_pixels = CountNonZero(*stitch_result.pano);
+  CHECK(total_pixels == inpaint_result.pixels_inpainted + pano_pixels);
+
+  auto non_zero_pixels = CountNonZero(inpaint_result.pano);
+  CHECK(total_pixels == non_zero_pixels);
+
+  // known pixels are left untouched
+  cv::Mat diff;
+  cv::absdiff(*stitch_result.pano, inpaint_result.pano, diff);
+  cv::Mat diff_gray;
+  cv::cvtColor(diff, diff_gray, cv::COLOR_BGR2GRAY);
+  cv::Mat changed_known_pixels;
+  cv::bitwise_and(diff_gray, *stitch_result.mask, changed_known_pixels);
+  CHECK(cv::countNonZero(changed_known_pixels) == 0);
+}
+
+TEST_CASE("Live canvas") {
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+
+  auto loading_task = stitcher.RunLoading(kInputs, {}, {});
+  auto result = loading_task.future.get();
+  REQUIRE(result.panos.size() == 2);
+
+  auto stitching_task =
+      stitcher.RunStitching(result, {.pano_id = 0, .live_canvas = true});
+  auto stitch_result = stitching_task.future.get();
+  REQUIRE(stitch_result.pano.has_value());
+  REQUIRE(stitching_task.live_canvas);
+
+  // Prepared once, then pasted into
+  CHECK(stitching_task.live_canvas->Version() > 1);
+  auto canvas = stitching_task.live_canvas->Snapshot();
+  CHECK(std::max(canvas.rows, canvas.cols) == xpano::kLiveCanvasSize);
+  const auto& pano = *stitch_result.pano;
+  CHECK_THAT(static_cast<float>(canvas.cols) / static_cast<float>(canvas.rows),
+             WithinRel(static_cast<float>(pano.cols) /
+                           static_cast<float>(pano.rows),
+                       0.01f));
+
+  // Covers roughly the same area as the pano
+  auto canvas_coverage = static_cast<float>(CountNonZero(canvas)) /
+                         static_cast<float>(canvas.total());
+  auto pano_coverage = static_cast<float>(CountNonZero(pano)) /
+                       static_cast<float>(pano.total());
+  CHECK_THAT(canvas_coverage, WithinAbs(pano_coverage, 0.05));
+}
+
+TEST_CASE("Speculative stitching") {
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto data = stitcher.RunLoading(kInputs, {}, {}).future.get();
+  REQUIRE(data.panos.size() == 2);
+
+  const auto options = xpano::pipeline::StitchAlgorithmOptions{};
+  stitcher.RunSpeculativeStitching(data, options);
+
+  // Preempted by the interactive task, then restarted
+  auto stitch_result = stitcher.RunStitching(data, {.pano_id = 1}).future.get();
+  REQUIRE(stitch_result.pano.has_value());
+
+  const int max_polls = 600;
+  std::optional<xpano::pipeline::StitchingResult> preview;
+  for (int i = 0; i < max_polls && !preview; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (stitcher.SpeculativeResult(data.panos[0], options)) {
+      preview = stitcher.SpeculativeResult(data.panos[1], options);
+    }
+  }
+  REQUIRE(preview.has_value());
+  REQUIRE(preview->pano.has_value());
+  CHECK(preview->pano->size() == stitch_result.pano->size());
+  CHECK(preview->cameras.has_value());
+  CHECK(preview->auto_crop.has_value());
+
+  // Different images, cameras or options aren't served
+  auto modified = data.panos[1];
+  modified.ids.pop_back();
+  CHECK_FALSE(stitcher.SpeculativeResult(modified, options).has_value());
+  auto with_cameras = data.panos[1];
+  with_cameras.cameras = stitch_result.cameras;
+  CHECK_FALSE(stitcher.SpeculativeResult(with_cameras, options).has_value());
+  auto cylindrical = options;
+  cylindrical.projection.type = xpano::algorithm::ProjectionType::kCylindrical;
+  CHECK_FALSE(
+      stitcher.SpeculativeResult(data.panos[1], cylindrical).has_value());
+
+  stitcher.CancelSpeculation();
+  CHECK_FALSE(stitcher.SpeculativeResult(data.panos[1], options).has_value());
+}
+
+TEST_CASE("Batch stitching") {
+  const auto tmp_dir = xpano::tests::TmpPath();
+  std::filesystem::create_directories(tmp_dir);
+
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto data = stitcher.RunLoading(kInputs, {}, {}).future.get();
+  REQUIRE(data.panos.size() == 2);
+
+  std::vector<xpano::pipeline::StitchingOptions> options;
+  for (int pano_id = 0; pano_id < data.panos.size(); pano_id++) {
+    options.push_back(
+        {.pano_id = pano_id,
+         .export_path = tmp_dir / fmt::format("pano_{}.jpg", pano_id)});
+  }
+
+  auto batch_task = stitcher.RunBatchStitching(data, options, {.max_jobs = 2});
+  auto results = batch_task.future.get();
+  auto progress = batch_task.progress->Report();
+  CHECK(progress.tasks_done == progress.num_tasks);
+
+  REQUIRE(results.size() == 2);
+  for (const auto& result : results) {
+    CHECK(xpano::algorithm::stitcher::IsSuccess(result.status));
+    REQUIRE(result.export_path.has_value());
+    CHECK(std::filesystem::exists(*result.export_path));
+    // Dropped after export
+    CHECK_FALSE(result.pano.has_value());
+    CHECK_FALSE(result.mask.has_value());
+  }
+  REQUIRE(results[0].cameras.has_value());
+  CHECK(results[0].cameras->cameras.size() == 5);
+  REQUIRE(results[1].cameras.has_value());
+  CHECK(results[1].cameras->cameras.size() == 3);
+
+  std::filesystem::remove_all(tmp_dir);
+}
+
+TEST_CASE("Batch jobs") {
+  const auto tmp_dir = xpano::tests::TmpPath();
+  std::filesystem::create_directories(tmp_dir);
+
+  const std::vector<xpano::pipeline::BatchJob> jobs = {
+      {.inputs = {"data/image06.jpg", "data/image07.jpg", "data/image08.jpg"},
+       .stitching = {.export_path = tmp_dir / "first.jpg"}},
+      {.inputs = {"data/image06.jpg", "data/missing.jpg"},
+       .stitching = {.export_path = tmp_dir / "second.jpg"}},
+      {.inputs = {"data/image01.jpg", "data/image02.jpg", "data/image03.jpg",
+                  "data/image04.jpg", "data/image05.jpg"},
+       .stitching = {.full_res = true, .export_path = tmp_dir / "third.tif"}},
+  };
+
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto batch_task = stitcher.RunBatchJobs(jobs, {.max_jobs = 2});
+  auto results = batch_task.future.get();
+  auto progress = batch_task.progress->Report();
+  CHECK(progress.tasks_done == progress.num_tasks);
+
+  REQUIRE(results.size() == 3);
+  for (int job_id = 0; job_id < results.size(); job_id++) {
+    CHECK(results[job_id].job_id == job_id);
+  }
+
+  for (const auto& result : {results[0], results[2]}) {
+    CHECK(result.error.empty());
+    REQUIRE(result.status.has_value());
+    CHECK(xpano::algorithm::stitcher::IsSuccess(*result.status));
+    REQUIRE(result.export_path.has_value());
+    CHECK(std::filesystem::exists(*result.export_path));
+  }
+  CHECK(results[0].num_images == 3);
+  CHECK(results[2].num_images == 5);
+
+  CHECK_FALSE(results[1].status.has_value());
+  CHECK_FALSE(results[1].error.empty());
+  CHECK_FALSE(std::filesystem::exists(tmp_dir / "second.jpg"));
+
+  std::filesystem::remove_all(tmp_dir);
+}
+
+TEST_CASE("Batch jobs output directory") {
+  const auto tmp_dir = xpano::tests::TmpPath();
+  std::filesystem::create_directories(tmp_dir);
+  // A file standing in the way of the output directory
+  std::ofstream(tmp_dir / "file") << "";
+
+  const std::vector<xpano::pipeline::BatchJob> jobs = {
+      {.inputs = {"data/image06.jpg", "data/image07.jpg", "data/image08.jpg"},
+       .stitching = {.export_path = tmp_dir / "file" / "pano.jpg"}},
+      {.inputs = {"data/image06.jpg", "data/image07.jpg", "data/image08.jpg"},
+       .stitching = {.export_path = tmp_dir / "new" / "pano.jpg"}},
+  };
+
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto results = stitcher.RunBatchJobs(jobs, {}).future.get();
+
+  REQUIRE(results.size() == 2);
+  CHECK_FALSE(results[0].status.has_value());
+  CHECK_THAT(results[0].error, ContainsSubstring("output directory"));
+  CHECK(results[1].error.empty());
+  CHECK(std::filesystem::exists(tmp_dir / "new" / "pano.jpg"));
+
+  std::filesystem::remove_all(tmp_dir);
+}
+
+TEST_CASE("Concurrent jobs") {
+  const auto tmp_dir = xpano::tests::TmpPath();
+  std::filesystem::create_directories(tmp_dir);
+
+  const xpano::pipeline::BatchJob first = {
+      .inputs = {"data/image06.jpg", "data/image07.jpg", "data/image08.jpg"},
+      .stitching = {.export_path = tmp_dir / "first.jpg"}};
+  const xpano::pipeline::BatchJob second = {
+      .inputs = {"data/image01.jpg", "data/image02.jpg", "data/image03.jpg"},
+      .stitching = {.export_path = tmp_dir / "second.png"}};
+
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  // Unlike the other Run* methods, a new job doesn't cancel the running ones
+  auto first_task = stitcher.RunJob(first, {.max_jobs = 2});
+  auto second_task = stitcher.RunJob(second, {.max_jobs = 2});
+  auto first_result = first_task.future.get();
+  auto second_result = second_task.future.get();
+
+  for (const auto& result : {first_result, second_result}) {
+    CHECK(result.error.empty());
+    REQUIRE(result.status.has_value());
+    CHECK(xpano::algorithm::stitcher::IsSuccess(*result.status));
+    REQUIRE(result.export_path.has_value());
+    CHECK(std::filesystem::exists(*result.export_path));
+    CHECK(result.num_images == 3);
+  }
+
+  auto cancelled_task = stitcher.RunJob(first, {});
+  cancelled_task.progress->Cancel();
+  auto cancelled_result = cancelled_task.future.get();
+  CHECK_FALSE(cancelled_result.error.empty());
+
+  std::filesystem::remove_all(tmp_dir);
+}
+
 const std::vector<std::filesystem::path> kInputsFirstPano = {
     "data/image01.jpg", "data/image02.jpg", "data/image03.jpg",
     "data/image04.jpg", "data/image05.jpg"};
@@ -399,6 +648,166 @@ TEST_CASE("Stitcher pipeline loading options") {
                        allowed_margin));
 }
 
+TEST_CASE("Stitcher pipeline in-memory inputs") {
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+
+  std::vector<xpano::algorithm::Image> inputs;
+  for (const auto* path : {"data/image06.jpg", "data/image07.jpg"}) {
+    std::ifstream file(path, std::ios::binary);
+    inputs.emplace_back(path, std::vector<unsigned char>(
+                                  std::istreambuf_iterator<char>(file),
+                                  std::istreambuf_iterator<char>()));
+  }
+  const cv::Mat decoded = cv::imread("data/image08.jpg");
+  inputs.emplace_back("frame", decoded);
+
+  auto loading_task = stitcher.RunLoadingImages(
+      inputs, {}, {.type = xpano::pipeline::MatchingType::kSinglePano});
+  auto data = loading_task.future.get();
+  REQUIRE(data.images.size() == 3);
+  CHECK(data.images[0].IsInMemory());
+  CHECK(data.images[2].GetFullSize() == decoded.size());
+  REQUIRE(data.panos.size() == 1);
+
+  auto stitching_task = stitcher.RunStitching(
+      data, {.full_res = true,
+             .encode_extension = ".png",
+             .metadata = {.copy_from_first_image = true}});
+  auto result = stitching_task.future.get();
+  auto progress = stitching_task.progress->Report();
+  CHECK(progress.tasks_done == progress.num_tasks);
+
+  REQUIRE(result.pano.has_value());
+  CHECK_FALSE(result.export_path.has_value());
+  REQUIRE(result.encoded.has_value());
+  auto roundtrip = cv::imdecode(*result.encoded, cv::IMREAD_COLOR);
+  CHECK(roundtrip.size() == result.pano->size());
+
+  // Not a BGR image
+  const cv::Mat gray(16, 16, CV_8UC1);
+  auto failed_task = stitcher.RunLoadingImages({{"gray", gray}}, {}, {});
+  CHECK(failed_task.future.get().images.empty());
+}
+
+TEST_CASE("Session") {
+  const auto tmp_dir = xpano::tests::TmpPath();
+  std::filesystem::create_directory(tmp_dir);
+  std::vector<std::filesystem::path> inputs;
+  for (const auto* name : {"image06.jpg", "image07.jpg", "image08.jpg"}) {
+    inputs.push_back(tmp_dir / name);
+    std::filesystem::copy_file(std::filesystem::path("data") / name,
+                               inputs.back());
+  }
+
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto data =
+      stitcher
+          .RunLoading(inputs, {},
+                      {.type = xpano::pipeline::MatchingType::kSinglePano})
+          .future.get();
+  REQUIRE(data.panos.size() == 1);
+  auto stitched = stitcher.RunStitching(data, {.pano_id = 0}).future.get();
+  REQUIRE(stitched.pano.has_value());
+  auto& pano = data.panos[0];
+  pano.cameras = stitched.cameras;
+  pano.auto_crop = stitched.auto_crop;
+  pano.crop = xpano::utils::Rect(xpano::utils::Ratio2f{0.25f, 0.25f},
+                                 xpano::utils::Ratio2f{0.5f, 0.75f});
+
+  const auto session_path = tmp_dir / "session.xpano";
+  auto saving_task = stitcher.RunSavingSession(data, session_path);
+  CHECK(saving_task.lane == xpano::pipeline::Lane::kBackground);
+  CHECK(saving_task.future.get().session_path == session_path);
+
+  auto loading_task = stitcher.RunLoadingSession(session_path);
+  auto restored = loading_task.future.get();
+  auto progress = loading_task.progress->Report();
+  CHECK(progress.tasks_done == progress.num_tasks);
+
+  REQUIRE(restored.images.size() == data.images.size());
+  for (std::size_t i = 0; i < data.images.size(); ++i) {
+    const auto& image = restored.images[i];
+    const auto& original = data.images[i];
+    CHECK(image.GetPath() == original.GetPath());
+    CHECK(image.GetFullSize() == original.GetFullSize());
+    CHECK(cv::norm(image.GetPreview(), original.GetPreview()) == 0.0);
+    CHECK(cv::norm(image.GetThumbnail(), original.GetThumbnail()) == 0.0);
+    CHECK(image.GetKeypoints().size() == original.GetKeypoints().size());
+    CHECK(cv::norm(image.GetDescriptors(), original.GetDescriptors()) == 0.0);
+  }
+  CHECK(restored.matches.size() == data.matches.size());
+  REQUIRE(restored.panos.size() == 1);
+  const auto& restored_pano = restored.panos[0];
+  CHECK_THAT(restored_pano.ids, Equals(pano.ids));
+  REQUIRE(restored_pano.crop.has_value());
+  CHECK(restored_pano.crop->start[0] == 0.25f);
+  CHECK(restored_pano.crop->end[1] == 0.75f);
+  CHECK(restored_pano.auto_crop.has_value());
+  REQUIRE(restored_pano.cameras.has_value());
+  CHECK(restored_pano.cameras->cameras.size() == pano.cameras->cameras.size());
+
+  // Stitched with the saved cameras
+  auto restitched =
+      stitcher.RunStitching(restored, {.pano_id = 0}).future.get();
+  REQUIRE(restitched.pano.has_value());
+  CHECK(restitched.pano->size() == stitched.pano->size());
+
+  // The files are checked once the full resolution is needed
+  std::filesystem::last_write_time(
+      inputs[1],
+      std::filesystem::last_write_time(inputs[1]) + std::chrono::hours(1));
+  auto full_res =
+      stitcher.RunStitching(restored, {.pano_id = 0, .full_res = true})
+          .future.get();
+  CHECK_FALSE(full_res.pano.has_value());
+  CHECK(full_res.status ==
+        xpano::algorithm::stitcher::Status::kErrInputChanged);
+
+  std::filesystem::remove_all(tmp_dir);
+}
+
+TEST_CASE("Session with tampered cameras") {
+  const auto tmp_dir = xpano::tests::TmpPath();
+  std::filesystem::create_directory(tmp_dir);
+
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto data =
+      stitcher
+          .RunLoading(kInputs, {},
+                      {.type = xpano::pipeline::MatchingType::kSinglePano})
+          .future.get();
+  REQUIRE(data.panos.size() == 1);
+  const int num_images = static_cast<int>(data.panos[0].ids.size());
+  auto& cameras = data.panos[0].cameras.emplace();
+  cameras.cameras.resize(num_images);
+  for (int i = 0; i < num_images; i++) {
+    cameras.component.push_back(i);
+  }
+
+  // The defaults are 3x3 and 3x1 double matrices
+  bool tampered = true;
+  SECTION("valid") { tampered = false; }
+  SECTION("out of range component") { cameras.component.back() = num_images; }
+  SECTION("missing camera") { cameras.cameras.pop_back(); }
+  SECTION("rotation size") {
+    cameras.cameras[0].R = cv::Mat::eye(2, 2, CV_64F);
+  }
+  SECTION("translation type") {
+    cameras.cameras[0].t = cv::Mat::zeros(3, 1, CV_8U);
+  }
+
+  const auto session_path = tmp_dir / "session.xpano";
+  REQUIRE(xpano::pipeline::SaveSession(session_path, data));
+  auto restored = stitcher.RunLoadingSession(session_path).future;
+  if (tampered) {
+    CHECK_THROWS_WITH(restored.get(), ContainsSubstring("Corrupted"));
+  } else {
+    CHECK(restored.get().panos[0].cameras.has_value());
+  }
+
+  std::filesystem::remove_all(tmp_dir);
+}
+
 const std::vector<std::filesystem::path> kVerticalPanoInputs = {
     "data/image10.jpg",
     "data/image11.jpg",
@@ -500,6 +909,79 @@ TEST_CASE("Export with crop") {
   std::filesystem::remove(tmp_path);
 }
 
+TEST_CASE("Export parallel encoders") {
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto loading_task = stitcher.RunLoading(kInputsWithExifMetadata, {}, {});
+  auto data = loading_task.future.get();
+  REQUIRE(data.panos.size() == 1);
+  auto stitch_result = stitcher.RunStitching(data, {.pano_id = 0}).future.get();
+  REQUIRE(stitch_result.pano.has_value());
+  const auto& pano = *stitch_result.pano;
+
+  auto crop = xpano::utils::Rect(xpano::utils::Ratio2f{0.1f, 0.2f},
+                                 xpano::utils::Ratio2f{0.9f, 0.7f});
+  auto pano_cropped = pano(xpano::utils::GetCvRect(pano, crop));
+
+  auto export_image = [&stitcher, &pano](
+                          const std::string& extension,
+                          const xpano::pipeline::CompressionOptions& options,
+                          std::optional<xpano::utils::RectRRf> crop = {}) {
+    const std::filesystem::path tmp_path =
+        xpano::tests::TmpPath().replace_extension(extension);
+    auto export_result = stitcher
+                             .RunExport(pano, {.export_path = tmp_path,
+                                               .compression = options,
+                                               .crop = crop})
+                             .future.get();
+    CHECK(export_result.export_path.has_value());
+    auto image = cv::imread(tmp_path.string(), cv::IMREAD_UNCHANGED);
+    std::filesystem::remove(tmp_path);
+    return image;
+  };
+
+  auto avg_abs_diff = [](const cv::Mat& lhs, const cv::Mat& rhs) {
+    return cv::norm(lhs, rhs, cv::NORM_L1) /
+           static_cast<double>(lhs.total() * lhs.channels());
+  };
+
+  SECTION("png") {
+    for (const int compression : {0, 1, 6, 9}) {
+      auto image = export_image("png", {.png_compression = compression});
+      REQUIRE(image.size == pano.size);
+      CHECK(cv::norm(image, pano, cv::NORM_INF) == 0);
+    }
+    auto image = export_image("png", {}, crop);
+    REQUIRE(image.size == pano_cropped.size);
+    CHECK(cv::norm(image, pano_cropped, cv::NORM_INF) == 0);
+  }
+
+  SECTION("tiff") {
+    auto image = export_image("tif", {});
+    REQUIRE(image.size == pano.size);
+    CHECK(cv::norm(image, pano, cv::NORM_INF) == 0);
+
+    image = export_image("tiff", {}, crop);
+    REQUIRE(image.size == pano_cropped.size);
+    CHECK(cv::norm(image, pano_cropped, cv::NORM_INF) == 0);
+  }
+
+  SECTION("jpeg") {
+    const xpano::pipeline::CompressionOptions options;
+    auto image = export_image("jpg", options);
+    REQUIRE(image.size == pano.size);
+    CHECK(avg_abs_diff(image, pano) < 5.0);
+
+    image = export_image("jpg", options, crop);
+    REQUIRE(image.size == pano_cropped.size);
+    CHECK(avg_abs_diff(image, pano_cropped) < 5.0);
+
+    // sequential fallback
+    image = export_image("jpg", {.jpeg_progressive = true});
+    REQUIRE(image.size == pano.size);
+    CHECK(avg_abs_diff(image, pano) < 5.0);
+  }
+}
+
 TEST_CASE("ExportWithMetadata") {
   const std::filesystem::path tmp_path =
       xpano::tests::TmpPath().replace_extension("jpg");
@@ -543,6 +1025,140 @@ TEST_CASE("ExportWithMetadata") {
   std::filesystem::remove(tmp_path);
 }
 
+TEST_CASE("ExportWithMetadata TIFF") {
+  const std::filesystem::path tmp_path =
+      xpano::tests::TmpPath().replace_extension("tif");
+
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto loading_task = stitcher.RunLoading(kInputsWithExifMetadata, {}, {});
+  auto data = loading_task.future.get();
+  REQUIRE(data.panos.size() == 1);
+  auto stitch_result =
+      stitcher.RunStitching(data, {.pano_id = 0, .export_path = tmp_path})
+          .future.get();
+  REQUIRE(stitch_result.pano.has_value());
+
+  REQUIRE(std::filesystem::exists(tmp_path));
+  auto image = cv::imread(tmp_path.string());
+  REQUIRE(!image.empty());
+  REQUIRE(image.size == stitch_result.pano->size);
+  CHECK(cv::norm(image, *stitch_result.pano, cv::NORM_INF) == 0);
+
+#ifdef XPANO_WITH_EXIV2
+  auto read_img = Exiv2::ImageFactory::open(tmp_path.string());
+  read_img->readMetadata();
+  auto exif = read_img->exifData();
+
+  auto software = exif["Exif.Image.Software"].toString();
+  REQUIRE(software.starts_with("Xpano"));
+
+  auto width = exif["Exif.Photo.PixelXDimension"].toUint32();
+  auto height = exif["Exif.Photo.PixelYDimension"].toUint32();
+  CHECK(width == image.cols);
+  CHECK(height == image.rows);
+
+  auto orientation = exif["Exif.Image.Orientation"].toUint32();
+  CHECK(orientation == xpano::kExifDefaultOrientation);
+#endif
+  std::filesystem::remove(tmp_path);
+}
+
+TEST_CASE("Export pyramidal TIFF") {
+  const std::filesystem::path tmp_path =
+      xpano::tests::TmpPath().replace_extension("ptif");
+
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto loading_task = stitcher.RunLoading(kInputsWithExifMetadata, {}, {});
+  auto data = loading_task.future.get();
+  REQUIRE(data.panos.size() == 1);
+  auto stitch_result =
+      stitcher.RunStitching(data, {.pano_id = 0, .export_path = tmp_path})
+          .future.get();
+  REQUIRE(stitch_result.pano.has_value());
+  REQUIRE(stitch_result.export_path.has_value());
+
+  std::vector<cv::Mat> pages;
+  REQUIRE(cv::imreadmulti(tmp_path.string(), pages));
+  REQUIRE(pages.size() > 1);
+  REQUIRE(pages[0].size == stitch_result.pano->size);
+  CHECK(cv::norm(pages[0], *stitch_result.pano, cv::NORM_INF) == 0);
+
+  for (std::size_t i = 1; i < pages.size(); i++) {
+    CHECK(pages[i].cols == (pages[i - 1].cols + 1) / 2);
+    CHECK(pages[i].rows == (pages[i - 1].rows + 1) / 2);
+  }
+  CHECK(std::max(pages.back().cols, pages.back().rows) <= 256);
+  std::filesystem::remove(tmp_path);
+}
+
+TEST_CASE("Export deep zoom") {
+  const std::filesystem::path tmp_path =
+      xpano::tests::TmpPath().replace_extension("dzi");
+  const auto tiles_path =
+      tmp_path.parent_path() / (tmp_path.stem().string() + "_files");
+
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto loading_task = stitcher.RunLoading(kInputsWithExifMetadata, {}, {});
+  auto data = loading_task.future.get();
+  REQUIRE(data.panos.size() == 1);
+  auto stitch_result =
+      stitcher.RunStitching(data, {.pano_id = 0, .export_path = tmp_path})
+          .future.get();
+  REQUIRE(stitch_result.pano.has_value());
+  REQUIRE(stitch_result.export_path.has_value());
+  REQUIRE(std::filesystem::exists(tmp_path));
+
+  const auto& pano = *stitch_result.pano;
+  int max_level = 0;
+  while ((1 << max_level) < std::max(pano.cols, pano.rows)) {
+    max_level++;
+  }
+
+  auto top_left =
+      cv::imread((tiles_path / std::to_string(max_level) / "0_0.jpg").string());
+  CHECK(top_left.cols == std::min(pano.cols, 255));
+  CHECK(top_left.rows == std::min(pano.rows, 255));
+
+  auto bottom_right = cv::imread(
+      (tiles_path / std::to_string(max_level) /
+       fmt::format("{}_{}.jpg", (pano.cols - 1) / 254, (pano.rows - 1) / 254))
+          .string());
+  CHECK_FALSE(bottom_right.empty());
+
+  auto single_pixel = cv::imread((tiles_path / "0" / "0_0.jpg").string());
+  CHECK(single_pixel.cols == 1);
+  CHECK(single_pixel.rows == 1);
+  CHECK_FALSE(std::filesystem::exists(tiles_path /
+                                      std::to_string(max_level + 1)));
+
+  std::filesystem::remove(tmp_path);
+  std::filesystem::remove_all(tiles_path);
+}
+
+TEST_CASE("Export deep zoom keeps other files") {
+  const std::filesystem::path tmp_path =
+      xpano::tests::TmpPath().replace_extension("dzi");
+  const auto tiles_path =
+      tmp_path.parent_path() / (tmp_path.stem().string() + "_files");
+  std::filesystem::create_directories(tiles_path);
+  const auto other_file = tiles_path / "notes.txt";
+  std::ofstream(other_file) << "keep";
+
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+  auto loading_task = stitcher.RunLoading(kInputsWithExifMetadata, {}, {});
+  auto data = loading_task.future.get();
+  REQUIRE(data.panos.size() == 1);
+  auto stitch_result =
+      stitcher.RunStitching(data, {.pano_id = 0, .export_path = tmp_path})
+          .future.get();
+  CHECK(stitch_result.pano.has_value());
+  CHECK_FALSE(stitch_result.export_path.has_value());
+  CHECK(std::filesystem::exists(other_file));
+  CHECK_FALSE(std::filesystem::exists(tmp_path));
+
+  std::filesystem::remove_all(tiles_path);
+}
+
 #ifdef XPANO_WITH_EXIV2
 bool TagExists(const Exiv2::ExifData& exif, const std::string& tag) {
   return exif.findKey(Exiv2::ExifKey(tag)) != exif.end();
@@ -719,6 +1335,58 @@ TEST_CASE("Stitcher pipeline polling") {
   CHECK_THAT(pano1->cols, WithinRel(1335, eps));
 }
 
+TEST_CASE("Stitcher pipeline lanes") {
+  const auto tmp_dir = xpano::tests::TmpPath();
+  std::filesystem::create_directories(tmp_dir);
+
+  xpano::pipeline::StitcherPipeline<> stitcher;
+  stitcher.RunLoading(kInputs, {}, {});
+  auto loading_task = WaitForTask(&stitcher);
+  REQUIRE(loading_task.has_value());
+  auto data = std::get<std::future<xpano::pipeline::StitcherData>>(
+                  std::move(loading_task->future))
+                  .get();
+  REQUIRE(data.panos.size() == 2);
+
+  // The export keeps running while the previews replace each other
+  const auto export_path = tmp_dir / "pano_0.jpg";
+  stitcher.RunStitching(data, {.pano_id = 0, .export_path = export_path});
+  stitcher.RunStitching(data, {.pano_id = 0});
+  stitcher.RunStitching(data, {.pano_id = 1});
+
+  const int max_iterations = 6000;
+  int num_cancelled = 0;
+  std::optional<xpano::pipeline::StitchingResult> exported;
+  std::optional<xpano::pipeline::StitchingResult> preview;
+  for (int i = 0; i < 3; i++) {
+    auto task = WaitForTask(&stitcher, max_iterations);
+    REQUIRE(task.has_value());
+    if (task->progress->IsCancelled()) {
+      CHECK(task->lane == xpano::pipeline::Lane::kInteractive);
+      num_cancelled++;
+      continue;
+    }
+    auto result = std::get<std::future<xpano::pipeline::StitchingResult>>(
+                      std::move(task->future))
+                      .get();
+    if (task->lane == xpano::pipeline::Lane::kBackground) {
+      exported = std::move(result);
+    } else {
+      preview = std::move(result);
+    }
+  }
+  CHECK(num_cancelled == 1);
+
+  REQUIRE(exported.has_value());
+  CHECK(exported->export_path == export_path);
+  CHECK(std::filesystem::exists(export_path));
+  REQUIRE(preview.has_value());
+  CHECK(preview->pano_id == 1);
+  CHECK(preview->pano.has_value());
+
+  std::filesystem::remove_all(tmp_dir);
+}
+
 const std::vector<std::filesystem::path> kInputsWithStack = {
     "data/image01.jpg",  // Minimal shift
     "data/image05.jpg",  // between images
@@ -751,4 +1419,36 @@ TEST_CASE("Stitcher pipeline stack detection") {
   CHECK_THAT(result.panos[0].ids, Equals<int>({2, 3}));
 }
 
+TEST_CASE("Stitcher pipeline metrics") {
+  xpano::pipeline::StitcherPipeline<kReturnFuture> stitcher;
+
+  auto stage_names = [](const xpano::utils::metrics::Stages& stages) {
+    std::vector<std::string> names;
+    std::transform(stages.begin(), stages.end(), std::back_inserter(names),
+                   [](const auto& stage) { return stage.name; });
+    return names;
+  };
+
+  auto data = stitcher.RunLoading(kInputs, {}, {}).future.get();
+  auto loading_stages = stage_names(data.metrics);
+  CHECK_THAT(loading_stages, VectorContains(std::string("decode")));
+  CHECK_THAT(loading_stages, VectorContains(std::string("keypoints")));
+  CHECK_THAT(loading_stages, VectorContains(std::string("match")));
+  CHECK_THAT(loading_stages, VectorContains(std::string("find_panos")));
+  for (const auto& stage : data.metrics) {
+    CHECK(stage.count > 0);
+    CHECK(stage.wall_seconds >= 0.0);
+  }
+
+  auto result = stitcher.RunStitching(data, {.pano_id = 0, .full_res = true})
+                    .future.get();
+  REQUIRE(result.pano.has_value());
+  auto stitching_stages = stage_names(result.metrics);
+  CHECK_THAT(stitching_stages, VectorContains(std::string("decode")));
+  CHECK_THAT(stitching_stages,
+             VectorContains(std::string("bundle_adjustment")));
+  CHECK_THAT(stitching_stages, VectorContains(std::string("blend")));
+  CHECK_THAT(stitching_stages, VectorContains(std::string("crop")));
+}
+
 // NOLINTEND(readability-function-cognitive-complexity)
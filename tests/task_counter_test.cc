@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/task_counter.h"
+
+#include <chrono>
+#include <future>
+
+#include <catch2/catch_test_macros.hpp>
+
+using xpano::utils::mt::TaskCounter;
+
+constexpr auto kNoWait = std::chrono::milliseconds(0);
+constexpr auto kLongWait = std::chrono::seconds(10);
+
+TEST_CASE("Task counter idle") {
+  TaskCounter tasks;
+  CHECK(tasks.IsIdle());
+  CHECK(tasks.WaitUntilIdle(kNoWait));
+
+  tasks.Add();
+  tasks.Add();
+  CHECK_FALSE(tasks.IsIdle());
+  CHECK_FALSE(tasks.WaitUntilIdle(kNoWait));
+
+  tasks.Done();
+  CHECK_FALSE(tasks.IsIdle());
+  tasks.Done();
+  CHECK(tasks.IsIdle());
+}
+
+TEST_CASE("Task counter wakes up the waiting thread") {
+  TaskCounter tasks;
+  tasks.Add();
+
+  auto waiting = std::async(std::launch::async, [&tasks]() {
+    return tasks.WaitUntilIdle(kLongWait);
+  });
+  tasks.Done();
+  CHECK(waiting.get());
+}
@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/trace.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "xpano/constants.h"
+#include "xpano/utils/json.h"
+
+namespace trace = xpano::utils::trace;
+namespace json = xpano::utils::json;
+
+namespace {
+
+// Events without the thread name metadata
+std::vector<json::Value> RecordedEvents() {
+  auto parsed = json::Parse(trace::ToChromeJson());
+  REQUIRE(parsed);
+  const auto* events = parsed->Find("traceEvents");
+  REQUIRE(events);
+  std::vector<json::Value> result;
+  for (const auto& event : events->AsArray()) {
+    if (event.Find("ph")->AsString() != "M") {
+      result.push_back(event);
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST_CASE("Trace disabled") {
+  trace::Clear();
+  trace::Enable(false);
+  { const trace::Scope scope("ignored"); }
+  CHECK(RecordedEvents().empty());
+}
+
+TEST_CASE("Trace nested scopes") {
+  trace::Clear();
+  trace::Enable(true);
+  {
+    const trace::Scope outer("outer", {.pano_id = 2});
+    const trace::Scope inner("inner", {.pano_id = 2, .image_id = 5});
+  }
+  trace::Enable(false);
+
+  auto events = RecordedEvents();
+  REQUIRE(events.size() == 4);
+  CHECK(events[0].Find("name")->AsString() == "outer");
+  CHECK(events[0].Find("ph")->AsString() == "B");
+  CHECK(events[0].Find("args")->Find("pano_id")->AsNumber() == 2);
+  CHECK(events[0].Find("args")->Find("image_id") == nullptr);
+  CHECK(events[1].Find("name")->AsString() == "inner");
+  CHECK(events[1].Find("args")->Find("image_id")->AsNumber() == 5);
+  CHECK(events[2].Find("ph")->AsString() == "E");
+  CHECK(events[3].Find("name")->AsString() == "outer");
+  CHECK(events[3].Find("ph")->AsString() == "E");
+  CHECK(events[0].Find("ts")->AsNumber() <= events[3].Find("ts")->AsNumber());
+}
+
+TEST_CASE("Trace stopped inside a scope") {
+  trace::Clear();
+  trace::Enable(true);
+  {
+    const trace::Scope scope("started");
+    trace::Enable(false);
+  }
+  CHECK(RecordedEvents().size() == 2);
+}
+
+TEST_CASE("Trace threads") {
+  trace::Clear();
+  trace::Enable(true);
+  std::vector<std::thread> threads;
+  threads.reserve(3);
+  for (int i = 0; i < 3; i++) {
+    threads.emplace_back(
+        [i]() { const trace::Scope scope("task", {.image_id = i}); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  trace::Enable(false);
+
+  auto events = RecordedEvents();
+  REQUIRE(events.size() == 6);
+  for (std::size_t i = 0; i < events.size(); i += 2) {
+    CHECK(events[i].Find("tid")->AsNumber() ==
+          events[i + 1].Find("tid")->AsNumber());
+  }
+}
+
+TEST_CASE("Trace ring buffer overwrites the oldest events") {
+  trace::Clear();
+  trace::Enable(true);
+  {
+    const trace::Scope outer("outer");
+    for (int i = 0; i < xpano::kTraceEventsPerThread; i++) {
+      const trace::Scope inner("inner");
+    }
+  }
+  trace::Enable(false);
+
+  // The oldest kept event ends an inner scope whose begin was overwritten,
+  // both it and the end of the outer scope are dropped
+  auto events = RecordedEvents();
+  CHECK(events.size() == xpano::kTraceEventsPerThread - 2);
+  CHECK(events.front().Find("ph")->AsString() == "B");
+  CHECK(events.back().Find("name")->AsString() == "inner");
+}
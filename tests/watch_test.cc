@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/watch.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "xpano/utils/bounded_queue.h"
+#include "tests/utils.h"
+
+using xpano::utils::watch::Clock;
+using xpano::utils::watch::FileGrouper;
+using xpano::utils::watch::FolderWatcher;
+
+using namespace std::chrono_literals;
+
+TEST_CASE("File grouper sentinel") {
+  FileGrouper grouper(10s);
+  auto now = Clock::now();
+
+  grouper.Add("b.jpg", now);
+  grouper.Add("a.jpg", now);
+  grouper.Add("notes.txt", now);
+  grouper.Add("a.jpg", now);
+  CHECK(grouper.NumPending() == 2);
+  CHECK_FALSE(grouper.TakeReady(now));
+
+  grouper.Add("set1.done", now);
+  grouper.Add("c.jpg", now);
+  grouper.Add("set2.done", now);
+  grouper.Add("empty.done", now);
+  CHECK(grouper.NumPending() == 0);
+
+  auto first = grouper.TakeReady(now);
+  REQUIRE(first);
+  CHECK(*first == std::vector<std::filesystem::path>{"a.jpg", "b.jpg"});
+  auto second = grouper.TakeReady(now);
+  REQUIRE(second);
+  CHECK(*second == std::vector<std::filesystem::path>{"c.jpg"});
+  CHECK_FALSE(grouper.TakeReady(now));
+}
+
+TEST_CASE("File grouper idle timeout") {
+  FileGrouper grouper(10s);
+  auto now = Clock::now();
+
+  grouper.Add("a.jpg", now);
+  grouper.Add("b.jpg", now + 5s);
+  CHECK_FALSE(grouper.TakeReady(now + 12s));
+
+  auto ready = grouper.TakeReady(now + 15s);
+  REQUIRE(ready);
+  CHECK(ready->size() == 2);
+  CHECK(grouper.NumPending() == 0);
+}
+
+TEST_CASE("Folder watcher") {
+  const auto tmp_dir = xpano::tests::TmpPath();
+  std::filesystem::create_directories(tmp_dir);
+  std::ofstream(tmp_dir / "existing.jpg") << "old";
+
+  FolderWatcher watcher(tmp_dir);
+  std::ofstream(tmp_dir / "new.jpg") << "new";
+  std::filesystem::create_directories(tmp_dir / "subdir");
+
+  std::vector<std::filesystem::path> files;
+  // The polling fallback needs two rounds to see a stable file size
+  for (int i = 0; i < 10 && files.empty(); i++) {
+    files = watcher.Wait(1s);
+  }
+  REQUIRE(files.size() == 1);
+  CHECK(files[0] == tmp_dir / "new.jpg");
+
+  std::filesystem::remove_all(tmp_dir);
+}
+
+TEST_CASE("Bounded queue") {
+  xpano::utils::mt::BoundedQueue<int> queue(2);
+
+  int item = 1;
+  CHECK(queue.Push(&item, 0ms));
+  item = 2;
+  CHECK(queue.Push(&item, 0ms));
+  item = 3;
+  CHECK_FALSE(queue.Push(&item, 10ms));
+  CHECK(queue.Size() == 2);
+
+  std::thread consumer([&queue]() {
+    std::this_thread::sleep_for(50ms);
+    queue.Pop(0ms);
+  });
+  CHECK(queue.Push(&item, 5s));
+  consumer.join();
+
+  CHECK(queue.Pop(0ms) == 2);
+  CHECK(queue.Pop(0ms) == 3);
+  CHECK_FALSE(queue.Pop(10ms));
+}
@@ -18,6 +18,7 @@
 #include <opencv2/calib3d.hpp>
 #include <opencv2/core.hpp>
 #include <opencv2/features2d.hpp>
+#include <opencv2/imgproc.hpp>
 #include <opencv2/photo.hpp>
 #include <opencv2/stitching.hpp>
 
@@ -269,6 +270,8 @@ StitchResult Stitch(const std::vector<cv::Mat>& images,
   stitcher->SetBlender(PickBlender(user_options.blending_method,
                                    options.threads_for_multiblend));
   stitcher->SetProgressMonitor(options.progress_monitor);
+  stitcher->SetMetrics(options.metrics);
+  stitcher->SetLiveCanvas(options.live_canvas);
 
   cv::Mat pano;
   stitcher::Status status;
@@ -327,6 +330,8 @@ std::string ToString(stitcher::Status& status) {
       return "ERR_HOMOGRAPHY_EST_FAIL";
     case stitcher::Status::kErrCameraParamsAdjustFail:
       return "ERR_CAMERA_PARAMS_ADJUST_FAIL";
+    case stitcher::Status::kErrInputChanged:
+      return "ERR_INPUT_CHANGED";
     default:
       return "ERR_UNKNOWN";
   }
@@ -341,8 +346,65 @@ std::optional<utils::RectRRf> FindLargestCrop(const cv::Mat& mask) {
   return Rect(largest_rect->start / image_end, largest_rect->end / image_end);
 }
 
+namespace {
+
+cv::Size HalfSize(const cv::Size& size) {
+  return {(size.width + 1) / 2, (size.height + 1) / 2};
+}
+
+// Inpaints the coarsest level of a pyramid, then at each finer level only
+// refines a narrow band along the hole boundary, the hole interior is
+// upsampled from the coarser result. The cost scales with the hole boundary
+// instead of the hole area.
+cv::Mat InpaintPyramid(const cv::Mat& pano, const cv::Mat& mask,
+                       double radius, const PyramidInpaintingOptions& options) {
+  std::vector<cv::Mat> images = {pano};
+  std::vector<cv::Mat> masks = {mask};
+  while (static_cast<int>(images.size()) < options.levels) {
+    auto size = HalfSize(images.back().size());
+    if (std::min(size.width, size.height) < kMinInpaintingPyramidSize) {
+      break;
+    }
+    cv::Mat image;
+    cv::resize(images.back(), image, size, 0, 0, cv::INTER_AREA);
+    // A coarse pixel is a hole if any of its source pixels was a hole, this
+    // way no hole pixels leak into the known region of the coarser level
+    cv::Mat level_mask;
+    cv::resize(masks.back(), level_mask, size, 0, 0, cv::INTER_AREA);
+    cv::threshold(level_mask, level_mask, 0, 255, cv::THRESH_BINARY);
+    images.push_back(image);
+    masks.push_back(level_mask);
+  }
+
+  cv::Mat result;
+  cv::inpaint(images.back(), masks.back(), result, radius, cv::INPAINT_TELEA);
+
+  auto kernel_size = 2 * options.band_width + 1;
+  auto kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE,
+                                          {kernel_size, kernel_size});
+  for (int level = static_cast<int>(images.size()) - 2; level >= 0; level--) {
+    cv::Mat upsampled;
+    cv::resize(result, upsampled, images[level].size(), 0, 0,
+               cv::INTER_LINEAR);
+    cv::Mat filled = images[level].clone();
+    upsampled.copyTo(filled, masks[level]);
+
+    cv::Mat interior;
+    cv::erode(masks[level], interior, kernel);
+    cv::Mat band = masks[level] - interior;
+    cv::inpaint(filled, band, result, radius, cv::INPAINT_TELEA);
+  }
+  return result;
+}
+
+}  // namespace
+
 cv::Mat Inpaint(const cv::Mat& pano, const cv::Mat& mask,
                 InpaintingOptions options) {
+  if (options.method == InpaintingMethod::kPyramid) {
+    return InpaintPyramid(pano, mask, options.radius, options.pyramid);
+  }
+
   cv::Mat result;
   int method = cv::INPAINT_TELEA;
   if (options.method == InpaintingMethod::kNavierStokes) {
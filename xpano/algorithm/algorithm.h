@@ -12,9 +12,11 @@
 #include <opencv2/stitching.hpp>
 
 #include "xpano/algorithm/image.h"
+#include "xpano/algorithm/live_canvas.h"
 #include "xpano/algorithm/options.h"
 #include "xpano/algorithm/progress.h"
 #include "xpano/algorithm/stitcher.h"
+#include "xpano/utils/metrics.h"
 #include "xpano/utils/rect.h"
 #include "xpano/utils/threadpool.h"
 
@@ -63,6 +65,8 @@ struct StitchOptions {
   bool return_pano_mask = false;
   utils::mt::Threadpool* threads_for_multiblend = nullptr;
   ProgressMonitor* progress_monitor = nullptr;
+  utils::metrics::Recorder* metrics = nullptr;
+  LiveCanvas* live_canvas = nullptr;
 };
 
 StitchResult Stitch(const std::vector<cv::Mat>& images,
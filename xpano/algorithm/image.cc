@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
 #include <utility>
@@ -17,6 +18,8 @@
 #include <spdlog/spdlog.h>
 
 #include "xpano/constants.h"
+#include "xpano/utils/metrics.h"
+#include "xpano/utils/path.h"
 
 namespace xpano::algorithm {
 namespace {
@@ -41,19 +44,60 @@ std::optional<cv::Size> PreviewSize(const cv::Size& full_size,
 
 Image::Image(std::filesystem::path path) : path_(std::move(path)) {}
 
+Image::Image(std::string name, std::vector<unsigned char> encoded)
+    : path_(std::move(name)),
+      encoded_(std::make_shared<const std::vector<unsigned char>>(
+          std::move(encoded))) {}
+
+Image::Image(std::string name, cv::Mat image)
+    : path_(std::move(name)), full_res_(std::move(image)) {}
+
+Image::Image(std::filesystem::path path, LoadedImage loaded)
+    : path_(std::move(path)),
+      preview_(std::move(loaded.preview)),
+      thumbnail_(std::move(loaded.thumbnail)),
+      full_size_(loaded.full_size),
+      keypoints_(std::move(loaded.keypoints)),
+      descriptors_(std::move(loaded.descriptors)),
+      is_raw_(loaded.is_raw),
+      identity_(loaded.identity) {}
+
+cv::Mat Image::Read(int flags) const {
+  if (encoded_) {
+    return cv::imdecode(*encoded_, flags);
+  }
+  if (IsInMemory()) {
+    return full_res_;
+  }
+  if (identity_ && utils::path::Identity(path_) != identity_) {
+    spdlog::error("Image {} changed since it was loaded", path_.string());
+    return {};
+  }
+  return cv::imread(path_.string(), flags);
+}
+
 void Image::Load(ImageLoadOptions options) {
-  cv::Mat tmp =
-      cv::imread(path_.string(), cv::IMREAD_COLOR | cv::IMREAD_ANYDEPTH);
+  if (!full_res_.empty() && full_res_.type() != CV_8UC3) {
+    spdlog::error("Image {} is not 8-bit BGR", path_.string());
+    return;
+  }
+  utils::metrics::ScopedStage stage(options.metrics, "decode",
+                                    options.metrics_label);
+  cv::Mat tmp = Read(cv::IMREAD_COLOR | cv::IMREAD_ANYDEPTH);
   if (!tmp.empty() && tmp.depth() != CV_8U) {
     is_raw_ = true;
     spdlog::warn("Image {} is not 8-bit, converting", path_.string());
-    tmp = cv::imread(path_.string());
+    tmp = Read(cv::IMREAD_COLOR);
   }
   if (tmp.empty()) {
     spdlog::error("Failed to load image {}", path_.string());
     return;
   }
 
+  full_size_ = tmp.size();
+  if (!IsInMemory()) {
+    identity_ = utils::path::Identity(path_);
+  }
   if (auto preview_size = PreviewSize(tmp.size(), options.preview_longer_side);
       preview_size) {
     cv::resize(tmp, preview_, *preview_size, 0.0, 0.0, cv::INTER_AREA);
@@ -62,8 +106,10 @@ void Image::Load(ImageLoadOptions options) {
   }
 
   if (options.compute_keypoints) {
+    stage.Next("keypoints");
     sift->detectAndCompute(preview_, cv::Mat(), keypoints_, descriptors_);
   }
+  stage.End();
   cv::resize(preview_, thumbnail_, cv::Size(kThumbnailSize, kThumbnailSize), 0,
              0, cv::INTER_AREA);
 
@@ -80,7 +126,11 @@ bool Image::IsLoaded() const { return !preview_.empty(); }
 
 bool Image::IsRaw() const { return is_raw_; }
 
-cv::Mat Image::GetFullRes() const { return cv::imread(path_.string()); }
+bool Image::IsInMemory() const {
+  return encoded_ != nullptr || !full_res_.empty();
+}
+
+cv::Mat Image::GetFullRes() const { return Read(cv::IMREAD_COLOR); }
 cv::Mat Image::GetThumbnail() const { return thumbnail_; }
 cv::Mat Image::GetPreview() const { return preview_; }
 
@@ -88,6 +138,8 @@ int Image::GetPreviewLongerSide() const {
   return std::max(preview_.size[1], preview_.size[0]);
 }
 
+cv::Size Image::GetFullSize() const { return full_size_; }
+
 float Image::GetAspect() const {
   auto width = static_cast<float>(preview_.size[1]);
   auto height = static_cast<float>(preview_.size[0]);
@@ -112,6 +164,10 @@ cv::Mat Image::GetDescriptors() const { return descriptors_; }
 
 std::filesystem::path Image::GetPath() const { return path_; }
 
+std::optional<utils::path::FileIdentity> Image::GetIdentity() const {
+  return identity_;
+}
+
 std::string Image::PanoName() const {
   return path_.stem().string() + kDefaultPanoSuffix +
          path_.extension().string();
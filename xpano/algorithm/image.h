@@ -4,16 +4,35 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include <opencv2/core.hpp>
 
+#include "xpano/utils/metrics.h"
+#include "xpano/utils/path.h"
+
 namespace xpano::algorithm {
 
 struct ImageLoadOptions {
   int preview_longer_side = 0;
   bool compute_keypoints = true;
+  utils::metrics::Recorder* metrics = nullptr;
+  // Of the stages of this image, e.g. its index
+  std::string metrics_label;
+};
+
+// Results of Image::Load, kept in session files
+struct LoadedImage {
+  cv::Mat preview;
+  cv::Mat thumbnail;
+  cv::Size full_size;
+  std::vector<cv::KeyPoint> keypoints;
+  cv::Mat descriptors;
+  bool is_raw = false;
+  std::optional<utils::path::FileIdentity> identity;
 };
 
 class Image {
@@ -21,12 +40,23 @@ class Image {
   Image() = default;
   explicit Image(std::filesystem::path path);
 
+  // In-memory inputs, the name stands in for the path in the logs and in the
+  // pano name. The buffer holds an encoded image in any format supported by
+  // cv::imdecode, the matrix is an 8-bit BGR image shared without a copy.
+  Image(std::string name, std::vector<unsigned char> encoded);
+  Image(std::string name, cv::Mat image);
+
+  // Already loaded, the file is read only for the full resolution image,
+  // which fails if the file doesn't match the identity anymore
+  Image(std::filesystem::path path, LoadedImage loaded);
+
   void Load(ImageLoadOptions options);
 
   [[nodiscard]] cv::Mat GetFullRes() const;
   [[nodiscard]] cv::Mat GetThumbnail() const;
   [[nodiscard]] cv::Mat GetPreview() const;
   [[nodiscard]] int GetPreviewLongerSide() const;
+  [[nodiscard]] cv::Size GetFullSize() const;
   [[nodiscard]] float GetAspect() const;
   [[nodiscard]] cv::Mat Draw(bool show_debug) const;
   [[nodiscard]] const std::vector<cv::KeyPoint>& GetKeypoints() const;
@@ -34,16 +64,26 @@ class Image {
   [[nodiscard]] bool IsLoaded() const;
   [[nodiscard]] std::filesystem::path GetPath() const;
   [[nodiscard]] bool IsRaw() const;
+  [[nodiscard]] bool IsInMemory() const;
+  // Of the file at the time it was loaded
+  [[nodiscard]] std::optional<utils::path::FileIdentity> GetIdentity() const;
   [[nodiscard]] std::string PanoName() const;
 
  private:
+  [[nodiscard]] cv::Mat Read(int flags) const;
+
   std::filesystem::path path_;
+  // Shared between the copies of the image
+  std::shared_ptr<const std::vector<unsigned char>> encoded_;
+  cv::Mat full_res_;
   cv::Mat preview_;
   cv::Mat thumbnail_;
+  cv::Size full_size_;
 
   std::vector<cv::KeyPoint> keypoints_;
   cv::Mat descriptors_;
   bool is_raw_ = false;
+  std::optional<utils::path::FileIdentity> identity_;
 };
 
 }  // namespace xpano::algorithm
@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/algorithm/live_canvas.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace xpano::algorithm {
+
+LiveCanvas::LiveCanvas(int longer_side) : longer_side_(longer_side) {}
+
+void LiveCanvas::Prepare(const cv::Rect& roi) {
+  roi_ = roi;
+  scale_ = std::min(1.0, static_cast<double>(longer_side_) /
+                             std::max({roi.width, roi.height, 1}));
+  {
+    const std::lock_guard lock(mut_);
+    canvas_ = cv::Mat::zeros(std::max(cvRound(roi.height * scale_), 1),
+                             std::max(cvRound(roi.width * scale_), 1),
+                             CV_8UC3);
+  }
+  version_++;
+}
+
+void LiveCanvas::Paste(cv::InputArray image, cv::InputArray mask,
+                       cv::Point corner) {
+  const cv::Point offset = corner - roi_.tl();
+  const cv::Size image_size = image.size();
+  const cv::Rect target(cvRound(offset.x * scale_), cvRound(offset.y * scale_),
+                        cvRound(image_size.width * scale_),
+                        cvRound(image_size.height * scale_));
+  if (target.empty()) {
+    return;
+  }
+
+  cv::Mat small;
+  cv::resize(image, small, target.size(), 0, 0, cv::INTER_AREA);
+  if (small.depth() != CV_8U) {
+    small.convertTo(small, CV_8U);
+  }
+  cv::Mat small_mask;
+  cv::resize(mask, small_mask, target.size(), 0, 0, cv::INTER_NEAREST);
+
+  {
+    const std::lock_guard lock(mut_);
+    const cv::Rect visible =
+        target & cv::Rect(0, 0, canvas_.cols, canvas_.rows);
+    if (visible.empty() || small.type() != canvas_.type()) {
+      return;
+    }
+    const cv::Rect source(visible.tl() - target.tl(), visible.size());
+    small(source).copyTo(canvas_(visible), small_mask(source));
+  }
+  version_++;
+}
+
+int LiveCanvas::Version() const { return version_; }
+
+cv::Mat LiveCanvas::Snapshot() const {
+  const std::lock_guard lock(mut_);
+  return canvas_.clone();
+}
+
+}  // namespace xpano::algorithm
@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include <opencv2/core.hpp>
+
+#include "xpano/constants.h"
+
+namespace xpano::algorithm {
+
+// Low resolution copy of a panorama that fills in while the images are being
+// composed. The stitcher pastes the warped images from its thread, the gui
+// shows snapshots of the canvas.
+class LiveCanvas {
+ public:
+  explicit LiveCanvas(int longer_side = kLiveCanvasSize);
+
+  // Clears the canvas, the roi is in the panorama coordinates
+  void Prepare(const cv::Rect& roi);
+  // Pastes the downscaled image where the mask is set
+  void Paste(cv::InputArray image, cv::InputArray mask, cv::Point corner);
+
+  // Increments with every change
+  [[nodiscard]] int Version() const;
+  [[nodiscard]] cv::Mat Snapshot() const;
+
+ private:
+  const int longer_side_;
+
+  cv::Rect roi_;
+  double scale_ = 1.0;
+
+  mutable std::mutex mut_;
+  cv::Mat canvas_;
+  std::atomic<int> version_ = 0;
+};
+
+}  // namespace xpano::algorithm
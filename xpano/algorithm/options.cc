@@ -77,6 +77,8 @@ const char* Label(InpaintingMethod inpaint_method) {
       return "NavierStokes";
     case InpaintingMethod::kTelea:
       return "Telea";
+    case InpaintingMethod::kPyramid:
+      return "Pyramid";
     default:
       return "Unknown";
   }
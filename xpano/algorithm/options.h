@@ -37,6 +37,7 @@ enum class WaveCorrectionType : std::uint8_t {
 enum class InpaintingMethod : std::uint8_t {
   kNavierStokes,
   kTelea,
+  kPyramid,
 };
 
 enum class BlendingMethod : std::uint8_t { kOpenCV, kMultiblend };
@@ -66,7 +67,8 @@ const auto kWaveCorrectionTypes =
                WaveCorrectionType::kHorizontal, WaveCorrectionType::kVertical};
 
 const auto kInpaintingMethods =
-    std::array{InpaintingMethod::kNavierStokes, InpaintingMethod::kTelea};
+    std::array{InpaintingMethod::kNavierStokes, InpaintingMethod::kTelea,
+               InpaintingMethod::kPyramid};
 
 const auto kBlendingMethods =
     std::array{BlendingMethod::kOpenCV, BlendingMethod::kMultiblend};
@@ -83,6 +85,8 @@ struct ProjectionOptions {
   ProjectionType type = ProjectionType::kSpherical;
   float a_param = kDefaultPaniniA;
   float b_param = kDefaultPaniniB;
+
+  bool operator==(const ProjectionOptions&) const = default;
 };
 
 struct StitchUserOptions {
@@ -92,11 +96,21 @@ struct StitchUserOptions {
   float match_conf = kDefaultMatchConf;
   int max_pano_mpx = kMaxPanoMpx;
   BlendingMethod blending_method = kDefaultBlendingMethod;
+
+  bool operator==(const StitchUserOptions&) const = default;
+};
+
+struct PyramidInpaintingOptions {
+  // Upper bound, the actual count is limited by the image size
+  int levels = kDefaultInpaintingPyramidLevels;
+  // Width of the refined band along the hole boundary, in pixels of each level
+  int band_width = kDefaultInpaintingBandWidth;
 };
 
 struct InpaintingOptions {
   double radius = kDefaultInpaintingRadius;
   InpaintingMethod method = InpaintingMethod::kTelea;
+  PyramidInpaintingOptions pyramid;
 };
 
 }  // namespace xpano::algorithm
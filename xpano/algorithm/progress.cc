@@ -3,17 +3,27 @@
 
 #include "xpano/algorithm/progress.h"
 
+#include <functional>
+#include <utility>
+
 namespace xpano::algorithm {
 
 void ProgressMonitor::Reset(ProgressType type, int num_tasks) {
   type_ = type;
   done_ = 0;
   num_tasks_ = num_tasks;
+  NotifyListener();
 }
 
-void ProgressMonitor::SetTaskType(ProgressType type) { type_ = type; }
+void ProgressMonitor::SetTaskType(ProgressType type) {
+  type_ = type;
+  NotifyListener();
+}
 
-void ProgressMonitor::SetNumTasks(int num_tasks) { num_tasks_ = num_tasks; }
+void ProgressMonitor::SetNumTasks(int num_tasks) {
+  num_tasks_ = num_tasks;
+  NotifyListener();
+}
 
 ProgressReport ProgressMonitor::Report() const {
   if (IsCancelled()) {
@@ -22,10 +32,26 @@ ProgressReport ProgressMonitor::Report() const {
   return {.type = type_, .tasks_done = done_, .num_tasks = num_tasks_};
 }
 
-void ProgressMonitor::NotifyTaskDone() { done_++; }
+void ProgressMonitor::NotifyTaskDone() {
+  done_++;
+  NotifyListener();
+}
 
-void ProgressMonitor::Cancel() { cancel_ = true; }
+void ProgressMonitor::Cancel() {
+  cancel_ = true;
+  NotifyListener();
+}
 
 bool ProgressMonitor::IsCancelled() const { return cancel_; }
 
+void ProgressMonitor::SetListener(std::function<void()> listener) {
+  listener_ = std::move(listener);
+}
+
+void ProgressMonitor::NotifyListener() const {
+  if (listener_) {
+    listener_();
+  }
+}
+
 }  // namespace xpano::algorithm
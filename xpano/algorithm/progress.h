@@ -5,6 +5,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <functional>
 
 namespace xpano::algorithm {
 
@@ -16,6 +17,7 @@ enum class ProgressType : std::uint8_t {
   kDetectingKeypoints,
   kMatchingImages,
   kExport,
+  kSavingSession,
   kInpainting,
   kStitchFindFeatures,
   kStitchMatchFeatures,
@@ -45,11 +47,18 @@ class ProgressMonitor {
   void Cancel();
   [[nodiscard]] bool IsCancelled() const;
 
+  // Called from the worker threads whenever the report changes, e.g. to wake
+  // up the gui. Set before the monitor is shared with the workers.
+  void SetListener(std::function<void()> listener);
+
  private:
+  void NotifyListener() const;
+
   std::atomic<ProgressType> type_{ProgressType::kNone};
   std::atomic<int> done_ = 0;
   std::atomic<int> num_tasks_ = 0;
   std::atomic<bool> cancel_ = false;
+  std::function<void()> listener_;
 };
 
 }  // namespace xpano::algorithm
@@ -60,7 +60,9 @@
 #include <spdlog/spdlog.h>
 
 #include "xpano/algorithm/progress.h"
+#include "xpano/utils/metrics.h"
 #include "xpano/utils/opencv.h"
+#include "xpano/utils/trace.h"
 
 namespace xpano::algorithm::stitcher {
 
@@ -102,6 +104,31 @@ class Timer {
   int64 start_count_ = 0;
 };
 
+const char *StageName(ProgressType type) {
+  switch (type) {
+    case ProgressType::kStitchFindFeatures:
+      return "find_features";
+    case ProgressType::kStitchMatchFeatures:
+      return "match_features";
+    case ProgressType::kStitchEstimateHomography:
+      return "estimate_homography";
+    case ProgressType::kStitchBundleAdjustment:
+      return "bundle_adjustment";
+    case ProgressType::kStitchComputeRoi:
+      return "compute_roi";
+    case ProgressType::kStitchSeamsPrepare:
+      return "seams_prepare";
+    case ProgressType::kStitchSeamsFind:
+      return "seams_find";
+    case ProgressType::kStitchCompose:
+      return "compose";
+    case ProgressType::kStitchBlend:
+      return "blend";
+    default:
+      return "stitch";
+  }
+}
+
 double ComputeWarpScale(const std::vector<cv::detail::CameraParams> &cameras) {
   std::vector<double> focals(cameras.size());
   std::transform(cameras.begin(), cameras.end(), focals.begin(),
@@ -355,6 +382,9 @@ Status Stitcher::ComposePanorama(cv::OutputArray pano) {
   auto compositing_total_timer = Timer();
 
   blender_->prepare(roi.rect);
+  if (live_canvas_ != nullptr) {
+    live_canvas_->Prepare(roi.rect);
+  }
   for (size_t img_idx = 0; img_idx < imgs_.size(); ++img_idx) {
     NextTask(ProgressType::kStitchCompose);
     if (auto non_zero = cv::countNonZero(masks_warped[img_idx]);
@@ -405,6 +435,11 @@ Status Stitcher::ComposePanorama(cv::OutputArray pano) {
     blender_->feed(img_warped, mask_warped, roi.corners[img_idx]);
     timer.Report(" feed time");
 
+    if (live_canvas_ != nullptr) {
+      live_canvas_->Paste(img_warped, mask_warped, roi.corners[img_idx]);
+      timer.Report(" live canvas");
+    }
+
     compositing_timer.Report("Compositing ## time");
 
     if (Cancelled()) {
@@ -633,12 +668,17 @@ void Stitcher::NextTask(algorithm::ProgressType task) {
     monitor_->NotifyTaskDone();
     monitor_->SetTaskType(task);
   }
+  // Destroying the previous stage records it
+  stage_.emplace(metrics_, StageName(task));
+  trace_.emplace(StageName(task));
 }
 
 void Stitcher::EndMonitoring() {
   if (monitor_ != nullptr) {
     monitor_->NotifyTaskDone();
   }
+  stage_.reset();
+  trace_.reset();
 }
 
 }  // namespace xpano::algorithm::stitcher
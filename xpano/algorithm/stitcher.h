@@ -49,6 +49,7 @@
 #pragma once
 
 #include <cstdint>
+#include <optional>
 #include <vector>
 
 #include <opencv2/core.hpp>
@@ -56,7 +57,10 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/stitching.hpp>
 
+#include "xpano/algorithm/live_canvas.h"
 #include "xpano/algorithm/progress.h"
+#include "xpano/utils/metrics.h"
+#include "xpano/utils/trace.h"
 
 namespace xpano::algorithm::stitcher {
 
@@ -66,7 +70,9 @@ enum class Status : std::uint8_t {
   kCancelled,
   kErrNeedMoreImgs,
   kErrHomographyEstFail,
-  kErrCameraParamsAdjustFail
+  kErrCameraParamsAdjustFail,
+  // An input file changed since it was loaded, or can't be read anymore
+  kErrInputChanged
 };
 
 bool IsSuccess(Status status);
@@ -232,6 +238,10 @@ class Stitcher {
   [[nodiscard]] cv::UMat ResultMask() const { return result_mask_; }
 
   void SetProgressMonitor(ProgressMonitor* monitor) { monitor_ = monitor; }
+  // Gets a low resolution copy of each image as it is composed
+  void SetLiveCanvas(LiveCanvas* canvas) { live_canvas_ = canvas; }
+  // Records the same stages as reported to the progress monitor
+  void SetMetrics(utils::metrics::Recorder* metrics) { metrics_ = metrics; }
 
   [[nodiscard]] WarpHelper GetWarpHelper() const { return warp_helper_; }
 
@@ -278,6 +288,10 @@ class Stitcher {
   double warped_image_scale_ = 1.0;
 
   ProgressMonitor* monitor_ = nullptr;
+  utils::metrics::Recorder* metrics_ = nullptr;
+  LiveCanvas* live_canvas_ = nullptr;
+  std::optional<utils::metrics::ScopedStage> stage_;
+  std::optional<utils::trace::Scope> trace_;
   WarpHelper warp_helper_ = {};
   float max_pano_mpx_;
 };
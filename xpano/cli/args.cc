@@ -3,10 +3,14 @@
 
 #include "xpano/cli/args.h"
 
+#include <algorithm>
+#include <charconv>
 #include <exception>
 #include <filesystem>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <system_error>
 #include <vector>
 
 #include <spdlog/spdlog.h>
@@ -26,6 +30,24 @@ const std::string kGuiFlag = "--gui";
 const std::string kOutputFlag = "--output=";
 const std::string kHelpFlag = "--help";
 const std::string kVersionFlag = "--version";
+const std::string kOutputDirFlag = "--output-dir=";
+const std::string kMaxMemoryFlag = "--max-memory=";
+const std::string kBatchFlag = "--batch=";
+const std::string kWatchFlag = "--watch=";
+const std::string kStatsFlag = "--stats=";
+const std::string kTraceFlag = "--trace=";
+const std::string kStatsFormatJson = "json";
+
+// The whole value has to be a number, "12abc" is rejected
+int ParseInt(const std::string& value) {
+  int result = 0;
+  auto [end, error] =
+      std::from_chars(value.data(), value.data() + value.size(), result);
+  if (error != std::errc() || end != value.data() + value.size()) {
+    throw std::invalid_argument(fmt::format("invalid number \"{}\"", value));
+  }
+  return result;
+}
 
 void ParseArg(Args* result, const std::string& arg) {
   if (arg == kGuiFlag) {
@@ -34,6 +56,28 @@ void ParseArg(Args* result, const std::string& arg) {
     result->print_help = true;
   } else if (arg == kVersionFlag) {
     result->print_version = true;
+  } else if (arg.starts_with(kOutputDirFlag)) {
+    auto substr = arg.substr(kOutputDirFlag.size());
+    result->output_dir = std::filesystem::path(substr);
+  } else if (arg.starts_with(kBatchFlag)) {
+    auto substr = arg.substr(kBatchFlag.size());
+    result->batch_manifest = std::filesystem::path(substr);
+  } else if (arg.starts_with(kWatchFlag)) {
+    auto substr = arg.substr(kWatchFlag.size());
+    result->watch_dir = std::filesystem::path(substr);
+  } else if (arg.starts_with(kStatsFlag)) {
+    auto substr = arg.substr(kStatsFlag.size());
+    if (substr != kStatsFormatJson) {
+      throw std::invalid_argument(
+          fmt::format("unsupported stats format \"{}\"", substr));
+    }
+    result->print_stats = true;
+  } else if (arg.starts_with(kTraceFlag)) {
+    auto substr = arg.substr(kTraceFlag.size());
+    result->trace_path = std::filesystem::path(substr);
+  } else if (arg.starts_with(kMaxMemoryFlag)) {
+    auto substr = arg.substr(kMaxMemoryFlag.size());
+    result->max_memory_mib = ParseInt(substr);
   } else if (arg.starts_with(kOutputFlag)) {
     auto substr = arg.substr(kOutputFlag.size());
     result->output_path = std::filesystem::path(substr);
@@ -52,13 +96,36 @@ Args ParseArgsRaw(int argc, char** argv) {
   return result;
 }
 
+// The paths are compared after resolving them, they don't have to exist
+bool IsInside(const std::filesystem::path& path,
+              const std::filesystem::path& dir) {
+  std::error_code path_error;
+  std::error_code dir_error;
+  auto resolved_path = std::filesystem::weakly_canonical(
+      std::filesystem::absolute(path, path_error), path_error);
+  auto resolved_dir = std::filesystem::weakly_canonical(
+      std::filesystem::absolute(dir, dir_error), dir_error);
+  if (path_error || dir_error) {
+    return false;
+  }
+  for (auto* resolved : {&resolved_path, &resolved_dir}) {
+    if (!resolved->has_filename()) {
+      *resolved = resolved->parent_path();
+    }
+  }
+  auto dir_end = std::mismatch(resolved_dir.begin(), resolved_dir.end(),
+                               resolved_path.begin(), resolved_path.end())
+                     .first;
+  return dir_end == resolved_dir.end();
+}
+
 bool ValidateArgs(const Args& args) {
   if (args.output_path && args.input_paths.empty()) {
     spdlog::error("No supported images provided");
     return false;
   }
   if (args.output_path &&
-      !utils::path::IsExtensionSupported(*args.output_path)) {
+      !utils::path::IsExportExtensionSupported(*args.output_path)) {
     spdlog::error("Unsupported output file extension: \"{}\"",
                   args.output_path->extension().string());
     return false;
@@ -68,6 +135,64 @@ bool ValidateArgs(const Args& args) {
         "Specifying --gui and --output together is not yet supported.");
     return false;
   }
+  if (args.output_dir && args.input_paths.empty() && !args.watch_dir) {
+    spdlog::error("No supported images provided");
+    return false;
+  }
+  if (args.output_dir && args.output_path) {
+    spdlog::error("Specifying --output and --output-dir together is not "
+                  "supported.");
+    return false;
+  }
+  if (args.output_dir && args.run_gui) {
+    spdlog::error(
+        "Specifying --gui and --output-dir together is not supported.");
+    return false;
+  }
+  if (args.batch_manifest &&
+      (!args.input_paths.empty() || args.output_path || args.output_dir)) {
+    spdlog::error(
+        "Specifying --batch together with input files, --output or "
+        "--output-dir is not supported.");
+    return false;
+  }
+  if (args.batch_manifest && args.run_gui) {
+    spdlog::error("Specifying --gui and --batch together is not supported.");
+    return false;
+  }
+  if (args.watch_dir && !args.output_dir) {
+    spdlog::error("Specifying --watch requires --output-dir.");
+    return false;
+  }
+  if (args.watch_dir && IsInside(*args.output_dir, *args.watch_dir)) {
+    spdlog::error(
+        "Specifying --output-dir inside the --watch directory is not "
+        "supported.");
+    return false;
+  }
+  if (args.watch_dir && (!args.input_paths.empty() || args.output_path ||
+                         args.batch_manifest || args.run_gui)) {
+    spdlog::error(
+        "Specifying --watch together with input files, --output, --batch or "
+        "--gui is not supported.");
+    return false;
+  }
+  if (args.print_stats && (args.input_paths.empty() || args.run_gui)) {
+    spdlog::error("Specifying --stats requires input files without --gui.");
+    return false;
+  }
+  if (args.trace_path &&
+      (args.run_gui || (args.input_paths.empty() && !args.batch_manifest &&
+                        !args.watch_dir))) {
+    spdlog::error(
+        "Specifying --trace is not supported in the GUI, use Help > Record "
+        "trace instead.");
+    return false;
+  }
+  if (args.max_memory_mib && *args.max_memory_mib <= 0) {
+    spdlog::error("Invalid memory budget: {} MiB", *args.max_memory_mib);
+    return false;
+  }
   return true;
 }
 
@@ -98,8 +223,25 @@ std::optional<Args> ParseArgs(int argc, char** argv) {
 
 void PrintHelp() {
   spdlog::info("Usage: Xpano [<input files>] [--output=<path>]");
-  spdlog::info("\t[--gui] [--help] [--version]");
+  spdlog::info("\t[--gui] [--help] [--version] [--stats=json]");
+  spdlog::info("Batch mode, detects and exports all panoramas:");
+  spdlog::info("\tXpano [<input files>] [--output-dir=<path>]");
+  spdlog::info("\t[--max-memory=<MiB>] [--stats=json]");
+  spdlog::info(
+      "\t--stats=json prints the per-stage timings to stdout, the log goes "
+      "to stderr");
+  spdlog::info("All command line modes:");
+  spdlog::info("\t[--trace=<trace.json>] records a Chrome / Perfetto trace");
+  spdlog::info("Batch mode, stitches the jobs listed in a JSON manifest:");
+  spdlog::info("\tXpano --batch=<manifest.json> [--max-memory=<MiB>]");
+  spdlog::info("Watch mode, stitches image sets dropped into a folder:");
+  spdlog::info("\tXpano --watch=<path> --output-dir=<path>");
+  spdlog::info("\t[--max-memory=<MiB>]");
+  spdlog::info("\tA set ends with a *{} file or after {} s without images",
+               kWatchSentinelExtension, kWatchIdleTimeout.count());
   spdlog::info("Supported formats: {}", fmt::join(kSupportedExtensions, ", "));
+  spdlog::info("Export only formats: {}",
+               fmt::join(kExportOnlyExtensions, ", "));
 }
 
 }  // namespace xpano::cli
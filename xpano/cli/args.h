@@ -15,6 +15,12 @@ struct Args {
   bool print_version = false;
   std::vector<std::filesystem::path> input_paths;
   std::optional<std::filesystem::path> output_path;
+  std::optional<std::filesystem::path> output_dir;
+  std::optional<int> max_memory_mib;
+  std::optional<std::filesystem::path> batch_manifest;
+  std::optional<std::filesystem::path> watch_dir;
+  bool print_stats = false;
+  std::optional<std::filesystem::path> trace_path;
 };
 
 std::optional<Args> ParseArgs(int argc, char** argv);
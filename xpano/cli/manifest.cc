@@ -0,0 +1,278 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/cli/manifest.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "xpano/algorithm/options.h"
+#include "xpano/pipeline/stitcher_pipeline.h"
+#include "xpano/utils/expected.h"
+#include "xpano/utils/fmt.h"
+#include "xpano/utils/json.h"
+#include "xpano/utils/path.h"
+
+namespace xpano::cli::manifest {
+
+namespace {
+
+using utils::json::Value;
+
+struct Error {
+  std::string message;
+};
+
+[[noreturn]] void Fail(const std::string& message) { throw Error{message}; }
+
+// Case insensitive, ignores the '*' marking the experimental options
+bool LabelEquals(std::string_view label, std::string_view text) {
+  std::string normalized;
+  for (const char character : label) {
+    if (character != '*') {
+      normalized.push_back(static_cast<char>(
+          std::tolower(static_cast<unsigned char>(character))));
+    }
+  }
+  return std::equal(normalized.begin(), normalized.end(), text.begin(),
+                    text.end(), [](char lhs, char rhs) {
+                      return lhs == std::tolower(static_cast<unsigned char>(
+                                        rhs));
+                    });
+}
+
+template <typename TEnum, std::size_t N>
+TEnum ParseEnum(const std::array<TEnum, N>& values, const Value& value,
+                const std::string& key) {
+  if (!value.IsString()) {
+    Fail(fmt::format("\"{}\" must be a string", key));
+  }
+  for (const auto& option : values) {
+    if (LabelEquals(algorithm::Label(option), value.AsString())) {
+      return option;
+    }
+  }
+  Fail(fmt::format("Unknown {}: \"{}\"", key, value.AsString()));
+}
+
+bool ParseBool(const Value& value, const std::string& key) {
+  if (!value.IsBool()) {
+    Fail(fmt::format("\"{}\" must be true or false", key));
+  }
+  return value.AsBool();
+}
+
+int ParseInt(const Value& value, const std::string& key, int min, int max) {
+  if (!value.IsNumber() || value.AsNumber() != std::floor(value.AsNumber()) ||
+      value.AsNumber() < min || value.AsNumber() > max) {
+    Fail(fmt::format("\"{}\" must be an integer between {} and {}", key, min,
+                     max));
+  }
+  return static_cast<int>(value.AsNumber());
+}
+
+std::filesystem::path ParsePath(const Value& value, const std::string& key,
+                                const std::filesystem::path& base_dir) {
+  if (!value.IsString() || value.AsString().empty()) {
+    Fail(fmt::format("\"{}\" must be a path", key));
+  }
+  return base_dir / std::filesystem::path(value.AsString());
+}
+
+const Value::Object& ParseObject(const Value& value, const std::string& key) {
+  if (!value.IsObject()) {
+    Fail(fmt::format("\"{}\" must be an object", key));
+  }
+  return value.AsObject();
+}
+
+void ApplyOptions(const Value& value, pipeline::StitchingOptions* options) {
+  for (const auto& [key, option] : ParseObject(value, "options")) {
+    if (key == "full_res") {
+      options->full_res = ParseBool(option, key);
+    } else if (key == "projection") {
+      options->stitch_algorithm.projection.type =
+          ParseEnum(algorithm::kProjectionTypes, option, key);
+    } else if (key == "feature") {
+      options->stitch_algorithm.feature =
+          ParseEnum(algorithm::kFeatureTypes, option, key);
+    } else if (key == "wave_correction") {
+      options->stitch_algorithm.wave_correction =
+          ParseEnum(algorithm::kWaveCorrectionTypes, option, key);
+    } else if (key == "blending") {
+      options->stitch_algorithm.blending_method =
+          ParseEnum(algorithm::kBlendingMethods, option, key);
+    } else if (key == "max_pano_mpx") {
+      options->stitch_algorithm.max_pano_mpx =
+          ParseInt(option, key, 1, std::numeric_limits<int>::max());
+    } else if (key == "jpeg_quality") {
+      options->compression.jpeg_quality = ParseInt(option, key, 0, 100);
+    } else if (key == "png_compression") {
+      options->compression.png_compression = ParseInt(option, key, 0, 9);
+    } else if (key == "copy_metadata") {
+      options->metadata.copy_from_first_image = ParseBool(option, key);
+    } else {
+      Fail(fmt::format("Unknown option \"{}\"", key));
+    }
+  }
+}
+
+pipeline::BatchJob ParseJob(const Value& value,
+                            const pipeline::StitchingOptions& defaults,
+                            const std::filesystem::path& base_dir) {
+  pipeline::BatchJob job;
+  job.stitching = defaults;
+  const Value* inputs = nullptr;
+  for (const auto& [key, item] : ParseObject(value, "jobs")) {
+    if (key == "inputs") {
+      inputs = &item;
+    } else if (key == "output") {
+      job.stitching.export_path = ParsePath(item, key, base_dir);
+    } else if (key == "options") {
+      ApplyOptions(item, &job.stitching);
+    } else {
+      Fail(fmt::format("Unknown job key \"{}\"", key));
+    }
+  }
+
+  if (inputs == nullptr || !inputs->IsArray() || inputs->AsArray().empty()) {
+    Fail("\"inputs\" must be a non-empty array of paths");
+  }
+  for (const auto& input : inputs->AsArray()) {
+    job.inputs.push_back(ParsePath(input, "inputs", base_dir));
+  }
+  if (!job.stitching.export_path) {
+    Fail("Missing \"output\"");
+  }
+  if (!utils::path::IsExportExtensionSupported(*job.stitching.export_path)) {
+    Fail(fmt::format("Unsupported output file extension: \"{}\"",
+                     job.stitching.export_path->extension().string()));
+  }
+  return job;
+}
+
+Manifest ParseManifest(const Value& root,
+                       const std::filesystem::path& base_dir) {
+  Manifest manifest;
+  manifest.results_path = base_dir / "results.json";
+  pipeline::StitchingOptions defaults;
+  const Value* jobs = nullptr;
+  for (const auto& [key, item] : ParseObject(root, "manifest")) {
+    if (key == "max_jobs") {
+      manifest.batch.max_jobs =
+          ParseInt(item, key, 0, std::numeric_limits<int>::max());
+    } else if (key == "max_memory") {
+      manifest.batch.memory_budget_mib =
+          ParseInt(item, key, 1, std::numeric_limits<int>::max());
+    } else if (key == "results") {
+      manifest.results_path = ParsePath(item, key, base_dir);
+    } else if (key == "defaults") {
+      ApplyOptions(item, &defaults);
+    } else if (key == "jobs") {
+      jobs = &item;
+    } else {
+      Fail(fmt::format("Unknown key \"{}\"", key));
+    }
+  }
+
+  // Parsed last, the defaults can be listed after the jobs
+  if (jobs == nullptr || !jobs->IsArray()) {
+    Fail("\"jobs\" must be an array");
+  }
+  for (std::size_t i = 0; i < jobs->AsArray().size(); i++) {
+    try {
+      manifest.jobs.push_back(ParseJob(jobs->AsArray()[i], defaults, base_dir));
+    } catch (const Error& error) {
+      Fail(fmt::format("Job {}: {}", i, error.message));
+    }
+  }
+  return manifest;
+}
+
+}  // namespace
+
+utils::Expected<Manifest, std::string> Parse(
+    std::string_view text, const std::filesystem::path& base_dir) {
+  auto root = utils::json::Parse(text);
+  if (!root) {
+    return utils::Unexpected<std::string>(root.error());
+  }
+  try {
+    return ParseManifest(*root, base_dir);
+  } catch (const Error& error) {
+    return utils::Unexpected<std::string>(error.message);
+  }
+}
+
+utils::Expected<pipeline::StitchingOptions, std::string> ParseOptions(
+    const utils::json::Value& options, pipeline::StitchingOptions defaults) {
+  try {
+    ApplyOptions(options, &defaults);
+  } catch (const Error& error) {
+    return utils::Unexpected<std::string>(error.message);
+  }
+  return defaults;
+}
+
+utils::Expected<Manifest, std::string> Read(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return utils::Unexpected<std::string>(
+        fmt::format("Failed to open {}", path.string()));
+  }
+  const std::string text((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>());
+  return Parse(text, path.parent_path());
+}
+
+utils::json::Value ResultsToJson(
+    const Manifest& manifest,
+    const std::vector<pipeline::BatchJobResult>& results,
+    double total_seconds) {
+  Value::Array jobs;
+  int num_succeeded = 0;
+  for (const auto& result : results) {
+    const auto& job = manifest.jobs[result.job_id];
+    const bool success = result.error.empty();
+    num_succeeded += success ? 1 : 0;
+    Value::Object entry = {
+        {"job", result.job_id},
+        {"status", success ? "ok" : "failed"},
+        {"output", job.stitching.export_path->string()},
+        {"images", result.num_images},
+        {"loading_seconds", result.loading_seconds},
+        {"stitching_seconds", result.stitching_seconds},
+    };
+    if (!success) {
+      entry.emplace_back("error", result.error);
+    }
+    jobs.emplace_back(std::move(entry));
+  }
+  return Value::Object{
+      {"total_seconds", total_seconds},
+      {"succeeded", num_succeeded},
+      {"failed", static_cast<int>(results.size()) - num_succeeded},
+      {"jobs", std::move(jobs)},
+  };
+}
+
+bool WriteResults(const std::filesystem::path& path,
+                  const utils::json::Value& results) {
+  std::ofstream file(path, std::ios::binary);
+  file << utils::json::Dump(results);
+  return file.good();
+}
+
+}  // namespace xpano::cli::manifest
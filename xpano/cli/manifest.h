@@ -0,0 +1,56 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "xpano/pipeline/stitcher_pipeline.h"
+#include "xpano/utils/expected.h"
+#include "xpano/utils/json.h"
+
+namespace xpano::cli::manifest {
+
+// Example:
+// {
+//   "max_jobs": 4,
+//   "max_memory": 8192,
+//   "results": "results.json",
+//   "defaults": {"full_res": true, "projection": "cylindrical"},
+//   "jobs": [
+//     {"inputs": ["a1.jpg", "a2.jpg"], "output": "a.jpg"},
+//     {"inputs": ["b1.jpg", "b2.jpg"], "output": "b.tif",
+//      "options": {"wave_correction": "off"}}
+//   ]
+// }
+//
+// Job options: full_res, projection, feature, wave_correction, blending,
+// max_pano_mpx, jpeg_quality, png_compression, copy_metadata.
+struct Manifest {
+  std::vector<pipeline::BatchJob> jobs;
+  pipeline::BatchOptions batch;
+  std::filesystem::path results_path;
+};
+
+// Relative paths are resolved against base_dir
+utils::Expected<Manifest, std::string> Parse(
+    std::string_view text, const std::filesystem::path& base_dir);
+
+// Applies the job options on top of the defaults
+utils::Expected<pipeline::StitchingOptions, std::string> ParseOptions(
+    const utils::json::Value& options, pipeline::StitchingOptions defaults);
+
+utils::Expected<Manifest, std::string> Read(const std::filesystem::path& path);
+
+utils::json::Value ResultsToJson(
+    const Manifest& manifest,
+    const std::vector<pipeline::BatchJobResult>& results,
+    double total_seconds);
+
+bool WriteResults(const std::filesystem::path& path,
+                  const utils::json::Value& results);
+
+}  // namespace xpano::cli::manifest
@@ -4,21 +4,34 @@
 #include "xpano/cli/pano_cli.h"
 
 #include <atomic>
+#include <chrono>
 #include <exception>
 #include <filesystem>
+#include <future>
+#include <iostream>
 #include <optional>
+#include <system_error>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include <spdlog/spdlog.h>
 
 #include "xpano/algorithm/algorithm.h"
+#include "xpano/algorithm/stitcher.h"
 #include "xpano/cli/args.h"
+#include "xpano/cli/manifest.h"
 #include "xpano/cli/signal.h"
 #include "xpano/constants.h"
 #include "xpano/log/logger.h"
 #include "xpano/pipeline/options.h"
 #include "xpano/pipeline/stitcher_pipeline.h"
+#include "xpano/utils/bounded_queue.h"
 #include "xpano/utils/future.h"
+#include "xpano/utils/json.h"
+#include "xpano/utils/metrics.h"
+#include "xpano/utils/trace.h"
+#include "xpano/utils/watch.h"
 #include "xpano/version_fmt.h"
 
 #ifdef _WIN32
@@ -51,29 +64,73 @@ void CancelHandler(int /*signal*/) { cancel.fetch_add(1); }
 
 void PrintVersion() { spdlog::info("Xpano version {}", version::Current()); }
 
-ResultType RunPipeline(const Args &args) {
-  pipeline::StitcherPipeline<pipeline::RunTraits::kReturnFuture> pipeline;
-
-  auto loading_task = pipeline.RunLoading(
-      args.input_paths, {.preview_longer_side = kMaxImageSizeForCLI},
-      {.type = pipeline::MatchingType::kSinglePano});
-
-  pipeline::StitcherData stitcher_data;
+using Pipeline = pipeline::StitcherPipeline<pipeline::RunTraits::kReturnFuture>;
 
+template <typename TResult>
+std::optional<TResult> WaitForTask(pipeline::Task<std::future<TResult>> task,
+                                   Pipeline *pipeline,
+                                   const char *description) {
   try {
-    stitcher_data = utils::future::GetWithCancellation(
-        std::move(loading_task.future), cancel);
+    return utils::future::GetWithCancellation(std::move(task.future), cancel);
   } catch (const utils::future::Cancelled) {
     spdlog::info("Canceling, press CTRL+C again to force quit.");
-    loading_task.progress->Cancel();
-    pipeline.CancelAndWait();
-    return ResultType::kError;
+    task.progress->Cancel();
+    pipeline->CancelAndWait();
   } catch (const std::exception &e) {
-    spdlog::error("Failed to load images: {}", e.what());
+    spdlog::error("Failed to {}: {}", description, e.what());
+  }
+  return {};
+}
+
+utils::json::Value StagesToJson(const utils::metrics::Stages &stages) {
+  utils::json::Value::Array array;
+  for (const auto &stage : stages) {
+    utils::json::Value::Object object = {
+        {"name", stage.name},
+        {"count", stage.count},
+        {"wall_seconds", stage.wall_seconds},
+        {"cpu_seconds", stage.cpu_seconds},
+        {"allocated_bytes", static_cast<double>(stage.allocated_bytes)},
+        {"peak_rss_bytes", static_cast<double>(stage.peak_rss_bytes)}};
+    if (!stage.occurrences.empty()) {
+      object.emplace_back("occurrences", StagesToJson(stage.occurrences));
+    }
+    array.emplace_back(std::move(object));
+  }
+  return array;
+}
+
+// Printed to stdout as a single JSON document, the log goes to stderr with
+// --stats
+void PrintStats(const pipeline::StitcherData &stitcher_data,
+                const std::vector<pipeline::StitchingResult> &results) {
+  utils::json::Value::Array panos;
+  for (const auto &result : results) {
+    panos.emplace_back(utils::json::Value::Object{
+        {"pano_id", result.pano_id}, {"stages", StagesToJson(result.metrics)}});
+  }
+  const utils::json::Value stats = utils::json::Value::Object{
+      {"loading", StagesToJson(stitcher_data.metrics)},
+      {"panos", std::move(panos)},
+      {"peak_rss_bytes",
+       static_cast<double>(utils::metrics::PeakRssBytes())}};
+  std::cout << utils::json::Dump(stats) << std::flush;
+}
+
+ResultType RunPipeline(const Args &args) {
+  Pipeline pipeline;
+
+  auto stitcher_data = WaitForTask(
+      pipeline.RunLoading(args.input_paths,
+                          {.preview_longer_side = kMaxImageSizeForCLI},
+                          {.type = pipeline::MatchingType::kSinglePano}),
+      &pipeline, "load images");
+
+  if (!stitcher_data) {
     return ResultType::kError;
   }
 
-  if (stitcher_data.images.empty()) {
+  if (stitcher_data->images.empty()) {
     spdlog::error("Failed to load any images");
     return ResultType::kError;
   }
@@ -81,45 +138,240 @@ ResultType RunPipeline(const Args &args) {
   auto export_path =
       args.output_path
           ? *args.output_path
-          : std::filesystem::path(stitcher_data.images[0].PanoName());
+          : std::filesystem::path(stitcher_data->images[0].PanoName());
 
-  auto stitching_task = pipeline.RunStitching(
-      stitcher_data, {.pano_id = 0, .export_path = export_path});
+  auto stitching_result = WaitForTask(
+      pipeline.RunStitching(*stitcher_data,
+                            {.pano_id = 0, .export_path = export_path}),
+      &pipeline, "stitch panorama");
 
-  pipeline::StitchingResult stitching_result;
-
-  try {
-    stitching_result = utils::future::GetWithCancellation(
-        std::move(stitching_task.future), cancel);
-  } catch (const utils::future::Cancelled) {
-    spdlog::info("Canceling, press CTRL+C again to force quit.");
-    stitching_task.progress->Cancel();
-    pipeline.CancelAndWait();
-    return ResultType::kError;
-  } catch (const std::exception &e) {
-    spdlog::error("Failed to stitch panorama: {}", e.what());
+  if (!stitching_result) {
     return ResultType::kError;
   }
 
-  if (!stitching_result.pano) {
+  if (args.print_stats) {
+    PrintStats(*stitcher_data, {*stitching_result});
+  }
+
+  if (!stitching_result->pano) {
     spdlog::error("Failed to stitch panorama: {}",
-                  algorithm::ToString(stitching_result.status));
+                  algorithm::ToString(stitching_result->status));
     return ResultType::kError;
   }
 
-  if (!stitching_result.export_path) {
+  if (!stitching_result->export_path) {
     spdlog::error("Failed to export panorama to file: {}",
                   export_path.string());
     return ResultType::kError;
   }
 
   spdlog::info("Successfully exported to {}",
-               stitching_result.export_path->string());
-  spdlog::info("Size: {} x {}", stitching_result.pano->cols,
-               stitching_result.pano->rows);
+               stitching_result->export_path->string());
+  spdlog::info("Size: {} x {}", stitching_result->pano->cols,
+               stitching_result->pano->rows);
 
   return ResultType::kSuccess;
 }
+
+// Detects all panoramas in the inputs and exports them into output_dir
+ResultType StitchAllPanos(Pipeline *pipeline,
+                          const std::vector<std::filesystem::path> &inputs,
+                          const std::filesystem::path &output_dir,
+                          std::optional<int> max_memory_mib,
+                          bool print_stats = false) {
+  auto stitcher_data = WaitForTask(
+      pipeline->RunLoading(inputs, {}, {.type = pipeline::MatchingType::kAuto}),
+      pipeline, "load images");
+
+  if (!stitcher_data) {
+    return ResultType::kError;
+  }
+
+  if (stitcher_data->panos.empty()) {
+    spdlog::error("No panoramas found");
+    return ResultType::kError;
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(output_dir, error);
+  if (error) {
+    spdlog::error("Failed to create the output directory {}: {}",
+                  output_dir.string(), error.message());
+    return ResultType::kError;
+  }
+
+  std::vector<pipeline::StitchingOptions> options;
+  for (int pano_id = 0; pano_id < stitcher_data->panos.size(); pano_id++) {
+    const auto &first_image =
+        stitcher_data->images[stitcher_data->panos[pano_id].ids[0]];
+    options.push_back({.pano_id = pano_id,
+                       .full_res = true,
+                       .export_path = output_dir / first_image.PanoName()});
+  }
+
+  pipeline::BatchOptions batch_options;
+  if (max_memory_mib) {
+    batch_options.memory_budget_mib = *max_memory_mib;
+  }
+
+  auto results = WaitForTask(
+      pipeline->RunBatchStitching(*stitcher_data, options, batch_options),
+      pipeline, "stitch panoramas");
+
+  if (!results) {
+    return ResultType::kError;
+  }
+
+  if (print_stats) {
+    PrintStats(*stitcher_data, *results);
+  }
+
+  int num_exported = 0;
+  for (auto &result : *results) {
+    if (result.export_path) {
+      spdlog::info("Successfully exported to {}",
+                   result.export_path->string());
+      num_exported++;
+    } else if (algorithm::stitcher::IsSuccess(result.status)) {
+      spdlog::error("Failed to export panorama {}", result.pano_id);
+    } else {
+      spdlog::error("Failed to stitch panorama {}: {}", result.pano_id,
+                    algorithm::ToString(result.status));
+    }
+  }
+  spdlog::info("Exported {} of {} panoramas", num_exported, options.size());
+
+  return num_exported == static_cast<int>(options.size()) ? ResultType::kSuccess
+                                                          : ResultType::kError;
+}
+
+ResultType RunBatchPipeline(const Args &args) {
+  Pipeline pipeline;
+  return StitchAllPanos(&pipeline, args.input_paths, *args.output_dir,
+                        args.max_memory_mib, args.print_stats);
+}
+
+// Runs until cancelled, the pipeline and its threadpools are reused for all
+// the image sets. The watcher thread keeps reading new files while the queue
+// is full, so that the inotify queue doesn't overflow. The complete sets wait
+// in the grouper meanwhile.
+ResultType RunWatchPipeline(const Args &args) {
+  if (!std::filesystem::is_directory(*args.watch_dir)) {
+    spdlog::error("Not a directory: {}", args.watch_dir->string());
+    return ResultType::kError;
+  }
+
+  utils::watch::FolderWatcher watcher(*args.watch_dir);
+  utils::mt::BoundedQueue<std::vector<std::filesystem::path>> queue(
+      kWatchQueueSize);
+  std::atomic_bool stop = false;
+  std::thread watcher_thread([&watcher, &queue, &stop]() {
+    utils::watch::FileGrouper grouper(kWatchIdleTimeout);
+    std::optional<std::vector<std::filesystem::path>> ready;
+    while (!stop) {
+      for (const auto &file : watcher.Wait(kTaskCancellationTimeout)) {
+        grouper.Add(file, utils::watch::Clock::now());
+      }
+      if (!ready) {
+        ready = grouper.TakeReady(utils::watch::Clock::now());
+      }
+      while (ready && queue.Push(&*ready, std::chrono::milliseconds(0))) {
+        ready = grouper.TakeReady(utils::watch::Clock::now());
+      }
+    }
+  });
+
+  spdlog::info("Watching {} for new images, press CTRL+C to stop.",
+               args.watch_dir->string());
+  Pipeline pipeline;
+  int num_sets = 0;
+  while (cancel == 0) {
+    auto files = queue.Pop(kTaskCancellationTimeout);
+    if (!files) {
+      continue;
+    }
+    spdlog::info("Processing a set of {} images, {} more sets queued",
+                 files->size(), queue.Size());
+    StitchAllPanos(&pipeline, *files, *args.output_dir, args.max_memory_mib);
+    num_sets++;
+  }
+
+  stop = true;
+  watcher_thread.join();
+  spdlog::info("Stopped watching, processed {} sets", num_sets);
+  return ResultType::kSuccess;
+}
+
+ResultType RunManifestPipeline(const Args &args) {
+  auto manifest = manifest::Read(*args.batch_manifest);
+  if (!manifest) {
+    spdlog::error("Failed to read the batch manifest {}: {}",
+                  args.batch_manifest->string(), manifest.error());
+    return ResultType::kError;
+  }
+  if (args.max_memory_mib) {
+    manifest->batch.memory_budget_mib = *args.max_memory_mib;
+  }
+
+  Pipeline pipeline;
+  const auto start = std::chrono::steady_clock::now();
+  auto results = WaitForTask(
+      pipeline.RunBatchJobs(manifest->jobs, manifest->batch), &pipeline,
+      "run the batch");
+  const auto total_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  if (!results) {
+    return ResultType::kError;
+  }
+
+  int num_exported = 0;
+  for (const auto &result : *results) {
+    const auto &output = *manifest->jobs[result.job_id].stitching.export_path;
+    if (result.error.empty()) {
+      spdlog::info("Job {}: exported to {} in {:.1f} s", result.job_id,
+                   output.string(),
+                   result.loading_seconds + result.stitching_seconds);
+      num_exported++;
+    } else {
+      spdlog::error("Job {}: failed to export {}: {}", result.job_id,
+                    output.string(), result.error);
+    }
+  }
+  spdlog::info("Exported {} of {} panoramas in {:.1f} s", num_exported,
+               manifest->jobs.size(), total_seconds);
+
+  if (!manifest::WriteResults(
+          manifest->results_path,
+          manifest::ResultsToJson(*manifest, *results, total_seconds))) {
+    spdlog::error("Failed to write the results to {}",
+                  manifest->results_path.string());
+    return ResultType::kError;
+  }
+  spdlog::info("Results written to {}", manifest->results_path.string());
+
+  return num_exported == static_cast<int>(manifest->jobs.size())
+             ? ResultType::kSuccess
+             : ResultType::kError;
+}
+
+// Records a trace of the whole run if requested
+ResultType Traced(ResultType (*run)(const Args &), const Args &args) {
+  if (!args.trace_path) {
+    return run(args);
+  }
+  utils::trace::Enable(true);
+  auto result = run(args);
+  utils::trace::Enable(false);
+  if (utils::trace::WriteChromeJson(*args.trace_path)) {
+    spdlog::info("Trace written to {}", args.trace_path->string());
+  } else {
+    spdlog::error("Failed to write the trace to {}",
+                  args.trace_path->string());
+  }
+  return result;
+}
 }  // namespace
 
 std::pair<ResultType, std::optional<Args>> Run(int argc, char **argv) {
@@ -135,6 +387,10 @@ std::pair<ResultType, std::optional<Args>> Run(int argc, char **argv) {
     return {ResultType::kError, std::nullopt};
   }
 
+  if (args->print_stats) {
+    logger::RedirectSpdlogToCerr();
+  }
+
   if (args->print_help) {
     PrintHelp();
     return {ResultType::kSuccess, std::nullopt};
@@ -145,12 +401,25 @@ std::pair<ResultType, std::optional<Args>> Run(int argc, char **argv) {
     return {ResultType::kSuccess, std::nullopt};
   }
 
+  if (args->batch_manifest) {
+    signal::RegisterInterruptHandler(CancelHandler);
+    return {Traced(RunManifestPipeline, *args), args};
+  }
+
+  if (args->watch_dir) {
+    signal::RegisterInterruptHandler(CancelHandler);
+    return {Traced(RunWatchPipeline, *args), args};
+  }
+
   if (args->run_gui || args->input_paths.empty()) {
     return {ResultType::kForwardToGui, args};
   }
 
   signal::RegisterInterruptHandler(CancelHandler);
-  return {RunPipeline(*args), args};
+  if (args->output_dir) {
+    return {Traced(RunBatchPipeline, *args), args};
+  }
+  return {Traced(RunPipeline, *args), args};
 }
 
 int ExitCode(ResultType result) {
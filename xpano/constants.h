@@ -5,14 +5,31 @@
 
 #include <array>
 #include <chrono>
+#include <cstddef>
 #include <string>
 
 namespace xpano {
 
 constexpr int kNumFeatures = 3000;
 constexpr int kThumbnailSize = 256;
+// Thumbnail atlas pages hold kThumbnailPageSide^2 thumbnails
+constexpr int kThumbnailPageSide = 4;
+constexpr int kThumbnailsPerPage = kThumbnailPageSide * kThumbnailPageSide;
+constexpr int kThumbnailPageSize = kThumbnailPageSide * kThumbnailSize;
+constexpr int kMaxThumbnailPages = 32;
 constexpr int kMaxTexSize = 16384;
 constexpr int kLoupeSize = 4096;
+// Zoomed in previews of images larger than kLoupeSize are drawn from tiles
+constexpr int kPreviewTileSize = 512;
+constexpr int kMaxPreviewTiles = 64;
+// Longer side of the panorama shown while its images are being composed
+constexpr int kLiveCanvasSize = 1024;
+// Longer side of the pano remapped while the rotation is being dragged
+constexpr int kRotatePreviewSize = 1024;
+
+constexpr std::size_t kTextureUploadBytesPerFrame = 8 * 1024 * 1024;
+constexpr std::size_t kMaxPooledTextureBytes = 128 * 1024 * 1024;
+
 constexpr int kMinMatchThreshold = 4;
 constexpr int kDefaultMatchThreshold = 70;
 constexpr int kMaxMatchThreshold = 250;
@@ -25,6 +42,13 @@ constexpr int kWindowWidth = 1280;
 constexpr int kWindowHeight = 800;
 constexpr int kMinWindowSize = 200;
 
+// The gui waits for events instead of drawing when nothing changes, the
+// background work that can't wake it up is polled with the busy timeout
+constexpr auto kIdleFrameTimeout = std::chrono::milliseconds(1000);
+constexpr auto kBusyFrameTimeout = std::chrono::milliseconds(100);
+// Imgui needs a few frames to settle after an input
+constexpr int kFramesAfterEvent = 3;
+
 constexpr float kZoomFactor = 1.4f;
 constexpr int kZoomLevels = 11;
 constexpr float kZoomSpeed = 0.1f;
@@ -36,8 +60,17 @@ constexpr int kScrollingStepPerFrame = 25;
 const std::array<std::string, 6> kSupportedExtensions = {"jpg", "jpeg", "tiff",
                                                          "tif", "png",  "bmp"};
 
-const std::array<std::string, 4> kMetadataSupportedExtensions = {"jpg", "jpeg",
-                                                                 "tiff", "tif"};
+const std::array<std::string, 5> kMetadataSupportedExtensions = {
+    "jpg", "jpeg", "tiff", "tif", "ptif"};
+
+const std::array<std::string, 2> kJpegExtensions = {"jpg", "jpeg"};
+const std::array<std::string, 1> kPngExtensions = {"png"};
+const std::array<std::string, 2> kTiffExtensions = {"tiff", "tif"};
+const std::array<std::string, 1> kPyramidTiffExtensions = {"ptif"};
+// Can be exported to, but not loaded
+const std::array<std::string, 2> kExportOnlyExtensions = {"ptif", "dzi"};
+const std::array<std::string, 1> kDeepZoomExtensions = {"dzi"};
+const std::array<std::string, 1> kSessionExtensions = {"xpano"};
 
 const std::string kLogFilename = "logs/xpano.log";
 constexpr int kMaxLogSize = 5 * 1024 * 1024;
@@ -53,6 +86,7 @@ constexpr int kDefaultJpegQuality = 95;
 constexpr int kMaxJpegQuality = 100;
 constexpr int kDefaultPngCompression = 6;
 constexpr int kMaxPngCompression = 9;
+constexpr int kDefaultTiffCompression = 6;
 
 constexpr int kAboutBoxWidth = 70;
 constexpr int kAboutBoxHeight = 30;
@@ -83,6 +117,9 @@ constexpr float kMaxMatchConf = 0.4f;
 
 const std::string kAppConfigFilename = "app_config.alpaca";
 const std::string kUserConfigFilename = "user_config.alpaca";
+// Previews and thumbnails in session files, lossless and fast to write
+const std::string kSessionImageExtension = ".png";
+constexpr int kSessionPngCompression = 1;
 const std::string kChangelogFilename = "CHANGELOG.md";
 
 constexpr int kCropEdgeTolerance = 10;
@@ -91,11 +128,45 @@ constexpr int kAutoCropSamplingDistance = 512;
 constexpr double kDefaultInpaintingRadius = 3.0;
 constexpr double kMaxInpaintingRadius = 15.0;
 constexpr double kInpaintingRadiusStep = 1.0;
+constexpr int kDefaultInpaintingPyramidLevels = 4;
+constexpr int kMaxInpaintingPyramidLevels = 8;
+constexpr int kMinInpaintingPyramidSize = 64;
+constexpr int kDefaultInpaintingBandWidth = 8;
+constexpr int kMaxInpaintingBandWidth = 32;
 constexpr float kMegapixel = 1'000'000;
 
 const std::string kDefaultPanoSuffix = "_pano";
 constexpr int kMaxImageSizeForCLI = 8192;
 
+// Rough peak memory use of stitching per pixel of the input images, used to
+// limit the number of panos stitched concurrently in the batch mode
+constexpr int kBatchBytesPerInputPixel = 24;
+constexpr int kDefaultBatchMemoryBudgetMiB = 8192;
+
+// Previews of all panos stitched in the background after matching, the budget
+// covers the kept previews and the estimate of the one being stitched
+constexpr int kSpeculativeMemoryBudgetMiB = 1024;
+// Recently shown pano previews kept by the gui
+constexpr int kPreviewCacheMiB = 512;
+
+// Watch mode: a set of images is complete once a sentinel file arrives or no
+// new image arrived for the idle timeout
+const std::string kWatchSentinelExtension = ".done";
+constexpr auto kWatchIdleTimeout = std::chrono::seconds(10);
+constexpr auto kWatchPollInterval = std::chrono::seconds(1);
+constexpr int kWatchQueueSize = 4;
+
+// Older events of a thread are overwritten once its buffer is full
+constexpr int kTraceEventsPerThread = 32 * 1024;
+const std::string kTraceFilename = "logs/xpano_trace.json";
+
+constexpr int kDefaultServerPort = 8642;
+constexpr int kServerMaxConnections = 32;
+constexpr std::size_t kServerMaxHeaderSize = 64 * 1024;
+constexpr std::size_t kServerMaxBodySize = 1024 * 1024 * 1024;
+constexpr auto kServerReadTimeout = std::chrono::seconds(30);
+constexpr auto kServerProgressInterval = std::chrono::milliseconds(250);
+
 constexpr int kExifDefaultOrientation = 1;
 
 constexpr int kCancelAnimationFrameDuration = 128;
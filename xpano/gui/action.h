@@ -29,6 +29,9 @@ enum class ActionType : std::uint8_t {
   kLoadFiles,
   kOpenDirectory,
   kOpenFiles,
+  kOpenSession,
+  kLoadSession,
+  kSaveSession,
   kShowAbout,
   kShowBugReport,
   kShowImage,
@@ -39,6 +42,7 @@ enum class ActionType : std::uint8_t {
   kRecomputePanoFullRes,
   kQuit,
   kToggleDebugLog,
+  kToggleTrace,
   kWarnInputConversion,
   kResetOptions,
   kResetRotation,
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <type_traits>
 
@@ -31,7 +32,22 @@ class Base {
  public:
   virtual ~Base() = default;
   virtual Texture CreateTexture(utils::Vec2i size) = 0;
+
+  // Copies the image to the top left corner of the texture right away, drops
+  // the queued updates of the texture
   virtual void UpdateTexture(ImTextureID tex, cv::Mat image) = 0;
+
+  // Copies the image to the texture at the target position during the next
+  // ProcessUpdates calls. Replaces a queued update of the same area.
+  virtual void QueueUpdate(ImTextureID tex, cv::Mat image,
+                           utils::Point2i target) = 0;
+  [[nodiscard]] virtual bool IsUpdatePending(ImTextureID tex) const = 0;
+  [[nodiscard]] virtual bool HasPendingUpdates() const = 0;
+
+  // Called once per frame, runs the queued updates in order until the budget
+  // is used up
+  virtual void ProcessUpdates(std::size_t byte_budget) = 0;
+
   virtual void DestroyTexture(ImTextureID tex) = 0;
 };
 
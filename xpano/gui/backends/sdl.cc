@@ -3,17 +3,56 @@
 
 #include "xpano/gui/backends/sdl.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
 #include <imgui.h>
 #include <opencv2/core.hpp>
 #include <SDL.h>
 #include <spdlog/spdlog.h>
 
+#include "xpano/constants.h"
 #include "xpano/gui/backends/base.h"
 #include "xpano/utils/vec.h"
 #include "xpano/utils/vec_converters.h"
 
 namespace xpano::gui::backends {
 
+namespace {
+
+std::size_t RowBytes(const cv::Mat &image) {
+  return image.cols * image.elemSize();
+}
+
+std::size_t TextureBytes(utils::Vec2i size) {
+  // SDL_PIXELFORMAT_BGR24
+  return static_cast<std::size_t>(size[0]) * size[1] * 3;
+}
+
+// Copies the rows [first_row, first_row + num_rows) of the image
+void CopyRows(SDL_Texture *tex, const cv::Mat &image, utils::Point2i target,
+              int first_row, int num_rows) {
+  const auto rect = utils::SdlRect(target + utils::Vec2i{0, first_row},
+                                   utils::Vec2i{image.cols, num_rows});
+  void *pixels = nullptr;
+  int pitch = 0;
+  if (SDL_LockTexture(tex, &rect, &pixels, &pitch) != 0) {
+    spdlog::error("Failed to lock SDL_Texture: {}", SDL_GetError());
+    return;
+  }
+  const auto row_bytes = RowBytes(image);
+  for (int row = 0; row < num_rows; row++) {
+    std::memcpy(static_cast<std::uint8_t *>(pixels) +
+                    static_cast<std::ptrdiff_t>(row) * pitch,
+                image.ptr(first_row + row), row_bytes);
+  }
+  SDL_UnlockTexture(tex);
+}
+
+}  // namespace
+
 Sdl::Sdl(SDL_Renderer *renderer) : renderer_(renderer) {
   if (SDL_GetRendererInfo(renderer, &info_) == 0) {
     spdlog::info("Current SDL_Renderer: {}", info_.name);
@@ -29,10 +68,22 @@ Texture Sdl::CreateTexture(utils::Vec2i size) {
     spdlog::error("Texture size {} x {} is too big.", size[0], size[1]);
     return nullptr;
   }
+  if (auto pooled = std::find_if(pool_.begin(), pool_.end(),
+                                 [size](const PooledTexture &pooled) {
+                                   return pooled.size == size;
+                                 });
+      pooled != pool_.end()) {
+    auto *sdl_tex = pooled->tex;
+    pool_bytes_ -= TextureBytes(size);
+    pool_.erase(pooled);
+    return {static_cast<ImTextureID>(sdl_tex), TexDeleter{this}};
+  }
+
   const char *old_texture_sampling = SDL_GetHint(SDL_HINT_RENDER_SCALE_QUALITY);
   SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "best");
   auto *sdl_tex = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_BGR24,
-                                    SDL_TEXTUREACCESS_STATIC, size[0], size[1]);
+                                    SDL_TEXTUREACCESS_STREAMING, size[0],
+                                    size[1]);
   if (old_texture_sampling != nullptr) {
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, old_texture_sampling);
   }
@@ -44,16 +95,80 @@ Texture Sdl::CreateTexture(utils::Vec2i size) {
 }
 
 void Sdl::UpdateTexture(ImTextureID tex, cv::Mat image) {
-  auto target = utils::SdlRect(utils::Point2i{0}, utils::ToIntVec(image.size));
   auto *sdl_tex = static_cast<SDL_Texture *>(tex);
-  if (SDL_UpdateTexture(sdl_tex, &target, image.data,
-                        static_cast<int>(image.step1())) != 0) {
-    spdlog::error("Failed to update SDL_Texture: {}", SDL_GetError());
+  DropUpdates(sdl_tex);
+  CopyRows(sdl_tex, image, utils::Point2i{0}, 0, image.rows);
+}
+
+void Sdl::QueueUpdate(ImTextureID tex, cv::Mat image, utils::Point2i target) {
+  auto *sdl_tex = static_cast<SDL_Texture *>(tex);
+  auto same_area = [&](const Update &update) {
+    return update.tex == sdl_tex && update.target == target &&
+           update.image.size == image.size;
+  };
+  if (auto update = std::find_if(updates_.begin(), updates_.end(), same_area);
+      update != updates_.end()) {
+    *update = {.tex = sdl_tex, .image = std::move(image), .target = target};
+    return;
+  }
+  updates_.push_back(
+      {.tex = sdl_tex, .image = std::move(image), .target = target});
+}
+
+bool Sdl::IsUpdatePending(ImTextureID tex) const {
+  auto *sdl_tex = static_cast<SDL_Texture *>(tex);
+  return std::any_of(
+      updates_.begin(), updates_.end(),
+      [sdl_tex](const Update &update) { return update.tex == sdl_tex; });
+}
+
+bool Sdl::HasPendingUpdates() const { return !updates_.empty(); }
+
+void Sdl::ProcessUpdates(std::size_t byte_budget) {
+  while (!updates_.empty()) {
+    auto &update = updates_.front();
+    const auto row_bytes = RowBytes(update.image);
+    // At least one row to always make progress
+    const int num_rows =
+        std::clamp(static_cast<int>(byte_budget / std::max<std::size_t>(
+                                                      row_bytes, 1)),
+                   1, update.image.rows - update.next_row);
+    CopyRows(update.tex, update.image, update.target, update.next_row,
+             num_rows);
+    update.next_row += num_rows;
+    if (update.next_row == update.image.rows) {
+      updates_.pop_front();
+    }
+
+    const auto bytes = num_rows * row_bytes;
+    if (bytes >= byte_budget) {
+      return;
+    }
+    byte_budget -= bytes;
   }
 }
 
 void Sdl::DestroyTexture(ImTextureID tex) {
-  SDL_DestroyTexture(static_cast<SDL_Texture *>(tex));
+  auto *sdl_tex = static_cast<SDL_Texture *>(tex);
+  DropUpdates(sdl_tex);
+
+  utils::Vec2i size;
+  if (SDL_QueryTexture(sdl_tex, nullptr, nullptr, &size[0], &size[1]) != 0) {
+    SDL_DestroyTexture(sdl_tex);
+    return;
+  }
+  pool_.push_back({.tex = sdl_tex, .size = size});
+  pool_bytes_ += TextureBytes(size);
+  while (pool_bytes_ > kMaxPooledTextureBytes) {
+    pool_bytes_ -= TextureBytes(pool_.front().size);
+    SDL_DestroyTexture(pool_.front().tex);
+    pool_.pop_front();
+  }
+}
+
+void Sdl::DropUpdates(SDL_Texture *tex) {
+  std::erase_if(updates_,
+                [tex](const Update &update) { return update.tex == tex; });
 }
 
 }  // namespace xpano::gui::backends
@@ -3,6 +3,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <deque>
+
 #include <imgui.h>
 #include <opencv2/core.hpp>
 #include <SDL.h>
@@ -16,13 +19,39 @@ class Sdl final : public Base {
  public:
   explicit Sdl(SDL_Renderer* renderer);
 
+  // Reuses a released texture of the same size if possible
   Texture CreateTexture(utils::Vec2i size) override;
   void UpdateTexture(ImTextureID tex, cv::Mat image) override;
+  void QueueUpdate(ImTextureID tex, cv::Mat image,
+                   utils::Point2i target) override;
+  [[nodiscard]] bool IsUpdatePending(ImTextureID tex) const override;
+  [[nodiscard]] bool HasPendingUpdates() const override;
+  void ProcessUpdates(std::size_t byte_budget) override;
+  // Keeps the texture for reuse, up to kMaxPooledTextureBytes
   void DestroyTexture(ImTextureID tex) override;
 
  private:
+  struct Update {
+    SDL_Texture* tex;
+    cv::Mat image;
+    utils::Point2i target;
+    int next_row = 0;
+  };
+
+  struct PooledTexture {
+    SDL_Texture* tex;
+    utils::Vec2i size;
+  };
+
+  void DropUpdates(SDL_Texture* tex);
+
   SDL_Renderer* renderer_;
   SDL_RendererInfo info_;
+
+  std::deque<Update> updates_;
+  // The textures are destroyed together with the renderer
+  std::deque<PooledTexture> pool_;
+  std::size_t pool_bytes_ = 0;
 };
 
 }  // namespace xpano::gui::backends
@@ -102,6 +102,29 @@ utils::Expected<std::vector<std::filesystem::path>, Error> DirectoryOpen() {
   return results;
 }
 
+utils::Expected<std::vector<std::filesystem::path>, Error> SessionOpen() {
+  NFD::UniquePath out_path;
+  auto extensions = fmt::format("{}", fmt::join(kSessionExtensions, ","));
+  auto filter_item =
+      std::array{nfdfilteritem_t{"Xpano sessions", extensions.c_str()}};
+  auto nfd_result = NFD::OpenDialog(out_path, filter_item.data(), 1);
+
+  if (nfd_result == NFD_CANCEL) {
+    return MakeUnexpected(ErrorType::kUserCancelled);
+  }
+  if (nfd_result == NFD_ERROR) {
+    return MakeUnexpected(ErrorType::kUnknownError, NFD::GetError());
+  }
+
+  auto result_path = std::filesystem::path(out_path.get());
+  spdlog::info("Selected session {}", result_path.string());
+  if (!utils::path::IsSessionExtension(result_path)) {
+    return MakeUnexpected(ErrorType::kUnsupportedExtension,
+                          result_path.filename().string());
+  }
+  return std::vector{result_path};
+}
+
 }  // namespace
 
 utils::Expected<std::vector<std::filesystem::path>, Error> Open(
@@ -114,13 +137,19 @@ utils::Expected<std::vector<std::filesystem::path>, Error> Open(
     return DirectoryOpen().map(utils::path::KeepSupported);
   }
 
+  if (action.type == ActionType::kOpenSession) {
+    return SessionOpen();
+  }
+
   return MakeUnexpected(ErrorType::kUnknownAction);
 }
 
 utils::Expected<std::filesystem::path, Error> Save(
     const std::string& default_name) {
   NFD::UniquePath out_path;
-  auto extensions = fmt::format("{}", fmt::join(kSupportedExtensions, ","));
+  auto extensions =
+      fmt::format("{},{}", fmt::join(kSupportedExtensions, ","),
+                  fmt::join(kExportOnlyExtensions, ","));
   auto filter_item = std::array{nfdfilteritem_t{"Images", extensions.c_str()}};
   auto nfd_result = NFD::SaveDialog(out_path, filter_item.data(), 1, nullptr,
                                     default_name.c_str());
@@ -134,7 +163,7 @@ utils::Expected<std::filesystem::path, Error> Save(
 
   auto result_path = std::filesystem::path(out_path.get());
   spdlog::info("Picked save file {}", result_path.string());
-  if (!utils::path::IsExtensionSupported(result_path)) {
+  if (!utils::path::IsExportExtensionSupported(result_path)) {
     return MakeUnexpected(ErrorType::kUnsupportedExtension,
                           result_path.filename().string());
   }
@@ -142,4 +171,29 @@ utils::Expected<std::filesystem::path, Error> Save(
   return result_path;
 }
 
+utils::Expected<std::filesystem::path, Error> SaveSession(
+    const std::string& default_name) {
+  NFD::UniquePath out_path;
+  auto extensions = fmt::format("{}", fmt::join(kSessionExtensions, ","));
+  auto filter_item =
+      std::array{nfdfilteritem_t{"Xpano sessions", extensions.c_str()}};
+  auto nfd_result = NFD::SaveDialog(out_path, filter_item.data(), 1, nullptr,
+                                    default_name.c_str());
+
+  if (nfd_result == NFD_CANCEL) {
+    return MakeUnexpected(ErrorType::kUserCancelled);
+  }
+  if (nfd_result == NFD_ERROR) {
+    return MakeUnexpected(ErrorType::kUnknownError, NFD::GetError());
+  }
+
+  auto result_path = std::filesystem::path(out_path.get());
+  spdlog::info("Picked session file {}", result_path.string());
+  if (!utils::path::IsSessionExtension(result_path)) {
+    return MakeUnexpected(ErrorType::kUnsupportedExtension,
+                          result_path.filename().string());
+  }
+  return result_path;
+}
+
 }  // namespace xpano::gui::file_dialog
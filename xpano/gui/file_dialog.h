@@ -33,6 +33,9 @@ utils::Expected<std::vector<std::filesystem::path>, Error> Open(
 utils::Expected<std::filesystem::path, Error> Save(
     const std::string& default_name);
 
+utils::Expected<std::filesystem::path, Error> SaveSession(
+    const std::string& default_name);
+
 }  // namespace xpano::gui::file_dialog
 
 template <>
@@ -4,10 +4,14 @@
 #include "xpano/gui/panels/preview_pane.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <exception>
+#include <future>
 #include <numeric>
 #include <optional>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -128,9 +132,106 @@ void Overlay(const widgets::RotationWidget& widget, const utils::RectPVf& image,
        window, axis_color);
 }
 
+int LongerSide(const cv::Mat& image) {
+  return std::max(image.rows, image.cols);
+}
+
+// Halves the image while it's larger than twice kLoupeSize, the last level is
+// resized to fit kLoupeSize exactly
+std::vector<cv::Mat> BuildPyramid(const cv::Mat& image) {
+  std::vector<cv::Mat> levels = {image};
+  while (LongerSide(levels.back()) / 2 > kLoupeSize) {
+    const auto& level = levels.back();
+    cv::Mat half;
+    const cv::Size half_size((level.cols + 1) / 2, (level.rows + 1) / 2);
+    cv::resize(level, half, half_size, 0, 0, cv::INTER_AREA);
+    levels.push_back(std::move(half));
+  }
+
+  const auto& last = levels.back();
+  const float scale =
+      static_cast<float>(kLoupeSize) / static_cast<float>(LongerSide(last));
+  const auto overview_size = cv::Size(
+      std::min(kLoupeSize, static_cast<int>(std::round(last.cols * scale))),
+      std::min(kLoupeSize, static_cast<int>(std::round(last.rows * scale))));
+  cv::Mat overview;
+  cv::resize(last, overview, overview_size, 0, 0, cv::INTER_AREA);
+  levels.push_back(std::move(overview));
+  return levels;
+}
+
+cv::Mat FitLongerSide(const cv::Mat& image, int longer_side) {
+  if (LongerSide(image) <= longer_side) {
+    return image;
+  }
+  const float scale =
+      static_cast<float>(longer_side) / static_cast<float>(LongerSide(image));
+  const auto size = cv::Size(
+      std::min(longer_side, static_cast<int>(std::round(image.cols * scale))),
+      std::min(longer_side, static_cast<int>(std::round(image.rows * scale))));
+  cv::Mat result;
+  cv::resize(image, result, size, 0, 0, cv::INTER_AREA);
+  return result;
+}
+
+bool IsIdentity(const widgets::RotationState& state) {
+  return state.yaw == 0.0f && state.pitch == 0.0f && state.roll == 0.0f;
+}
+
+bool IsSameRotation(const widgets::RotationState& lhs,
+                    const widgets::RotationState& rhs) {
+  return lhs.yaw == rhs.yaw && lhs.pitch == rhs.pitch && lhs.roll == rhs.roll;
+}
+
 }  // namespace
 
-PreviewPane::PreviewPane(backends::Base* backend) : backend_(backend) {
+TileCache::TileCache(backends::Base* backend) : backend_(backend) {}
+
+ImTextureID TileCache::Get(const cv::Mat& level, int level_id, int tile_x,
+                           int tile_y) {
+  const auto key = std::make_tuple(level_id, tile_x, tile_y);
+  if (auto tile = tiles_.find(key); tile != tiles_.end()) {
+    tile->second.last_used = frame_;
+    auto* tex = tile->second.tex.get();
+    return backend_->IsUpdatePending(tex) ? nullptr : tex;
+  }
+
+  auto tex = backend_->CreateTexture(utils::Vec2i{kPreviewTileSize});
+  if (!tex) {
+    return nullptr;
+  }
+  const int x = tile_x * kPreviewTileSize;
+  const int y = tile_y * kPreviewTileSize;
+  const cv::Rect rect(x, y, std::min(kPreviewTileSize, level.cols - x),
+                      std::min(kPreviewTileSize, level.rows - y));
+  backend_->QueueUpdate(tex.get(), level(rect), utils::Point2i{0});
+  tiles_[key] = {.tex = std::move(tex), .last_used = frame_};
+  return nullptr;
+}
+
+void TileCache::NextFrame() {
+  Evict();
+  frame_++;
+}
+
+void TileCache::Reset() { tiles_.clear(); }
+
+// Tiles drawn in the current frame are kept even above the limit
+void TileCache::Evict() {
+  while (tiles_.size() > kMaxPreviewTiles) {
+    auto oldest = std::min_element(
+        tiles_.begin(), tiles_.end(), [](const auto& lhs, const auto& rhs) {
+          return lhs.second.last_used < rhs.second.last_used;
+        });
+    if (oldest->second.last_used >= frame_) {
+      return;
+    }
+    tiles_.erase(oldest);
+  }
+}
+
+PreviewPane::PreviewPane(backends::Base* backend)
+    : backend_(backend), tile_cache_(backend) {
   std::iota(zoom_levels_.begin(), zoom_levels_.end(), -1.0f);
   std::transform(zoom_levels_.begin(), zoom_levels_.end(), zoom_levels_.begin(),
                  [](float exp) { return std::pow(kZoomFactor, exp); });
@@ -140,6 +241,12 @@ float PreviewPane::Zoom() const { return zoom_; }
 
 bool PreviewPane::IsZoomed() const { return zoom_id_ != 1; }
 
+bool PreviewPane::IsAnimating() const {
+  return tex_ && zoom_ != zoom_levels_[zoom_id_];
+}
+
+bool PreviewPane::IsLoading() const { return pyramid_future_.valid(); }
+
 void PreviewPane::ZoomIn() {
   if (crop_mode_ != CropMode::kEnabled && zoom_id_ < kZoomLevels - 1) {
     zoom_id_++;
@@ -175,37 +282,66 @@ void PreviewPane::Load(cv::Mat image, ImageType image_type) {
 }
 
 void PreviewPane::Reload(cv::Mat image, ImageType image_type) {
-  auto texture_size = utils::Vec2i{kLoupeSize};
-  if (!tex_) {
-    tex_ = backend_->CreateTexture(texture_size);
-  }
-
-  const int larger_dim = image.size[0] > image.size[1] ? 0 : 1;
-
-  cv::Mat resized;
-  utils::Ratio2f coord_uv;
-  if (image.size[larger_dim] > kLoupeSize) {
-    if (const float aspect = utils::ToIntVec(image.size).Aspect();
-        aspect >= 1.0f) {
-      coord_uv = {1.0f, 1.0f / aspect};
-    } else {
-      coord_uv = {1.0f * aspect, 1.0f};
-    }
-    auto size = utils::ToIntVec(texture_size * coord_uv);
-    cv::resize(image, resized, utils::CvSize(size), 0, 0, cv::INTER_AREA);
+  pyramid_.clear();
+  tile_cache_.Reset();
+  pyramid_future_ = {};
+
+  if (LongerSide(image) > kLoupeSize) {
+    // The previous texture stays visible until the pyramid is built
+    pyramid_pool_.purge();
+    pyramid_future_ =
+        pyramid_pool_.submit([image]() { return BuildPyramid(image); });
   } else {
-    resized = image;
-    coord_uv = utils::ToIntVec(image.size) / texture_size;
+    UploadOverview(image);
   }
-  backend_->UpdateTexture(tex_.get(), resized);
-  tex_coord_ = coord_uv;
 
   image_type_ = image_type;
+  image_ = image;
+  rotate_source_ = cv::Mat{};
+  rotate_preview_state_.reset();
   if (image_type == ImageType::kPanoFullRes) {
     full_resolution_pano_ = image;
   }
 }
 
+void PreviewPane::UploadOverview(const cv::Mat& overview) {
+  auto texture_size = utils::Vec2i{kLoupeSize};
+  if (!next_tex_) {
+    next_tex_ = backend_->CreateTexture(texture_size);
+    if (!next_tex_) {
+      return;
+    }
+  }
+  backend_->QueueUpdate(next_tex_.get(), overview, utils::Point2i{0});
+  next_tex_coord_ = utils::ToIntVec(overview.size) / texture_size;
+}
+
+// The previous overview stays visible until the new one is uploaded, its
+// texture is then reused for the next upload
+void PreviewPane::SwapUploadedOverview() {
+  if (!next_tex_coord_ || backend_->IsUpdatePending(next_tex_.get())) {
+    return;
+  }
+  std::swap(tex_, next_tex_);
+  tex_coord_ = *next_tex_coord_;
+  next_tex_coord_.reset();
+}
+
+void PreviewPane::ResolvePyramid() {
+  if (!pyramid_future_.valid() ||
+      pyramid_future_.wait_for(std::chrono::seconds(0)) !=
+          std::future_status::ready) {
+    return;
+  }
+  try {
+    pyramid_ = pyramid_future_.get();
+  } catch (const std::exception& e) {
+    spdlog::error("Failed to build the preview pyramid: {}", e.what());
+    return;
+  }
+  UploadOverview(pyramid_.back());
+}
+
 void PreviewPane::Reset() {
   ResetZoom();
   image_type_ = ImageType::kNone;
@@ -214,11 +350,20 @@ void PreviewPane::Reset() {
   rotate_mode_ = RotateMode::kDisabled;
   rotate_widget_ = {};
   suggested_crop_ = utils::DefaultCropRect();
+  image_ = cv::Mat{};
   full_resolution_pano_ = cv::Mat{};
+  rotate_source_ = cv::Mat{};
+  rotate_preview_state_.reset();
+  pyramid_.clear();
+  tile_cache_.Reset();
+  pyramid_future_ = {};
 }
 
 Action PreviewPane::Draw(const std::string& message) {
   Action action{};
+  ResolvePyramid();
+  SwapUploadedOverview();
+  tile_cache_.NextFrame();
   ImGui::Begin("Preview");
   auto window = utils::Rect(utils::ToPoint(ImGui::GetCursorScreenPos()),
                             utils::ToVec(ImGui::GetContentRegionAvail()));
@@ -254,16 +399,23 @@ Action PreviewPane::Draw(const std::string& message) {
 
     action |= HandleInputs(window, image);
 
-    auto tex_coords =
+    auto region =
         (crop_mode_ == CropMode::kEnabled || crop_mode_ == CropMode::kInitial)
-            ? utils::Rect(utils::Ratio2f{0.0f}, tex_coord_)
-            : utils::Rect(tex_coord_ * crop_widget_.rect.start,
-                          tex_coord_ * crop_widget_.rect.end);
+            ? utils::DefaultCropRect()
+            : crop_widget_.rect;
+    const bool rotate_preview = UpdateRotatePreview();
+    const auto& tex = rotate_preview ? rotate_tex_ : tex_;
+    const auto tex_coord = rotate_preview ? rotate_tex_coord_ : tex_coord_;
+    auto tex_coords =
+        utils::Rect(tex_coord * region.start, tex_coord * region.end);
 
-    ImGui::GetWindowDrawList()->AddImage(tex_.get(), utils::ImVec(image.start),
+    ImGui::GetWindowDrawList()->AddImage(tex.get(), utils::ImVec(image.start),
                                          utils::ImVec(image.start + image.size),
                                          utils::ImVec(tex_coords.start),
                                          utils::ImVec(tex_coords.end));
+    if (!pyramid_.empty() && !rotate_preview) {
+      DrawTiles(window, image, region);
+    }
 
     if (crop_mode_ == CropMode::kEnabled) {
       Overlay(crop_widget_.rect, image);
@@ -277,6 +429,123 @@ Action PreviewPane::Draw(const std::string& message) {
   return action;
 }
 
+// Remaps the shown pano to the rotation being dragged, the pano is stitched
+// again only after the mouse is released. Returns false when the pano should
+// be drawn as it is.
+bool PreviewPane::UpdateRotatePreview() {
+  const auto& rotation = rotate_widget_.rotation;
+  if (rotate_mode_ != RotateMode::kEnabled || image_.empty() ||
+      IsIdentity(rotation)) {
+    return false;
+  }
+  if (rotate_preview_state_ &&
+      IsSameRotation(*rotate_preview_state_, rotation)) {
+    return true;
+  }
+
+  if (!rotate_tex_) {
+    rotate_tex_ = backend_->CreateTexture(utils::Vec2i{kRotatePreviewSize});
+    if (!rotate_tex_) {
+      return false;
+    }
+  }
+  if (rotate_source_.empty()) {
+    rotate_source_ = FitLongerSide(image_, kRotatePreviewSize);
+  }
+  auto rotated =
+      widgets::RotatePano(rotate_source_, rotate_widget_.warp, rotation);
+  backend_->UpdateTexture(rotate_tex_.get(), rotated);
+  rotate_tex_coord_ =
+      utils::ToIntVec(rotated.size) / utils::Vec2i{kRotatePreviewSize};
+  rotate_preview_state_ = rotation;
+  return true;
+}
+
+// Draws the tiles of the smallest pyramid level with at least one pixel per
+// screen pixel over the overview
+void PreviewPane::DrawTiles(const utils::RectPVf& window,
+                            const utils::RectPVf& image,
+                            const utils::RectRRf& region) {
+  const float region_width = region.end[0] - region.start[0];
+  const float region_height = region.end[1] - region.start[1];
+  const float needed_cols = image.size[0] / region_width;
+  const int overview_id = static_cast<int>(pyramid_.size()) - 1;
+  int level_id = overview_id;
+  while (level_id > 0 &&
+         static_cast<float>(pyramid_[level_id].cols) < needed_cols) {
+    level_id--;
+  }
+  if (level_id == overview_id) {
+    return;
+  }
+  const cv::Mat& level = pyramid_[level_id];
+
+  const float visible_x0 = std::max(window.start[0], image.start[0]);
+  const float visible_y0 = std::max(window.start[1], image.start[1]);
+  const float visible_x1 = std::min(window.start[0] + window.size[0],
+                                    image.start[0] + image.size[0]);
+  const float visible_y1 = std::min(window.start[1] + window.size[1],
+                                    image.start[1] + image.size[1]);
+  if (visible_x0 >= visible_x1 || visible_y0 >= visible_y1) {
+    return;
+  }
+
+  // Screen position <-> level pixels
+  auto level_x = [&](float screen_x) {
+    return (region.start[0] +
+            (screen_x - image.start[0]) / image.size[0] * region_width) *
+           static_cast<float>(level.cols);
+  };
+  auto level_y = [&](float screen_y) {
+    return (region.start[1] +
+            (screen_y - image.start[1]) / image.size[1] * region_height) *
+           static_cast<float>(level.rows);
+  };
+  auto screen_x = [&](int level_x) {
+    return image.start[0] + (static_cast<float>(level_x) /
+                                 static_cast<float>(level.cols) -
+                             region.start[0]) /
+                                region_width * image.size[0];
+  };
+  auto screen_y = [&](int level_y) {
+    return image.start[1] + (static_cast<float>(level_y) /
+                                 static_cast<float>(level.rows) -
+                             region.start[1]) /
+                                region_height * image.size[1];
+  };
+
+  auto to_tile = [](float level_pixel, int level_size) {
+    return std::clamp(static_cast<int>(level_pixel) / kPreviewTileSize, 0,
+                      (level_size - 1) / kPreviewTileSize);
+  };
+  const int first_x = to_tile(level_x(visible_x0), level.cols);
+  const int last_x = to_tile(level_x(visible_x1), level.cols);
+  const int first_y = to_tile(level_y(visible_y0), level.rows);
+  const int last_y = to_tile(level_y(visible_y1), level.rows);
+
+  auto* draw_list = ImGui::GetWindowDrawList();
+  draw_list->PushClipRect(ImVec2(visible_x0, visible_y0),
+                          ImVec2(visible_x1, visible_y1), true);
+  for (int tile_y = first_y; tile_y <= last_y; tile_y++) {
+    for (int tile_x = first_x; tile_x <= last_x; tile_x++) {
+      auto* tex = tile_cache_.Get(level, level_id, tile_x, tile_y);
+      if (tex == nullptr) {
+        continue;
+      }
+      const int x0 = tile_x * kPreviewTileSize;
+      const int y0 = tile_y * kPreviewTileSize;
+      const int x1 = std::min(x0 + kPreviewTileSize, level.cols);
+      const int y1 = std::min(y0 + kPreviewTileSize, level.rows);
+      draw_list->AddImage(
+          tex, ImVec2(screen_x(x0), screen_y(y0)),
+          ImVec2(screen_x(x1), screen_y(y1)), ImVec2(0.0f, 0.0f),
+          ImVec2(static_cast<float>(x1 - x0) / kPreviewTileSize,
+                 static_cast<float>(y1 - y0) / kPreviewTileSize));
+    }
+  }
+  draw_list->PopClipRect();
+}
+
 Action PreviewPane::HandleInputs(const utils::RectPVf& window,
                                  const utils::RectPVf& image) {
   // Let the crop widget take events from the whole window
@@ -5,8 +5,12 @@
 
 #include <array>
 #include <cstdint>
+#include <future>
+#include <map>
 #include <optional>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include <opencv2/core.hpp>
 
@@ -17,6 +21,7 @@
 #include "xpano/gui/widgets/drag.h"
 #include "xpano/gui/widgets/rotate.h"
 #include "xpano/utils/rect.h"
+#include "xpano/utils/threadpool.h"
 #include "xpano/utils/vec.h"
 
 namespace xpano::gui {
@@ -26,13 +31,40 @@ enum class ImageType : std::uint8_t {
   kSingleImage,
   kMatch,
   kPanoPreview,
-  kPanoFullRes
+  kPanoFullRes,
+  // Low resolution pano filling in while it's being composed
+  kLiveCanvas
 };
 
 enum class CropMode : std::uint8_t { kInitial, kEnabled, kDisabled };
 
 enum class RotateMode : std::uint8_t { kEnabled, kDisabled };
 
+// Textures of kPreviewTileSize tiles cut from the levels of an image pyramid.
+// The least recently drawn tiles are released above kMaxPreviewTiles.
+class TileCache {
+ public:
+  explicit TileCache(backends::Base* backend);
+
+  // Queues the upload on the first call, nullptr until it's finished
+  ImTextureID Get(const cv::Mat& level, int level_id, int tile_x, int tile_y);
+  void NextFrame();
+  void Reset();
+
+ private:
+  struct Tile {
+    backends::Texture tex;
+    std::int64_t last_used = 0;
+  };
+
+  void Evict();
+
+  std::map<std::tuple<int, int, int>, Tile> tiles_;
+  std::int64_t frame_ = 0;
+
+  backends::Base* backend_;
+};
+
 class PreviewPane {
  public:
   explicit PreviewPane(backends::Base* backend);
@@ -53,6 +85,11 @@ class PreviewPane {
   [[nodiscard]] ImageType Type() const;
   [[nodiscard]] cv::Mat Image() const;
 
+  // Zooming is animated over several frames
+  [[nodiscard]] bool IsAnimating() const;
+  // The pyramid of a large image is being built
+  [[nodiscard]] bool IsLoading() const;
+
  private:
   [[nodiscard]] float Zoom() const;
   [[nodiscard]] bool IsZoomed() const;
@@ -62,6 +99,12 @@ class PreviewPane {
   void ResetZoom(int target_level = 1);
   Action HandleInputs(const utils::RectPVf& window,
                       const utils::RectPVf& image);
+  void UploadOverview(const cv::Mat& overview);
+  void SwapUploadedOverview();
+  void ResolvePyramid();
+  void DrawTiles(const utils::RectPVf& window, const utils::RectPVf& image,
+                 const utils::RectRRf& region);
+  bool UpdateRotatePreview();
 
   utils::Ratio2f tex_coord_;
 
@@ -80,10 +123,27 @@ class PreviewPane {
   utils::Ratio2f screen_offset_;
 
   backends::Texture tex_;
+  // Uploaded over several frames, then swapped with tex_
+  backends::Texture next_tex_;
+  std::optional<utils::Ratio2f> next_tex_coord_;
   backends::Base* backend_;
 
   ImageType image_type_ = ImageType::kNone;
+  cv::Mat image_;
   cv::Mat full_resolution_pano_;
+
+  // The pano remapped to the rotation being dragged, drawn instead of tex_
+  cv::Mat rotate_source_;
+  backends::Texture rotate_tex_;
+  utils::Ratio2f rotate_tex_coord_;
+  std::optional<widgets::RotationState> rotate_preview_state_;
+
+  // Set for images larger than kLoupeSize, the first level is the image
+  // itself, the last one is the overview texture
+  std::vector<cv::Mat> pyramid_;
+  std::future<std::vector<cv::Mat>> pyramid_future_;
+  TileCache tile_cache_;
+  utils::mt::Threadpool pyramid_pool_ = {1};
 };
 
 }  // namespace xpano::gui
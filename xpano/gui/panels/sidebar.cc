@@ -27,6 +27,7 @@
 #include "xpano/utils/fmt.h"
 #include "xpano/utils/imgui_.h"
 #include "xpano/utils/opencv.h"
+#include "xpano/utils/trace.h"
 
 namespace xpano::gui {
 
@@ -47,6 +48,8 @@ std::string ProgressLabel(pipeline::ProgressType type) {
       return "Matching images";
     case pipeline::ProgressType::kExport:
       return "Exporting pano";
+    case pipeline::ProgressType::kSavingSession:
+      return "Saving session";
     case pipeline::ProgressType::kInpainting:
       return "Auto fill";
     case pipeline::ProgressType::kStitchFindFeatures:
@@ -81,9 +84,15 @@ Action DrawFileMenu() {
     if (ImGui::MenuItem("Open directory")) {
       action |= {ActionType::kOpenDirectory};
     }
+    if (ImGui::MenuItem("Open session")) {
+      action |= {ActionType::kOpenSession};
+    }
     if (ImGui::MenuItem("Export", Label(ShortcutType::kExport))) {
       action |= {ActionType::kExport};
     }
+    if (ImGui::MenuItem("Save session")) {
+      action |= {ActionType::kSaveSession};
+    }
     ImGui::Separator();
     if (ImGui::MenuItem("Quit")) {
       action |= {ActionType::kQuit};
@@ -393,6 +402,22 @@ void DrawAutofillOptionsMenu(pipeline::InpaintingOptions* inpaint_options) {
           std::clamp(inpaint_options->radius, kDefaultInpaintingRadius,
                      kMaxInpaintingRadius);
     }
+    if (inpaint_options->method == algorithm::InpaintingMethod::kPyramid) {
+      ImGui::SliderInt("Pyramid levels", &inpaint_options->pyramid.levels, 1,
+                       kMaxInpaintingPyramidLevels);
+      ImGui::SameLine();
+      utils::imgui::InfoMarker(
+          "(?)",
+          "Only the coarsest level is fully inpainted, more levels are "
+          "faster\nbut produce blurrier fills in large holes.");
+      ImGui::SliderInt("Band width", &inpaint_options->pyramid.band_width, 1,
+                       kMaxInpaintingBandWidth);
+      ImGui::SameLine();
+      utils::imgui::InfoMarker(
+          "(?)",
+          "Width of the region along the hole boundary that is refined\nat "
+          "each finer level, wider bands give smoother transitions.");
+    }
     ImGui::EndMenu();
   }
 }
@@ -426,6 +451,9 @@ Action DrawHelpMenu() {
     if (ImGui::MenuItem("Show debug info", Label(ShortcutType::kDebug))) {
       action |= {ActionType::kToggleDebugLog};
     }
+    if (ImGui::MenuItem("Record trace", nullptr, utils::trace::IsEnabled())) {
+      action |= {ActionType::kToggleTrace};
+    }
     if (ImGui::MenuItem("Support")) {
       action |= {ActionType::kShowBugReport};
     }
@@ -480,7 +508,7 @@ cv::Mat DrawMatches(const algorithm::Match& match,
 }
 
 Action DrawMatchesMenu(const std::vector<algorithm::Match>& matches,
-                       const ThumbnailPane& thumbnail_pane, int highlight_id) {
+                       ThumbnailPane* thumbnail_pane, int highlight_id) {
   Action action{};
   ImGui::TextUnformatted("List of matches:");
   if (ImGui::BeginTable("table1", 3)) {
@@ -507,7 +535,7 @@ Action DrawMatchesMenu(const std::vector<algorithm::Match>& matches,
       }
 
       if (ImGui::IsItemHovered()) {
-        thumbnail_pane.ThumbnailTooltip({matches[i].id1, matches[i].id2});
+        thumbnail_pane->ThumbnailTooltip({matches[i].id1, matches[i].id2});
       }
     }
     ImGui::EndTable();
@@ -516,7 +544,7 @@ Action DrawMatchesMenu(const std::vector<algorithm::Match>& matches,
 }
 
 Action DrawPanosMenu(const std::vector<algorithm::Pano>& panos,
-                     const ThumbnailPane& thumbnail_pane, int highlight_id) {
+                     ThumbnailPane* thumbnail_pane, int highlight_id) {
   Action action{};
   ImGui::TextUnformatted("List of panoramas:");
   ImGui::SameLine();
@@ -555,7 +583,7 @@ Action DrawPanosMenu(const std::vector<algorithm::Pano>& panos,
       }
 
       if (ImGui::IsItemHovered()) {
-        thumbnail_pane.ThumbnailTooltip(panos[i].ids);
+        thumbnail_pane->ThumbnailTooltip(panos[i].ids);
       }
     }
     ImGui::EndTable();
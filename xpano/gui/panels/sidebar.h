@@ -24,10 +24,10 @@ cv::Mat DrawMatches(const algorithm::Match& match,
                     const std::vector<algorithm::Image>& images);
 
 Action DrawMatchesMenu(const std::vector<algorithm::Match>& matches,
-                       const ThumbnailPane& thumbnail_pane, int highlight_id);
+                       ThumbnailPane* thumbnail_pane, int highlight_id);
 
 Action DrawPanosMenu(const std::vector<algorithm::Pano>& panos,
-                     const ThumbnailPane& thumbnail_pane, int highlight_id);
+                     ThumbnailPane* thumbnail_pane, int highlight_id);
 
 Action DrawMenu(pipeline::Options* options, bool debug_enabled);
 
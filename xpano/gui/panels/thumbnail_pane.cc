@@ -121,41 +121,160 @@ ResizeChecker::Status ResizeChecker::Check(ImVec2 window_size) {
   return Status::kIdle;
 }
 
-ThumbnailPane::ThumbnailPane(backends::Base *backend) : backend_(backend) {}
+bool ResizeChecker::IsResizing() const { return resizing_streak_ > 0; }
 
-void ThumbnailPane::Load(const std::vector<algorithm::Image> &images) {
-  spdlog::info("Loading {} thumbnails", images.size());
-  const int num_images = static_cast<int>(images.size());
-  auto thumbnail_size = utils::Vec2i{kThumbnailSize};
-  int side = 0;
-  while (side * side < num_images) {
-    side++;
+ThumbnailAtlas::ThumbnailAtlas(backends::Base *backend) : backend_(backend) {}
+
+bool ThumbnailAtlas::IsPrefixOf(
+    const std::vector<algorithm::Image> &images) const {
+  if (thumbnails_.size() > images.size()) {
+    return false;
+  }
+  for (int i = 0; i < thumbnails_.size(); i++) {
+    if (thumbnails_[i].data != images[i].GetThumbnail().data) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ThumbnailAtlas::Add(const std::vector<algorithm::Image> &images) {
+  const int first_new = static_cast<int>(thumbnails_.size());
+  for (int i = first_new; i < images.size(); i++) {
+    thumbnails_.push_back(images[i].GetThumbnail());
+  }
+
+  const int num_pages =
+      (static_cast<int>(thumbnails_.size()) + kThumbnailsPerPage - 1) /
+      kThumbnailsPerPage;
+  pages_.resize(num_pages);
+  for (int img_id = first_new; img_id < thumbnails_.size(); img_id++) {
+    if (pages_[img_id / kThumbnailsPerPage].tex) {
+      UploadThumbnail(img_id);
+    }
+  }
+}
+
+ThumbnailAtlas::Coord ThumbnailAtlas::Get(int img_id) {
+  const int page_id = img_id / kThumbnailsPerPage;
+  auto &page = pages_[page_id];
+  if (!page.tex) {
+    Evict(kMaxThumbnailPages - 1);
+    page.tex = backend_->CreateTexture(utils::Vec2i{kThumbnailPageSize});
+    if (!page.tex) {
+      return {};
+    }
+    Upload(page_id);
+  }
+  page.last_used = frame_;
+  if (!page.uploaded) {
+    if (backend_->IsUpdatePending(page.tex.get())) {
+      return {};
+    }
+    page.uploaded = true;
+  }
+
+  const int slot = img_id % kThumbnailsPerPage;
+  const auto tex_coord =
+      utils::Ratio2i{slot % kThumbnailPageSide, slot / kThumbnailPageSide};
+  const auto side = static_cast<float>(kThumbnailPageSide);
+  return {.tex = page.tex.get(),
+          .uv0 = utils::Ratio2f{static_cast<float>(tex_coord[0]) / side,
+                                static_cast<float>(tex_coord[1]) / side},
+          .uv1 = utils::Ratio2f{static_cast<float>(tex_coord[0] + 1) / side,
+                                static_cast<float>(tex_coord[1] + 1) / side}};
+}
+
+void ThumbnailAtlas::NextFrame() {
+  Evict(kMaxThumbnailPages);
+  frame_++;
+}
+
+int ThumbnailAtlas::NumResidentPages() const {
+  return static_cast<int>(std::count_if(
+      pages_.begin(), pages_.end(),
+      [](const Page &page) { return static_cast<bool>(page.tex); }));
+}
+
+void ThumbnailAtlas::Reset() {
+  thumbnails_.clear();
+  pages_.clear();
+  frame_ = 0;
+}
+
+void ThumbnailAtlas::Upload(int page_id) {
+  const int first = page_id * kThumbnailsPerPage;
+  const int last = std::min(first + kThumbnailsPerPage,
+                            static_cast<int>(thumbnails_.size()));
+  const cv::Mat page{utils::CvSize(utils::Vec2i{kThumbnailPageSize}),
+                     thumbnails_[first].type(), cv::Scalar::all(0)};
+  const auto thumbnail_size = utils::Vec2i{kThumbnailSize};
+  for (int i = first; i < last; i++) {
+    const int slot = i - first;
+    const auto tex_coord =
+        thumbnail_size * utils::Ratio2i{slot % kThumbnailPageSide,
+                                        slot / kThumbnailPageSide};
+    thumbnails_[i].copyTo(
+        page(utils::CvRect(utils::Point2i{0} + tex_coord, thumbnail_size)));
   }
-  auto size = thumbnail_size * side;
-  spdlog::info("Thumbnail texture size: {} x {}", size[0], size[1]);
-  auto type = images[0].GetThumbnail().type();
-  const cv::Mat atlas{utils::CvSize(size), type};
-  for (int i = 0; i < images.size(); i++) {
-    auto tex_coord = thumbnail_size * utils::Ratio2i{i % side, i / side};
-    const auto preview = images[i].GetThumbnail();
-    preview.copyTo(
-        atlas(utils::CvRect(utils::Point2i{0} + tex_coord, thumbnail_size)));
-    const Coord coord{tex_coord / size, (tex_coord + thumbnail_size) / size,
-                      images[i].GetAspect()};
-    coords_.emplace_back(coord);
+  pages_[page_id].uploaded = false;
+  backend_->QueueUpdate(pages_[page_id].tex.get(), page, utils::Point2i{0});
+}
+
+void ThumbnailAtlas::UploadThumbnail(int img_id) {
+  const int slot = img_id % kThumbnailsPerPage;
+  const auto tex_coord =
+      utils::Vec2i{kThumbnailSize} *
+      utils::Ratio2i{slot % kThumbnailPageSide, slot / kThumbnailPageSide};
+  backend_->QueueUpdate(pages_[img_id / kThumbnailsPerPage].tex.get(),
+                        thumbnails_[img_id], utils::Point2i{0} + tex_coord);
+}
+
+// Pages used in the current frame are kept even above the limit
+void ThumbnailAtlas::Evict(int max_pages) {
+  int num_resident = NumResidentPages();
+  while (num_resident > max_pages) {
+    auto oldest = pages_.end();
+    for (auto page = pages_.begin(); page != pages_.end(); ++page) {
+      if (page->tex && page->last_used < frame_ &&
+          (oldest == pages_.end() || page->last_used < oldest->last_used)) {
+        oldest = page;
+      }
+    }
+    if (oldest == pages_.end()) {
+      return;
+    }
+    oldest->tex.reset();
+    oldest->uploaded = false;
+    num_resident--;
   }
-  scroll_.resize(coords_.size());
+}
+
+ThumbnailPane::ThumbnailPane(backends::Base *backend) : atlas_(backend) {}
 
-  tex_ = backend_->CreateTexture(size);
-  backend_->UpdateTexture(tex_.get(), atlas);
+void ThumbnailPane::Load(const std::vector<algorithm::Image> &images) {
+  if (!atlas_.IsPrefixOf(images)) {
+    Reset();
+  }
+  spdlog::info("Loading {} thumbnails", images.size() - aspects_.size());
+  for (int i = static_cast<int>(aspects_.size()); i < images.size(); i++) {
+    aspects_.push_back(images[i].GetAspect());
+  }
+  scroll_.resize(aspects_.size());
+  atlas_.Add(images);
   spdlog::info("Thumbnails loaded successfully");
 }
 
-bool ThumbnailPane::Loaded() const { return !coords_.empty(); }
+bool ThumbnailPane::Loaded() const { return !aspects_.empty(); }
+
+bool ThumbnailPane::IsAnimating() const {
+  return auto_scroller_.NeedsRescroll() || resize_checker_.IsResizing();
+}
 
 Action ThumbnailPane::Draw() {
   ImGui::Begin("Images", nullptr, ImGuiWindowFlags_AlwaysHorizontalScrollbar);
   Action action{};
+  atlas_.NextFrame();
 
   if (auto_scroller_.NeedsRescroll()) {
     auto_scroller_.Rescroll();
@@ -170,10 +289,18 @@ Action ThumbnailPane::Draw() {
     }
   }
 
-  for (int coord_id = 0; coord_id < coords_.size(); coord_id++) {
+  for (int coord_id = 0; coord_id < aspects_.size(); coord_id++) {
+    const float scroll_pre = ImGui::GetCursorPosX();
+    // Only the visible thumbnails need their atlas page
+    if (const ImVec2 button_size = ButtonSize(coord_id);
+        !ImGui::IsRectVisible(button_size)) {
+      ImGui::Dummy(button_size);
+      ImGui::SameLine();
+      scroll_[coord_id] = (scroll_pre + ImGui::GetCursorPosX()) / 2.0f;
+      continue;
+    }
     ImGui::PushID(coord_id);
     hover_checker_.SetColor(coord_id);
-    const float scroll_pre = ImGui::GetCursorPosX();
     if (ThumbnailButton(coord_id)) {
       if (io_.KeyCtrl) {
         action = {ActionType::kModifyPano, coord_id};
@@ -197,7 +324,7 @@ Action ThumbnailPane::Draw() {
   return action;
 }
 
-void ThumbnailPane::ThumbnailTooltip(const std::vector<int> &images) const {
+void ThumbnailPane::ThumbnailTooltip(const std::vector<int> &images) {
   if (images.empty()) {
     return;
   }
@@ -211,11 +338,20 @@ void ThumbnailPane::ThumbnailTooltip(const std::vector<int> &images) const {
   ImGui::EndTooltip();
 }
 
-bool ThumbnailPane::ThumbnailButton(int img_id) const {
-  const auto &coord = coords_[img_id];
+ImVec2 ThumbnailPane::ButtonSize(int img_id) const {
+  const ImVec2 padding = ImGui::GetStyle().FramePadding;
+  return {thumbnail_height_ * aspects_[img_id] + 2 * padding.x,
+          thumbnail_height_ + 2 * padding.y};
+}
+
+bool ThumbnailPane::ThumbnailButton(int img_id) {
+  const auto coord = atlas_.Get(img_id);
+  if (coord.tex == nullptr) {
+    return ImGui::Button("", ButtonSize(img_id));
+  }
   return ImGui::ImageButton(
-      "", tex_.get(),
-      ImVec2(thumbnail_height_ * coord.aspect, thumbnail_height_),
+      "", coord.tex, ImVec2(thumbnail_height_ * aspects_[img_id],
+                            thumbnail_height_),
       utils::ImVec(coord.uv0), utils::ImVec(coord.uv1));
 }
 
@@ -248,8 +384,8 @@ void ThumbnailPane::Highlight(const std::vector<int> &ids) {
 void ThumbnailPane::DisableHighlight() { hover_checker_.DisableHighlight(); }
 
 void ThumbnailPane::Reset() {
-  tex_.reset(nullptr);
-  coords_.resize(0);
+  atlas_.Reset();
+  aspects_.resize(0);
   scroll_.resize(0);
   hover_checker_ = HoverChecker{};
 }
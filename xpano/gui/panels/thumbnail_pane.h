@@ -7,6 +7,7 @@
 #include <vector>
 
 #include <imgui.h>
+#include <opencv2/core.hpp>
 
 #include "xpano/algorithm/image.h"
 #include "xpano/constants.h"
@@ -61,6 +62,7 @@ class ResizeChecker {
 
   explicit ResizeChecker(int delay = kResizingDelayFrames);
   Status Check(ImVec2 window_size);
+  [[nodiscard]] bool IsResizing() const;
 
  private:
   const int delay_;
@@ -69,21 +71,64 @@ class ResizeChecker {
   ImVec2 window_size_ = {0, 0};
 };
 
-class ThumbnailPane {
+// Thumbnails split into fixed size texture pages. A page is uploaded when one
+// of its thumbnails is first drawn and the least recently drawn pages are
+// released above kMaxThumbnailPages.
+class ThumbnailAtlas {
+ public:
   struct Coord {
+    ImTextureID tex;
     utils::Ratio2f uv0;
     utils::Ratio2f uv1;
-    float aspect;
   };
 
+  explicit ThumbnailAtlas(backends::Base *backend);
+
+  // Whether the images start with the already added thumbnails
+  [[nodiscard]] bool IsPrefixOf(
+      const std::vector<algorithm::Image> &images) const;
+  // Appends the thumbnails past the already added ones, the new thumbnails
+  // on resident pages are queued for upload
+  void Add(const std::vector<algorithm::Image> &images);
+
+  // Queues the page upload if needed, tex is nullptr until it's finished
+  Coord Get(int img_id);
+  // Releases the pages over the limit that weren't drawn in the last frame
+  void NextFrame();
+
+  [[nodiscard]] int NumResidentPages() const;
+
+  void Reset();
+
+ private:
+  struct Page {
+    backends::Texture tex;
+    bool uploaded = false;
+    std::int64_t last_used = 0;
+  };
+
+  void Upload(int page_id);
+  void UploadThumbnail(int img_id);
+  void Evict(int max_pages);
+
+  std::vector<cv::Mat> thumbnails_;
+  std::vector<Page> pages_;
+  std::int64_t frame_ = 0;
+
+  backends::Base *backend_;
+};
+
+class ThumbnailPane {
  public:
   explicit ThumbnailPane(backends::Base *backend);
   void Load(const std::vector<algorithm::Image> &images);
   [[nodiscard]] bool Loaded() const;
 
   Action Draw();
+  // Needs to be drawn every frame until the scrolling or resizing finishes
+  [[nodiscard]] bool IsAnimating() const;
 
-  void ThumbnailTooltip(const std::vector<int> &images) const;
+  void ThumbnailTooltip(const std::vector<int> &images);
 
   void SetScrollX(int img_id);
   void SetScrollX(int id1, int id2);
@@ -97,10 +142,10 @@ class ThumbnailPane {
   void Reset();
 
  private:
-  // NOLINTNEXTLINE(modernize-use-nodiscard)
-  bool ThumbnailButton(int img_id) const;
+  [[nodiscard]] ImVec2 ButtonSize(int img_id) const;
+  bool ThumbnailButton(int img_id);
 
-  std::vector<Coord> coords_;
+  std::vector<float> aspects_;
   std::vector<float> scroll_;
 
   AutoScroller auto_scroller_;
@@ -110,8 +155,7 @@ class ThumbnailPane {
 
   HoverChecker hover_checker_;
 
-  backends::Texture tex_;
-  backends::Base *backend_;
+  ThumbnailAtlas atlas_;
 
   ImGuiIO &io_ = ImGui::GetIO();
 };
@@ -174,8 +174,9 @@ void WarningPane::QueueFilePickerError(const file_dialog::Error& error) {
     case file_dialog::ErrorType::kUnsupportedExtension: {
       pending_warnings_.push(
           {WarningType::kFilePickerUnsupportedExt,
-           fmt::format("Selected filename: {}\nSupported extensions: {}",
-                       error.message, fmt::join(kSupportedExtensions, ", "))});
+           fmt::format("Selected filename: {}\nSupported extensions: {}, {}",
+                       error.message, fmt::join(kSupportedExtensions, ", "),
+                       fmt::join(kExportOnlyExtensions, ", "))});
       break;
     }
     case file_dialog::ErrorType::kUnknownError: {
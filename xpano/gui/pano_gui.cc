@@ -6,8 +6,10 @@
 #include "xpano/gui/pano_gui.h"
 
 #include <algorithm>
+#include <chrono>
 #include <exception>
 #include <filesystem>
+#include <functional>
 #include <future>
 #include <optional>
 #include <string>
@@ -35,12 +37,14 @@
 #include "xpano/gui/shortcut.h"
 #include "xpano/log/logger.h"
 #include "xpano/pipeline/options.h"
+#include "xpano/pipeline/session.h"
 #include "xpano/pipeline/stitcher_pipeline.h"
 #include "xpano/utils/common.h"
 #include "xpano/utils/config.h"
 #include "xpano/utils/fmt.h"
 #include "xpano/utils/imgui_.h"
 #include "xpano/utils/text.h"
+#include "xpano/utils/trace.h"
 #include "xpano/version.h"
 
 template <>
@@ -77,6 +81,9 @@ std::string PreviewMessage(const Selection& selection, ImageType image_type) {
       if (image_type == ImageType::kPanoPreview) {
         return fmt::format("Pano {} (Preview)", selection.target_id);
       }
+      if (image_type == ImageType::kLiveCanvas) {
+        return fmt::format("Pano {} (Composing)", selection.target_id);
+      }
       return fmt::format("Pano {}", selection.target_id);
     }
     default:
@@ -157,8 +164,17 @@ auto ResolveStitcherDataFuture(
   return stitcher_data;
 }
 
+// Exports are stitched in the background, their result is shown only if the
+// pano is still selected
+bool IsShown(const pipeline::StitchingResult& result,
+             const Selection& selection) {
+  return !result.export_path || (selection.type == SelectionType::kPano &&
+                                 selection.target_id == result.pano_id);
+}
+
 auto ResolveStitchingResultFuture(
-    std::future<pipeline::StitchingResult> pano_future, PreviewPane* plot_pane,
+    std::future<pipeline::StitchingResult> pano_future,
+    const Selection& selection, PreviewPane* plot_pane,
     StatusMessage* status_message) -> pipeline::StitchingResult {
   pipeline::StitchingResult result;
   try {
@@ -173,7 +189,7 @@ auto ResolveStitchingResultFuture(
     *status_message = {fmt::format("Failed to stitch pano {}", result.pano_id),
                        algorithm::ToString(result.status)};
     spdlog::info(*status_message);
-    if (!result.full_res) {
+    if (!result.full_res || plot_pane->Type() == ImageType::kLiveCanvas) {
       plot_pane->Reset();
     }
     return {};
@@ -183,6 +199,14 @@ auto ResolveStitchingResultFuture(
       fmt::format("Stitched pano {} successfully", result.pano_id)};
   spdlog::info(*status_message);
 
+  if (!IsShown(result, selection)) {
+    *status_message = {
+        fmt::format("Exported pano {} successfully", result.pano_id),
+        result.export_path->string()};
+    spdlog::info(*status_message);
+    return result;
+  }
+
   if (!plot_pane->IsRotateEnabled() || result.full_res) {
     plot_pane->Reset();
   }
@@ -231,6 +255,21 @@ auto ResolveExportFuture(std::future<pipeline::ExportResult> export_future,
   return {};
 }
 
+auto ResolveSaveSessionFuture(
+    std::future<pipeline::SaveSessionResult> save_future,
+    StatusMessage* status_message) -> void {
+  pipeline::SaveSessionResult result;
+  try {
+    result = save_future.get();
+  } catch (const std::exception& e) {
+    *status_message = {"Failed to save session", e.what()};
+    spdlog::error(*status_message);
+    return;
+  }
+  *status_message = {"Saved session", result.session_path.string()};
+  spdlog::info(*status_message);
+}
+
 auto ResolveInpaintingResultFuture(
     std::future<pipeline::InpaintingResult> inpainting_future,
     PreviewPane* plot_pane, StatusMessage* status_message) -> void {
@@ -279,13 +318,19 @@ const algorithm::Image* FirstImage(const pipeline::StitcherData& stitcher_data,
 
 PanoGui::PanoGui(backends::Base* backend, logger::Logger* logger,
                  const utils::config::Config& config,
-                 std::future<utils::Texts> licenses, const cli::Args& args)
+                 std::future<utils::Texts> licenses, const cli::Args& args,
+                 std::function<void()> wake_up)
     : options_(config.user_options),
       log_pane_(logger),
       about_pane_(std::move(licenses)),
       bugreport_pane_(logger),
       plot_pane_(backend),
-      thumbnail_pane_(backend) {
+      thumbnail_pane_(backend),
+      trace_path_(std::filesystem::path(kTraceFilename).filename()) {
+  if (auto log_dir = logger->GetLogDirPath(); log_dir) {
+    trace_path_ = std::filesystem::path(*log_dir) / kTraceFilename;
+  }
+  stitcher_pipeline_.SetNotifier(std::move(wake_up));
   if (config.app_state.xpano_version != version::Current()) {
     warning_pane_.QueueNewVersion(config.app_state.xpano_version,
                                   about_pane_.GetText(kChangelogFilename));
@@ -304,6 +349,7 @@ bool PanoGui::IsDebugEnabled() const { return log_pane_.IsShown(); }
 bool PanoGui::Run() {
   MultiAction actions = std::move(next_actions_);
 
+  ShowLiveCanvas();
   actions |= DrawGui();
   actions |= CheckKeybindings();
   actions |= ResolveFutures();
@@ -320,6 +366,38 @@ bool PanoGui::Run() {
       [](const auto& action) { return action.type == ActionType::kQuit; });
 }
 
+bool PanoGui::IsAnimating() const {
+  return !next_actions_.items.empty() || plot_pane_.IsAnimating() ||
+         thumbnail_pane_.IsAnimating();
+}
+
+std::chrono::milliseconds PanoGui::IdleTimeout() const {
+  // Cancelled tasks and the preview pyramid finish without a notification,
+  // the text cursor blinks
+  if (stitcher_pipeline_.HasTasks() || plot_pane_.IsLoading() ||
+      ImGui::GetIO().WantTextInput) {
+    return kBusyFrameTimeout;
+  }
+  return kIdleFrameTimeout;
+}
+
+void PanoGui::ShowLiveCanvas() {
+  const auto* canvas = stitcher_pipeline_.CurrentCanvas();
+  if (canvas == nullptr || canvas->Version() == live_canvas_version_) {
+    return;
+  }
+  live_canvas_version_ = canvas->Version();
+  auto image = canvas->Snapshot();
+  if (image.empty()) {
+    return;
+  }
+  if (plot_pane_.Type() == ImageType::kLiveCanvas) {
+    plot_pane_.Reload(image, ImageType::kLiveCanvas);
+  } else {
+    plot_pane_.Load(image, ImageType::kLiveCanvas);
+  }
+}
+
 Action PanoGui::DrawGui() {
   layout::InitDockSpace();
   auto action = DrawSidebar();
@@ -360,12 +438,12 @@ Action PanoGui::DrawSidebar() {
     auto highlight_id =
         selection_.type == SelectionType::kPano ? selection_.target_id : -1;
     action |=
-        DrawPanosMenu(stitcher_data_->panos, thumbnail_pane_, highlight_id);
+        DrawPanosMenu(stitcher_data_->panos, &thumbnail_pane_, highlight_id);
     if (IsDebugEnabled()) {
       ImGui::SeparatorText("Debug");
       auto highlight_id =
           selection_.type == SelectionType::kMatch ? selection_.target_id : -1;
-      action |= DrawMatchesMenu(stitcher_data_->matches, thumbnail_pane_,
+      action |= DrawMatchesMenu(stitcher_data_->matches, &thumbnail_pane_,
                                 highlight_id);
     }
   }
@@ -381,6 +459,8 @@ void PanoGui::Reset() {
   selection_ = {};
   status_message_ = {};
   pano_mask_ = cv::Mat{};
+  preview_cache_.Clear();
+  cameras_versions_.clear();
   // Order of the following lines is important
   stitcher_pipeline_.CancelAndWait();
   stitcher_data_.reset();
@@ -397,7 +477,7 @@ Action PanoGui::PerformAction(const Action& action) {
       break;
     }
     case ActionType::kCancelPipeline: {
-      stitcher_pipeline_.Cancel();
+      stitcher_pipeline_.CancelCurrent();
       break;
     }
     case ActionType::kDisableHighlight: {
@@ -442,6 +522,29 @@ Action PanoGui::PerformAction(const Action& action) {
       }
       break;
     }
+    case ActionType::kOpenSession: {
+      auto files = file_dialog::Open(action);
+      if (!files) {
+        spdlog::warn(files.error());
+        warning_pane_.QueueFilePickerError(files.error());
+        break;
+      }
+      return {
+          .type = ActionType::kLoadSession, .delayed = true, .extra = *files};
+    }
+    case ActionType::kLoadSession: {
+      if (auto files = ValueOrDefault<LoadFilesExtra>(action); !files.empty()) {
+        Reset();
+        stitcher_pipeline_.RunLoadingSession(files[0]);
+      }
+      break;
+    }
+    case ActionType::kSaveSession: {
+      if (stitcher_data_) {
+        PerformSaveSessionAction();
+      }
+      break;
+    }
     case ActionType::kShowMatch: {
       selection_ = {SelectionType::kMatch, action.target_id};
       spdlog::info("Clicked match {}", action.target_id);
@@ -460,16 +563,35 @@ Action PanoGui::PerformAction(const Action& action) {
       auto extra = ValueOrDefault<ShowPanoExtra>(action);
       auto& pano = stitcher_data_->panos[selection_.target_id];
       if (extra.reset_cameras) {
+        if (pano.cameras) {
+          ForgetPreviews(pano);
+        }
         pano.cameras.reset();
         pano.backup_cameras.reset();
       }
       if (extra.reset_crop) {
         pano.crop.reset();
       }
-      stitcher_pipeline_.RunStitching(*stitcher_data_,
-                                      {.pano_id = selection_.target_id,
-                                       .full_res = extra.full_res,
-                                       .stitch_algorithm = options_.stitch});
+      std::optional<pipeline::StitchingResult> preview;
+      if (!extra.full_res) {
+        preview = FindPreview(pano);
+      }
+      if (preview) {
+        // Already stitched, the running task would replace it
+        stitcher_pipeline_.Cancel(pipeline::Lane::kInteractive);
+        preview->pano_id = selection_.target_id;
+        std::promise<pipeline::StitchingResult> ready;
+        ready.set_value(*std::move(preview));
+        ShowStitchingResult(ready.get_future());
+      } else {
+        // The rotation widget is drawn over the previous pano instead
+        stitcher_pipeline_.RunStitching(
+            *stitcher_data_, {.pano_id = selection_.target_id,
+                              .full_res = extra.full_res,
+                              .stitch_algorithm = options_.stitch,
+                              .live_canvas = !plot_pane_.IsRotateEnabled()});
+        live_canvas_version_ = 0;
+      }
       thumbnail_pane_.Highlight(pano.ids);
       if (extra.scroll_thumbnails) {
         thumbnail_pane_.SetScrollX(pano.ids);
@@ -486,6 +608,7 @@ Action PanoGui::PerformAction(const Action& action) {
             cameras) {
           auto extra = ValueOrDefault<RotateExtra>(action);
           cameras = algorithm::Rotate(*cameras, extra.rotation_matrix);
+          ForgetPreviews(stitcher_data_->panos.at(selection_.target_id));
         }
       }
     }
@@ -493,6 +616,10 @@ Action PanoGui::PerformAction(const Action& action) {
     case ActionType::kRecomputePanoFullRes:
       [[fallthrough]];
     case ActionType::kRecomputePano: {
+      if (action.type == ActionType::kRecomputePano && stitcher_data_) {
+        stitcher_pipeline_.RunSpeculativeStitching(*stitcher_data_,
+                                                   options_.stitch);
+      }
       if (selection_.type == SelectionType::kPano) {
         spdlog::info("Recomputing pano {}: {}", selection_.target_id,
                      Label(options_.stitch.projection.type));
@@ -525,6 +652,23 @@ Action PanoGui::PerformAction(const Action& action) {
       log_pane_.ToggleShow();
       break;
     }
+    case ActionType::kToggleTrace: {
+      if (!utils::trace::IsEnabled()) {
+        utils::trace::Clear();
+        utils::trace::Enable(true);
+        spdlog::info("Recording a trace");
+        break;
+      }
+      utils::trace::Enable(false);
+      if (utils::trace::WriteChromeJson(trace_path_)) {
+        status_message_ = {"Trace saved", trace_path_.string()};
+        spdlog::info("Trace saved to {}", trace_path_.string());
+      } else {
+        status_message_ = {"Failed to save the trace", trace_path_.string()};
+        spdlog::error(status_message_);
+      }
+      break;
+    }
     case ActionType::kToggleCrop: {
       return plot_pane_.ToggleCrop();
     }
@@ -562,6 +706,7 @@ Action PanoGui::PerformAction(const Action& action) {
         auto& pano = stitcher_data_->panos[selection_.target_id];
         if (pano.backup_cameras) {
           pano.cameras = pano.backup_cameras;
+          ForgetPreviews(pano);
           return {.type = ActionType::kRecomputePano, .delayed = true};
         }
       }
@@ -618,6 +763,78 @@ void PanoGui::PerformExportAction(int pano_id) {
   }
 }
 
+void PanoGui::ShowStitchingResult(
+    std::future<pipeline::StitchingResult> pano_future) {
+  auto result = ResolveStitchingResultFuture(
+      std::move(pano_future), selection_, &plot_pane_, &status_message_);
+  auto& pano = stitcher_data_->panos[result.pano_id];
+  if (result.full_res &&
+      result.status == algorithm::stitcher::Status::kSuccessResolutionCapped) {
+    warning_pane_.QueueResolutionCapped(options_.stitch.max_pano_mpx);
+  }
+  if (result.export_path) {
+    pano.exported = true;
+  }
+  if (result.cameras) {
+    pano.cameras = result.cameras;
+    if (!pano.backup_cameras) {
+      pano.backup_cameras = result.cameras;
+    }
+  }
+  if (result.auto_crop) {
+    pano.auto_crop = result.auto_crop;
+  }
+  if (result.pano && !result.full_res && !result.export_path) {
+    const auto cost = pipeline::MemoryMiB(result);
+    preview_cache_.Insert(MakePreviewKey(pano), result, cost);
+  }
+  if (!IsShown(result, selection_)) {
+    return;
+  }
+  if (pano.crop && !plot_pane_.IsRotateEnabled()) {
+    plot_pane_.ForceCrop(*pano.crop);
+  }
+  pano_mask_ = result.mask;
+}
+
+std::optional<pipeline::StitchingResult> PanoGui::FindPreview(
+    const algorithm::Pano& pano) {
+  if (auto preview = preview_cache_.Find(MakePreviewKey(pano)); preview) {
+    return preview;
+  }
+  return stitcher_pipeline_.SpeculativeResult(pano, options_.stitch);
+}
+
+// The cached previews were stitched with the previous cameras
+void PanoGui::ForgetPreviews(const algorithm::Pano& pano) {
+  cameras_versions_[pano.ids]++;
+  preview_cache_.EraseIf(
+      [&pano](const PreviewKey& key) { return key.ids == pano.ids; });
+}
+
+PreviewKey PanoGui::MakePreviewKey(const algorithm::Pano& pano) const {
+  auto version = cameras_versions_.find(pano.ids);
+  return {.ids = pano.ids,
+          .stitch_algorithm = options_.stitch,
+          .cameras_version =
+              version != cameras_versions_.end() ? version->second : 0};
+}
+
+void PanoGui::PerformSaveSessionAction() {
+  status_message_ = {};
+  const auto& first_image = stitcher_data_->images[0];
+  auto session_path = file_dialog::SaveSession(
+      first_image.GetPath().stem().string() + "." + kSessionExtensions[0]);
+
+  if (!session_path) {
+    spdlog::warn(session_path.error());
+    warning_pane_.QueueFilePickerError(session_path.error());
+    return;
+  }
+
+  stitcher_pipeline_.RunSavingSession(*stitcher_data_, *session_path);
+}
+
 // NOLINTNEXTLINE(readability-function-cognitive-complexity): fixme
 MultiAction PanoGui::ResolveFutures() {
   MultiAction actions;
@@ -632,6 +849,8 @@ MultiAction PanoGui::ResolveFutures() {
           actions |= {.type = ActionType::kWarnInputConversion};
         }
         if (stitcher_data_ && !stitcher_data_->panos.empty()) {
+          stitcher_pipeline_.RunSpeculativeStitching(*stitcher_data_,
+                                                     options_.stitch);
           // keep delayed == true to wait for the thumbnails to be drawn at
           // leaset once before scrolling
           actions |= {.type = ActionType::kShowPano,
@@ -643,30 +862,7 @@ MultiAction PanoGui::ResolveFutures() {
 
   auto handle_pano =
       [this](std::future<pipeline::StitchingResult> pano_future) {
-        auto result = ResolveStitchingResultFuture(
-            std::move(pano_future), &plot_pane_, &status_message_);
-        auto& pano = stitcher_data_->panos[result.pano_id];
-        if (result.full_res &&
-            result.status ==
-                algorithm::stitcher::Status::kSuccessResolutionCapped) {
-          warning_pane_.QueueResolutionCapped(options_.stitch.max_pano_mpx);
-        }
-        if (result.export_path) {
-          pano.exported = true;
-        }
-        if (result.cameras) {
-          pano.cameras = result.cameras;
-          if (!pano.backup_cameras) {
-            pano.backup_cameras = result.cameras;
-          }
-        }
-        if (result.auto_crop) {
-          pano.auto_crop = result.auto_crop;
-        }
-        if (pano.crop && !plot_pane_.IsRotateEnabled()) {
-          plot_pane_.ForceCrop(*pano.crop);
-        }
-        pano_mask_ = result.mask;
+        ShowStitchingResult(std::move(pano_future));
       };
 
   auto handle_export =
@@ -684,12 +880,18 @@ MultiAction PanoGui::ResolveFutures() {
                                       &status_message_);
       };
 
+  auto handle_save_session =
+      [this](std::future<pipeline::SaveSessionResult> save_future) {
+        ResolveSaveSessionFuture(std::move(save_future), &status_message_);
+      };
+
   if (auto task = stitcher_pipeline_.GetReadyTask();
       task && task->progress->IsCancelled()) {
     spdlog::info("Task cancelled");
   } else if (task && !task->progress->IsCancelled()) {
     std::visit(utils::Overloaded{handle_stitcher_data, handle_pano,
-                                 handle_export, handle_inpaint},
+                                 handle_export, handle_inpaint,
+                                 handle_save_session},
                std::move(task->future));
   }
 
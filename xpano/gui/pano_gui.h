@@ -5,14 +5,20 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <future>
+#include <map>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include <opencv2/core.hpp>
 
 #include "xpano/cli/args.h"
+#include "xpano/constants.h"
 #include "xpano/gui/action.h"
 #include "xpano/gui/backends/base.h"
 #include "xpano/gui/panels/about.h"
@@ -25,6 +31,7 @@
 #include "xpano/pipeline/options.h"
 #include "xpano/pipeline/stitcher_pipeline.h"
 #include "xpano/utils/config.h"
+#include "xpano/utils/lru_cache.h"
 #include "xpano/utils/text.h"
 
 namespace xpano::gui {
@@ -46,21 +53,44 @@ struct Selection {
   int target_id = -1;
 };
 
+// The images are reloaded with a different preview size, which resets the
+// cache, so the size doesn't need to be a part of the key
+struct PreviewKey {
+  std::vector<int> ids;
+  pipeline::StitchAlgorithmOptions stitch_algorithm;
+  // Changes whenever the cameras of the pano are rotated or reset
+  int cameras_version = 0;
+  bool operator==(const PreviewKey&) const = default;
+};
+
 class PanoGui {
  public:
   PanoGui(backends::Base* backend, logger::Logger* logger,
           const utils::config::Config& config,
-          std::future<utils::Texts> licenses, const cli::Args& args);
+          std::future<utils::Texts> licenses, const cli::Args& args,
+          std::function<void()> wake_up);
 
   bool Run();
+  // The next frame should be drawn right away instead of waiting for events
+  [[nodiscard]] bool IsAnimating() const;
+  // How long to wait for events otherwise, shorter while there is background
+  // work that doesn't wake up the main loop
+  [[nodiscard]] std::chrono::milliseconds IdleTimeout() const;
   pipeline::Options GetOptions() const;
 
  private:
   Action DrawGui();
   Action DrawSidebar();
   MultiAction ResolveFutures();
+  void ShowStitchingResult(std::future<pipeline::StitchingResult> pano_future);
+  std::optional<pipeline::StitchingResult> FindPreview(
+      const algorithm::Pano& pano);
+  void ForgetPreviews(const algorithm::Pano& pano);
+  PreviewKey MakePreviewKey(const algorithm::Pano& pano) const;
+  void ShowLiveCanvas();
   Action PerformAction(const Action& action);
   void PerformExportAction(int pano_id);
+  void PerformSaveSessionAction();
   void Reset();
   bool IsDebugEnabled() const;
 
@@ -83,8 +113,19 @@ class PanoGui {
   // Algorithm
   pipeline::StitcherPipeline<> stitcher_pipeline_;
 
+  // Recently shown previews, switching back to them doesn't stitch again
+  utils::LruCache<PreviewKey, pipeline::StitchingResult> preview_cache_{
+      kPreviewCacheMiB};
+  // Keyed by the image ids of the pano
+  std::map<std::vector<int>, int> cameras_versions_;
+
   // Used for inpainting
   std::optional<cv::Mat> pano_mask_;
+
+  // Last shown version of the live canvas
+  int live_canvas_version_ = 0;
+
+  std::filesystem::path trace_path_;
 };
 
 }  // namespace xpano::gui
@@ -7,11 +7,13 @@
 #include <cmath>
 #include <iterator>
 #include <numeric>
+#include <optional>
 #include <utility>
 #include <vector>
 
 #include <imgui.h>
 #include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
 #include <spdlog/spdlog.h>
 
 #include "xpano/algorithm/algorithm.h"
@@ -27,6 +29,10 @@ namespace xpano::gui::widgets {
 namespace {
 
 constexpr int kPointsPerEdge = 50;
+// Pano pixels between the exactly projected points of RotatePano
+constexpr int kRemapGridStep = 16;
+// Far enough to stay outside of the pano after interpolation
+const cv::Point2f kOutsidePano = {-10000.0f, -10000.0f};
 
 std::vector<cv::Point2f> PointsOnRectangle(
     cv::Size size, int points_per_edge = kPointsPerEdge) {
@@ -284,6 +290,30 @@ bool IsHorizontal(const cv::Point2f& dir) {
   return std::abs(dir.x) > std::abs(dir.y);
 }
 
+// Finds the point in the stitched pano that ends up at the given point after
+// the extra rotation. Goes through the images starting with the last hit,
+// neighboring points usually come from the same image.
+std::optional<cv::Point2f> Unrotate(const cv::Point2f& point,
+                                    const StaticWarpData& warp,
+                                    const std::vector<cv::Mat>& rotated_r_mats,
+                                    int* last_camera_id) {
+  const int num_cameras = static_cast<int>(warp.cameras.size());
+  for (int i = 0; i < num_cameras; i++) {
+    const int camera_id = (*last_camera_id + i) % num_cameras;
+    const auto& camera = warp.cameras[camera_id];
+    const auto& size = warp.image_sizes[camera_id];
+    auto image_point = warp.warper->warpPointBackward(
+        point, camera.k_mat, rotated_r_mats[camera_id]);
+    if (image_point.x >= 0.0f && image_point.y >= 0.0f &&
+        image_point.x < static_cast<float>(size.width) &&
+        image_point.y < static_cast<float>(size.height)) {
+      *last_camera_id = camera_id;
+      return warp.warper->warpPoint(image_point, camera.k_mat, camera.r_mat);
+    }
+  }
+  return {};
+}
+
 }  // namespace
 
 RotationWidget SetupRotationWidget(const algorithm::Cameras& cameras) {
@@ -312,7 +342,9 @@ RotationWidget SetupRotationWidget(const algorithm::Cameras& cameras) {
       Preprocess(cameras.cameras, cameras.warp_helper.work_scale);
 
   auto warp = StaticWarpData{.scale = dst_roi.size(),
+                             .origin = dst_roi.tl(),
                              .cameras = std::move(preprocessed_cameras),
+                             .image_sizes = cameras.warp_helper.full_sizes,
                              .warper = cameras.warp_helper.warper};
 
   auto pano_center = ComputePanoCenter(cameras.warp_helper.full_sizes, warp);
@@ -384,6 +416,58 @@ Polyline Warp(const Projectable& projectable, const StaticWarpData& warp,
   return projected;
 }
 
+cv::Mat RotatePano(const cv::Mat& pano, const StaticWarpData& warp,
+                   const RotationState& state) {
+  const cv::Mat extra_rotation = FullRotation(state, warp);
+  std::vector<cv::Mat> rotated_r_mats;
+  rotated_r_mats.reserve(warp.cameras.size());
+  for (const auto& camera : warp.cameras) {
+    rotated_r_mats.emplace_back(extra_rotation * camera.r_mat);
+  }
+
+  // Pano pixels -> warper coordinates
+  const float scale_x =
+      static_cast<float>(warp.scale.width) / static_cast<float>(pano.cols);
+  const float scale_y =
+      static_cast<float>(warp.scale.height) / static_cast<float>(pano.rows);
+
+  // The grid points are placed where cv::resize samples them when scaling the
+  // grid up to the pano size
+  const int grid_cols = pano.cols / kRemapGridStep + 2;
+  const int grid_rows = pano.rows / kRemapGridStep + 2;
+  const float step_x =
+      static_cast<float>(pano.cols) / static_cast<float>(grid_cols);
+  const float step_y =
+      static_cast<float>(pano.rows) / static_cast<float>(grid_rows);
+
+  cv::Mat grid(grid_rows, grid_cols, CV_32FC2);
+  int last_camera_id = 0;
+  for (int row = 0; row < grid_rows; row++) {
+    const float pano_y = (static_cast<float>(row) + 0.5f) * step_y - 0.5f;
+    for (int col = 0; col < grid_cols; col++) {
+      const float pano_x = (static_cast<float>(col) + 0.5f) * step_x - 0.5f;
+      const cv::Point2f point = {pano_x * scale_x + warp.origin.x,
+                                 pano_y * scale_y + warp.origin.y};
+      auto source = Unrotate(point, warp, rotated_r_mats, &last_camera_id);
+      grid.at<cv::Point2f>(row, col) =
+          source ? cv::Point2f{(source->x - warp.origin.x) / scale_x,
+                               (source->y - warp.origin.y) / scale_y}
+                 : kOutsidePano;
+    }
+  }
+
+  cv::Mat map;
+  cv::resize(grid, map, pano.size(), 0, 0, cv::INTER_LINEAR);
+  // The fixed point maps take the vectorized remap path
+  cv::Mat map_xy;
+  cv::Mat map_interpolation;
+  cv::convertMaps(map, cv::noArray(), map_xy, map_interpolation, CV_16SC2);
+  cv::Mat result;
+  cv::remap(pano, result, map_xy, map_interpolation, cv::INTER_LINEAR,
+            cv::BORDER_CONSTANT);
+  return result;
+}
+
 DragResult<RotationState> Drag(const RotationWidget& widget,
                                const utils::RectPVf& image,
                                utils::Point2f mouse_pos, bool mouse_clicked,
@@ -57,7 +57,10 @@ struct Axis {
 
 struct StaticWarpData {
   cv::Size scale;
+  // Top left corner of the pano in the warper coordinates
+  cv::Point2f origin;
   std::vector<PreprocessedCamera> cameras;
+  std::vector<cv::Size> image_sizes;
   cv::Ptr<cv::detail::RotationWarper> warper;
   cv::Mat roll_axis;
   Axis pitch_axis;
@@ -86,6 +89,12 @@ cv::Mat FullRotation(const RotationState& state, const StaticWarpData& warp);
 Polyline Warp(const Projectable& projectable, const StaticWarpData& warp,
               const RotationState& state, const utils::RectPVf& image);
 
+// Resamples the stitched pano as if it was stitched with the extra rotation,
+// keeping its size. The projection is computed exactly on a coarse grid and
+// interpolated in between, which is fast enough to follow the mouse.
+cv::Mat RotatePano(const cv::Mat& pano, const StaticWarpData& warp,
+                   const RotationState& state);
+
 void SelectMouseCursor(const widgets::RotationWidget& widget);
 
 }  // namespace xpano::gui::widgets
\ No newline at end of file
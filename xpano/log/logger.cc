@@ -130,4 +130,11 @@ void RedirectSpdlogToCout() {
   spdlog::set_default_logger(logger);
 };
 
+void RedirectSpdlogToCerr() {
+  auto logger = spdlog::stderr_logger_mt("console_stderr");
+  logger->flush_on(spdlog::level::info);
+  logger->set_pattern("%l: %v");
+  spdlog::set_default_logger(logger);
+}
+
 }  // namespace xpano::logger
@@ -56,4 +56,7 @@ void RedirectSDLOutput();
 
 void RedirectSpdlogToCout();
 
+// Keeps stdout free for machine readable output
+void RedirectSpdlogToCerr();
+
 }  // namespace xpano::logger
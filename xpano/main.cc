@@ -135,8 +135,10 @@ int main(int argc, char** argv) {
       std::async(std::launch::async, xpano::utils::LoadTexts, *app_exe_path,
                  xpano::kLicensePath);
 
+  // Wakes up the main loop on pipeline progress
+  xpano::utils::sdl::EventNotifier notifier;
   xpano::gui::PanoGui gui(&backend, &logger, config, std::move(license_texts),
-                          *args);
+                          *args, [&notifier]() { notifier.Notify(); });
 
   auto window_manager =
       xpano::utils::sdl::DetermineWindowManager(has_wayland_support);
@@ -150,9 +152,22 @@ int main(int argc, char** argv) {
 
   // Main loop
   bool done = false;
+  int frames_to_draw = xpano::kFramesAfterEvent;
   while (!done) {
+    if (frames_to_draw > 0) {
+      frames_to_draw--;
+    } else if (!gui.IsAnimating() && !backend.HasPendingUpdates()) {
+      // Nothing changes on screen, sleep until the next event
+      SDL_WaitEventTimeout(nullptr,
+                           static_cast<int>(gui.IdleTimeout().count()));
+    }
+
     SDL_Event event;
     while (SDL_PollEvent(&event) > 0) {
+      frames_to_draw = xpano::kFramesAfterEvent;
+      if (notifier.Consume(event)) {
+        continue;
+      }
       ImGui_ImplSDL2_ProcessEvent(&event);
       if (event.type == SDL_QUIT) {
         done = true;
@@ -176,6 +191,7 @@ int main(int argc, char** argv) {
 
     // User code
     done |= gui.Run();
+    backend.ProcessUpdates(xpano::kTextureUploadBytesPerFrame);
 
     // ImGui::ShowDemoWindow();
 
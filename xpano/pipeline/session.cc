@@ -0,0 +1,450 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/pipeline/session.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/stitching/detail/camera.hpp>
+#include <spdlog/spdlog.h>
+
+#include "xpano/algorithm/algorithm.h"
+#include "xpano/algorithm/image.h"
+#include "xpano/algorithm/options.h"
+#include "xpano/constants.h"
+#include "xpano/utils/expected.h"
+#include "xpano/utils/fmt.h"
+#include "xpano/utils/path.h"
+#include "xpano/utils/rect.h"
+#include "xpano/utils/serialize.h"
+#include "xpano/utils/vec.h"
+
+namespace xpano::pipeline {
+
+namespace {
+
+// Plain copies of the data, alpaca versions the file by their layout
+
+struct MatData {
+  int rows = 0;
+  int cols = 0;
+  int type = 0;
+  std::vector<std::uint8_t> bytes;
+};
+
+struct KeypointData {
+  float x;
+  float y;
+  float size;
+  float angle;
+  float response;
+  int octave;
+  int class_id;
+};
+
+struct ImageData {
+  std::string path;
+  std::optional<utils::path::FileIdentity> identity;
+  int full_width = 0;
+  int full_height = 0;
+  bool is_raw = false;
+  // Encoded with kSessionImageExtension
+  std::vector<std::uint8_t> preview;
+  std::vector<std::uint8_t> thumbnail;
+  std::vector<KeypointData> keypoints;
+  MatData descriptors;
+};
+
+struct DMatchData {
+  int query_idx;
+  int train_idx;
+  float distance;
+};
+
+struct MatchData {
+  int id1;
+  int id2;
+  std::vector<DMatchData> matches;
+  float avg_shift;
+};
+
+struct CameraData {
+  double focal;
+  double aspect;
+  double ppx;
+  double ppy;
+  MatData rotation;
+  MatData translation;
+};
+
+// The warp helper is computed again when the pano is stitched
+struct CamerasData {
+  std::vector<CameraData> cameras;
+  std::vector<int> component;
+  algorithm::WaveCorrectionType wave_correction_user;
+  int wave_correction_auto;
+};
+
+struct CropData {
+  float start_x;
+  float start_y;
+  float end_x;
+  float end_y;
+};
+
+struct PanoData {
+  std::vector<int> ids;
+  bool exported;
+  std::optional<CropData> crop;
+  std::optional<CropData> auto_crop;
+  std::optional<CamerasData> cameras;
+  std::optional<CamerasData> backup_cameras;
+};
+
+struct Session {
+  std::vector<ImageData> images;
+  std::vector<MatchData> matches;
+  std::vector<PanoData> panos;
+};
+
+MatData ToData(const cv::Mat &mat) {
+  if (mat.empty()) {
+    return {};
+  }
+  const cv::Mat continuous = mat.isContinuous() ? mat : mat.clone();
+  const auto *begin = continuous.ptr<std::uint8_t>();
+  return {.rows = continuous.rows,
+          .cols = continuous.cols,
+          .type = continuous.type(),
+          .bytes = {begin, begin + continuous.total() * continuous.elemSize()}};
+}
+
+cv::Mat FromData(const MatData &data) {
+  if (data.bytes.empty()) {
+    return {};
+  }
+  // The header doesn't own the bytes
+  auto mat = cv::Mat(data.rows, data.cols, data.type,
+                     const_cast<std::uint8_t *>(data.bytes.data()));
+  return mat.clone();
+}
+
+std::vector<std::uint8_t> Encode(const cv::Mat &image) {
+  std::vector<std::uint8_t> buffer;
+  if (!image.empty()) {
+    cv::imencode(kSessionImageExtension, image, buffer,
+                 {cv::IMWRITE_PNG_COMPRESSION, kSessionPngCompression});
+  }
+  return buffer;
+}
+
+cv::Mat Decode(const std::vector<std::uint8_t> &buffer) {
+  if (buffer.empty()) {
+    return {};
+  }
+  return cv::imdecode(buffer, cv::IMREAD_UNCHANGED);
+}
+
+// Keeps non-ascii paths intact on all platforms
+std::string PathToData(const std::filesystem::path &path) {
+  auto utf8 = path.u8string();
+  return {utf8.begin(), utf8.end()};
+}
+
+std::filesystem::path PathFromData(const std::string &data) {
+  return {std::u8string(data.begin(), data.end())};
+}
+
+ImageData ToData(const algorithm::Image &image) {
+  ImageData data{.path = PathToData(image.GetPath()),
+                 .identity = image.GetIdentity(),
+                 .full_width = image.GetFullSize().width,
+                 .full_height = image.GetFullSize().height,
+                 .is_raw = image.IsRaw(),
+                 .preview = Encode(image.GetPreview()),
+                 .thumbnail = Encode(image.GetThumbnail()),
+                 .descriptors = ToData(image.GetDescriptors())};
+  for (const auto &keypoint : image.GetKeypoints()) {
+    data.keypoints.push_back({.x = keypoint.pt.x,
+                              .y = keypoint.pt.y,
+                              .size = keypoint.size,
+                              .angle = keypoint.angle,
+                              .response = keypoint.response,
+                              .octave = keypoint.octave,
+                              .class_id = keypoint.class_id});
+  }
+  return data;
+}
+
+algorithm::Image FromData(const ImageData &data) {
+  algorithm::LoadedImage loaded{
+      .preview = Decode(data.preview),
+      .thumbnail = Decode(data.thumbnail),
+      .full_size = {data.full_width, data.full_height},
+      .descriptors = FromData(data.descriptors),
+      .is_raw = data.is_raw,
+      .identity = data.identity,
+  };
+  for (const auto &keypoint : data.keypoints) {
+    loaded.keypoints.emplace_back(cv::Point2f{keypoint.x, keypoint.y},
+                                  keypoint.size, keypoint.angle,
+                                  keypoint.response, keypoint.octave,
+                                  keypoint.class_id);
+  }
+  return {PathFromData(data.path), std::move(loaded)};
+}
+
+MatchData ToData(const algorithm::Match &match) {
+  MatchData data{
+      .id1 = match.id1, .id2 = match.id2, .avg_shift = match.avg_shift};
+  for (const auto &dmatch : match.matches) {
+    data.matches.push_back({.query_idx = dmatch.queryIdx,
+                            .train_idx = dmatch.trainIdx,
+                            .distance = dmatch.distance});
+  }
+  return data;
+}
+
+algorithm::Match FromData(const MatchData &data) {
+  algorithm::Match match{
+      .id1 = data.id1, .id2 = data.id2, .avg_shift = data.avg_shift};
+  for (const auto &dmatch : data.matches) {
+    match.matches.emplace_back(dmatch.query_idx, dmatch.train_idx,
+                               dmatch.distance);
+  }
+  return match;
+}
+
+CamerasData ToData(const algorithm::Cameras &cameras) {
+  CamerasData data{.component = cameras.component,
+                   .wave_correction_user = cameras.wave_correction_user,
+                   .wave_correction_auto =
+                       static_cast<int>(cameras.wave_correction_auto)};
+  for (const auto &camera : cameras.cameras) {
+    data.cameras.push_back({.focal = camera.focal,
+                            .aspect = camera.aspect,
+                            .ppx = camera.ppx,
+                            .ppy = camera.ppy,
+                            .rotation = ToData(camera.R),
+                            .translation = ToData(camera.t)});
+  }
+  return data;
+}
+
+algorithm::Cameras FromData(const CamerasData &data) {
+  algorithm::Cameras cameras;
+  cameras.component = data.component;
+  cameras.wave_correction_user = data.wave_correction_user;
+  cameras.wave_correction_auto =
+      static_cast<cv::detail::WaveCorrectKind>(data.wave_correction_auto);
+  for (const auto &camera_data : data.cameras) {
+    cv::detail::CameraParams camera;
+    camera.focal = camera_data.focal;
+    camera.aspect = camera_data.aspect;
+    camera.ppx = camera_data.ppx;
+    camera.ppy = camera_data.ppy;
+    camera.R = FromData(camera_data.rotation);
+    camera.t = FromData(camera_data.translation);
+    cameras.cameras.push_back(camera);
+  }
+  return cameras;
+}
+
+CropData ToData(const utils::RectRRf &crop) {
+  return {.start_x = crop.start[0],
+          .start_y = crop.start[1],
+          .end_x = crop.end[0],
+          .end_y = crop.end[1]};
+}
+
+utils::RectRRf FromData(const CropData &data) {
+  return utils::Rect(utils::Ratio2f{data.start_x, data.start_y},
+                     utils::Ratio2f{data.end_x, data.end_y});
+}
+
+template <typename TType>
+auto ToData(const std::optional<TType> &value)
+    -> std::optional<decltype(ToData(*value))> {
+  if (!value) {
+    return {};
+  }
+  return ToData(*value);
+}
+
+template <typename TType>
+auto FromData(const std::optional<TType> &data)
+    -> std::optional<decltype(FromData(*data))> {
+  if (!data) {
+    return {};
+  }
+  return FromData(*data);
+}
+
+PanoData ToData(const algorithm::Pano &pano) {
+  return {.ids = pano.ids,
+          .exported = pano.exported,
+          .crop = ToData(pano.crop),
+          .auto_crop = ToData(pano.auto_crop),
+          .cameras = ToData(pano.cameras),
+          .backup_cameras = ToData(pano.backup_cameras)};
+}
+
+algorithm::Pano FromData(const PanoData &data) {
+  return {.ids = data.ids,
+          .exported = data.exported,
+          .crop = FromData(data.crop),
+          .auto_crop = FromData(data.auto_crop),
+          .cameras = FromData(data.cameras),
+          .backup_cameras = FromData(data.backup_cameras)};
+}
+
+// Checked before a cv::Mat header is created over the bytes
+bool IsValid(const MatData &data) {
+  if (data.bytes.empty()) {
+    return true;
+  }
+  if (data.rows <= 0 || data.cols <= 0 || data.type < 0 ||
+      data.type != CV_MAT_TYPE(data.type)) {
+    return false;
+  }
+  const auto elem_size = static_cast<std::uint64_t>(CV_ELEM_SIZE(data.type));
+  const auto num_elems = static_cast<std::uint64_t>(data.rows) *
+                         static_cast<std::uint64_t>(data.cols);
+  return data.bytes.size() % elem_size == 0 &&
+         data.bytes.size() / elem_size == num_elems;
+}
+
+// One descriptor per keypoint, the matches index both of them
+bool IsValid(const ImageData &data) {
+  return IsValid(data.descriptors) &&
+         (data.descriptors.bytes.empty() ||
+          data.descriptors.rows == static_cast<int>(data.keypoints.size()));
+}
+
+// A float or double matrix of the given size, as used by cv::detail
+bool IsValidCameraMat(const MatData &data, int rows, int cols) {
+  return !data.bytes.empty() && IsValid(data) && data.rows == rows &&
+         data.cols == cols && (data.type == CV_32F || data.type == CV_64F);
+}
+
+// The component picks the pano images by their index in the pano, one camera
+// for each of them
+bool IsValid(const CamerasData &data, int num_pano_images) {
+  auto is_pano_image = [num_pano_images](int index) {
+    return index >= 0 && index < num_pano_images;
+  };
+  return data.cameras.size() == data.component.size() &&
+         std::all_of(data.component.begin(), data.component.end(),
+                     is_pano_image) &&
+         std::all_of(data.cameras.begin(), data.cameras.end(),
+                     [](const CameraData &camera) {
+                       return IsValidCameraMat(camera.rotation, 3, 3) &&
+                              IsValidCameraMat(camera.translation, 3, 1);
+                     });
+}
+
+bool IsValid(const Session &session) {
+  const int num_images = static_cast<int>(session.images.size());
+  auto is_image = [num_images](int img_id) {
+    return img_id >= 0 && img_id < num_images;
+  };
+  auto is_keypoint = [&session](int img_id, int keypoint_id) {
+    return keypoint_id >= 0 &&
+           keypoint_id <
+               static_cast<int>(session.images[img_id].keypoints.size());
+  };
+  auto is_valid_match = [&is_image, &is_keypoint](const MatchData &match) {
+    return is_image(match.id1) && is_image(match.id2) &&
+           std::all_of(match.matches.begin(), match.matches.end(),
+                       [&match, &is_keypoint](const DMatchData &dmatch) {
+                         return is_keypoint(match.id1, dmatch.query_idx) &&
+                                is_keypoint(match.id2, dmatch.train_idx);
+                       });
+  };
+  auto is_valid_pano = [&is_image](const PanoData &pano) {
+    const int num_pano_images = static_cast<int>(pano.ids.size());
+    return !pano.ids.empty() &&
+           std::all_of(pano.ids.begin(), pano.ids.end(), is_image) &&
+           (!pano.cameras || IsValid(*pano.cameras, num_pano_images)) &&
+           (!pano.backup_cameras ||
+            IsValid(*pano.backup_cameras, num_pano_images));
+  };
+  return std::all_of(session.images.begin(), session.images.end(),
+                     [](const ImageData &image) { return IsValid(image); }) &&
+         std::all_of(session.matches.begin(), session.matches.end(),
+                     is_valid_match) &&
+         std::all_of(session.panos.begin(), session.panos.end(),
+                     is_valid_pano);
+}
+
+}  // namespace
+
+utils::Expected<void, std::string> SaveSession(
+    const std::filesystem::path &path, const StitcherData &data) {
+  Session session;
+  for (const auto &image : data.images) {
+    if (image.IsInMemory()) {
+      return utils::Unexpected<std::string>(fmt::format(
+          "Image {} was loaded from memory", image.GetPath().string()));
+    }
+    session.images.push_back(ToData(image));
+  }
+  for (const auto &match : data.matches) {
+    session.matches.push_back(ToData(match));
+  }
+  for (const auto &pano : data.panos) {
+    session.panos.push_back(ToData(pano));
+  }
+
+  if (auto error = utils::serialize::SerializeWithVersion(path, session);
+      error) {
+    return utils::Unexpected<std::string>(error.message());
+  }
+  spdlog::info("Saved session with {} images to {}", data.images.size(),
+               path.string());
+  return {};
+}
+
+utils::Expected<StitcherData, std::string> LoadSession(
+    const std::filesystem::path &path) {
+  auto [status, session] =
+      utils::serialize::DeserializeWithVersion<Session>(path);
+  switch (status) {
+    case utils::serialize::DeserializeStatus::kSuccess:
+      break;
+    case utils::serialize::DeserializeStatus::kNoSuchFile:
+      return utils::Unexpected<std::string>("No such file");
+    case utils::serialize::DeserializeStatus::kBreakingChange:
+      return utils::Unexpected<std::string>(
+          "Saved by an incompatible version of Xpano");
+    case utils::serialize::DeserializeStatus::kUnknownError:
+      return utils::Unexpected<std::string>("Unknown error");
+  }
+  if (!IsValid(session)) {
+    return utils::Unexpected<std::string>("Corrupted session file");
+  }
+
+  StitcherData data;
+  for (const auto &image : session.images) {
+    data.images.push_back(FromData(image));
+  }
+  for (const auto &match : session.matches) {
+    data.matches.push_back(FromData(match));
+  }
+  for (const auto &pano : session.panos) {
+    data.panos.push_back(FromData(pano));
+  }
+  spdlog::info("Opened session with {} images from {}", data.images.size(),
+               path.string());
+  return data;
+}
+
+}  // namespace xpano::pipeline
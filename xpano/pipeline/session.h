@@ -0,0 +1,25 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+#include "xpano/pipeline/stitcher_pipeline.h"
+#include "xpano/utils/expected.h"
+
+namespace xpano::pipeline {
+
+// Saves the loaded images with their thumbnails, previews and keypoints, the
+// matches and the panos with their cameras and crops. Images loaded from
+// memory can't be saved.
+utils::Expected<void, std::string> SaveSession(
+    const std::filesystem::path &path, const StitcherData &data);
+
+// Restores the data without loading and matching the images again, the image
+// files are checked only once their full resolution is needed
+utils::Expected<StitcherData, std::string> LoadSession(
+    const std::filesystem::path &path);
+
+}  // namespace xpano::pipeline
@@ -5,11 +5,20 @@
 #include "xpano/pipeline/stitcher_pipeline.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <exception>
 #include <filesystem>
+#include <fstream>
+#include <functional>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -20,14 +29,26 @@
 
 #include "xpano/algorithm/algorithm.h"
 #include "xpano/algorithm/image.h"
+#include "xpano/algorithm/live_canvas.h"
 #include "xpano/algorithm/progress.h"
 #include "xpano/algorithm/stitcher.h"
 #include "xpano/constants.h"
 #include "xpano/pipeline/options.h"
+#include "xpano/pipeline/session.h"
+#include "xpano/utils/budget.h"
+#include "xpano/utils/dzi.h"
 #include "xpano/utils/exiv2.h"
+#include "xpano/utils/fmt.h"
 #include "xpano/utils/future.h"
+#include "xpano/utils/jpeg.h"
+#include "xpano/utils/metrics.h"
 #include "xpano/utils/opencv.h"
+#include "xpano/utils/path.h"
+#include "xpano/utils/png.h"
+#include "xpano/utils/task_counter.h"
 #include "xpano/utils/threadpool.h"
+#include "xpano/utils/tiff.h"
+#include "xpano/utils/trace.h"
 #include "xpano/utils/vec_opencv.h"
 
 namespace xpano::pipeline {
@@ -65,9 +86,63 @@ std::vector<int> CompressionParameters(const CompressionOptions &options) {
 }
 
 template <typename TFutureType, RunTraits run>
-auto MakeTask() -> std::conditional_t<run == RunTraits::kReturnFuture,
-                                      Task<TFutureType>, Task<GenericFuture>> {
-  return {.progress = std::make_unique<ProgressMonitor>()};
+auto MakeTask(const std::function<void()> &notifier = {})
+    -> std::conditional_t<run == RunTraits::kReturnFuture, Task<TFutureType>,
+                          Task<GenericFuture>> {
+  auto progress = std::make_unique<ProgressMonitor>();
+  if (notifier) {
+    progress->SetListener(notifier);
+  }
+  return {.progress = std::move(progress)};
+}
+
+// Counts a submitted task until it is destroyed
+class RunningTask {
+ public:
+  explicit RunningTask(utils::mt::TaskCounter *tasks) : tasks_(tasks) {
+    tasks_->Add();
+  }
+  ~RunningTask() { tasks_->Done(); }
+
+  RunningTask(const RunningTask &) = delete;
+  RunningTask &operator=(const RunningTask &) = delete;
+  RunningTask(RunningTask &&) = delete;
+  RunningTask &operator=(RunningTask &&) = delete;
+
+ private:
+  utils::mt::TaskCounter *tasks_;
+};
+
+// Returns false if cancelled before all of the tasks finished
+bool WaitUntilIdle(utils::mt::TaskCounter *tasks,
+                   const ProgressMonitor &progress) {
+  while (!progress.IsCancelled()) {
+    if (tasks->WaitUntilIdle(kTaskCancellationTimeout)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The notifier runs only after the future is ready, so that the woken up
+// caller finds the task in GetReadyTask()
+template <typename TFunc>
+auto SubmitAndNotify(utils::mt::Threadpool *pool,
+                     const std::function<void()> &notifier,
+                     std::shared_ptr<RunningTask> running, TFunc &&func)
+    -> std::future<std::invoke_result_t<TFunc>> {
+  using TResult = std::invoke_result_t<TFunc>;
+  auto work = std::make_shared<std::packaged_task<TResult()>>(
+      std::forward<TFunc>(func));
+  auto future = work->get_future();
+  pool->push_task([work, running = std::move(running), notifier]() mutable {
+    (*work)();
+    running.reset();
+    if (notifier) {
+      notifier();
+    }
+  });
+  return future;
 }
 
 enum class WaitStatus : std::uint8_t {
@@ -91,8 +166,78 @@ WaitStatus WaitWithCancellation(TFutureType *future,
   return WaitStatus::kReady;
 }
 
+// The subtasks of a cancelled task skip their work, they are waited for so
+// that they don't outlive the data they reference
+template <typename TFutureType>
+WaitStatus WaitForSubtasks(TFutureType *future, ProgressMonitor *progress) {
+  auto status = WaitWithCancellation(future, progress);
+  if (status == WaitStatus::kCancelled) {
+    future->wait();
+  }
+  return status;
+}
+
+// Encodes the image in memory with the Exif data included, returns
+// std::nullopt if there is no such encoder for the given format or if the
+// encoding was cancelled
+std::optional<std::vector<unsigned char>> Encode(
+    const cv::Mat &pano, const std::filesystem::path &path,
+    const CompressionOptions &options,
+    const std::optional<utils::exiv2::Exif> &exif, utils::mt::Threadpool *pool,
+    const utils::mt::CancelCheck &is_cancelled) {
+  if (utils::path::IsJpegExtension(path)) {
+    std::optional<std::vector<unsigned char>> encoded;
+    // Strips can't share the Huffman tables in these modes
+    if (!options.jpeg_progressive && !options.jpeg_optimize) {
+      encoded = utils::jpeg::EncodeParallel(
+          pano, CompressionParameters(options), pool, is_cancelled);
+    }
+    if (utils::mt::IsCancelled(is_cancelled)) {
+      return {};
+    }
+    if (!encoded) {
+      std::vector<unsigned char> buffer;
+      if (!cv::imencode(".jpg", pano, buffer,
+                        CompressionParameters(options))) {
+        return {};
+      }
+      encoded = std::move(buffer);
+    }
+    if (exif && !utils::jpeg::InsertExif(&*encoded, exif->blob)) {
+      spdlog::warn("Exif data too large, skipping metadata for {}",
+                   path.string());
+    }
+    return encoded;
+  }
+  if (utils::path::IsPngExtension(path)) {
+    return utils::png::EncodeParallel(pano, options.png_compression, pool,
+                                      is_cancelled);
+  }
+  if (utils::path::IsTiffExtension(path)) {
+    return utils::tiff::EncodeParallel(
+        pano, kDefaultTiffCompression, pool,
+        exif ? exif->tiff : utils::tiff::Metadata{}, is_cancelled);
+  }
+  return {};
+}
+
+bool WriteFile(const std::filesystem::path &path,
+               const std::vector<unsigned char> &data) {
+  std::ofstream file(path, std::ios::binary);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  file.write(reinterpret_cast<const char *>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+  return file.good();
+}
+
 ExportResult RunExportPipeline(cv::Mat pano, const ExportOptions &options,
-                               ProgressMonitor *progress) {
+                               ProgressMonitor *progress,
+                               utils::mt::Threadpool *pool,
+                               utils::metrics::Recorder *metrics = nullptr) {
+  const utils::trace::Scope scope("export");
+  if (progress->IsCancelled()) {
+    return ExportResult{options.pano_id};
+  }
   const int num_tasks = 2;
   progress->Reset(ProgressType::kExport, num_tasks);
 
@@ -101,38 +246,122 @@ ExportResult RunExportPipeline(cv::Mat pano, const ExportOptions &options,
     pano = pano(crop_rect);
   }
 
-  std::optional<std::filesystem::path> export_path;
-  if (cv::imwrite(options.export_path.string(), pano,
-                  CompressionParameters(options.compression))) {
-    export_path = options.export_path;
+  utils::metrics::ScopedStage stage(metrics, "exif");
+  auto pano_size = utils::ToIntVec(pano.size);
+  std::optional<utils::exiv2::Exif> exif;
+  if (utils::exiv2::Enabled()) {
+    exif = utils::exiv2::BuildExif(options.metadata_path, options.export_path,
+                                   pano_size);
   }
   progress->NotifyTaskDone();
-  if (export_path && utils::exiv2::Enabled()) {
-    auto pano_size = utils::ToIntVec(pano.size);
-    utils::exiv2::CreateExif(options.metadata_path, *export_path, pano_size);
+
+  stage.Next("encode");
+  auto is_cancelled = [progress]() { return progress->IsCancelled(); };
+  std::optional<std::filesystem::path> export_path;
+  if (utils::path::IsPyramidTiffExtension(options.export_path)) {
+    // Streamed to the file, the overviews would not fit into memory otherwise
+    if (utils::tiff::WritePyramid(
+            pano, options.export_path, kDefaultTiffCompression, pool,
+            exif ? exif->tiff : utils::tiff::Metadata{}, is_cancelled)) {
+      export_path = options.export_path;
+    }
+  } else if (utils::path::IsDeepZoomExtension(options.export_path)) {
+    if (utils::dzi::WritePyramid(pano, options.export_path,
+                                 CompressionParameters(options.compression),
+                                 pool, is_cancelled)) {
+      export_path = options.export_path;
+    }
+  } else if (auto encoded = Encode(pano, options.export_path,
+                                   options.compression, exif, pool,
+                                   is_cancelled);
+             encoded) {
+    if (WriteFile(options.export_path, *encoded)) {
+      export_path = options.export_path;
+    }
+  } else if (progress->IsCancelled()) {
+    // Nothing is written for a cancelled export
+  } else if (cv::imwrite(options.export_path.string(), pano,
+                         CompressionParameters(options.compression))) {
+    export_path = options.export_path;
+    // Formats without an in-memory encoder get the metadata written afterwards
+    if (exif) {
+      utils::exiv2::CreateExif(options.metadata_path, *export_path, pano_size);
+    }
   }
   progress->NotifyTaskDone();
   return ExportResult{options.pano_id, export_path};
 }
 
+std::optional<std::vector<unsigned char>> EncodeInMemory(
+    cv::Mat pano, const std::string &extension,
+    const std::optional<std::filesystem::path> &metadata_path,
+    const CompressionOptions &options,
+    const std::optional<utils::RectRRf> &crop, utils::mt::Threadpool *pool,
+    utils::metrics::Recorder *metrics, ProgressMonitor *progress) {
+  const utils::trace::Scope scope("encode_in_memory");
+  if (crop) {
+    pano = pano(utils::GetCvRect(pano, *crop));
+  }
+  // Only the extension of the name is used to pick the encoder
+  const std::filesystem::path name = "pano" + extension;
+  utils::metrics::ScopedStage stage(metrics, "exif");
+  std::optional<utils::exiv2::Exif> exif;
+  if (utils::exiv2::Enabled()) {
+    exif = utils::exiv2::BuildExif(metadata_path, name,
+                                   utils::ToIntVec(pano.size));
+  }
+  stage.Next("encode");
+  auto is_cancelled = [progress]() { return progress->IsCancelled(); };
+  if (auto encoded = Encode(pano, name, options, exif, pool, is_cancelled);
+      encoded) {
+    return encoded;
+  }
+  if (progress->IsCancelled()) {
+    return {};
+  }
+  std::vector<unsigned char> buffer;
+  if (!cv::imencode(extension, pano, buffer, CompressionParameters(options))) {
+    spdlog::error("Failed to encode the pano as {}", extension);
+    return {};
+  }
+  return buffer;
+}
+
+std::vector<algorithm::Image> ToImages(
+    const std::vector<std::filesystem::path> &inputs) {
+  std::vector<algorithm::Image> images;
+  images.reserve(inputs.size());
+  for (const auto &input : inputs) {
+    images.emplace_back(input);
+  }
+  return images;
+}
+
 std::vector<algorithm::Image> RunLoadingPipeline(
-    const std::vector<std::filesystem::path> &inputs,
-    const LoadingOptions &options, bool compute_keypoints,
-    ProgressMonitor *progress, utils::mt::Threadpool *pool) {
+    const std::vector<algorithm::Image> &inputs, const LoadingOptions &options,
+    bool compute_keypoints, ProgressMonitor *progress,
+    utils::mt::Threadpool *pool, utils::metrics::Recorder *metrics = nullptr) {
   const int num_tasks = static_cast<int>(inputs.size());
   progress->Reset(ProgressType::kDetectingKeypoints, num_tasks);
   utils::mt::MultiFuture<algorithm::Image> loading_future;
-  for (const auto &input : inputs) {
+  for (int image_id = 0; image_id < num_tasks; image_id++) {
     loading_future.push_back(
-        pool->submit([options, input, compute_keypoints, progress]() {
-          algorithm::Image image(input);
+        pool->submit([options, input = inputs[image_id], image_id,
+                      compute_keypoints, progress, metrics]() {
+          if (progress->IsCancelled()) {
+            return input;
+          }
+          const utils::trace::Scope scope("load_image", {.image_id = image_id});
+          auto image = input;
           image.Load({.preview_longer_side = options.preview_longer_side,
-                      .compute_keypoints = compute_keypoints});
+                      .compute_keypoints = compute_keypoints,
+                      .metrics = metrics,
+                      .metrics_label = std::to_string(image_id)});
           progress->NotifyTaskDone();
           return image;
         }));
   }
-  if (auto status = WaitWithCancellation(&loading_future, progress);
+  if (auto status = WaitForSubtasks(&loading_future, progress);
       status == WaitStatus::kCancelled) {
     return {};
   }
@@ -149,7 +378,8 @@ std::vector<algorithm::Image> RunLoadingPipeline(
 StitcherData RunMatchingPipeline(std::vector<algorithm::Image> images,
                                  const MatchingOptions &options,
                                  ProgressMonitor *progress,
-                                 utils::mt::Threadpool *pool) {
+                                 utils::mt::Threadpool *pool,
+                                 utils::metrics::Recorder *metrics) {
   if (images.empty()) {
     return {};
   }
@@ -177,20 +407,29 @@ StitcherData RunMatchingPipeline(std::vector<algorithm::Image> images,
     for (int i = std::max(0, j - num_neighbors); i < j; i++) {
       matches_future.push_back(
           pool->submit([i, j, left = images[i], right = images[j],
-                        match_conf = options.match_conf, progress]() {
+                        match_conf = options.match_conf, progress, metrics]() {
+            if (progress->IsCancelled()) {
+              return algorithm::Match{.id1 = i, .id2 = j};
+            }
+            const utils::trace::Scope scope("match_pair", {.image_id = j});
+            const utils::metrics::ScopedStage stage(metrics, "match",
+                                                    fmt::format("{}-{}", i, j));
             auto match = algorithm::MatchImages(i, j, left, right, match_conf);
             progress->NotifyTaskDone();
             return match;
           }));
     }
   }
-  if (auto status = WaitWithCancellation(&matches_future, progress);
+  if (auto status = WaitForSubtasks(&matches_future, progress);
       status == WaitStatus::kCancelled) {
     return {};
   }
   auto matches = matches_future.get();
 
+  const utils::trace::Scope scope("find_panos");
+  utils::metrics::ScopedStage stage(metrics, "find_panos");
   auto panos = FindPanos(matches, options.match_threshold, options.min_shift);
+  stage.End();
   progress->NotifyTaskDone();
   return StitcherData{images, matches, panos};
 }
@@ -201,6 +440,7 @@ int StitchTaskCount(const StitchingOptions &options, int num_images,
          algorithm::StitchTasksCount(
              num_images, cameras_precomputed) +  // Stitching subtasks
          (options.export_path ? 1 : 0) +         // Export
+         (options.encode_extension ? 1 : 0) +    // Encode in memory
          1 +                                     // Auto crop
          (options.full_res ? num_images : 1);  // Load full res / load previews
 }
@@ -209,26 +449,50 @@ StitchingResult RunStitchingPipeline(
     const algorithm::Pano &pano, const std::vector<algorithm::Image> &images,
     const StitchingOptions &options, ProgressMonitor *progress,
     // NOLINTNEXTLINE(bugprone-easily-swappable-parameters): fixme
-    utils::mt::Threadpool *pool, utils::mt::Threadpool *multiblend_pool) {
+    utils::mt::Threadpool *pool, utils::mt::Threadpool *multiblend_pool,
+    algorithm::LiveCanvas *live_canvas = nullptr) {
+  const utils::trace::Scope scope("stitch_pano", {.pano_id = options.pano_id});
+  if (progress->IsCancelled()) {
+    return {};
+  }
   const int num_images = static_cast<int>(pano.ids.size());
   const int num_tasks =
       StitchTaskCount(options, num_images, pano.cameras.has_value());
   progress->Reset(ProgressType::kLoadingImages, num_tasks);
+  utils::metrics::Recorder metrics;
   std::vector<cv::Mat> imgs;
   if (options.full_res) {
     utils::mt::MultiFuture<cv::Mat> imgs_future;
     for (const auto &img_id : pano.ids) {
-      imgs_future.push_back(pool->submit([&image = images[img_id], progress]() {
-        auto full_res_image = image.GetFullRes();
-        progress->NotifyTaskDone();
-        return full_res_image;
-      }));
+      imgs_future.push_back(
+          pool->submit([&image = images[img_id], img_id,
+                        pano_id = options.pano_id, progress, &metrics]() {
+            if (progress->IsCancelled()) {
+              return cv::Mat{};
+            }
+            const utils::trace::Scope scope(
+                "load_full_res", {.pano_id = pano_id, .image_id = img_id});
+            const utils::metrics::ScopedStage stage(&metrics, "decode",
+                                                    std::to_string(img_id));
+            auto full_res_image = image.GetFullRes();
+            progress->NotifyTaskDone();
+            return full_res_image;
+          }));
     }
-    if (auto status = WaitWithCancellation(&imgs_future, progress);
+    if (auto status = WaitForSubtasks(&imgs_future, progress);
         status == WaitStatus::kCancelled) {
       return {};
     }
     imgs = imgs_future.get();
+    if (std::any_of(imgs.begin(), imgs.end(),
+                    [](const cv::Mat &img) { return img.empty(); })) {
+      return StitchingResult{
+          .pano_id = options.pano_id,
+          .full_res = options.full_res,
+          .status = algorithm::stitcher::Status::kErrInputChanged,
+          .metrics = metrics.Snapshot(),
+      };
+    }
   } else {
     for (const int img_id : pano.ids) {
       imgs.push_back(images[img_id].GetPreview());
@@ -241,7 +505,9 @@ StitchingResult RunStitchingPipeline(
       algorithm::Stitch(imgs, pano.cameras, options.stitch_algorithm,
                         {.return_pano_mask = true,
                          .threads_for_multiblend = multiblend_pool,
-                         .progress_monitor = progress});
+                         .progress_monitor = progress,
+                         .metrics = &metrics,
+                         .live_canvas = live_canvas});
   progress->NotifyTaskDone();
 
   if (!IsSuccess(status)) {
@@ -249,55 +515,456 @@ StitchingResult RunStitchingPipeline(
         .pano_id = options.pano_id,
         .full_res = options.full_res,
         .status = status,
+        .metrics = metrics.Snapshot(),
     };
   }
 
   progress->SetTaskType(ProgressType::kAutoCrop);
+  utils::metrics::ScopedStage stage(&metrics, "crop");
   auto auto_crop = algorithm::FindLargestCrop(mask);
+  stage.End();
   progress->NotifyTaskDone();
 
+  std::optional<std::filesystem::path> metadata_path;
+  if (const auto &first_image = images[pano.ids[0]];
+      options.metadata.copy_from_first_image && !first_image.IsInMemory()) {
+    metadata_path = first_image.GetPath();
+  }
+
+  std::optional<std::vector<unsigned char>> encoded;
+  if (options.encode_extension) {
+    progress->SetTaskType(ProgressType::kExport);
+    encoded = EncodeInMemory(result, *options.encode_extension, metadata_path,
+                             options.compression, options.export_crop, pool,
+                             &metrics, progress);
+    progress->NotifyTaskDone();
+  }
+
   std::optional<std::filesystem::path> export_path;
   if (options.export_path) {
-    std::optional<std::filesystem::path> metadata_path;
-    if (options.metadata.copy_from_first_image) {
-      const auto &first_image = images[pano.ids[0]];
-      metadata_path = first_image.GetPath();
-    }
-
     export_path = RunExportPipeline(result,
                                     {.export_path = *options.export_path,
                                      .metadata_path = metadata_path,
                                      .compression = options.compression,
                                      .crop = options.export_crop},
-                                    progress)
+                                    progress, pool, &metrics)
                       .export_path;
   }
 
-  return StitchingResult{options.pano_id, options.full_res, status, result,
-                         auto_crop,       export_path,      mask,   cameras};
+  return StitchingResult{options.pano_id, options.full_res, status,
+                         result,          auto_crop,        export_path,
+                         mask,            cameras,          std::move(encoded),
+                         metrics.Snapshot()};
+}
+
+std::int64_t EstimateMemoryMiB(const algorithm::Pano &pano,
+                               const std::vector<algorithm::Image> &images) {
+  std::int64_t pixels = 0;
+  for (const int img_id : pano.ids) {
+    pixels += images[img_id].GetFullSize().area();
+  }
+  return pixels * kBatchBytesPerInputPixel / (1024 * 1024);
+}
+
+std::int64_t EstimatePreviewMemoryMiB(
+    const algorithm::Pano &pano, const std::vector<algorithm::Image> &images) {
+  std::int64_t pixels = 0;
+  for (const int img_id : pano.ids) {
+    pixels += images[img_id].GetPreview().size().area();
+  }
+  return pixels * kBatchBytesPerInputPixel / (1024 * 1024);
+}
+
+int MaxBatchJobs(const BatchOptions &options,
+                 const utils::mt::Threadpool &pool) {
+  // Running jobs block their threads while waiting for their subtasks, keep
+  // at least half of the threads free to process them
+  const int max_jobs =
+      std::max(1, static_cast<int>(pool.get_thread_count()) / 2);
+  if (options.max_jobs > 0) {
+    return std::min(options.max_jobs, max_jobs);
+  }
+  return max_jobs;
+}
+
+// Keeps the budget alive until the last lease is returned, the pool destroys
+// the finished tasks only after their futures are ready
+struct BatchSlot {
+  std::shared_ptr<utils::mt::Budget> budget;
+  utils::mt::Lease lease;
+};
+
+// Admits jobs to the pool while they fit into the budget, each job gets its
+// own progress monitor so that it can be cancelled together with the batch
+template <typename TResult>
+class BatchScheduler {
+ public:
+  BatchScheduler(const BatchOptions &options, ProgressMonitor *progress,
+                 utils::mt::Threadpool *pool)
+      : budget_(std::make_shared<utils::mt::Budget>(
+            MaxBatchJobs(options, *pool), options.memory_budget_mib)),
+        progress_(progress),
+        pool_(pool) {}
+
+  // Waits for the budget, returns false if the batch was cancelled first
+  template <typename TJob>
+  bool Submit(std::int64_t cost, TJob job) {
+    std::optional<utils::mt::Lease> lease;
+    while (!lease && !progress_->IsCancelled()) {
+      lease = budget_->Acquire(cost, kTaskCancellationTimeout);
+    }
+    if (!lease) {
+      return false;
+    }
+
+    job_progress_.push_back(std::make_unique<ProgressMonitor>());
+    futures_.push_back(pool_->submit(
+        [job = std::move(job),
+         slot = std::make_shared<BatchSlot>(
+             BatchSlot{budget_, std::move(*lease)}),
+         job_progress = job_progress_.back().get(),
+         progress = progress_]() {
+          auto result = job(job_progress);
+          progress->NotifyTaskDone();
+          return result;
+        }));
+    return true;
+  }
+
+  utils::mt::MultiFuture<TResult> Finish() {
+    if (WaitWithCancellation(&futures_, progress_) == WaitStatus::kCancelled) {
+      for (auto &monitor : job_progress_) {
+        monitor->Cancel();
+      }
+      futures_.wait();
+    }
+    return std::move(futures_);
+  }
+
+ private:
+  std::shared_ptr<utils::mt::Budget> budget_;
+  ProgressMonitor *progress_;
+  utils::mt::Threadpool *pool_;
+  std::vector<std::unique_ptr<ProgressMonitor>> job_progress_;
+  utils::mt::MultiFuture<TResult> futures_;
+};
+
+std::vector<StitchingResult> RunBatchPipeline(
+    const StitcherData &data, const std::vector<StitchingOptions> &options,
+    const BatchOptions &batch_options, ProgressMonitor *progress,
+    // NOLINTNEXTLINE(bugprone-easily-swappable-parameters): fixme
+    utils::mt::Threadpool *pool, utils::mt::Threadpool *multiblend_pool) {
+  progress->Reset(ProgressType::kStitchingPano,
+                  static_cast<int>(options.size()));
+  BatchScheduler<StitchingResult> scheduler(batch_options, progress, pool);
+
+  for (const auto &job_options : options) {
+    const auto &pano = data.panos[job_options.pano_id];
+    const auto cost = EstimateMemoryMiB(pano, data.images);
+    auto job = [&pano, &images = data.images, job_options, pool,
+                multiblend_pool](ProgressMonitor *job_progress) {
+      auto result = RunStitchingPipeline(pano, images, job_options,
+                                         job_progress, pool, multiblend_pool);
+      result.pano.reset();
+      result.mask.reset();
+      return result;
+    };
+    if (!scheduler.Submit(cost, std::move(job))) {
+      break;
+    }
+    spdlog::info("Stitching pano {} ({} images, ~{} MiB)", job_options.pano_id,
+                 pano.ids.size(), cost);
+  }
+
+  auto jobs_future = scheduler.Finish();
+  std::vector<StitchingResult> results;
+  for (std::size_t i = 0; i < jobs_future.size(); i++) {
+    try {
+      results.push_back(jobs_future[i].get());
+    } catch (const std::exception &e) {
+      spdlog::error("Failed to stitch pano {}: {}", options[i].pano_id,
+                    e.what());
+    }
+  }
+  return results;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// Returns false if the directory of the job's output can't be created
+bool CreateOutputDirectory(const BatchJob &job, BatchJobResult *result) {
+  if (!job.stitching.export_path) {
+    return true;
+  }
+  const auto output_dir = job.stitching.export_path->parent_path();
+  std::error_code error;
+  std::filesystem::create_directories(output_dir, error);
+  if (error) {
+    result->error = fmt::format("Failed to create the output directory {}: {}",
+                                output_dir.string(), error.message());
+    return false;
+  }
+  return true;
+}
+
+// Returns false if some of the images failed to load
+bool LoadJobImages(const BatchJob &job, ProgressMonitor *progress,
+                   utils::mt::Threadpool *pool,
+                   std::vector<algorithm::Image> *images,
+                   BatchJobResult *result) {
+  const auto loading_start = std::chrono::steady_clock::now();
+  auto inputs = ToImages(job.inputs);
+  inputs.insert(inputs.end(), job.images.begin(), job.images.end());
+  const auto num_inputs = inputs.size();
+  try {
+    *images = RunLoadingPipeline(
+        inputs,
+        {.preview_longer_side = job.stitching.full_res
+                                    ? kDefaultPreviewLongerSide
+                                    : kMaxImageSizeForCLI},
+        /*compute_keypoints=*/false, progress, pool);
+  } catch (const std::exception &e) {
+    result->error = e.what();
+  }
+  result->num_images = static_cast<int>(images->size());
+  result->loading_seconds = SecondsSince(loading_start);
+
+  if (images->size() == num_inputs) {
+    return true;
+  }
+  if (progress->IsCancelled()) {
+    result->error = "Cancelled";
+  } else if (result->error.empty()) {
+    result->error = fmt::format("Failed to load {} of {} images",
+                                num_inputs - images->size(), num_inputs);
+  }
+  return false;
+}
+
+BatchJobResult StitchJobImages(
+    const std::vector<algorithm::Image> &images,
+    const StitchingOptions &options, BatchJobResult result,
+    ProgressMonitor *progress,
+    // NOLINTNEXTLINE(bugprone-easily-swappable-parameters): fixme
+    utils::mt::Threadpool *pool, utils::mt::Threadpool *multiblend_pool) {
+  const auto pano = algorithm::SinglePano(static_cast<int>(images.size()));
+  const auto stitching_start = std::chrono::steady_clock::now();
+  auto stitched = RunStitchingPipeline(pano, images, options, progress, pool,
+                                       multiblend_pool);
+  result.stitching_seconds = SecondsSince(stitching_start);
+  if (progress->IsCancelled()) {
+    result.error = "Cancelled";
+    return result;
+  }
+  result.status = stitched.status;
+  result.export_path = stitched.export_path;
+  result.encoded = std::move(stitched.encoded);
+  if (!algorithm::stitcher::IsSuccess(stitched.status)) {
+    result.error = algorithm::ToString(stitched.status);
+  } else if (options.export_path && !stitched.export_path) {
+    result.error = "Failed to export";
+  } else if (options.encode_extension && !result.encoded) {
+    result.error = "Failed to encode";
+  }
+  return result;
+}
+
+// The images of a job are loaded on the coordinating thread while the
+// previous jobs are stitching, the job is then queued with the memory
+// estimate based on the full resolution image sizes
+std::vector<BatchJobResult> RunBatchJobsPipeline(
+    const std::vector<BatchJob> &jobs, const BatchOptions &batch_options,
+    ProgressMonitor *progress,
+    // NOLINTNEXTLINE(bugprone-easily-swappable-parameters): fixme
+    utils::mt::Threadpool *pool, utils::mt::Threadpool *multiblend_pool) {
+  progress->Reset(ProgressType::kStitchingPano, static_cast<int>(jobs.size()));
+  BatchScheduler<BatchJobResult> scheduler(batch_options, progress, pool);
+
+  std::vector<BatchJobResult> results;
+  std::vector<int> submitted_ids;
+  for (int job_id = 0; job_id < jobs.size(); job_id++) {
+    if (progress->IsCancelled()) {
+      break;
+    }
+    const auto &job = jobs[job_id];
+    BatchJobResult result;
+    result.job_id = job_id;
+
+    ProgressMonitor loading_progress;
+    std::vector<algorithm::Image> images;
+    if (!CreateOutputDirectory(job, &result) ||
+        !LoadJobImages(job, &loading_progress, pool, &images, &result)) {
+      results.push_back(std::move(result));
+      progress->NotifyTaskDone();
+      continue;
+    }
+
+    const auto cost = EstimateMemoryMiB(
+        algorithm::SinglePano(static_cast<int>(images.size())), images);
+    auto stitch = [images = std::move(images), options = job.stitching,
+                   loaded = result, pool,
+                   multiblend_pool](ProgressMonitor *job_progress) {
+      return StitchJobImages(images, options, loaded, job_progress, pool,
+                             multiblend_pool);
+    };
+    if (!scheduler.Submit(cost, std::move(stitch))) {
+      break;
+    }
+    spdlog::info("Stitching job {} ({} images, ~{} MiB)", job_id,
+                 result.num_images, cost);
+    submitted_ids.push_back(job_id);
+  }
+
+  auto jobs_future = scheduler.Finish();
+  for (std::size_t i = 0; i < jobs_future.size(); i++) {
+    try {
+      results.push_back(jobs_future[i].get());
+    } catch (const std::exception &e) {
+      auto &result = results.emplace_back();
+      result.job_id = submitted_ids[i];
+      result.error = e.what();
+    }
+  }
+
+  std::vector<bool> finished(jobs.size(), false);
+  for (const auto &result : results) {
+    finished[result.job_id] = true;
+  }
+  for (int job_id = 0; job_id < jobs.size(); job_id++) {
+    if (!finished[job_id]) {
+      auto &result = results.emplace_back();
+      result.job_id = job_id;
+      result.error = "Cancelled";
+    }
+  }
+  std::sort(results.begin(), results.end(),
+            [](const auto &lhs, const auto &rhs) {
+              return lhs.job_id < rhs.job_id;
+            });
+  return results;
+}
+
+// Runs on its own thread from job_pool_, the admission is shared with the
+// other jobs through the budget
+BatchJobResult RunJobPipeline(
+    const BatchJob &job, ProgressMonitor *progress, utils::mt::Budget *budget,
+    // NOLINTNEXTLINE(bugprone-easily-swappable-parameters): fixme
+    utils::mt::Threadpool *pool, utils::mt::Threadpool *multiblend_pool) {
+  BatchJobResult result;
+  std::vector<algorithm::Image> images;
+  if (!LoadJobImages(job, progress, pool, &images, &result)) {
+    return result;
+  }
+
+  const auto cost = EstimateMemoryMiB(
+      algorithm::SinglePano(static_cast<int>(images.size())), images);
+  std::optional<utils::mt::Lease> lease;
+  while (!lease && !progress->IsCancelled()) {
+    lease = budget->Acquire(cost, kTaskCancellationTimeout);
+  }
+  if (!lease) {
+    result.error = "Cancelled";
+    return result;
+  }
+  return StitchJobImages(images, job.stitching, std::move(result), progress,
+                         pool, multiblend_pool);
 }
 
 }  // namespace
 
+std::int64_t MemoryMiB(const StitchingResult &result) {
+  std::size_t bytes = 0;
+  if (result.pano) {
+    bytes += result.pano->total() * result.pano->elemSize();
+  }
+  if (result.mask) {
+    bytes += result.mask->total() * result.mask->elemSize();
+  }
+  const std::size_t mib = 1024 * 1024;
+  return static_cast<std::int64_t>((bytes + mib - 1) / mib);
+}
+
 using ProgressType = algorithm::ProgressType;
 
+template <RunTraits run>
+StitcherPipeline<run>::StitcherPipeline(unsigned num_threads)
+    : pool_(std::max(2U, num_threads)),
+      multiblend_pool_(std::max(3U, num_threads) - 1) {}
+
+// The running tasks use the progress monitors owned by the queue
 template <RunTraits run>
 StitcherPipeline<run>::~StitcherPipeline() {
+  CancelSpeculation();
   Cancel();
+  background_pool_.wait_for_tasks();
+  pool_.wait_for_tasks();
+}
+
+template <RunTraits run>
+template <typename TFunc>
+auto StitcherPipeline<run>::SubmitInteractive(TFunc &&func)
+    -> std::future<std::invoke_result_t<TFunc>> {
+  // Counted before preempting, so that the speculative lane either sees the
+  // task or gets its attempt cancelled
+  auto running = std::make_shared<RunningTask>(&interactive_tasks_);
+  PreemptSpeculation();
+  return SubmitAndNotify(&pool_, notifier_, std::move(running),
+                         std::forward<TFunc>(func));
+}
+
+// Waits for the interactive tasks before starting, the ones queued later run
+// alongside it
+template <RunTraits run>
+template <typename TFunc>
+auto StitcherPipeline<run>::SubmitBackground(const ProgressMonitor *progress,
+                                             TFunc &&func)
+    -> std::future<std::invoke_result_t<TFunc>> {
+  return SubmitAndNotify(
+      &background_pool_, notifier_, nullptr,
+      [this, progress, func = std::forward<TFunc>(func)]() mutable {
+        WaitUntilIdle(&interactive_tasks_, *progress);
+        return func();
+      });
 }
 
 template <RunTraits run>
 void StitcherPipeline<run>::Cancel() {
+  for (auto &task : queue_) {
+    task.progress->Cancel();
+  }
+}
+
+template <RunTraits run>
+void StitcherPipeline<run>::Cancel(Lane lane) {
+  for (auto &task : queue_) {
+    if (task.lane == lane) {
+      task.progress->Cancel();
+    }
+  }
+}
+
+template <RunTraits run>
+void StitcherPipeline<run>::CancelCurrent() {
   if (!queue_.empty()) {
     queue_.back().progress->Cancel();
   }
-  pool_.purge();
+}
+
+template <RunTraits run>
+void StitcherPipeline<run>::SetNotifier(std::function<void()> notifier) {
+  notifier_ = std::move(notifier);
 }
 
 template <RunTraits run>
 void StitcherPipeline<run>::CancelAndWait() {
+  CancelSpeculation();
   Cancel();
   spdlog::info("Waiting for running tasks to finish...");
+  background_pool_.wait_for_tasks();
   pool_.wait_for_tasks();
   spdlog::info("Finished");
 }
@@ -309,17 +976,62 @@ auto StitcherPipeline<run>::RunLoading(
     const MatchingOptions &matching_options)
     -> std::conditional_t<run == RunTraits::kReturnFuture,
                           Task<std::future<StitcherData>>, void> {
+  return RunLoadingImages(ToImages(inputs), loading_options, matching_options);
+}
+
+template <RunTraits run>
+auto StitcherPipeline<run>::RunLoadingImages(
+    std::vector<algorithm::Image> inputs, const LoadingOptions &loading_options,
+    const MatchingOptions &matching_options)
+    -> std::conditional_t<run == RunTraits::kReturnFuture,
+                          Task<std::future<StitcherData>>, void> {
+  CancelSpeculation();
   Cancel();
-  auto task = MakeTask<std::future<StitcherData>, run>();
-
-  task.future = pool_.submit([this, loading_options, matching_options, inputs,
-                              progress = task.progress.get()]() {
-    auto images = RunLoadingPipeline(
-        inputs, loading_options,
-        /*compute_keypoints=*/matching_options.type == MatchingType::kAuto,
-        progress, &pool_);
-    return RunMatchingPipeline(images, matching_options, progress, &pool_);
-  });
+  auto task = MakeTask<std::future<StitcherData>, run>(notifier_);
+
+  task.future = SubmitInteractive(
+      [this, loading_options, matching_options, inputs = std::move(inputs),
+       progress = task.progress.get()]() {
+        const utils::trace::Scope scope("load_and_match");
+        utils::metrics::Recorder metrics;
+        auto images = RunLoadingPipeline(
+            inputs, loading_options,
+            /*compute_keypoints=*/matching_options.type == MatchingType::kAuto,
+            progress, &pool_, &metrics);
+        auto data = RunMatchingPipeline(images, matching_options, progress,
+                                        &pool_, &metrics);
+        data.metrics = metrics.Snapshot();
+        return data;
+      });
+
+  if constexpr (run == RunTraits::kReturnFuture) {
+    return task;
+  } else {
+    queue_.push_back(std::move(task));
+  }
+}
+
+template <RunTraits run>
+auto StitcherPipeline<run>::RunLoadingSession(
+    const std::filesystem::path &session_path)
+    -> std::conditional_t<run == RunTraits::kReturnFuture,
+                          Task<std::future<StitcherData>>, void> {
+  CancelSpeculation();
+  Cancel();
+  auto task = MakeTask<std::future<StitcherData>, run>(notifier_);
+
+  task.future =
+      SubmitInteractive([session_path, progress = task.progress.get()]() {
+        const utils::trace::Scope scope("load_session");
+        progress->Reset(ProgressType::kLoadingImages, 1);
+        auto data = LoadSession(session_path);
+        if (!data) {
+          throw std::runtime_error(fmt::format(
+              "Couldn't open {}: {}", session_path.string(), data.error()));
+        }
+        progress->NotifyTaskDone();
+        return *std::move(data);
+      });
 
   if constexpr (run == RunTraits::kReturnFuture) {
     return task;
@@ -333,15 +1045,26 @@ auto StitcherPipeline<run>::RunStitching(const StitcherData &data,
                                          const StitchingOptions &options)
     -> std::conditional_t<run == RunTraits::kReturnFuture,
                           Task<std::future<StitchingResult>>, void> {
-  Cancel();
-  auto task = MakeTask<std::future<StitchingResult>, run>();
+  auto task = MakeTask<std::future<StitchingResult>, run>(notifier_);
+  if (options.live_canvas) {
+    task.live_canvas = std::make_unique<algorithm::LiveCanvas>();
+  }
 
   auto pano = data.panos[options.pano_id];
-  task.future = pool_.submit([pano, &images = data.images, options,
-                              progress = task.progress.get(), this]() {
+  auto stitch = [pano, &images = data.images, options,
+                 progress = task.progress.get(),
+                 live_canvas = task.live_canvas.get(), this]() {
     return RunStitchingPipeline(pano, images, options, progress, &pool_,
-                                &multiblend_pool_);
-  });
+                                &multiblend_pool_, live_canvas);
+  };
+  // Exports finish even if a different pano is selected in the meantime
+  if (options.export_path) {
+    task.lane = Lane::kBackground;
+    task.future = SubmitBackground(task.progress.get(), std::move(stitch));
+  } else {
+    Cancel(Lane::kInteractive);
+    task.future = SubmitInteractive(std::move(stitch));
+  }
 
   if constexpr (run == RunTraits::kReturnFuture) {
     return task;
@@ -350,17 +1073,105 @@ auto StitcherPipeline<run>::RunStitching(const StitcherData &data,
   }
 }
 
+template <RunTraits run>
+auto StitcherPipeline<run>::RunBatchStitching(
+    const StitcherData &data, const std::vector<StitchingOptions> &options,
+    const BatchOptions &batch_options)
+    -> Task<std::future<std::vector<StitchingResult>>>
+  requires(run == RunTraits::kReturnFuture)
+{
+  auto task = MakeTask<std::future<std::vector<StitchingResult>>, run>();
+
+  task.future = batch_pool_.submit([&data, options, batch_options,
+                                    progress = task.progress.get(), this]() {
+    return RunBatchPipeline(data, options, batch_options, progress, &pool_,
+                            &multiblend_pool_);
+  });
+  return task;
+}
+
+template <RunTraits run>
+auto StitcherPipeline<run>::RunBatchJobs(const std::vector<BatchJob> &jobs,
+                                         const BatchOptions &batch_options)
+    -> Task<std::future<std::vector<BatchJobResult>>>
+  requires(run == RunTraits::kReturnFuture)
+{
+  auto task = MakeTask<std::future<std::vector<BatchJobResult>>, run>();
+
+  task.future = batch_pool_.submit([jobs, batch_options,
+                                    progress = task.progress.get(), this]() {
+    return RunBatchJobsPipeline(jobs, batch_options, progress, &pool_,
+                                &multiblend_pool_);
+  });
+  return task;
+}
+
+template <RunTraits run>
+auto StitcherPipeline<run>::RunJob(const BatchJob &job,
+                                   const BatchOptions &batch_options)
+    -> Task<std::future<BatchJobResult>>
+  requires(run == RunTraits::kReturnFuture)
+{
+  if (!job_pool_) {
+    const int max_jobs = MaxBatchJobs(batch_options, pool_);
+    job_pool_ = std::make_unique<utils::mt::Threadpool>(max_jobs);
+    job_budget_ = std::make_unique<utils::mt::Budget>(
+        max_jobs, batch_options.memory_budget_mib);
+  }
+  auto task = MakeTask<std::future<BatchJobResult>, run>();
+
+  task.future = job_pool_->submit([job, progress = task.progress.get(),
+                                   budget = job_budget_.get(), this]() {
+    return RunJobPipeline(job, progress, budget, &pool_, &multiblend_pool_);
+  });
+  return task;
+}
+
 template <RunTraits run>
 auto StitcherPipeline<run>::RunExport(cv::Mat pano,
                                       const ExportOptions &options)
     -> std::conditional_t<run == RunTraits::kReturnFuture,
                           Task<std::future<ExportResult>>, void> {
-  Cancel();
-  auto task = MakeTask<std::future<ExportResult>, run>();
+  auto task = MakeTask<std::future<ExportResult>, run>(notifier_);
+  task.lane = Lane::kBackground;
 
-  task.future = pool_.submit(
-      [pano = std::move(pano), options, progress = task.progress.get()]() {
-        return RunExportPipeline(pano, options, progress);
+  task.future = SubmitBackground(
+      task.progress.get(),
+      [pano = std::move(pano), options, progress = task.progress.get(),
+       pool = &pool_]() {
+        return RunExportPipeline(pano, options, progress, pool);
+      });
+
+  if constexpr (run == RunTraits::kReturnFuture) {
+    return task;
+  } else {
+    queue_.push_back(std::move(task));
+  }
+}
+
+template <RunTraits run>
+auto StitcherPipeline<run>::RunSavingSession(
+    const StitcherData &data, const std::filesystem::path &session_path)
+    -> std::conditional_t<run == RunTraits::kReturnFuture,
+                          Task<std::future<SaveSessionResult>>, void> {
+  auto task = MakeTask<std::future<SaveSessionResult>, run>(notifier_);
+  task.lane = Lane::kBackground;
+
+  // The copy shares the image buffers, the gui keeps editing its own data
+  task.future = SubmitBackground(
+      task.progress.get(),
+      [data, session_path, progress = task.progress.get()]() {
+        const utils::trace::Scope scope("save_session");
+        if (progress->IsCancelled()) {
+          return SaveSessionResult{session_path};
+        }
+        progress->Reset(ProgressType::kSavingSession, 1);
+        if (auto saved = SaveSession(session_path, data); !saved) {
+          throw std::runtime_error(fmt::format(
+              "Couldn't save {}: {}", session_path.string(), saved.error()));
+        }
+        progress->NotifyTaskDone();
+        return SaveSessionResult{session_path};
       });
 
   if constexpr (run == RunTraits::kReturnFuture) {
@@ -375,12 +1186,16 @@ auto StitcherPipeline<run>::RunInpainting(cv::Mat pano, cv::Mat pano_mask,
                                           const InpaintingOptions &options)
     -> std::conditional_t<run == RunTraits::kReturnFuture,
                           Task<std::future<InpaintingResult>>, void> {
-  Cancel();
-  auto task = MakeTask<std::future<InpaintingResult>, run>();
+  Cancel(Lane::kInteractive);
+  auto task = MakeTask<std::future<InpaintingResult>, run>(notifier_);
 
-  task.future =
-      pool_.submit([pano = std::move(pano), pano_mask = std::move(pano_mask),
-                    options, progress = task.progress.get()]() {
+  task.future = SubmitInteractive(
+      [pano = std::move(pano), pano_mask = std::move(pano_mask), options,
+       progress = task.progress.get()]() {
+        const utils::trace::Scope scope("inpaint");
+        if (progress->IsCancelled()) {
+          return InpaintingResult{};
+        }
         const int num_tasks = 3;
         progress->Reset(ProgressType::kInpainting, num_tasks);
 
@@ -402,6 +1217,142 @@ auto StitcherPipeline<run>::RunInpainting(cv::Mat pano, cv::Mat pano_mask,
   }
 }
 
+template <RunTraits run>
+void StitcherPipeline<run>::RunSpeculativeStitching(
+    const StitcherData &data, const StitchAlgorithmOptions &options) {
+  if (speculative_stop_) {
+    if (!speculative_stop_->IsCancelled() && options == speculative_options_) {
+      return;
+    }
+    speculative_stop_->Cancel();
+  }
+  PreemptSpeculation();
+  {
+    const std::lock_guard lock(speculative_mut_);
+    speculative_options_ = options;
+    speculative_previews_.clear();
+    speculative_memory_mib_ = 0;
+  }
+
+  // The panos can be modified by the caller in the meantime, the images not
+  speculative_stop_ = std::make_shared<ProgressMonitor>();
+  speculative_pool_.push_task([panos = data.panos, &images = data.images,
+                               options, stop = speculative_stop_, this]() {
+    RunSpeculativeLane(panos, images, options, *stop);
+  });
+}
+
+template <RunTraits run>
+void StitcherPipeline<run>::RunSpeculativeLane(
+    const std::vector<algorithm::Pano> &panos,
+    const std::vector<algorithm::Image> &images,
+    const StitchAlgorithmOptions &options, const ProgressMonitor &stop) {
+  const utils::trace::Scope scope("speculative_stitching");
+  const int num_panos = static_cast<int>(panos.size());
+  for (int pano_id = 0; pano_id < num_panos && !stop.IsCancelled();
+       pano_id++) {
+    const auto &pano = panos[pano_id];
+    const auto cost = EstimatePreviewMemoryMiB(pano, images);
+    {
+      const std::lock_guard lock(speculative_mut_);
+      if (speculative_memory_mib_ + cost > kSpeculativeMemoryBudgetMiB) {
+        spdlog::debug("Speculative stitching: skipping pano {}", pano_id);
+        continue;
+      }
+    }
+
+    std::optional<StitchingResult> result;
+    while (!result && !stop.IsCancelled()) {
+      ProgressMonitor attempt;
+      {
+        const std::lock_guard lock(speculative_mut_);
+        speculative_attempt_ = &attempt;
+      }
+      if (!interactive_tasks_.IsIdle()) {
+        attempt.Cancel();
+      } else {
+        try {
+          result = RunStitchingPipeline(
+              pano, images, {.pano_id = pano_id, .stitch_algorithm = options},
+              &attempt, &pool_, &multiblend_pool_);
+        } catch (const std::exception &e) {
+          spdlog::debug("Speculative stitching of pano {} failed: {}", pano_id,
+                        e.what());
+          result = StitchingResult{.pano_id = pano_id};
+        }
+      }
+      {
+        const std::lock_guard lock(speculative_mut_);
+        speculative_attempt_ = nullptr;
+      }
+      if (attempt.IsCancelled()) {
+        result.reset();
+        // Preempted, resumes once the interactive tasks are finished
+        WaitUntilIdle(&interactive_tasks_, stop);
+      }
+    }
+
+    if (!result || !result->pano) {
+      continue;
+    }
+    const std::lock_guard lock(speculative_mut_);
+    if (stop.IsCancelled()) {
+      return;
+    }
+    const auto memory_mib = MemoryMiB(*result);
+    speculative_memory_mib_ += memory_mib;
+    speculative_previews_[pano_id] = {.ids = pano.ids,
+                                      .result = std::move(*result),
+                                      .memory_mib = memory_mib};
+  }
+}
+
+template <RunTraits run>
+void StitcherPipeline<run>::PreemptSpeculation() {
+  const std::lock_guard lock(speculative_mut_);
+  if (speculative_attempt_ != nullptr) {
+    speculative_attempt_->Cancel();
+  }
+}
+
+template <RunTraits run>
+auto StitcherPipeline<run>::SpeculativeResult(
+    const algorithm::Pano &pano, const StitchAlgorithmOptions &options) const
+    -> std::optional<StitchingResult> {
+  if (pano.cameras) {
+    return {};
+  }
+  const std::lock_guard lock(speculative_mut_);
+  if (options != speculative_options_) {
+    return {};
+  }
+  for (const auto &[pano_id, preview] : speculative_previews_) {
+    if (preview.ids == pano.ids) {
+      return preview.result;
+    }
+  }
+  return {};
+}
+
+template <RunTraits run>
+void StitcherPipeline<run>::CancelSpeculation() {
+  if (speculative_stop_) {
+    speculative_stop_->Cancel();
+  }
+  PreemptSpeculation();
+  speculative_pool_.wait_for_tasks();
+  speculative_stop_.reset();
+
+  const std::lock_guard lock(speculative_mut_);
+  speculative_previews_.clear();
+  speculative_memory_mib_ = 0;
+}
+
+template <RunTraits run>
+bool StitcherPipeline<run>::HasTasks() const {
+  return !queue_.empty();
+}
+
 template <RunTraits run>
 ProgressReport StitcherPipeline<run>::Progress() const {
   if (queue_.empty()) {
@@ -410,6 +1361,14 @@ ProgressReport StitcherPipeline<run>::Progress() const {
   return queue_.back().progress->Report();
 }
 
+template <RunTraits run>
+const algorithm::LiveCanvas *StitcherPipeline<run>::CurrentCanvas() const {
+  if (queue_.empty()) {
+    return nullptr;
+  }
+  return queue_.back().live_canvas.get();
+}
+
 template <RunTraits run>
 auto StitcherPipeline<run>::GetReadyTask()
     -> std::optional<Task<GenericFuture>> {
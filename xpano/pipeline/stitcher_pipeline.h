@@ -5,11 +5,16 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <deque>
 #include <filesystem>
+#include <functional>
 #include <future>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <thread>
 #include <type_traits>
 #include <variant>
@@ -19,10 +24,15 @@
 
 #include "xpano/algorithm/algorithm.h"
 #include "xpano/algorithm/image.h"
+#include "xpano/algorithm/live_canvas.h"
 #include "xpano/algorithm/progress.h"
 #include "xpano/algorithm/stitcher.h"
+#include "xpano/constants.h"
 #include "xpano/pipeline/options.h"
+#include "xpano/utils/budget.h"
+#include "xpano/utils/metrics.h"
 #include "xpano/utils/rect.h"
+#include "xpano/utils/task_counter.h"
 #include "xpano/utils/threadpool.h"
 
 namespace xpano::pipeline {
@@ -31,10 +41,28 @@ struct StitchingOptions {
   int pano_id = 0;
   bool full_res = false;
   std::optional<std::filesystem::path> export_path;
+  // Encodes the pano into StitchingResult::encoded, e.g. ".jpg", ".png"
+  std::optional<std::string> encode_extension;
   std::optional<utils::RectRRf> export_crop;
   MetadataOptions metadata;
   CompressionOptions compression;
   StitchAlgorithmOptions stitch_algorithm;
+  // Fills Task::live_canvas while the images are composed
+  bool live_canvas = false;
+};
+
+struct BatchOptions {
+  // 0: derived from the number of threads
+  int max_jobs = 0;
+  std::int64_t memory_budget_mib = kDefaultBatchMemoryBudgetMiB;
+};
+
+// A single pano stitched from all of the inputs, the pano_id is ignored
+struct BatchJob {
+  std::vector<std::filesystem::path> inputs;
+  // Unloaded in-memory inputs, e.g. uploads, they follow the inputs
+  std::vector<algorithm::Image> images;
+  StitchingOptions stitching;
 };
 
 struct ExportOptions {
@@ -49,6 +77,8 @@ struct StitcherData {
   std::vector<algorithm::Image> images;
   std::vector<algorithm::Match> matches;
   std::vector<algorithm::Pano> panos;
+  // Loading and matching
+  utils::metrics::Stages metrics;
 };
 
 struct InpaintingResult {
@@ -67,6 +97,32 @@ struct StitchingResult {
   std::optional<std::filesystem::path> export_path;
   std::optional<cv::Mat> mask;
   std::optional<Cameras> cameras;
+  std::optional<std::vector<unsigned char>> encoded;
+  utils::metrics::Stages metrics;
+};
+
+// A preview stitched in the background, see RunSpeculativeStitching()
+struct SpeculativePreview {
+  // Images of the pano at the time it was stitched
+  std::vector<int> ids;
+  StitchingResult result;
+  std::int64_t memory_mib = 0;
+};
+
+// Memory held by the pano and the mask, rounded up
+std::int64_t MemoryMiB(const StitchingResult &result);
+
+struct BatchJobResult {
+  int job_id = 0;
+  int num_images = 0;
+  // Empty if the job didn't get to stitching
+  std::optional<algorithm::stitcher::Status> status;
+  std::optional<std::filesystem::path> export_path;
+  // See StitchingOptions::encode_extension
+  std::optional<std::vector<unsigned char>> encoded;
+  std::string error;
+  double loading_seconds = 0.0;
+  double stitching_seconds = 0.0;
 };
 
 struct ExportResult {
@@ -74,34 +130,54 @@ struct ExportResult {
   std::optional<std::filesystem::path> export_path;
 };
 
+struct SaveSessionResult {
+  std::filesystem::path session_path;
+};
+
 using ProgressMonitor = algorithm::ProgressMonitor;
 using ProgressReport = algorithm::ProgressReport;
 using ProgressType = algorithm::ProgressType;
 
 enum class RunTraits : std::uint8_t { kOwnFuture, kReturnFuture };
 
+// Interactive tasks replace each other, e.g. the previews of the selected
+// pano. Background tasks, e.g. exports, run one by one in the order they were
+// queued, each starts once no interactive task is running.
+enum class Lane : std::uint8_t { kInteractive, kBackground };
+
 template <typename Result>
 struct Task {
+  Lane lane = Lane::kInteractive;
   Result future;
   std::unique_ptr<ProgressMonitor> progress;
+  std::unique_ptr<algorithm::LiveCanvas> live_canvas;
 };
 
 using GenericFuture =
     std::variant<std::future<StitcherData>, std::future<StitchingResult>,
-                 std::future<ExportResult>, std::future<InpaintingResult>>;
+                 std::future<ExportResult>, std::future<InpaintingResult>,
+                 std::future<SaveSessionResult>>;
 
 // By default: holds Task objects for the currently running tasks in a queue
 //  - this is used in the gui that is periodically checking GetReadyTask()
 // If run == RunTraits::kReturnFuture: returns the Task objects to the caller
 //  - this is used in the CLI and tests
 //
-// Whenever a new task is queued, the previous task is cancelled. The queue
-// serves the purpose of holding on to the resources of the cancelled tasks
-// until they are finished and can be safely deleted.
+// Whenever a new interactive task is queued, the previous interactive tasks
+// are cancelled, the background tasks keep running. The queue serves the
+// purpose of holding on to the resources of the cancelled tasks until they
+// are finished and can be safely deleted.
+//
+// The batch and job tasks coordinate their own jobs and are not part of
+// either lane. All of the tasks share pool_ for their subtasks, which skip
+// their work once their task is cancelled.
 template <RunTraits run = RunTraits::kOwnFuture>
 class StitcherPipeline {
  public:
   StitcherPipeline() = default;
+  // Fixed number of worker threads instead of one per core, e.g. for
+  // reproducible timings
+  explicit StitcherPipeline(unsigned num_threads);
   ~StitcherPipeline();
 
   // reason: some tasks use pointers to members
@@ -110,34 +186,138 @@ class StitcherPipeline {
   StitcherPipeline(StitcherPipeline &&) = delete;
   StitcherPipeline &operator=(StitcherPipeline &&) = delete;
 
+  // Cancels all of the queued tasks
   auto RunLoading(const std::vector<std::filesystem::path> &inputs,
                   const LoadingOptions &loading_options,
                   const MatchingOptions &matching_options)
       -> std::conditional_t<run == RunTraits::kReturnFuture,
                             Task<std::future<StitcherData>>, void>;
 
+  // Same as above with unloaded images, e.g. in-memory inputs, see
+  // algorithm::Image
+  auto RunLoadingImages(std::vector<algorithm::Image> inputs,
+                        const LoadingOptions &loading_options,
+                        const MatchingOptions &matching_options)
+      -> std::conditional_t<run == RunTraits::kReturnFuture,
+                            Task<std::future<StitcherData>>, void>;
+
+  // Restores the data saved with SaveSession(), see session.h
+  auto RunLoadingSession(const std::filesystem::path &session_path)
+      -> std::conditional_t<run == RunTraits::kReturnFuture,
+                            Task<std::future<StitcherData>>, void>;
+
+  // Runs in the background lane if the pano is exported
   auto RunStitching(const StitcherData &data, const StitchingOptions &options)
       -> std::conditional_t<run == RunTraits::kReturnFuture,
                             Task<std::future<StitchingResult>>, void>;
 
+  // Stitches multiple panos concurrently, limited by the number of threads and
+  // the estimated memory usage. The panos and masks are dropped from the
+  // results after export, panos that failed with an exception are logged and
+  // left out.
+  auto RunBatchStitching(const StitcherData &data,
+                         const std::vector<StitchingOptions> &options,
+                         const BatchOptions &batch_options)
+      -> Task<std::future<std::vector<StitchingResult>>>
+    requires(run == RunTraits::kReturnFuture);
+
+  // Loads and stitches independent jobs, sharing the threadpool between them
+  // under the same limits as RunBatchStitching. Returns a result for each job
+  // in the original order, the failed jobs have an error message.
+  auto RunBatchJobs(const std::vector<BatchJob> &jobs,
+                    const BatchOptions &batch_options)
+      -> Task<std::future<std::vector<BatchJobResult>>>
+    requires(run == RunTraits::kReturnFuture);
+
+  // Runs the job alongside the already running ones without cancelling them,
+  // e.g. for a server accepting jobs one by one. The limits are taken from
+  // the first call and shared by all the jobs.
+  auto RunJob(const BatchJob &job, const BatchOptions &batch_options)
+      -> Task<std::future<BatchJobResult>>
+    requires(run == RunTraits::kReturnFuture);
+
+  // Runs in the background lane
   auto RunExport(cv::Mat pano, const ExportOptions &options)
       -> std::conditional_t<run == RunTraits::kReturnFuture,
                             Task<std::future<ExportResult>>, void>;
 
+  // Runs in the background lane, see SaveSession() in session.h
+  auto RunSavingSession(const StitcherData &data,
+                        const std::filesystem::path &session_path)
+      -> std::conditional_t<run == RunTraits::kReturnFuture,
+                            Task<std::future<SaveSessionResult>>, void>;
+
   auto RunInpainting(cv::Mat pano, cv::Mat mask,
                      const InpaintingOptions &options)
       -> std::conditional_t<run == RunTraits::kReturnFuture,
                             Task<std::future<InpaintingResult>>, void>;
 
+  // Low priority lane: stitches the previews of the panos one by one in their
+  // order while no other task is running, so that they can be shown right
+  // away once selected. Starting any other task preempts the running stitch,
+  // it is restarted after the task finishes. The previews that don't fit into
+  // kSpeculativeMemoryBudgetMiB are skipped. Does nothing if the speculation
+  // with the same options is already running or finished, otherwise replaces
+  // it. The images have to outlive the speculation, loading new images
+  // cancels it.
+  void RunSpeculativeStitching(const StitcherData &data,
+                               const StitchAlgorithmOptions &options);
+
+  // The preview stitched in the background, if it is finished and matches the
+  // pano and the options. Panos with cameras set are stitched from those
+  // cameras instead and never match.
+  [[nodiscard]] std::optional<StitchingResult> SpeculativeResult(
+      const algorithm::Pano &pano, const StitchAlgorithmOptions &options) const;
+
+  // Waits for the lane to stop and drops the previews
+  void CancelSpeculation();
+
   ProgressReport Progress() const;
 
+  // The live canvas of the last queued task, if requested
+  [[nodiscard]] const algorithm::LiveCanvas *CurrentCanvas() const;
+
+  // Called from the worker threads when the progress of a queued task changes
+  // and after it finishes, e.g. to wake up the gui. Set before running tasks.
+  void SetNotifier(std::function<void()> notifier);
+
+  // Some tasks are queued, either running or waiting for GetReadyTask()
+  [[nodiscard]] bool HasTasks() const;
+
   auto GetReadyTask() -> std::optional<Task<GenericFuture>>;
 
+  // Cancels all of the queued tasks
   void Cancel();
 
+  void Cancel(Lane lane);
+
+  // Cancels the task reported by Progress()
+  void CancelCurrent();
+
   void CancelAndWait();
 
  private:
+  // Submits to pool_ and preempts the speculative lane until the task is
+  // finished or purged
+  template <typename TFunc>
+  auto SubmitInteractive(TFunc &&func)
+      -> std::future<std::invoke_result_t<TFunc>>;
+
+  template <typename TFunc>
+  auto SubmitBackground(const ProgressMonitor *progress, TFunc &&func)
+      -> std::future<std::invoke_result_t<TFunc>>;
+
+  void PreemptSpeculation();
+
+  void RunSpeculativeLane(const std::vector<algorithm::Pano> &panos,
+                          const std::vector<algorithm::Image> &images,
+                          const StitchAlgorithmOptions &options,
+                          const ProgressMonitor &stop);
+
+  // Declared before the pools, the running tasks call it until the pools are
+  // destroyed
+  std::function<void()> notifier_;
+
   utils::mt::Threadpool pool_ = {
       std::max(2U, std::thread::hardware_concurrency())};
 
@@ -148,7 +328,36 @@ class StitcherPipeline {
   utils::mt::Threadpool multiblend_pool_ = {
       std::max(2U, std::thread::hardware_concurrency() - 1)};
 
+  // Coordinates the batch jobs, waiting for them would otherwise block one of
+  // the threads they need.
+  utils::mt::Threadpool batch_pool_ = {1};
+
+  // Coordinates the background lane, the subtasks run in pool_
+  utils::mt::Threadpool background_pool_ = {1};
+
+  // Created by the first RunJob call, one thread per concurrent job. The pool
+  // is declared last to finish its jobs before the budget is destroyed.
+  std::unique_ptr<utils::mt::Budget> job_budget_;
+  std::unique_ptr<utils::mt::Threadpool> job_pool_;
+
   std::deque<Task<GenericFuture>> queue_;
+
+  // Interactive tasks submitted to pool_ and not finished yet, the background
+  // lanes wait until there are none
+  utils::mt::TaskCounter interactive_tasks_;
+
+  // The speculative lane, the stop monitor is cancelled when the speculation
+  // is replaced, the attempt monitor when a stitch is preempted
+  mutable std::mutex speculative_mut_;
+  StitchAlgorithmOptions speculative_options_;
+  std::map<int, SpeculativePreview> speculative_previews_;
+  std::int64_t speculative_memory_mib_ = 0;
+  ProgressMonitor *speculative_attempt_ = nullptr;
+  std::shared_ptr<ProgressMonitor> speculative_stop_;
+
+  // Declared last, the lane is stopped before the rest of the pipeline is
+  // destroyed
+  utils::mt::Threadpool speculative_pool_ = {1};
 };
 
 }  // namespace xpano::pipeline
@@ -0,0 +1,201 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/server/http.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "xpano/utils/expected.h"
+#include "xpano/utils/fmt.h"
+
+namespace xpano::server::http {
+
+namespace {
+
+std::string ToLower(std::string_view text) {
+  std::string result(text);
+  std::transform(result.begin(), result.end(), result.begin(), [](char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  });
+  return result;
+}
+
+std::string_view Trim(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+std::vector<std::string_view> Split(std::string_view text, char separator) {
+  std::vector<std::string_view> parts;
+  std::size_t begin = 0;
+  while (begin <= text.size()) {
+    auto end = text.find(separator, begin);
+    if (end == std::string_view::npos) {
+      end = text.size();
+    }
+    parts.push_back(text.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return parts;
+}
+
+}  // namespace
+
+std::optional<std::size_t> HeaderEnd(std::string_view data) {
+  const std::string_view separator = "\r\n\r\n";
+  auto pos = data.find(separator);
+  if (pos == std::string_view::npos) {
+    return {};
+  }
+  return pos + separator.size();
+}
+
+utils::Expected<Request, std::string> ParseHead(std::string_view head) {
+  auto lines = Split(head, '\n');
+  for (auto& line : lines) {
+    if (line.ends_with('\r')) {
+      line.remove_suffix(1);
+    }
+  }
+
+  auto request_line = Split(lines[0], ' ');
+  if (request_line.size() != 3 || !request_line[2].starts_with("HTTP/1.")) {
+    return utils::Unexpected<std::string>("Malformed request line");
+  }
+
+  Request request;
+  request.method = request_line[0];
+  auto target = request_line[1];
+  if (!target.starts_with('/')) {
+    return utils::Unexpected<std::string>("Malformed request target");
+  }
+  if (auto query_pos = target.find('?'); query_pos != std::string_view::npos) {
+    for (auto item : Split(target.substr(query_pos + 1), '&')) {
+      if (item.empty()) {
+        continue;
+      }
+      auto eq = item.find('=');
+      if (eq == std::string_view::npos) {
+        request.query[PercentDecode(item)] = "";
+      } else {
+        request.query[PercentDecode(item.substr(0, eq))] =
+            PercentDecode(item.substr(eq + 1));
+      }
+    }
+    target = target.substr(0, query_pos);
+  }
+  for (auto segment : Split(target.substr(1), '/')) {
+    if (!segment.empty()) {
+      request.path.push_back(PercentDecode(segment));
+    }
+  }
+
+  for (std::size_t i = 1; i < lines.size(); i++) {
+    if (lines[i].empty()) {
+      continue;
+    }
+    auto colon = lines[i].find(':');
+    if (colon == std::string_view::npos) {
+      return utils::Unexpected<std::string>("Malformed header");
+    }
+    request.headers[ToLower(Trim(lines[i].substr(0, colon)))] =
+        Trim(lines[i].substr(colon + 1));
+  }
+  return request;
+}
+
+std::optional<std::size_t> ContentLength(const Request& request) {
+  auto header = request.headers.find("content-length");
+  if (header == request.headers.end()) {
+    return 0;
+  }
+  std::size_t length = 0;
+  const auto& value = header->second;
+  auto [end, error] =
+      std::from_chars(value.data(), value.data() + value.size(), length);
+  if (error != std::errc() || end != value.data() + value.size()) {
+    return {};
+  }
+  return length;
+}
+
+std::string Format(const Response& response) {
+  return fmt::format(
+      "HTTP/1.1 {} {}\r\nContent-Type: {}\r\nContent-Length: {}\r\n"
+      "Connection: close\r\n\r\n{}",
+      response.status, StatusText(response.status), response.content_type,
+      response.body.size(), response.body);
+}
+
+std::string FormatChunkedHead(int status, std::string_view content_type) {
+  return fmt::format(
+      "HTTP/1.1 {} {}\r\nContent-Type: {}\r\nTransfer-Encoding: chunked\r\n"
+      "Connection: close\r\n\r\n",
+      status, StatusText(status), content_type);
+}
+
+std::string FormatChunk(std::string_view data) {
+  return fmt::format("{:x}\r\n{}\r\n", data.size(), data);
+}
+
+std::string_view StatusText(int status) {
+  switch (status) {
+    case 200:
+      return "OK";
+    case 201:
+      return "Created";
+    case 202:
+      return "Accepted";
+    case 400:
+      return "Bad Request";
+    case 404:
+      return "Not Found";
+    case 405:
+      return "Method Not Allowed";
+    case 409:
+      return "Conflict";
+    case 413:
+      return "Payload Too Large";
+    case 500:
+      return "Internal Server Error";
+    case 503:
+      return "Service Unavailable";
+    default:
+      return "Unknown";
+  }
+}
+
+std::string PercentDecode(std::string_view text) {
+  std::string result;
+  for (std::size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '+') {
+      result.push_back(' ');
+      continue;
+    }
+    int value = 0;
+    if (text[i] == '%' && i + 2 < text.size() &&
+        std::from_chars(text.data() + i + 1, text.data() + i + 3, value, 16)
+                .ptr == text.data() + i + 3) {
+      result.push_back(static_cast<char>(value));
+      i += 2;
+      continue;
+    }
+    result.push_back(text[i]);
+  }
+  return result;
+}
+
+}  // namespace xpano::server::http
@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "xpano/utils/expected.h"
+
+namespace xpano::server::http {
+
+// Just enough HTTP/1.1 for a localhost API: no keep-alive, no chunked
+// requests, the body length is given by Content-Length
+struct Request {
+  std::string method;
+  std::vector<std::string> path;
+  std::map<std::string, std::string> query;
+  std::map<std::string, std::string> headers;  // lower case names
+  std::string body;
+};
+
+struct Response {
+  int status = 200;
+  std::string content_type = "application/json";
+  std::string body;
+};
+
+// Position right after the empty line ending the headers
+std::optional<std::size_t> HeaderEnd(std::string_view data);
+
+// Parses the request line and the headers, the body is filled in separately
+utils::Expected<Request, std::string> ParseHead(std::string_view head);
+
+std::optional<std::size_t> ContentLength(const Request& request);
+
+std::string Format(const Response& response);
+
+// Progress streams: a chunked response, each update is a single chunk
+std::string FormatChunkedHead(int status, std::string_view content_type);
+std::string FormatChunk(std::string_view data);
+
+std::string_view StatusText(int status);
+
+std::string PercentDecode(std::string_view text);
+
+}  // namespace xpano::server::http
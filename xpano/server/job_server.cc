@@ -0,0 +1,453 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/server/job_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "xpano/algorithm/image.h"
+#include "xpano/cli/manifest.h"
+#include "xpano/constants.h"
+#include "xpano/pipeline/stitcher_pipeline.h"
+#include "xpano/server/http.h"
+#include "xpano/server/socket.h"
+#include "xpano/utils/fmt.h"
+#include "xpano/utils/future.h"
+#include "xpano/utils/json.h"
+#include "xpano/utils/path.h"
+
+namespace xpano::server {
+
+namespace {
+
+using utils::json::Value;
+
+http::Response Json(int status, const Value& value) {
+  return {.status = status, .body = utils::json::Dump(value)};
+}
+
+http::Response Error(int status, const std::string& message) {
+  return Json(status, Value::Object{{"error", message}});
+}
+
+std::optional<int> ParseId(const std::string& text) {
+  int value = 0;
+  auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc() || end != text.data() + text.size()) {
+    return {};
+  }
+  return value;
+}
+
+std::optional<int> ParseId(const Value& value) {
+  if (!value.IsNumber() || value.AsNumber() != std::floor(value.AsNumber()) ||
+      value.AsNumber() < 0 ||
+      value.AsNumber() > std::numeric_limits<int>::max()) {
+    return {};
+  }
+  return static_cast<int>(value.AsNumber());
+}
+
+const char* StageName(pipeline::ProgressType type) {
+  switch (type) {
+    case pipeline::ProgressType::kLoadingImages:
+      return "loading_images";
+    case pipeline::ProgressType::kDetectingKeypoints:
+      return "detecting_keypoints";
+    case pipeline::ProgressType::kMatchingImages:
+      return "matching_images";
+    case pipeline::ProgressType::kStitchingPano:
+    case pipeline::ProgressType::kStitchFindFeatures:
+    case pipeline::ProgressType::kStitchMatchFeatures:
+    case pipeline::ProgressType::kStitchEstimateHomography:
+    case pipeline::ProgressType::kStitchBundleAdjustment:
+    case pipeline::ProgressType::kStitchComputeRoi:
+    case pipeline::ProgressType::kStitchSeamsPrepare:
+    case pipeline::ProgressType::kStitchSeamsFind:
+    case pipeline::ProgressType::kStitchCompose:
+    case pipeline::ProgressType::kStitchBlend:
+      return "stitching";
+    case pipeline::ProgressType::kAutoCrop:
+      return "auto_crop";
+    case pipeline::ProgressType::kExport:
+      return "export";
+    case pipeline::ProgressType::kInpainting:
+      return "inpainting";
+    case pipeline::ProgressType::kCancelling:
+      return "cancelling";
+    default:
+      return "queued";
+  }
+}
+
+const char* ContentType(const std::filesystem::path& path) {
+  if (utils::path::IsJpegExtension(path)) {
+    return "image/jpeg";
+  }
+  if (utils::path::IsPngExtension(path)) {
+    return "image/png";
+  }
+  if (utils::path::IsTiffExtension(path) ||
+      utils::path::IsPyramidTiffExtension(path)) {
+    return "image/tiff";
+  }
+  return "application/octet-stream";
+}
+
+// A bare extension, the format ends up in the name of the exported file
+bool IsFormatToken(const std::string& format) {
+  return !format.empty() &&
+         std::all_of(format.begin(), format.end(), [](char character) {
+           return std::isalnum(static_cast<unsigned char>(character)) != 0;
+         });
+}
+
+const char* State(const pipeline::BatchJobResult& result) {
+  if (result.error.empty()) {
+    return "done";
+  }
+  return result.error == "Cancelled" ? "cancelled" : "failed";
+}
+
+}  // namespace
+
+JobServer::JobServer(ServerOptions options) : options_(std::move(options)) {}
+
+JobServer::~JobServer() {
+  stopping_ = true;
+  for (auto& connection : connections_) {
+    connection.wait();
+  }
+  const std::lock_guard lock(mut_);
+  for (auto& [job_id, job] : jobs_) {
+    job->task.progress->Cancel();
+  }
+}
+
+bool JobServer::Start() {
+  listener_ = Listen(options_.port);
+  if (!listener_) {
+    spdlog::error("Failed to listen on port {}", options_.port);
+    return false;
+  }
+  spdlog::info("Listening on http://127.0.0.1:{}", Port());
+  return true;
+}
+
+int JobServer::Port() const { return listener_ ? LocalPort(*listener_) : -1; }
+
+void JobServer::Serve(const std::atomic_bool& stop) {
+  while (!stop) {
+    auto client = Accept(*listener_, kTaskCancellationTimeout);
+    std::erase_if(connections_, [](const auto& connection) {
+      return utils::future::IsReady(connection);
+    });
+    if (!client) {
+      continue;
+    }
+    if (connections_.size() >= kServerMaxConnections) {
+      SendAll(*client, http::Format(Error(503, "Too many connections")));
+      continue;
+    }
+    connections_.push_back(std::async(
+        std::launch::async,
+        [this](Socket client) { HandleConnection(std::move(client)); },
+        std::move(*client)));
+  }
+}
+
+void JobServer::HandleConnection(Socket client) {
+  auto request = ReadRequest(client, kServerMaxBodySize);
+  if (!request) {
+    SendAll(client, http::Format(Error(request.error(),
+                                       std::string(http::StatusText(
+                                           request.error())))));
+    return;
+  }
+
+  const auto& path = request->path;
+  if (request->method == "GET" && path.size() == 3 && path[0] == "jobs" &&
+      path[2] == "progress") {
+    if (auto job_id = ParseId(path[1]); job_id) {
+      if (auto job = FindJob(*job_id); job) {
+        StreamProgress(job, client);
+        return;
+      }
+    }
+  }
+
+  http::Response response;
+  try {
+    response = Handle(*request);
+  } catch (const std::exception& e) {
+    response = Error(500, e.what());
+  }
+  SendAll(client, http::Format(response));
+}
+
+http::Response JobServer::Handle(const http::Request& request) {
+  const auto& path = request.path;
+  if (path.empty()) {
+    return Error(404, "Not found");
+  }
+  if (path[0] == "uploads" && path.size() == 1) {
+    return request.method == "POST" ? Upload(request)
+                                    : Error(405, "Method not allowed");
+  }
+  if (path[0] != "jobs" || path.size() > 3) {
+    return Error(404, "Not found");
+  }
+  if (path.size() == 1) {
+    if (request.method == "POST") {
+      return Submit(request);
+    }
+    return request.method == "GET" ? List() : Error(405, "Method not allowed");
+  }
+
+  auto job_id = ParseId(path[1]);
+  auto job = job_id ? FindJob(*job_id) : nullptr;
+  if (!job) {
+    return Error(404, "Unknown job");
+  }
+  if (path.size() == 3) {
+    return path[2] == "result" && request.method == "GET"
+               ? Result(job)
+               : Error(404, "Not found");
+  }
+  if (request.method == "GET") {
+    return Status(*job_id, job);
+  }
+  if (request.method == "DELETE") {
+    return Remove(*job_id, job);
+  }
+  return Error(405, "Method not allowed");
+}
+
+http::Response JobServer::Upload(const http::Request& request) {
+  auto name = request.query.find("name");
+  if (name == request.query.end()) {
+    return Error(400, "Missing the name parameter");
+  }
+  auto filename = std::filesystem::path(name->second).filename();
+  if (!utils::path::IsExtensionSupported(filename)) {
+    return Error(400, "Unsupported image format");
+  }
+
+  // Decoded when a job loads it
+  auto image = algorithm::Image(
+      filename.string(),
+      std::vector<unsigned char>(request.body.begin(), request.body.end()));
+  const std::lock_guard lock(mut_);
+  const int upload_id = next_upload_id_++;
+  uploads_.emplace(upload_id, std::move(image));
+  return Json(201, Value::Object{{"id", upload_id}});
+}
+
+http::Response JobServer::Submit(const http::Request& request) {
+  auto body = utils::json::Parse(request.body);
+  if (!body) {
+    return Error(400, body.error());
+  }
+
+  pipeline::BatchJob job;
+  if (const auto* inputs = body->Find("inputs"); inputs != nullptr) {
+    if (!inputs->IsArray()) {
+      return Error(400, "\"inputs\" must be an array of paths");
+    }
+    for (const auto& input : inputs->AsArray()) {
+      if (!input.IsString()) {
+        return Error(400, "\"inputs\" must be an array of paths");
+      }
+      job.inputs.emplace_back(input.AsString());
+    }
+  }
+  std::vector<int> upload_ids;
+  if (const auto* uploads = body->Find("uploads"); uploads != nullptr) {
+    if (!uploads->IsArray()) {
+      return Error(400, "\"uploads\" must be an array of upload ids");
+    }
+    for (const auto& upload : uploads->AsArray()) {
+      auto upload_id = ParseId(upload);
+      if (!upload_id) {
+        return Error(400, "\"uploads\" must be an array of upload ids");
+      }
+      upload_ids.push_back(*upload_id);
+    }
+  }
+  if (job.inputs.empty() && upload_ids.empty()) {
+    return Error(400, "No \"inputs\" or \"uploads\" given");
+  }
+
+  std::string format = "jpg";
+  if (const auto* value = body->Find("format"); value != nullptr) {
+    if (!value->IsString()) {
+      return Error(400, "\"format\" must be a string");
+    }
+    format = value->AsString();
+  }
+  const auto extension = std::filesystem::path("pano." + format);
+  // Encoded in memory, the pyramid formats are only streamed to files
+  if (!IsFormatToken(format) ||
+      !utils::path::IsExportExtensionSupported(extension) ||
+      utils::path::IsPyramidTiffExtension(extension) ||
+      utils::path::IsDeepZoomExtension(extension)) {
+    return Error(400, fmt::format("Unsupported format \"{}\"", format));
+  }
+
+  if (const auto* options = body->Find("options"); options != nullptr) {
+    auto parsed = cli::manifest::ParseOptions(*options, job.stitching);
+    if (!parsed) {
+      return Error(400, parsed.error());
+    }
+    job.stitching = *parsed;
+  }
+
+  job.stitching.encode_extension = extension.extension().string();
+
+  const std::lock_guard lock(mut_);
+  for (const int upload_id : upload_ids) {
+    if (!uploads_.contains(upload_id)) {
+      return Error(400, fmt::format("Unknown upload {}", upload_id));
+    }
+  }
+  // Taken by the job, an upload can't be used twice
+  for (const int upload_id : upload_ids) {
+    if (auto upload = uploads_.extract(upload_id); upload) {
+      job.images.push_back(std::move(upload.mapped()));
+    }
+  }
+  const int job_id = next_job_id_++;
+  auto task = pipeline_.RunJob(job, options_.batch);
+  jobs_[job_id] = std::make_shared<Job>(
+      Job{.content_type = ContentType(extension),
+          .task = {.future = task.future.share(),
+                   .progress = std::move(task.progress)}});
+  spdlog::info("Job {}: {} images", job_id,
+               job.inputs.size() + job.images.size());
+  return Json(202, Value::Object{{"id", job_id}});
+}
+
+http::Response JobServer::List() {
+  Value::Array jobs;
+  const std::lock_guard lock(mut_);
+  for (const auto& [job_id, job] : jobs_) {
+    const bool ready = utils::future::IsReady(job->task.future);
+    jobs.emplace_back(Value::Object{
+        {"id", job_id},
+        {"state", ready ? State(job->task.future.get()) : "running"}});
+  }
+  return Json(200, jobs);
+}
+
+http::Response JobServer::Status(int job_id,
+                                  const std::shared_ptr<Job>& job) {
+  const auto progress = job->task.progress->Report();
+  Value::Object status = {
+      {"id", job_id},
+      {"state", "running"},
+      {"progress", Value::Object{{"stage", StageName(progress.type)},
+                                 {"done", progress.tasks_done},
+                                 {"total", progress.num_tasks}}},
+  };
+  if (utils::future::IsReady(job->task.future)) {
+    const auto& result = job->task.future.get();
+    status[1].second = State(result);
+    status.emplace_back("images", result.num_images);
+    status.emplace_back("loading_seconds", result.loading_seconds);
+    status.emplace_back("stitching_seconds", result.stitching_seconds);
+    if (!result.error.empty()) {
+      status.emplace_back("error", result.error);
+    }
+  }
+  return Json(200, status);
+}
+
+http::Response JobServer::Result(const std::shared_ptr<Job>& job) {
+  if (!utils::future::IsReady(job->task.future)) {
+    return Error(409, "The job is still running");
+  }
+  const auto& result = job->task.future.get();
+  if (!result.error.empty()) {
+    return Error(409, result.error);
+  }
+  if (!result.encoded) {
+    return Error(500, "Missing the result");
+  }
+  return {.status = 200,
+          .content_type = job->content_type,
+          .body = std::string(result.encoded->begin(), result.encoded->end())};
+}
+
+http::Response JobServer::Remove(int job_id,
+                                  const std::shared_ptr<Job>& job) {
+  if (!utils::future::IsReady(job->task.future)) {
+    job->task.progress->Cancel();
+    return Json(202, Value::Object{{"id", job_id}, {"state", "cancelling"}});
+  }
+
+  const std::lock_guard lock(mut_);
+  jobs_.erase(job_id);
+  return Json(200, Value::Object{{"id", job_id}, {"state", "removed"}});
+}
+
+void JobServer::StreamProgress(const std::shared_ptr<Job>& job,
+                               const Socket& client) {
+  if (!SendAll(client, http::FormatChunkedHead(200, "application/x-ndjson"))) {
+    return;
+  }
+
+  std::optional<pipeline::ProgressReport> last_report;
+  while (!stopping_) {
+    const bool ready = utils::future::IsReady(job->task.future);
+    const auto report = job->task.progress->Report();
+    if (!last_report || report.type != last_report->type ||
+        report.tasks_done != last_report->tasks_done || ready) {
+      Value::Object update = {{"stage", StageName(report.type)},
+                              {"done", report.tasks_done},
+                              {"total", report.num_tasks}};
+      if (ready) {
+        update.emplace_back("state", State(job->task.future.get()));
+      }
+      auto line = utils::json::Dump(update);
+      // One JSON document per line
+      std::erase(line, '\n');
+      line.push_back('\n');
+      if (!SendAll(client, http::FormatChunk(line))) {
+        return;
+      }
+      last_report = report;
+    }
+    if (ready) {
+      break;
+    }
+    std::this_thread::sleep_for(kServerProgressInterval);
+  }
+  SendAll(client, http::FormatChunk(""));
+}
+
+std::shared_ptr<JobServer::Job> JobServer::FindJob(int job_id) {
+  const std::lock_guard lock(mut_);
+  auto job = jobs_.find(job_id);
+  return job != jobs_.end() ? job->second : nullptr;
+}
+
+}  // namespace xpano::server
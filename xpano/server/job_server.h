@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "xpano/algorithm/image.h"
+#include "xpano/constants.h"
+#include "xpano/pipeline/stitcher_pipeline.h"
+#include "xpano/server/http.h"
+#include "xpano/server/socket.h"
+
+namespace xpano::server {
+
+struct ServerOptions {
+  // 0 picks a free port
+  int port = kDefaultServerPort;
+  pipeline::BatchOptions batch;
+};
+
+// Localhost HTTP/JSON API on top of a single StitcherPipeline, the jobs are
+// multiplexed onto its threadpool with StitcherPipeline::RunJob.
+//
+//   POST   /uploads?name=<file>  raw image body -> {"id": ...}
+//   POST   /jobs                 {"inputs": [...], "uploads": [...],
+//                                 "format": "jpg", "options": {...}}
+//                                 -> {"id": ...}
+//   GET    /jobs                 all jobs and their states
+//   GET    /jobs/<id>            state, progress and timing
+//   GET    /jobs/<id>/progress   chunked stream of JSON lines until finished
+//   GET    /jobs/<id>/result     the encoded panorama
+//   DELETE /jobs/<id>            cancels a running job, removes a finished one
+//
+// The job options are the same as in the batch manifests. The inputs are
+// paths readable by the server, the uploads are ids of uploaded images.
+// Nothing is written to disk: an upload is kept in memory until a job takes
+// it, the encoded pano until the job is removed.
+class JobServer {
+ public:
+  explicit JobServer(ServerOptions options);
+  ~JobServer();
+
+  JobServer(const JobServer&) = delete;
+  JobServer& operator=(const JobServer&) = delete;
+  JobServer(JobServer&&) = delete;
+  JobServer& operator=(JobServer&&) = delete;
+
+  // Returns false if the port can't be bound
+  bool Start();
+
+  [[nodiscard]] int Port() const;
+
+  // Serves the requests until stop is set
+  void Serve(const std::atomic_bool& stop);
+
+ private:
+  struct Job {
+    std::string content_type;
+    pipeline::Task<std::shared_future<pipeline::BatchJobResult>> task;
+  };
+
+  void HandleConnection(Socket client);
+  http::Response Handle(const http::Request& request);
+
+  http::Response Upload(const http::Request& request);
+  http::Response Submit(const http::Request& request);
+  http::Response List();
+  // The job is looked up once per request, a concurrent DELETE may drop it
+  // from jobs_ in the meantime
+  http::Response Status(int job_id, const std::shared_ptr<Job>& job);
+  http::Response Result(const std::shared_ptr<Job>& job);
+  http::Response Remove(int job_id, const std::shared_ptr<Job>& job);
+  void StreamProgress(const std::shared_ptr<Job>& job, const Socket& client);
+
+  std::shared_ptr<Job> FindJob(int job_id);
+
+  ServerOptions options_;
+  std::optional<Socket> listener_;
+  std::atomic_bool stopping_ = false;
+
+  std::mutex mut_;
+  int next_upload_id_ = 0;
+  int next_job_id_ = 0;
+  std::map<int, algorithm::Image> uploads_;
+  std::map<int, std::shared_ptr<Job>> jobs_;
+  std::vector<std::future<void>> connections_;
+
+  // Declared last, the running jobs hold pointers to the progress monitors
+  // owned by jobs_
+  pipeline::StitcherPipeline<pipeline::RunTraits::kReturnFuture> pipeline_;
+};
+
+}  // namespace xpano::server
@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <atomic>
+#include <clocale>
+#include <exception>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+#include "xpano/cli/signal.h"
+#include "xpano/server/job_server.h"
+#include "xpano/utils/fmt.h"
+#include "xpano/version_fmt.h"
+
+namespace {
+
+const std::string kPortFlag = "--port=";
+const std::string kMaxMemoryFlag = "--max-memory=";
+const std::string kMaxJobsFlag = "--max-jobs=";
+
+std::atomic_bool stop = false;
+
+void StopHandler(int /*signal*/) { stop = true; }
+
+void PrintHelp() {
+  spdlog::info("Usage:");
+  spdlog::info(
+      "\tXpanoServer [--port=<port>] [--max-memory=<MiB>] [--max-jobs=<N>]");
+  spdlog::info("\tListens on 127.0.0.1, --port=0 picks a free port.");
+}
+
+bool ParseArgs(int argc, char** argv,
+               xpano::server::ServerOptions* options) {
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg.starts_with(kPortFlag)) {
+        options->port = std::stoi(arg.substr(kPortFlag.size()));
+      } else if (arg.starts_with(kMaxMemoryFlag)) {
+        options->batch.memory_budget_mib =
+            std::stoi(arg.substr(kMaxMemoryFlag.size()));
+      } else if (arg.starts_with(kMaxJobsFlag)) {
+        options->batch.max_jobs = std::stoi(arg.substr(kMaxJobsFlag.size()));
+      } else {
+        spdlog::error("Unknown argument: \"{}\"", arg);
+        return false;
+      }
+    }
+  } catch (const std::exception& e) {
+    spdlog::error("Invalid argument: {}", e.what());
+    return false;
+  }
+  if (options->port < 0 || options->batch.memory_budget_mib <= 0 ||
+      options->batch.max_jobs < 0) {
+    spdlog::error("Invalid argument value");
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::setlocale(LC_ALL, "en_US.UTF-8");
+  spdlog::info("Xpano server version {}", xpano::version::Current());
+
+  xpano::server::ServerOptions options;
+  if (!ParseArgs(argc, argv, &options)) {
+    PrintHelp();
+    return -1;
+  }
+
+  xpano::server::JobServer server(options);
+  if (!server.Start()) {
+    return -1;
+  }
+  xpano::cli::signal::RegisterInterruptHandler(StopHandler);
+  server.Serve(stop);
+  spdlog::info("Shutting down");
+  return 0;
+}
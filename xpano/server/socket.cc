@@ -0,0 +1,159 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/server/socket.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "xpano/constants.h"
+#include "xpano/server/http.h"
+#include "xpano/utils/expected.h"
+
+namespace xpano::server {
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+}  // namespace
+
+Socket::~Socket() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+Socket::Socket(Socket&& other) noexcept
+    : fd_(std::exchange(other.fd_, -1)) {}
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+  if (this != &other) {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    fd_ = std::exchange(other.fd_, -1);
+  }
+  return *this;
+}
+
+std::optional<Socket> Listen(int port) {
+  Socket listener(socket(AF_INET, SOCK_STREAM, 0));
+  if (listener.Fd() < 0) {
+    return {};
+  }
+  const int reuse = 1;
+  setsockopt(listener.Fd(), SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(static_cast<std::uint16_t>(port));
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (bind(listener.Fd(), reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(listener.Fd(), SOMAXCONN) != 0) {
+    return {};
+  }
+  return listener;
+}
+
+int LocalPort(const Socket& socket) {
+  sockaddr_in address{};
+  socklen_t length = sizeof(address);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (getsockname(socket.Fd(), reinterpret_cast<sockaddr*>(&address),
+                  &length) != 0) {
+    return -1;
+  }
+  return ntohs(address.sin_port);
+}
+
+std::optional<Socket> Accept(const Socket& listener,
+                             std::chrono::milliseconds timeout) {
+  pollfd poll_fd = {.fd = listener.Fd(), .events = POLLIN, .revents = 0};
+  if (poll(&poll_fd, 1, static_cast<int>(timeout.count())) <= 0) {
+    return {};
+  }
+  Socket client(accept(listener.Fd(), nullptr, nullptr));
+  if (client.Fd() < 0) {
+    return {};
+  }
+  const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+      kServerReadTimeout);
+  timeval read_timeout{.tv_sec = seconds.count(), .tv_usec = 0};
+  setsockopt(client.Fd(), SOL_SOCKET, SO_RCVTIMEO, &read_timeout,
+             sizeof(read_timeout));
+  return client;
+}
+
+utils::Expected<http::Request, int> ReadRequest(const Socket& socket,
+                                                std::size_t max_body_size) {
+  std::string data;
+  std::array<char, 16384> buffer{};
+  std::optional<std::size_t> header_end;
+  while (!(header_end = http::HeaderEnd(data))) {
+    if (data.size() > kServerMaxHeaderSize) {
+      return utils::Unexpected<int>(413);
+    }
+    auto length = recv(socket.Fd(), buffer.data(), buffer.size(), 0);
+    if (length <= 0) {
+      return utils::Unexpected<int>(400);
+    }
+    data.append(buffer.data(), static_cast<std::size_t>(length));
+  }
+
+  auto request = http::ParseHead(std::string_view(data).substr(0, *header_end));
+  if (!request) {
+    return utils::Unexpected<int>(400);
+  }
+  auto content_length = http::ContentLength(*request);
+  if (!content_length) {
+    return utils::Unexpected<int>(400);
+  }
+  if (*content_length > max_body_size) {
+    return utils::Unexpected<int>(413);
+  }
+
+  request->body = data.substr(*header_end);
+  request->body.reserve(*content_length);
+  while (request->body.size() < *content_length) {
+    auto length = recv(socket.Fd(), buffer.data(), buffer.size(), 0);
+    if (length <= 0) {
+      return utils::Unexpected<int>(400);
+    }
+    request->body.append(buffer.data(), static_cast<std::size_t>(length));
+  }
+  request->body.resize(*content_length);
+  return *std::move(request);
+}
+
+bool SendAll(const Socket& socket, std::string_view data) {
+  while (!data.empty()) {
+    auto sent = send(socket.Fd(), data.data(), data.size(), kSendFlags);
+    if (sent <= 0) {
+      return false;
+    }
+    data.remove_prefix(static_cast<std::size_t>(sent));
+  }
+  return true;
+}
+
+}  // namespace xpano::server
@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+#include "xpano/server/http.h"
+#include "xpano/utils/expected.h"
+
+namespace xpano::server {
+
+// POSIX socket owner
+class Socket {
+ public:
+  Socket() = default;
+  explicit Socket(int descriptor) : fd_(descriptor) {}
+  ~Socket();
+
+  Socket(const Socket&) = delete;
+  Socket& operator=(const Socket&) = delete;
+  Socket(Socket&& other) noexcept;
+  Socket& operator=(Socket&& other) noexcept;
+
+  [[nodiscard]] int Fd() const { return fd_; }
+
+ private:
+  int fd_ = -1;
+};
+
+// Bound to the loopback interface only, port 0 picks a free port
+std::optional<Socket> Listen(int port);
+
+int LocalPort(const Socket& socket);
+
+// Returns std::nullopt on timeout
+std::optional<Socket> Accept(const Socket& listener,
+                             std::chrono::milliseconds timeout);
+
+// Returns the HTTP status code on failure
+utils::Expected<http::Request, int> ReadRequest(const Socket& socket,
+                                                std::size_t max_body_size);
+
+bool SendAll(const Socket& socket, std::string_view data);
+
+}  // namespace xpano::server
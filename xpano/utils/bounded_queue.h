@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace xpano::utils::mt {
+
+// Producers wait while the queue is full, which slows them down to the pace
+// of the consumers
+template <typename TItem>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(std::size_t capacity) : capacity_(capacity) {}
+
+  // Returns false on timeout, the item is left untouched in that case
+  bool Push(TItem* item, std::chrono::milliseconds timeout) {
+    std::unique_lock lock(mut_);
+    if (!not_full_.wait_for(lock, timeout,
+                            [this]() { return items_.size() < capacity_; })) {
+      return false;
+    }
+    items_.push_back(std::move(*item));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  std::optional<TItem> Pop(std::chrono::milliseconds timeout) {
+    std::unique_lock lock(mut_);
+    if (!not_empty_.wait_for(lock, timeout,
+                             [this]() { return !items_.empty(); })) {
+      return {};
+    }
+    auto item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return item;
+  }
+
+  [[nodiscard]] std::size_t Size() const {
+    const std::lock_guard lock(mut_);
+    return items_.size();
+  }
+
+ private:
+  std::size_t capacity_;
+  std::deque<TItem> items_;
+  mutable std::mutex mut_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+};
+
+}  // namespace xpano::utils::mt
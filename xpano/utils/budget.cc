@@ -0,0 +1,69 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/budget.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace xpano::utils::mt {
+
+Lease::~Lease() {
+  if (budget_ != nullptr) {
+    budget_->Release(cost_);
+  }
+}
+
+Lease::Lease(Lease&& other) noexcept
+    : budget_(other.budget_), cost_(other.cost_) {
+  other.budget_ = nullptr;
+}
+
+Lease& Lease::operator=(Lease&& other) noexcept {
+  if (this != &other) {
+    if (budget_ != nullptr) {
+      budget_->Release(cost_);
+    }
+    budget_ = std::exchange(other.budget_, nullptr);
+    cost_ = other.cost_;
+  }
+  return *this;
+}
+
+Budget::Budget(int max_jobs, std::int64_t max_cost)
+    : max_jobs_(std::max(max_jobs, 1)), max_cost_(max_cost) {}
+
+std::optional<Lease> Budget::Acquire(std::int64_t cost,
+                                     std::chrono::milliseconds timeout) {
+  std::unique_lock lock(mut_);
+  auto fits = [this, cost]() {
+    return running_jobs_ == 0 || (running_jobs_ < max_jobs_ &&
+                                  used_cost_ + cost <= max_cost_);
+  };
+  if (!released_.wait_for(lock, timeout, fits)) {
+    return {};
+  }
+  running_jobs_++;
+  used_cost_ += cost;
+  return Lease(this, cost);
+}
+
+int Budget::RunningJobs() const {
+  const std::lock_guard lock(mut_);
+  return running_jobs_;
+}
+
+void Budget::Release(std::int64_t cost) {
+  {
+    const std::lock_guard lock(mut_);
+    running_jobs_--;
+    used_cost_ -= cost;
+  }
+  released_.notify_all();
+}
+
+}  // namespace xpano::utils::mt
@@ -0,0 +1,58 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+namespace xpano::utils::mt {
+
+class Budget;
+
+// Returns the acquired cost to the budget when destroyed
+class Lease {
+ public:
+  Lease(Budget* budget, std::int64_t cost) : budget_(budget), cost_(cost) {}
+  ~Lease();
+
+  Lease(const Lease&) = delete;
+  Lease& operator=(const Lease&) = delete;
+  Lease(Lease&& other) noexcept;
+  Lease& operator=(Lease&& other) noexcept;
+
+ private:
+  Budget* budget_;
+  std::int64_t cost_;
+};
+
+// Limits the number of concurrently running jobs and their total cost, e.g.
+// the estimated memory usage. A job more expensive than the whole budget is
+// admitted once no other job is running.
+class Budget {
+ public:
+  Budget(int max_jobs, std::int64_t max_cost);
+
+  // Waits until the job fits into the budget, returns std::nullopt on timeout
+  std::optional<Lease> Acquire(std::int64_t cost,
+                               std::chrono::milliseconds timeout);
+
+  [[nodiscard]] int RunningJobs() const;
+
+ private:
+  friend class Lease;
+  void Release(std::int64_t cost);
+
+  int max_jobs_;
+  std::int64_t max_cost_;
+
+  int running_jobs_ = 0;
+  std::int64_t used_cost_ = 0;
+  mutable std::mutex mut_;
+  std::condition_variable released_;
+};
+
+}  // namespace xpano::utils::mt
@@ -0,0 +1,200 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/dzi.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <spdlog/spdlog.h>
+
+#include "xpano/utils/fmt.h"
+#include "xpano/utils/threadpool.h"
+#include "xpano/utils/trace.h"
+
+namespace xpano::utils::dzi {
+
+namespace {
+
+constexpr int kTileSize = 254;
+constexpr int kOverlap = 1;
+
+int MaxLevel(const cv::Size& size) {
+  int level = 0;
+  for (int side = std::max(size.width, size.height); side > 1;
+       side = (side + 1) / 2) {
+    level++;
+  }
+  return level;
+}
+
+std::filesystem::path TilesDirectory(const std::filesystem::path& path) {
+  auto directory = path;
+  directory.replace_filename(path.stem().string() + "_files");
+  return directory;
+}
+
+bool WriteDescriptor(const std::filesystem::path& path,
+                     const cv::Size& size) {
+  std::ofstream file(path);
+  file << R"(<?xml version="1.0" encoding="UTF-8"?>)" << '\n'
+       << fmt::format(
+              R"(<Image xmlns="http://schemas.microsoft.com/deepzoom/2008" )"
+              R"(Format="jpg" Overlap="{}" TileSize="{}">)",
+              kOverlap, kTileSize)
+       << '\n'
+       << fmt::format(R"(  <Size Width="{}" Height="{}"/>)", size.width,
+                      size.height)
+       << '\n'
+       << "</Image>\n";
+  return file.good();
+}
+
+bool IsNumber(const std::string& text) {
+  return !text.empty() && std::all_of(text.begin(), text.end(), [](char c) {
+    return std::isdigit(static_cast<unsigned char>(c));
+  });
+}
+
+// Tiles are named "<col>_<row>.jpg"
+bool IsTileName(const std::string& name) {
+  const auto separator = name.find('_');
+  const std::string extension = ".jpg";
+  if (separator == std::string::npos || name.size() <= extension.size() ||
+      !name.ends_with(extension)) {
+    return false;
+  }
+  return IsNumber(name.substr(0, separator)) &&
+         IsNumber(name.substr(separator + 1, name.size() - extension.size() -
+                                                 separator - 1));
+}
+
+// Only numbered level directories holding tiles, as written by WritePyramid
+bool IsTileTree(const std::filesystem::path& directory) {
+  std::error_code error;
+  for (std::filesystem::directory_iterator level(directory, error), end;
+       !error && level != end; level.increment(error)) {
+    if (level->symlink_status().type() !=
+            std::filesystem::file_type::directory ||
+        !IsNumber(level->path().filename().string())) {
+      return false;
+    }
+    for (std::filesystem::directory_iterator tile(level->path(), error);
+         !error && tile != end; tile.increment(error)) {
+      if (tile->symlink_status().type() !=
+              std::filesystem::file_type::regular ||
+          !IsTileName(tile->path().filename().string())) {
+        return false;
+      }
+    }
+  }
+  return !error;
+}
+
+// Removes the tiles of a previous export, any other content is left alone
+bool RemoveTiles(const std::filesystem::path& directory) {
+  std::error_code error;
+  if (!std::filesystem::exists(std::filesystem::symlink_status(directory))) {
+    return true;
+  }
+  if (!std::filesystem::is_directory(
+          std::filesystem::symlink_status(directory)) ||
+      !IsTileTree(directory)) {
+    spdlog::warn("Not overwriting {}, it is not a Deep Zoom tile directory",
+                 directory.string());
+    return false;
+  }
+  std::filesystem::remove_all(directory, error);
+  if (error) {
+    spdlog::warn("Could not remove {}: {}", directory.string(),
+                 error.message());
+    return false;
+  }
+  return true;
+}
+
+// Tiles include the overlapping pixels of their neighbors
+cv::Range TileRange(int index, int length) {
+  const int begin = std::max(index * kTileSize - kOverlap, 0);
+  const int end = std::min((index + 1) * kTileSize + kOverlap, length);
+  return {begin, end};
+}
+
+}  // namespace
+
+bool WritePyramid(const cv::Mat& image, const std::filesystem::path& path,
+                  const std::vector<int>& jpeg_params, mt::Threadpool* pool,
+                  const mt::CancelCheck& is_cancelled) {
+  if (image.empty()) {
+    return false;
+  }
+
+  const auto tiles_dir = TilesDirectory(path);
+  if (!RemoveTiles(tiles_dir)) {
+    return false;
+  }
+
+  std::error_code error;
+  mt::MultiFuture<bool> tiles_future;
+  cv::Mat level_image = image;
+  for (int level = MaxLevel(image.size()); level >= 0; level--) {
+    if (mt::IsCancelled(is_cancelled)) {
+      break;
+    }
+    const auto level_dir = tiles_dir / std::to_string(level);
+    std::filesystem::create_directories(level_dir, error);
+    if (error) {
+      spdlog::warn("Could not create {}: {}", level_dir.string(),
+                   error.message());
+      break;
+    }
+
+    const int cols = (level_image.cols + kTileSize - 1) / kTileSize;
+    const int rows = (level_image.rows + kTileSize - 1) / kTileSize;
+    for (int row = 0; row < rows; row++) {
+      for (int col = 0; col < cols; col++) {
+        // The tile keeps its level alive until it is written
+        const cv::Mat tile =
+            level_image(TileRange(row, level_image.rows),
+                        TileRange(col, level_image.cols));
+        auto tile_path = level_dir / fmt::format("{}_{}.jpg", col, row);
+        tiles_future.push_back(pool->submit([tile, tile_path, &jpeg_params,
+                                             &is_cancelled]() {
+          if (mt::IsCancelled(is_cancelled)) {
+            return false;
+          }
+          const trace::Scope scope("dzi_tile");
+          return cv::imwrite(tile_path.string(), tile, jpeg_params);
+        }));
+      }
+    }
+
+    if (level > 0) {
+      cv::Mat half;
+      cv::resize(level_image, half,
+                 cv::Size((level_image.cols + 1) / 2,
+                          (level_image.rows + 1) / 2),
+                 0, 0, cv::INTER_AREA);
+      level_image = half;
+    }
+  }
+
+  tiles_future.wait();
+  auto written = tiles_future.get();
+  if (error || mt::IsCancelled(is_cancelled) ||
+      !std::all_of(written.begin(), written.end(),
+                   [](bool success) { return success; })) {
+    return false;
+  }
+  return WriteDescriptor(path, image.size());
+}
+
+}  // namespace xpano::utils::dzi
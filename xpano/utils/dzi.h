@@ -0,0 +1,25 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "xpano/utils/threadpool.h"
+
+namespace xpano::utils::dzi {
+
+// Writes the image as a Deep Zoom tile pyramid: the path.dzi descriptor and
+// the JPEG tiles in the path_files directory, replacing any previous tiles.
+// Fails if path_files exists and holds anything other than tiles.
+// Each level is downscaled once from the previous one and the tiles are
+// encoded concurrently. Once cancelled, the remaining tiles are skipped and
+// no descriptor is written.
+bool WritePyramid(const cv::Mat& image, const std::filesystem::path& path,
+                  const std::vector<int>& jpeg_params, mt::Threadpool* pool,
+                  const mt::CancelCheck& is_cancelled = {});
+
+}  // namespace xpano::utils::dzi
@@ -3,9 +3,12 @@
 
 #include "xpano/utils/exiv2.h"
 
+#include <cstdint>
 #include <filesystem>
 #include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #ifdef XPANO_WITH_EXIV2
 #include <exiv2/exiv2.hpp>
@@ -15,6 +18,7 @@
 #include "xpano/constants.h"
 #include "xpano/utils/fmt.h"
 #include "xpano/utils/path.h"
+#include "xpano/utils/tiff_fields.h"
 #include "xpano/utils/vec.h"
 #include "xpano/version_fmt.h"
 
@@ -52,9 +56,120 @@ void EraseThumbnail(Exiv2::ExifData& exif_data) {
   auto thumb = Exiv2::ExifThumb(exif_data);
   thumb.erase();
 }
+
+// Written by the TIFF encoder or pointing to data that is not copied
+bool IsStructuralTag(std::uint16_t tag) {
+  switch (tag) {
+    case 0x00fe:  // NewSubfileType
+    case 0x00ff:  // SubfileType
+    case 0x0100:  // ImageWidth
+    case 0x0101:  // ImageLength
+    case 0x0102:  // BitsPerSample
+    case 0x0103:  // Compression
+    case 0x0106:  // PhotometricInterpretation
+    case 0x010a:  // FillOrder
+    case 0x0111:  // StripOffsets
+    case 0x0115:  // SamplesPerPixel
+    case 0x0116:  // RowsPerStrip
+    case 0x0117:  // StripByteCounts
+    case 0x011c:  // PlanarConfiguration
+    case 0x013d:  // Predictor
+    case 0x0142:  // TileWidth
+    case 0x0143:  // TileLength
+    case 0x0144:  // TileOffsets
+    case 0x0145:  // TileByteCounts
+    case 0x014a:  // SubIFDs
+    case 0x0152:  // ExtraSamples
+    case 0x0153:  // SampleFormat
+    case 0x0201:  // JPEGInterchangeFormat
+    case 0x0202:  // JPEGInterchangeFormatLength
+    case 0x927c:  // MakerNote, may contain absolute offsets
+    case 0x8769:  // ExifTag
+    case 0x8825:  // GPSTag
+    case 0xa005:  // InteroperabilityTag
+      return true;
+    default:
+      return false;
+  }
+}
+
+tiff::Field ToTiffField(const Exiv2::Exifdatum& datum) {
+  std::vector<unsigned char> value(datum.size());
+  datum.copy(value.data(), Exiv2::littleEndian);
+  return {.tag = datum.tag(),
+          .type = static_cast<std::uint16_t>(datum.typeId()),
+          .count = datum.count(),
+          .value = std::move(value)};
+}
+
+bool IsTiffType(Exiv2::TypeId type) {
+  return (type >= Exiv2::unsignedByte && type <= Exiv2::tiffDouble) ||
+         type == Exiv2::tiffIfd;
+}
+
+tiff::Metadata ToTiffMetadata(const Exiv2::ExifData& exif_data) {
+  tiff::Metadata metadata;
+  for (const auto& datum : exif_data) {
+    if (IsStructuralTag(datum.tag()) || !IsTiffType(datum.typeId())) {
+      continue;
+    }
+    const auto group = datum.groupName();
+    if (group == "Image") {
+      metadata.image.push_back(ToTiffField(datum));
+    } else if (group == "Photo") {
+      metadata.exif.push_back(ToTiffField(datum));
+    } else if (group == "GPSInfo") {
+      metadata.gps.push_back(ToTiffField(datum));
+    }
+  }
+  return metadata;
+}
 #endif
 }  // namespace
 
+std::optional<Exif> BuildExif(
+    const std::optional<std::filesystem::path>& from_path,
+    const std::filesystem::path& to_path, const Vec2i& image_size) {
+#ifdef XPANO_WITH_EXIV2
+  if (from_path && !path::IsMetadataExtensionSupported(*from_path)) {
+    spdlog::info("Reading metadata is not supported for {}",
+                 from_path->string());
+    return {};
+  }
+  if (!path::IsMetadataExtensionSupported(to_path)) {
+    spdlog::warn("Writing metadata is not supported for {}", to_path.string());
+    return {};
+  }
+
+  try {
+    Exiv2::ExifData exif_data;
+    if (from_path) {
+      auto read_img = Exiv2::ImageFactory::open(from_path->string());
+      read_img->readMetadata();
+      exif_data = read_img->exifData();
+
+      UpdateImageSize(exif_data, image_size);
+      UpdateOrientation(exif_data, kExifDefaultOrientation);
+      EraseThumbnail(exif_data);
+    }
+    AddSoftwareTag(exif_data);
+
+    Exif exif;
+    Exiv2::Blob blob;
+    Exiv2::ExifParser::encode(blob, Exiv2::littleEndian, exif_data);
+    exif.blob.assign(blob.begin(), blob.end());
+    exif.tiff = ToTiffMetadata(exif_data);
+    return exif;
+  } catch (const Exiv2::Error&) {
+    spdlog::warn("Could not prepare Exif data for {}", to_path.string());
+    return {};
+  }
+#else
+  spdlog::error("Exiv2 support is not enabled");
+  return {};
+#endif
+}
+
 void CreateExif(const std::optional<std::filesystem::path>& from_path,
                 const std::filesystem::path& to_path, const Vec2i& image_size) {
 #ifdef XPANO_WITH_EXIV2
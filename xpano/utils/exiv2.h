@@ -5,7 +5,9 @@
 
 #include <filesystem>
 #include <optional>
+#include <vector>
 
+#include "xpano/utils/tiff_fields.h"
 #include "xpano/utils/vec.h"
 
 namespace xpano::utils::exiv2 {
@@ -18,6 +20,19 @@ constexpr bool Enabled() {
 #endif
 }
 
+// Exif data prepared to be written together with the image
+struct Exif {
+  // TIFF structured data as stored in the JPEG APP1 segment
+  std::vector<unsigned char> blob;
+  // Fields for the TIFF IFDs, without tags describing the image layout
+  tiff::Metadata tiff;
+};
+
+std::optional<Exif> BuildExif(
+    const std::optional<std::filesystem::path>& from_path,
+    const std::filesystem::path& to_path, const Vec2i& image_size);
+
+// Rewrites the metadata of an already written file
 void CreateExif(const std::optional<std::filesystem::path>& from_path,
                 const std::filesystem::path& to_path, const Vec2i& image_size);
 
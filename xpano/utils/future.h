@@ -18,6 +18,12 @@ bool IsReady(const std::future<TType>& future) {
          future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
 }
 
+template <typename TType>
+bool IsReady(const std::shared_future<TType>& future) {
+  return future.valid() &&
+         future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
 struct Cancelled {};
 
 template <typename TType>
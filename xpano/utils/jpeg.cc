@@ -0,0 +1,279 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/jpeg.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <spdlog/spdlog.h>
+
+#include "xpano/utils/threadpool.h"
+#include "xpano/utils/trace.h"
+
+namespace xpano::utils::jpeg {
+
+namespace {
+
+constexpr unsigned char kMarker = 0xFF;
+constexpr unsigned char kSoi = 0xD8;
+constexpr unsigned char kEoi = 0xD9;
+constexpr unsigned char kSos = 0xDA;
+constexpr unsigned char kDri = 0xDD;
+constexpr unsigned char kRst0 = 0xD0;
+constexpr unsigned char kSof0 = 0xC0;
+constexpr unsigned char kApp0 = 0xE0;
+constexpr unsigned char kApp1 = 0xE1;
+constexpr int kNumRstMarkers = 8;
+constexpr int kDriLength = 4;
+
+// Byte offsets within the SOF segment, starting at the marker
+constexpr std::size_t kSofHeightOffset = 5;
+constexpr std::size_t kSofNumComponentsOffset = 9;
+constexpr std::size_t kSofComponentSize = 3;
+
+constexpr int kBlockSize = 8;
+// Strip heights are a multiple of the largest MCU height used by libjpeg
+constexpr int kStripAlignment = 16;
+constexpr int kMaxRestartInterval = 65535;
+constexpr int kMaxDimension = 65535;
+constexpr std::size_t kMaxSegmentLength = 65535;
+constexpr std::array<unsigned char, 6> kExifHeader = {'E', 'x', 'i',
+                                                      'f', 0,   0};
+constexpr int kStripsPerThread = 4;
+
+struct Layout {
+  std::size_t sof_offset = 0;
+  std::size_t sos_offset = 0;
+  std::size_t entropy_begin = 0;
+  std::size_t entropy_end = 0;
+  int mcu_width = kBlockSize;
+  int mcu_height = kBlockSize;
+};
+
+int ReadU16(const std::vector<unsigned char>& data, std::size_t offset) {
+  return (data[offset] << 8) | data[offset + 1];
+}
+
+void AppendU16(std::vector<unsigned char>* data, int value) {
+  data->push_back(static_cast<unsigned char>((value >> 8) & 0xFF));
+  data->push_back(static_cast<unsigned char>(value & 0xFF));
+}
+
+// Locates the segments needed to splice strips produced by libjpeg
+std::optional<Layout> Parse(const std::vector<unsigned char>& data) {
+  if (data.size() < 4 || data[0] != kMarker || data[1] != kSoi ||
+      data[data.size() - 2] != kMarker || data[data.size() - 1] != kEoi) {
+    return {};
+  }
+
+  Layout layout;
+  bool has_sof = false;
+  std::size_t pos = 2;
+  while (pos + 4 <= data.size()) {
+    if (data[pos] != kMarker) {
+      return {};
+    }
+    const unsigned char marker = data[pos + 1];
+    const auto length = static_cast<std::size_t>(ReadU16(data, pos + 2));
+    const std::size_t segment_end = pos + 2 + length;
+    if (segment_end > data.size()) {
+      return {};
+    }
+
+    if (marker == kSof0) {
+      const std::size_t num_components_offset = pos + kSofNumComponentsOffset;
+      const int num_components = data[num_components_offset];
+      int max_h = 1;
+      int max_v = 1;
+      for (int i = 0; i < num_components; i++) {
+        const unsigned char sampling =
+            data[num_components_offset + 2 + kSofComponentSize * i];
+        max_h = std::max(max_h, sampling >> 4);
+        max_v = std::max(max_v, sampling & 0x0F);
+      }
+      // Non-interleaved scans have one block per MCU
+      if (num_components > 1) {
+        layout.mcu_width = kBlockSize * max_h;
+        layout.mcu_height = kBlockSize * max_v;
+      }
+      layout.sof_offset = pos;
+      has_sof = true;
+    }
+
+    if (marker == kSos) {
+      if (!has_sof) {
+        return {};
+      }
+      layout.sos_offset = pos;
+      layout.entropy_begin = segment_end;
+      layout.entropy_end = data.size() - 2;
+      return layout;
+    }
+    pos = segment_end;
+  }
+  return {};
+}
+
+std::vector<unsigned char> Encode(const cv::Mat& image,
+                                  const std::vector<int>& params) {
+  std::vector<unsigned char> result;
+  if (!cv::imencode(".jpg", image, result, params)) {
+    return {};
+  }
+  return result;
+}
+
+}  // namespace
+
+std::optional<std::vector<unsigned char>> EncodeParallel(
+    const cv::Mat& image, const std::vector<int>& params, mt::Threadpool* pool,
+    const mt::CancelCheck& is_cancelled) {
+  if (image.depth() != CV_8U ||
+      (image.channels() != 1 && image.channels() != 3) ||
+      image.rows > kMaxDimension || image.cols > kMaxDimension) {
+    return {};
+  }
+
+  // Worst case of one block per MCU has to fit the restart interval
+  const int max_mcus_per_row = (image.cols + kBlockSize - 1) / kBlockSize;
+  const int max_strip_height =
+      (kMaxRestartInterval / max_mcus_per_row) * kBlockSize;
+  const int num_threads = static_cast<int>(pool->get_thread_count());
+  int strip_height = (image.rows + num_threads * kStripsPerThread - 1) /
+                     (num_threads * kStripsPerThread);
+  strip_height = ((strip_height + kStripAlignment - 1) / kStripAlignment) *
+                 kStripAlignment;
+  strip_height = std::min(
+      strip_height, (max_strip_height / kStripAlignment) * kStripAlignment);
+
+  const int num_strips = (image.rows + strip_height - 1) / strip_height;
+  if (num_strips <= 1) {
+    auto result = Encode(image, params);
+    if (result.empty()) {
+      return {};
+    }
+    return result;
+  }
+
+  mt::MultiFuture<std::vector<unsigned char>> strips_future;
+  for (int i = 0; i < num_strips; i++) {
+    const int begin = i * strip_height;
+    const int end = std::min(begin + strip_height, image.rows);
+    strips_future.push_back(
+        pool->submit([&image, &params, begin, end, &is_cancelled]() {
+          if (mt::IsCancelled(is_cancelled)) {
+            return std::vector<unsigned char>{};
+          }
+          const trace::Scope scope("jpeg_strip");
+          return Encode(image.rowRange(begin, end), params);
+        }));
+  }
+  strips_future.wait();
+  auto strips = strips_future.get();
+  if (mt::IsCancelled(is_cancelled) ||
+      std::any_of(strips.begin(), strips.end(),
+                  [](const auto& strip) { return strip.empty(); })) {
+    return {};
+  }
+
+  std::vector<Layout> layouts;
+  for (const auto& strip : strips) {
+    auto layout = Parse(strip);
+    if (!layout) {
+      spdlog::warn("Unexpected JPEG strip layout, encoding sequentially");
+      return {};
+    }
+    layouts.push_back(*layout);
+  }
+
+  const auto& header = strips[0];
+  const auto& first = layouts[0];
+  if (strip_height % first.mcu_height != 0) {
+    return {};
+  }
+  const int mcus_per_row =
+      (image.cols + first.mcu_width - 1) / first.mcu_width;
+  const int restart_interval = (strip_height / first.mcu_height) * mcus_per_row;
+  if (restart_interval > kMaxRestartInterval) {
+    return {};
+  }
+
+  std::size_t total_size = header.size();
+  for (int i = 0; i < num_strips; i++) {
+    total_size += layouts[i].entropy_end - layouts[i].entropy_begin + 2;
+  }
+
+  std::vector<unsigned char> result;
+  result.reserve(total_size);
+
+  // Headers up to the scan, except for any restart intervals libjpeg wrote
+  result.insert(result.end(), header.begin(), header.begin() + 2);
+  std::size_t pos = 2;
+  while (pos < first.sos_offset) {
+    const std::size_t segment_end = pos + 2 + ReadU16(header, pos + 2);
+    if (header[pos + 1] != kDri) {
+      result.insert(result.end(), header.begin() + pos,
+                    header.begin() + segment_end);
+    }
+    if (pos == first.sof_offset) {
+      // Patch the image height in the copied SOF segment
+      const std::size_t height_offset =
+          result.size() - (segment_end - pos) + kSofHeightOffset;
+      result[height_offset] = static_cast<unsigned char>(image.rows >> 8);
+      result[height_offset + 1] =
+          static_cast<unsigned char>(image.rows & 0xFF);
+    }
+    pos = segment_end;
+  }
+
+  result.push_back(kMarker);
+  result.push_back(kDri);
+  AppendU16(&result, kDriLength);
+  AppendU16(&result, restart_interval);
+
+  result.insert(result.end(), header.begin() + first.sos_offset,
+                header.begin() + first.entropy_begin);
+
+  for (int i = 0; i < num_strips; i++) {
+    const auto& strip = strips[i];
+    result.insert(result.end(), strip.begin() + layouts[i].entropy_begin,
+                  strip.begin() + layouts[i].entropy_end);
+    if (i < num_strips - 1) {
+      result.push_back(kMarker);
+      result.push_back(kRst0 + (i % kNumRstMarkers));
+    }
+  }
+  result.push_back(kMarker);
+  result.push_back(kEoi);
+  return result;
+}
+
+bool InsertExif(std::vector<unsigned char>* jpeg,
+                const std::vector<unsigned char>& exif) {
+  const std::size_t length = 2 + kExifHeader.size() + exif.size();
+  if (length > kMaxSegmentLength || jpeg->size() < 4 ||
+      (*jpeg)[0] != kMarker || (*jpeg)[1] != kSoi) {
+    return false;
+  }
+
+  std::size_t pos = 2;
+  if ((*jpeg)[pos] == kMarker && (*jpeg)[pos + 1] == kApp0) {
+    pos += 2 + ReadU16(*jpeg, pos + 2);
+  }
+
+  std::vector<unsigned char> segment = {kMarker, kApp1};
+  AppendU16(&segment, static_cast<int>(length));
+  segment.insert(segment.end(), kExifHeader.begin(), kExifHeader.end());
+  segment.insert(segment.end(), exif.begin(), exif.end());
+  jpeg->insert(jpeg->begin() + static_cast<std::ptrdiff_t>(pos),
+               segment.begin(), segment.end());
+  return true;
+}
+
+}  // namespace xpano::utils::jpeg
@@ -0,0 +1,30 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "xpano/utils/threadpool.h"
+
+namespace xpano::utils::jpeg {
+
+// Encodes horizontal strips of the image concurrently and joins them into a
+// single baseline JPEG, each strip is one restart interval.
+//  - params are passed to cv::imencode, they must not enable progressive or
+//    optimized encoding, all strips need to share the same Huffman tables
+//  - returns std::nullopt if the image can't be split this way, or if the
+//    encoding was cancelled
+std::optional<std::vector<unsigned char>> EncodeParallel(
+    const cv::Mat& image, const std::vector<int>& params, mt::Threadpool* pool,
+    const mt::CancelCheck& is_cancelled = {});
+
+// Inserts an APP1 segment with the TIFF structured Exif data after the SOI
+// and JFIF markers, returns false if it doesn't fit into a single segment
+bool InsertExif(std::vector<unsigned char>* jpeg,
+                const std::vector<unsigned char>& exif);
+
+}  // namespace xpano::utils::jpeg
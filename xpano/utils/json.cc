@@ -0,0 +1,406 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/json.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <variant>
+
+#include "xpano/utils/expected.h"
+#include "xpano/utils/fmt.h"
+
+namespace xpano::utils::json {
+
+bool Value::IsNull() const {
+  return std::holds_alternative<std::nullptr_t>(data_);
+}
+
+bool Value::IsBool() const { return std::holds_alternative<bool>(data_); }
+
+bool Value::IsNumber() const { return std::holds_alternative<double>(data_); }
+
+bool Value::IsString() const {
+  return std::holds_alternative<std::string>(data_);
+}
+
+bool Value::IsArray() const { return std::holds_alternative<Array>(data_); }
+
+bool Value::IsObject() const { return std::holds_alternative<Object>(data_); }
+
+bool Value::AsBool() const { return std::get<bool>(data_); }
+
+double Value::AsNumber() const { return std::get<double>(data_); }
+
+const std::string& Value::AsString() const {
+  return std::get<std::string>(data_);
+}
+
+const Value::Array& Value::AsArray() const { return std::get<Array>(data_); }
+
+const Value::Object& Value::AsObject() const {
+  return std::get<Object>(data_);
+}
+
+const Value* Value::Find(std::string_view key) const {
+  if (!IsObject()) {
+    return nullptr;
+  }
+  const auto& object = AsObject();
+  auto member =
+      std::find_if(object.begin(), object.end(),
+                   [key](const auto& member) { return member.first == key; });
+  return member != object.end() ? &member->second : nullptr;
+}
+
+namespace {
+
+constexpr int kMaxDepth = 128;
+
+struct ParseError {
+  std::string message;
+};
+
+class Parser {
+ public:
+  explicit Parser(std::string_view text) : text_(text) {}
+
+  Value ParseDocument() {
+    auto value = ParseValue(0);
+    SkipWhitespace();
+    if (pos_ != text_.size()) {
+      Fail("unexpected trailing characters");
+    }
+    return value;
+  }
+
+  [[nodiscard]] int Line() const {
+    auto end = text_.begin() + static_cast<std::ptrdiff_t>(pos_);
+    return 1 + static_cast<int>(std::count(text_.begin(), end, '\n'));
+  }
+
+ private:
+  [[noreturn]] void Fail(const std::string& message) const {
+    throw ParseError{message};
+  }
+
+  void SkipWhitespace() {
+    while (pos_ < text_.size() &&
+           (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\n' ||
+            text_[pos_] == '\r')) {
+      pos_++;
+    }
+  }
+
+  char Peek() {
+    SkipWhitespace();
+    if (pos_ == text_.size()) {
+      Fail("unexpected end of input");
+    }
+    return text_[pos_];
+  }
+
+  void Expect(char expected) {
+    if (Peek() != expected) {
+      Fail(fmt::format("expected '{}'", expected));
+    }
+    pos_++;
+  }
+
+  bool Consume(std::string_view literal) {
+    if (text_.substr(pos_, literal.size()) == literal) {
+      pos_ += literal.size();
+      return true;
+    }
+    return false;
+  }
+
+  Value ParseValue(int depth) {
+    if (depth > kMaxDepth) {
+      Fail("nesting too deep");
+    }
+    const char next = Peek();
+    if (next == '{') {
+      return ParseObject(depth);
+    }
+    if (next == '[') {
+      return ParseArray(depth);
+    }
+    if (next == '"') {
+      return ParseString();
+    }
+    if (Consume("true")) {
+      return true;
+    }
+    if (Consume("false")) {
+      return false;
+    }
+    if (Consume("null")) {
+      return nullptr;
+    }
+    return ParseNumber();
+  }
+
+  Value ParseObject(int depth) {
+    Expect('{');
+    Value::Object object;
+    if (Peek() == '}') {
+      pos_++;
+      return object;
+    }
+    while (true) {
+      if (Peek() != '"') {
+        Fail("expected a string key");
+      }
+      auto key = ParseString();
+      Expect(':');
+      object.emplace_back(std::move(key), ParseValue(depth + 1));
+      if (Peek() == ',') {
+        pos_++;
+        continue;
+      }
+      Expect('}');
+      return object;
+    }
+  }
+
+  Value ParseArray(int depth) {
+    Expect('[');
+    Value::Array array;
+    if (Peek() == ']') {
+      pos_++;
+      return array;
+    }
+    while (true) {
+      array.push_back(ParseValue(depth + 1));
+      if (Peek() == ',') {
+        pos_++;
+        continue;
+      }
+      Expect(']');
+      return array;
+    }
+  }
+
+  Value ParseNumber() {
+    const std::size_t begin = pos_;
+    if (pos_ < text_.size() && text_[pos_] == '-') {
+      pos_++;
+    }
+    while (pos_ < text_.size() &&
+           (std::isdigit(static_cast<unsigned char>(text_[pos_])) != 0 ||
+            text_[pos_] == '.' || text_[pos_] == 'e' || text_[pos_] == 'E' ||
+            text_[pos_] == '+' || text_[pos_] == '-')) {
+      pos_++;
+    }
+    // Locale independent, unlike std::stod
+    const char* first = text_.data() + begin;
+    const char* last = text_.data() + pos_;
+    double value = 0.0;
+    auto [end, error] = std::from_chars(first, last, value);
+    if (first == last || error != std::errc() || end != last ||
+        !std::isfinite(value)) {
+      pos_ = begin;
+      Fail("invalid value");
+    }
+    return value;
+  }
+
+  unsigned ParseHex4() {
+    if (pos_ + 4 > text_.size()) {
+      Fail("invalid unicode escape");
+    }
+    unsigned code = 0;
+    auto [end, error] =
+        std::from_chars(text_.data() + pos_, text_.data() + pos_ + 4, code, 16);
+    if (error != std::errc() || end != text_.data() + pos_ + 4) {
+      Fail("invalid unicode escape");
+    }
+    pos_ += 4;
+    return code;
+  }
+
+  static void AppendUtf8(unsigned code, std::string* output) {
+    if (code < 0x80) {
+      output->push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+      output->push_back(static_cast<char>(0xC0 | (code >> 6)));
+      output->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+      output->push_back(static_cast<char>(0xE0 | (code >> 12)));
+      output->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+      output->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+      output->push_back(static_cast<char>(0xF0 | (code >> 18)));
+      output->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+      output->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+      output->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+  }
+
+  std::string ParseString() {
+    Expect('"');
+    std::string result;
+    while (true) {
+      if (pos_ == text_.size()) {
+        Fail("unterminated string");
+      }
+      const char next = text_[pos_++];
+      if (next == '"') {
+        return result;
+      }
+      if (static_cast<unsigned char>(next) < 0x20) {
+        Fail("control character in string");
+      }
+      if (next != '\\') {
+        result.push_back(next);
+        continue;
+      }
+      if (pos_ == text_.size()) {
+        Fail("unterminated string");
+      }
+      switch (const char escaped = text_[pos_++]; escaped) {
+        case '"':
+        case '\\':
+        case '/':
+          result.push_back(escaped);
+          break;
+        case 'b':
+          result.push_back('\b');
+          break;
+        case 'f':
+          result.push_back('\f');
+          break;
+        case 'n':
+          result.push_back('\n');
+          break;
+        case 'r':
+          result.push_back('\r');
+          break;
+        case 't':
+          result.push_back('\t');
+          break;
+        case 'u': {
+          unsigned code = ParseHex4();
+          if (code >= 0xD800 && code < 0xDC00) {
+            if (!Consume("\\u")) {
+              Fail("invalid surrogate pair");
+            }
+            const unsigned low = ParseHex4();
+            if (low < 0xDC00 || low >= 0xE000) {
+              Fail("invalid surrogate pair");
+            }
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          }
+          AppendUtf8(code, &result);
+          break;
+        }
+        default:
+          Fail("invalid escape sequence");
+      }
+    }
+  }
+
+  std::string_view text_;
+  std::size_t pos_ = 0;
+};
+
+void DumpString(const std::string& text, std::string* output) {
+  output->push_back('"');
+  for (const char character : text) {
+    switch (character) {
+      case '"':
+        *output += "\\\"";
+        break;
+      case '\\':
+        *output += "\\\\";
+        break;
+      case '\n':
+        *output += "\\n";
+        break;
+      case '\r':
+        *output += "\\r";
+        break;
+      case '\t':
+        *output += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(character) < 0x20) {
+          *output += fmt::format("\\u{:04x}", static_cast<int>(character));
+        } else {
+          output->push_back(character);
+        }
+    }
+  }
+  output->push_back('"');
+}
+
+void DumpValue(const Value& value, int indent, std::string* output) {
+  const std::string padding(2 * (indent + 1), ' ');
+  const std::string closing_padding(2 * indent, ' ');
+  if (value.IsNull()) {
+    *output += "null";
+  } else if (value.IsBool()) {
+    *output += value.AsBool() ? "true" : "false";
+  } else if (value.IsNumber()) {
+    *output += fmt::format("{}", value.AsNumber());
+  } else if (value.IsString()) {
+    DumpString(value.AsString(), output);
+  } else if (value.IsArray()) {
+    const auto& array = value.AsArray();
+    if (array.empty()) {
+      *output += "[]";
+      return;
+    }
+    *output += "[\n";
+    for (std::size_t i = 0; i < array.size(); i++) {
+      *output += padding;
+      DumpValue(array[i], indent + 1, output);
+      *output += i + 1 < array.size() ? ",\n" : "\n";
+    }
+    *output += closing_padding + "]";
+  } else {
+    const auto& object = value.AsObject();
+    if (object.empty()) {
+      *output += "{}";
+      return;
+    }
+    *output += "{\n";
+    for (std::size_t i = 0; i < object.size(); i++) {
+      *output += padding;
+      DumpString(object[i].first, output);
+      *output += ": ";
+      DumpValue(object[i].second, indent + 1, output);
+      *output += i + 1 < object.size() ? ",\n" : "\n";
+    }
+    *output += closing_padding + "}";
+  }
+}
+
+}  // namespace
+
+Expected<Value, std::string> Parse(std::string_view text) {
+  Parser parser(text);
+  try {
+    return parser.ParseDocument();
+  } catch (const ParseError& error) {
+    return Unexpected<std::string>(
+        fmt::format("line {}: {}", parser.Line(), error.message));
+  }
+}
+
+std::string Dump(const Value& value) {
+  std::string output;
+  DumpValue(value, 0, &output);
+  output.push_back('\n');
+  return output;
+}
+
+}  // namespace xpano::utils::json
@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "xpano/utils/expected.h"
+
+namespace xpano::utils::json {
+
+// Minimal JSON document model, enough for the batch manifests and reports.
+// Objects keep the order of their members.
+class Value {
+ public:
+  using Array = std::vector<Value>;
+  using Member = std::pair<std::string, Value>;
+  using Object = std::vector<Member>;
+
+  Value() = default;
+  Value(std::nullptr_t /*null*/) {}
+  Value(bool value) : data_(value) {}
+  Value(int value) : data_(static_cast<double>(value)) {}
+  Value(double value) : data_(value) {}
+  Value(const char* value) : data_(std::string(value)) {}
+  Value(std::string value) : data_(std::move(value)) {}
+  Value(Array value) : data_(std::move(value)) {}
+  Value(Object value) : data_(std::move(value)) {}
+
+  [[nodiscard]] bool IsNull() const;
+  [[nodiscard]] bool IsBool() const;
+  [[nodiscard]] bool IsNumber() const;
+  [[nodiscard]] bool IsString() const;
+  [[nodiscard]] bool IsArray() const;
+  [[nodiscard]] bool IsObject() const;
+
+  // Throw std::bad_variant_access if the value has a different type
+  [[nodiscard]] bool AsBool() const;
+  [[nodiscard]] double AsNumber() const;
+  [[nodiscard]] const std::string& AsString() const;
+  [[nodiscard]] const Array& AsArray() const;
+  [[nodiscard]] const Object& AsObject() const;
+
+  // Returns nullptr if the value is not an object or the key is missing
+  [[nodiscard]] const Value* Find(std::string_view key) const;
+
+ private:
+  std::variant<std::nullptr_t, bool, double, std::string, Array, Object>
+      data_ = nullptr;
+};
+
+// Returns the error message with the line number on failure
+Expected<Value, std::string> Parse(std::string_view text);
+
+// Indented with two spaces
+std::string Dump(const Value& value);
+
+}  // namespace xpano::utils::json
@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <optional>
+#include <utility>
+
+namespace xpano::utils {
+
+// Keeps the most recently used values while their total cost fits into the
+// limit, a value more expensive than the limit is not kept at all. The keys
+// are compared with operator==, meant for a handful of large values.
+template <typename TKey, typename TValue>
+class LruCache {
+ public:
+  explicit LruCache(std::int64_t max_cost) : max_cost_(max_cost) {}
+
+  // Marks the value as the most recently used
+  std::optional<TValue> Find(const TKey& key) {
+    auto entry = FindEntry(key);
+    if (entry == entries_.end()) {
+      return {};
+    }
+    entries_.splice(entries_.begin(), entries_, entry);
+    return entry->value;
+  }
+
+  void Insert(TKey key, TValue value, std::int64_t cost) {
+    if (auto entry = FindEntry(key); entry != entries_.end()) {
+      cost_ -= entry->cost;
+      entries_.erase(entry);
+    }
+    if (cost > max_cost_) {
+      return;
+    }
+    entries_.push_front({std::move(key), std::move(value), cost});
+    cost_ += cost;
+    while (cost_ > max_cost_) {
+      cost_ -= entries_.back().cost;
+      entries_.pop_back();
+    }
+  }
+
+  template <typename TPredicate>
+  void EraseIf(TPredicate predicate) {
+    for (auto entry = entries_.begin(); entry != entries_.end();) {
+      if (predicate(entry->key)) {
+        cost_ -= entry->cost;
+        entry = entries_.erase(entry);
+      } else {
+        entry = std::next(entry);
+      }
+    }
+  }
+
+  void Clear() {
+    entries_.clear();
+    cost_ = 0;
+  }
+
+  [[nodiscard]] std::int64_t Cost() const { return cost_; }
+
+ private:
+  struct Entry {
+    TKey key;
+    TValue value;
+    std::int64_t cost;
+  };
+
+  auto FindEntry(const TKey& key) {
+    auto entry = entries_.begin();
+    while (entry != entries_.end() && !(entry->key == key)) {
+      entry = std::next(entry);
+    }
+    return entry;
+  }
+
+  std::int64_t max_cost_;
+  std::int64_t cost_ = 0;
+  // The most recently used first
+  std::list<Entry> entries_;
+};
+
+}  // namespace xpano::utils
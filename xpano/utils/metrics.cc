@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+// windows.h has to be included first
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>  // NOLINT(modernize-deprecated-headers)
+#endif
+
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define XPANO_HAS_MALLINFO2
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+namespace xpano::utils::metrics {
+
+namespace {
+
+double ThreadCpuSeconds() {
+#ifdef _WIN32
+  FILETIME creation;
+  FILETIME exit;
+  FILETIME kernel;
+  FILETIME user;
+  if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user) ==
+      0) {
+    return 0.0;
+  }
+  auto to_100ns = [](const FILETIME& time) {
+    return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) |
+           time.dwLowDateTime;
+  };
+  return static_cast<double>(to_100ns(kernel) + to_100ns(user)) * 1e-7;
+#else
+  timespec time{};
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+    return 0.0;
+  }
+  return static_cast<double>(time.tv_sec) +
+         static_cast<double>(time.tv_nsec) * 1e-9;
+#endif
+}
+
+std::int64_t HeapBytes() {
+#if defined(XPANO_HAS_MALLINFO2)
+  // Large blocks are allocated with mmap and counted separately
+  const auto info = mallinfo2();
+  return static_cast<std::int64_t>(info.uordblks + info.hblkhd);
+#elif defined(__APPLE__)
+  malloc_statistics_t stats;
+  malloc_zone_statistics(nullptr, &stats);
+  return static_cast<std::int64_t>(stats.size_in_use);
+#else
+  return 0;
+#endif
+}
+
+}  // namespace
+
+Sample Now() {
+  return {.wall = std::chrono::steady_clock::now(),
+          .cpu_seconds = ThreadCpuSeconds(),
+          .heap_bytes = HeapBytes()};
+}
+
+std::int64_t PeakRssBytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                              sizeof(counters)) == 0) {
+    return 0;
+  }
+  return static_cast<std::int64_t>(counters.PeakWorkingSetSize);
+#else
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  // Reported in KiB on Linux
+  return static_cast<std::int64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void Recorder::Add(std::string_view name, const Sample& start,
+                   const Sample& end, std::string_view label) {
+  const Stage occurrence = {
+      .name = std::string(label),
+      .count = 1,
+      .wall_seconds =
+          std::chrono::duration<double>(end.wall - start.wall).count(),
+      .cpu_seconds = end.cpu_seconds - start.cpu_seconds,
+      .allocated_bytes = end.heap_bytes - start.heap_bytes,
+      .peak_rss_bytes = PeakRssBytes()};
+
+  const std::lock_guard lock(mut_);
+  auto stage = std::find_if(stages_.begin(), stages_.end(),
+                            [name](const auto& stage) {
+                              return stage.name == name;
+                            });
+  if (stage == stages_.end()) {
+    stage = stages_.insert(stages_.end(), Stage{.name = std::string(name)});
+  }
+  stage->count++;
+  stage->wall_seconds += occurrence.wall_seconds;
+  stage->cpu_seconds += occurrence.cpu_seconds;
+  stage->allocated_bytes += occurrence.allocated_bytes;
+  stage->peak_rss_bytes =
+      std::max(stage->peak_rss_bytes, occurrence.peak_rss_bytes);
+  if (!label.empty()) {
+    stage->occurrences.push_back(occurrence);
+  }
+}
+
+Stages Recorder::Snapshot() const {
+  const std::lock_guard lock(mut_);
+  return stages_;
+}
+
+ScopedStage::ScopedStage(Recorder* recorder, std::string_view name,
+                         std::string_view label)
+    : recorder_(recorder), name_(name), label_(label) {
+  if (recorder_ != nullptr) {
+    start_ = Now();
+  }
+}
+
+ScopedStage::~ScopedStage() { End(); }
+
+void ScopedStage::Next(std::string_view name) {
+  End();
+  name_ = name;
+  if (recorder_ != nullptr) {
+    start_ = Now();
+  }
+}
+
+void ScopedStage::End() {
+  if (recorder_ != nullptr && !name_.empty()) {
+    recorder_->Add(name_, start_, Now(), label_);
+  }
+  name_.clear();
+}
+
+}  // namespace xpano::utils::metrics
@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace xpano::utils::metrics {
+
+// Resource counters at a point in time
+struct Sample {
+  std::chrono::steady_clock::time_point wall;
+  // CPU time of the calling thread
+  double cpu_seconds = 0.0;
+  // Heap in use by the whole process, 0 where not available
+  std::int64_t heap_bytes = 0;
+};
+
+Sample Now();
+
+// Peak resident set size of the process, 0 where not available
+std::int64_t PeakRssBytes();
+
+// Totals over all occurrences of a stage, e.g. all the matched image pairs
+struct Stage {
+  std::string name;
+  int count = 0;
+  double wall_seconds = 0.0;
+  double cpu_seconds = 0.0;
+  // Net heap growth, approximate when other stages run at the same time
+  std::int64_t allocated_bytes = 0;
+  // Peak RSS of the whole process so far when the stage ended, the maximum
+  // over occurrences. Not the peak of the stage itself: it includes
+  // everything that ran earlier or at the same time.
+  std::int64_t peak_rss_bytes = 0;
+  // The labeled occurrences, e.g. "3-4" for a matched pair, in the order
+  // they ended. Their name is the label.
+  std::vector<Stage> occurrences;
+};
+
+using Stages = std::vector<Stage>;
+
+// Collects the stages of a single task, thread-safe
+class Recorder {
+ public:
+  // The occurrence is kept separately under the totals if it has a label
+  void Add(std::string_view name, const Sample& start, const Sample& end,
+           std::string_view label = {});
+
+  // In the order of the first occurrence
+  [[nodiscard]] Stages Snapshot() const;
+
+ private:
+  mutable std::mutex mut_;
+  Stages stages_;
+};
+
+// Records the stage when destroyed, does nothing without a recorder
+class ScopedStage {
+ public:
+  ScopedStage(Recorder* recorder, std::string_view name,
+              std::string_view label = {});
+  ~ScopedStage();
+
+  ScopedStage(const ScopedStage&) = delete;
+  ScopedStage& operator=(const ScopedStage&) = delete;
+  ScopedStage(ScopedStage&&) = delete;
+  ScopedStage& operator=(ScopedStage&&) = delete;
+
+  // Ends the current stage and starts the next one, with the same label
+  void Next(std::string_view name);
+  void End();
+
+ private:
+  Recorder* recorder_;
+  std::string name_;
+  std::string label_;
+  Sample start_;
+};
+
+}  // namespace xpano::utils::metrics
@@ -5,9 +5,12 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <filesystem>
 #include <iterator>
+#include <optional>
 #include <string>
+#include <system_error>
 #include <vector>
 
 #include "xpano/constants.h"
@@ -36,10 +39,54 @@ bool IsExtensionSupported(const std::filesystem::path& path) {
   return ContainsExtensionIgnoreCase(kSupportedExtensions, path);
 }
 
+bool IsExportExtensionSupported(const std::filesystem::path& path) {
+  return IsExtensionSupported(path) ||
+         ContainsExtensionIgnoreCase(kExportOnlyExtensions, path);
+}
+
 bool IsMetadataExtensionSupported(const std::filesystem::path& path) {
   return ContainsExtensionIgnoreCase(kMetadataSupportedExtensions, path);
 }
 
+bool IsJpegExtension(const std::filesystem::path& path) {
+  return ContainsExtensionIgnoreCase(kJpegExtensions, path);
+}
+
+bool IsPngExtension(const std::filesystem::path& path) {
+  return ContainsExtensionIgnoreCase(kPngExtensions, path);
+}
+
+bool IsTiffExtension(const std::filesystem::path& path) {
+  return ContainsExtensionIgnoreCase(kTiffExtensions, path);
+}
+
+bool IsPyramidTiffExtension(const std::filesystem::path& path) {
+  return ContainsExtensionIgnoreCase(kPyramidTiffExtensions, path);
+}
+
+bool IsDeepZoomExtension(const std::filesystem::path& path) {
+  return ContainsExtensionIgnoreCase(kDeepZoomExtensions, path);
+}
+
+bool IsSessionExtension(const std::filesystem::path& path) {
+  return ContainsExtensionIgnoreCase(kSessionExtensions, path);
+}
+
+std::optional<FileIdentity> Identity(const std::filesystem::path& path) {
+  std::error_code error;
+  auto size = std::filesystem::file_size(path, error);
+  if (error) {
+    return {};
+  }
+  auto last_write = std::filesystem::last_write_time(path, error);
+  if (error) {
+    return {};
+  }
+  return FileIdentity{.size = static_cast<std::uint64_t>(size),
+                      .last_write = static_cast<std::int64_t>(
+                          last_write.time_since_epoch().count())};
+}
+
 std::vector<std::filesystem::path> KeepSupported(
     const std::vector<std::filesystem::path>& paths) {
   std::vector<std::filesystem::path> valid_paths;
@@ -3,15 +3,40 @@
 
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <optional>
 #include <vector>
 
 namespace xpano::utils::path {
 
 bool IsExtensionSupported(const std::filesystem::path& path);
 
+bool IsExportExtensionSupported(const std::filesystem::path& path);
+
 bool IsMetadataExtensionSupported(const std::filesystem::path& path);
 
+bool IsJpegExtension(const std::filesystem::path& path);
+
+bool IsPngExtension(const std::filesystem::path& path);
+
+bool IsTiffExtension(const std::filesystem::path& path);
+
+bool IsPyramidTiffExtension(const std::filesystem::path& path);
+
+bool IsDeepZoomExtension(const std::filesystem::path& path);
+
+bool IsSessionExtension(const std::filesystem::path& path);
+
+// Changes when the file is modified or replaced
+struct FileIdentity {
+  std::uint64_t size = 0;
+  std::int64_t last_write = 0;
+  bool operator==(const FileIdentity&) const = default;
+};
+
+std::optional<FileIdentity> Identity(const std::filesystem::path& path);
+
 std::vector<std::filesystem::path> KeepSupported(
     const std::vector<std::filesystem::path>& paths);
 
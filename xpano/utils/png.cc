@@ -0,0 +1,273 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/png.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "xpano/utils/threadpool.h"
+#include "xpano/utils/trace.h"
+#include "xpano/utils/zlib.h"
+
+namespace xpano::utils::png {
+
+namespace {
+
+constexpr std::array<unsigned char, 8> kSignature = {0x89, 'P',  'N',  'G',
+                                                     '\r', '\n', 0x1A, '\n'};
+constexpr int kNumFilters = 5;
+constexpr int kStripsPerThread = 4;
+constexpr std::size_t kMinStripSize = 1 << 20;
+
+enum class ColorType : std::uint8_t {
+  kGray = 0,
+  kRgb = 2,
+  kRgba = 6,
+};
+
+enum class Filter : std::uint8_t {
+  kNone = 0,
+  kSub = 1,
+  kUp = 2,
+  kAverage = 3,
+  kPaeth = 4,
+};
+
+struct Strip {
+  std::vector<unsigned char> data;
+  std::uint32_t adler;
+  std::size_t raw_size;
+};
+
+void AppendU32(std::vector<unsigned char>* data, std::uint32_t value) {
+  data->push_back(static_cast<unsigned char>((value >> 24) & 0xFF));
+  data->push_back(static_cast<unsigned char>((value >> 16) & 0xFF));
+  data->push_back(static_cast<unsigned char>((value >> 8) & 0xFF));
+  data->push_back(static_cast<unsigned char>(value & 0xFF));
+}
+
+void AppendChunk(std::vector<unsigned char>* result, const std::string& type,
+                 std::span<const unsigned char> data) {
+  AppendU32(result, static_cast<std::uint32_t>(data.size()));
+  const std::size_t type_offset = result->size();
+  result->insert(result->end(), type.begin(), type.end());
+  result->insert(result->end(), data.begin(), data.end());
+  auto crc = zlib::Crc32(
+      0, std::span(result->data() + type_offset, result->size() - type_offset));
+  AppendU32(result, crc);
+}
+
+// Row in the PNG sample order: RGB(A), big endian samples
+void ConvertRow(const cv::Mat& image, int row, unsigned char* output) {
+  const int channels = image.channels();
+  const int sample_size = static_cast<int>(image.elemSize1());
+  const unsigned char* input = image.ptr<unsigned char>(row);
+  for (int col = 0; col < image.cols; col++) {
+    for (int channel = 0; channel < channels; channel++) {
+      // Swap B and R
+      int source_channel = channel;
+      if (channels >= 3 && channel < 3) {
+        source_channel = 2 - channel;
+      }
+      const unsigned char* sample =
+          input + (col * channels + source_channel) * sample_size;
+      unsigned char* target = output + (col * channels + channel) * sample_size;
+      if (sample_size == 1) {
+        target[0] = sample[0];
+      } else {
+        // Host is little endian for all supported platforms
+        target[0] = sample[1];
+        target[1] = sample[0];
+      }
+    }
+  }
+}
+
+unsigned char Paeth(int left, int up, int up_left) {
+  const int estimate = left + up - up_left;
+  const int dist_left = std::abs(estimate - left);
+  const int dist_up = std::abs(estimate - up);
+  const int dist_up_left = std::abs(estimate - up_left);
+  if (dist_left <= dist_up && dist_left <= dist_up_left) {
+    return static_cast<unsigned char>(left);
+  }
+  if (dist_up <= dist_up_left) {
+    return static_cast<unsigned char>(up);
+  }
+  return static_cast<unsigned char>(up_left);
+}
+
+void ApplyFilter(Filter filter, std::span<const unsigned char> row,
+                 std::span<const unsigned char> prev_row, std::size_t bpp,
+                 unsigned char* output) {
+  for (std::size_t i = 0; i < row.size(); i++) {
+    const int left = i >= bpp ? row[i - bpp] : 0;
+    const int up = prev_row[i];
+    const int up_left = i >= bpp ? prev_row[i - bpp] : 0;
+    int prediction = 0;
+    switch (filter) {
+      case Filter::kSub:
+        prediction = left;
+        break;
+      case Filter::kUp:
+        prediction = up;
+        break;
+      case Filter::kAverage:
+        prediction = (left + up) / 2;
+        break;
+      case Filter::kPaeth:
+        prediction = Paeth(left, up, up_left);
+        break;
+      default:
+        break;
+    }
+    output[i] = static_cast<unsigned char>(row[i] - prediction);
+  }
+}
+
+// Minimum sum of absolute differences heuristic, same as libpng
+int FilterCost(std::span<const unsigned char> filtered) {
+  int cost = 0;
+  for (const unsigned char value : filtered) {
+    cost += value < 128 ? value : 256 - value;
+  }
+  return cost;
+}
+
+Strip EncodeStrip(const cv::Mat& image, int begin, int end, int compression,
+                  bool last) {
+  const std::size_t bpp = image.elemSize();
+  const std::size_t row_size = image.cols * bpp;
+
+  std::vector<unsigned char> row(row_size);
+  std::vector<unsigned char> prev_row(row_size, 0);
+  if (begin > 0) {
+    ConvertRow(image, begin - 1, prev_row.data());
+  }
+
+  std::vector<unsigned char> candidate(row_size);
+  std::vector<unsigned char> filtered((end - begin) * (row_size + 1));
+  for (int y = begin; y < end; y++) {
+    ConvertRow(image, y, row.data());
+    unsigned char* output = &filtered[(y - begin) * (row_size + 1)];
+
+    auto best_filter = Filter::kNone;
+    std::copy(row.begin(), row.end(), output + 1);
+    if (compression > 0) {
+      int best_cost = FilterCost(row);
+      for (int i = 1; i < kNumFilters; i++) {
+        auto filter = static_cast<Filter>(i);
+        ApplyFilter(filter, row, prev_row, bpp, candidate.data());
+        if (int cost = FilterCost(candidate); cost < best_cost) {
+          best_cost = cost;
+          best_filter = filter;
+          std::copy(candidate.begin(), candidate.end(), output + 1);
+        }
+      }
+    }
+    output[0] = static_cast<unsigned char>(best_filter);
+    std::swap(row, prev_row);
+  }
+
+  return {.data = zlib::DeflateChunk(filtered, compression, last),
+          .adler = zlib::Adler32(filtered),
+          .raw_size = filtered.size()};
+}
+
+std::optional<ColorType> GetColorType(const cv::Mat& image) {
+  switch (image.channels()) {
+    case 1:
+      return ColorType::kGray;
+    case 3:
+      return ColorType::kRgb;
+    case 4:
+      return ColorType::kRgba;
+    default:
+      return {};
+  }
+}
+
+}  // namespace
+
+std::optional<std::vector<unsigned char>> EncodeParallel(
+    const cv::Mat& image, int compression, mt::Threadpool* pool,
+    const mt::CancelCheck& is_cancelled) {
+  auto color_type = GetColorType(image);
+  if (!zlib::Enabled() || !color_type ||
+      (image.depth() != CV_8U && image.depth() != CV_16U) || image.empty()) {
+    return {};
+  }
+
+  const std::size_t row_size = image.cols * image.elemSize() + 1;
+  const int num_threads = static_cast<int>(pool->get_thread_count());
+  const int min_strip_height =
+      static_cast<int>(std::max<std::size_t>(1, kMinStripSize / row_size));
+  const int strip_height =
+      std::max(min_strip_height,
+               (image.rows + num_threads * kStripsPerThread - 1) /
+                   (num_threads * kStripsPerThread));
+  const int num_strips = (image.rows + strip_height - 1) / strip_height;
+
+  mt::MultiFuture<Strip> strips_future;
+  for (int i = 0; i < num_strips; i++) {
+    const int begin = i * strip_height;
+    const int end = std::min(begin + strip_height, image.rows);
+    const bool last = i == num_strips - 1;
+    strips_future.push_back(
+        pool->submit([&image, begin, end, compression, last, &is_cancelled]() {
+          if (mt::IsCancelled(is_cancelled)) {
+            return Strip{};
+          }
+          const trace::Scope scope("png_strip");
+          return EncodeStrip(image, begin, end, compression, last);
+        }));
+  }
+  strips_future.wait();
+  auto strips = strips_future.get();
+  if (mt::IsCancelled(is_cancelled)) {
+    return {};
+  }
+
+  std::vector<unsigned char> result(kSignature.begin(), kSignature.end());
+
+  std::vector<unsigned char> header;
+  AppendU32(&header, image.cols);
+  AppendU32(&header, image.rows);
+  header.push_back(static_cast<unsigned char>(image.elemSize1() * 8));
+  header.push_back(static_cast<unsigned char>(*color_type));
+  header.push_back(0);  // compression method: deflate
+  header.push_back(0);  // filter method: adaptive
+  header.push_back(0);  // interlace method: none
+  AppendChunk(&result, "IHDR", header);
+
+  auto stream_header = zlib::StreamHeader(compression);
+  std::uint32_t adler = strips[0].adler;
+  for (int i = 0; i < num_strips; i++) {
+    auto& data = strips[i].data;
+    if (i == 0) {
+      data.insert(data.begin(), stream_header.begin(), stream_header.end());
+    } else {
+      adler = zlib::Adler32Combine(adler, strips[i].adler, strips[i].raw_size);
+    }
+    if (i == num_strips - 1) {
+      AppendU32(&data, adler);
+    }
+    AppendChunk(&result, "IDAT", data);
+  }
+
+  AppendChunk(&result, "IEND", {});
+  return result;
+}
+
+}  // namespace xpano::utils::png
@@ -0,0 +1,25 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "xpano/utils/threadpool.h"
+
+namespace xpano::utils::png {
+
+// Filters and deflates horizontal strips of the image concurrently, the
+// strips are joined into a single zlib stream stored in consecutive IDAT
+// chunks.
+//  - supports 8 and 16 bit grayscale, BGR and BGRA images
+//  - returns std::nullopt if the image format is not supported, or if the
+//    encoding was cancelled
+std::optional<std::vector<unsigned char>> EncodeParallel(
+    const cv::Mat& image, int compression, mt::Threadpool* pool,
+    const mt::CancelCheck& is_cancelled = {});
+
+}  // namespace xpano::utils::png
@@ -4,6 +4,7 @@
 #include "xpano/utils/sdl_.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <filesystem>
 #include <memory>
@@ -18,6 +19,13 @@
 
 namespace xpano::utils::sdl {
 
+namespace {
+
+// Returned by SDL_RegisterEvents when out of event types
+constexpr auto kInvalidEventType = static_cast<std::uint32_t>(-1);
+
+}  // namespace
+
 WindowManager DetermineWindowManager(bool wayland_supported) {
 #ifdef _WIN32
   spdlog::info("WM: Windows");
@@ -143,6 +151,31 @@ float DpiHandler::QueryDpiScale() const {
 
 // NOLINTEND(bugprone-branch-clone)
 
+EventNotifier::EventNotifier() : event_type_(SDL_RegisterEvents(1)) {
+  if (event_type_ == kInvalidEventType) {
+    spdlog::warn("Couldn't register a wake up event: {}", SDL_GetError());
+  }
+}
+
+void EventNotifier::Notify() {
+  if (event_type_ == kInvalidEventType || pending_.exchange(true)) {
+    return;
+  }
+  SDL_Event event{};
+  event.type = event_type_;
+  if (SDL_PushEvent(&event) < 1) {
+    pending_ = false;
+  }
+}
+
+bool EventNotifier::Consume(const SDL_Event& event) {
+  if (event_type_ == kInvalidEventType || event.type != event_type_) {
+    return false;
+  }
+  pending_ = false;
+  return true;
+}
+
 std::optional<std::filesystem::path> InitializePrefPath() {
   auto sdl_pref_path = std::unique_ptr<char, decltype(&SDL_free)>(
       SDL_GetPrefPath(kOrgName.c_str(), kAppName.c_str()), &SDL_free);
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <filesystem>
 #include <optional>
@@ -39,6 +40,22 @@ class DpiHandler {
   float dpi_scale_ = 0.0f;
 };
 
+// Wakes up the main loop waiting in SDL_WaitEventTimeout, Notify() can be
+// called from any thread. Repeated calls push a single event until the main
+// loop consumes it.
+class EventNotifier {
+ public:
+  EventNotifier();
+
+  void Notify();
+  // Returns true for the notifier's own events
+  bool Consume(const SDL_Event& event);
+
+ private:
+  std::uint32_t event_type_;
+  std::atomic<bool> pending_ = false;
+};
+
 std::optional<std::filesystem::path> InitializePrefPath();
 
 std::optional<std::filesystem::path> InitializeBasePath();
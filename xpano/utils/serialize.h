@@ -8,15 +8,12 @@
 #define ALPACA_EXCLUDE_SUPPORT_STD_DEQUE
 #define ALPACA_EXCLUDE_SUPPORT_STD_LIST
 #define ALPACA_EXCLUDE_SUPPORT_STD_MAP
-#define ALPACA_EXCLUDE_SUPPORT_STD_OPTIONAL
 #define ALPACA_EXCLUDE_SUPPORT_STD_SET
-#define ALPACA_EXCLUDE_SUPPORT_STD_STRING
 #define ALPACA_EXCLUDE_SUPPORT_STD_PAIR
 #define ALPACA_EXCLUDE_SUPPORT_STD_UNIQUE_PTR
 #define ALPACA_EXCLUDE_SUPPORT_STD_UNORDERED_MAP
 #define ALPACA_EXCLUDE_SUPPORT_STD_UNORDERED_SET
 #define ALPACA_EXCLUDE_SUPPORT_STD_VARIANT
-#define ALPACA_EXCLUDE_SUPPORT_STD_VECTOR
 
 #include <cstdint>
 #include <filesystem>
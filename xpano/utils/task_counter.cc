@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/task_counter.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace xpano::utils::mt {
+
+void TaskCounter::Add() {
+  const std::lock_guard lock(mut_);
+  running_++;
+}
+
+void TaskCounter::Done() {
+  bool idle = false;
+  {
+    const std::lock_guard lock(mut_);
+    running_--;
+    idle = running_ == 0;
+  }
+  if (idle) {
+    idle_.notify_all();
+  }
+}
+
+bool TaskCounter::IsIdle() const {
+  const std::lock_guard lock(mut_);
+  return running_ == 0;
+}
+
+bool TaskCounter::WaitUntilIdle(std::chrono::milliseconds timeout) {
+  std::unique_lock lock(mut_);
+  return idle_.wait_for(lock, timeout, [this]() { return running_ == 0; });
+}
+
+}  // namespace xpano::utils::mt
@@ -0,0 +1,30 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace xpano::utils::mt {
+
+// Counts the running tasks, other threads can wait until none is running
+class TaskCounter {
+ public:
+  void Add();
+  // Wakes up the waiting threads once the last task is done
+  void Done();
+
+  [[nodiscard]] bool IsIdle() const;
+
+  // Returns false on timeout
+  bool WaitUntilIdle(std::chrono::milliseconds timeout);
+
+ private:
+  int running_ = 0;
+  mutable std::mutex mut_;
+  std::condition_variable idle_;
+};
+
+}  // namespace xpano::utils::mt
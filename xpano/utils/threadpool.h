@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include <BS_thread_pool.hpp>
 
 namespace xpano::utils::mt {
@@ -12,4 +14,12 @@ using MultiFuture = BS::multi_future<TResultType>;
 
 using Threadpool = BS::thread_pool;
 
+// Polled by the subtasks before they start, they skip their work once it
+// returns true. Empty if the work can't be cancelled.
+using CancelCheck = std::function<bool()>;
+
+inline bool IsCancelled(const CancelCheck& is_cancelled) {
+  return is_cancelled && is_cancelled();
+}
+
 }  // namespace xpano::utils::mt
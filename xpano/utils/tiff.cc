@@ -0,0 +1,588 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/tiff.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "xpano/utils/threadpool.h"
+#include "xpano/utils/trace.h"
+#include "xpano/utils/zlib.h"
+
+namespace xpano::utils::tiff {
+
+namespace {
+
+enum class Type : std::uint16_t {
+  kAscii = 2,
+  kShort = 3,
+  kLong = 4,
+  kRational = 5,
+  kLong8 = 16,
+};
+
+enum Tag : std::uint16_t {
+  kNewSubfileType = 254,
+  kImageWidth = 256,
+  kImageLength = 257,
+  kBitsPerSample = 258,
+  kCompression = 259,
+  kPhotometricInterpretation = 262,
+  kStripOffsets = 273,
+  kSamplesPerPixel = 277,
+  kRowsPerStrip = 278,
+  kStripByteCounts = 279,
+  kXResolution = 282,
+  kYResolution = 283,
+  kPlanarConfiguration = 284,
+  kResolutionUnit = 296,
+  kPredictor = 317,
+  kTileWidth = 322,
+  kTileLength = 323,
+  kTileOffsets = 324,
+  kTileByteCounts = 325,
+  kExtraSamples = 338,
+  kExifIfd = 34665,
+  kGpsIfd = 34853,
+};
+
+constexpr std::uint16_t kCompressionNone = 1;
+constexpr std::uint16_t kCompressionDeflate = 8;
+constexpr std::uint16_t kPhotometricMinIsBlack = 1;
+constexpr std::uint16_t kPhotometricRgb = 2;
+constexpr std::uint16_t kPlanarContiguous = 1;
+constexpr std::uint16_t kPredictorHorizontal = 2;
+constexpr std::uint16_t kExtraSampleUnassociatedAlpha = 2;
+constexpr std::uint16_t kResolutionUnitInch = 2;
+constexpr std::uint32_t kDefaultResolution = 72;
+constexpr std::uint32_t kSubfileReducedImage = 1;
+
+constexpr std::uint16_t kClassicVersion = 42;
+constexpr std::uint16_t kBigTiffVersion = 43;
+constexpr std::uint16_t kBigTiffOffsetSize = 8;
+
+constexpr std::size_t kStripSize = 1 << 20;
+constexpr int kTileSize = 256;
+// Room for the IFD and its values when deciding between classic and BigTIFF
+constexpr std::size_t kIfdReserve = 1 << 16;
+
+class Writer {
+ public:
+  explicit Writer(bool big) : big_(big) {
+    buffer_ = {'I', 'I'};
+    if (big_) {
+      Append(kBigTiffVersion, 2);
+      Append(kBigTiffOffsetSize, 2);
+      Append(0, 2);
+    } else {
+      Append(kClassicVersion, 2);
+    }
+    next_ifd_pos_ = buffer_.size();
+    AppendOffset(0);
+  }
+
+  // Writes only the IFDs, to be placed at base_offset of a file whose header
+  // and image data were written separately
+  Writer(bool big, std::uint64_t base_offset)
+      : big_(big), base_offset_(base_offset) {}
+
+  std::uint64_t Size() const { return base_offset_ + buffer_.size(); }
+
+  void AppendData(const std::vector<unsigned char>& data) {
+    buffer_.insert(buffer_.end(), data.begin(), data.end());
+  }
+
+  // Appends the IFD and links it from the previous one, returns its offset
+  std::uint64_t AppendIfd(std::vector<Field> fields) {
+    AlignToWord();
+    const std::uint64_t offset = Size();
+    if (next_ifd_pos_) {
+      PatchOffset(*next_ifd_pos_, offset);
+    }
+    next_ifd_pos_ = WriteIfd(std::move(fields));
+    return offset;
+  }
+
+  // Appends an IFD referenced from a field of another IFD, e.g. the Exif IFD,
+  // returns its offset
+  std::uint64_t AppendSubIfd(std::vector<Field> fields) {
+    AlignToWord();
+    const std::uint64_t offset = Size();
+    WriteIfd(std::move(fields));
+    return offset;
+  }
+
+  std::vector<unsigned char> Release() && { return std::move(buffer_); }
+
+  bool IsBig() const { return big_; }
+
+ private:
+  // Values that don't fit into the entries are stored right after the IFD,
+  // returns the position of the next IFD offset
+  std::size_t WriteIfd(std::vector<Field> fields) {
+    std::sort(
+        fields.begin(), fields.end(),
+        [](const auto& lhs, const auto& rhs) { return lhs.tag < rhs.tag; });
+
+    const std::size_t inline_size = OffsetSize();
+    const std::size_t count_size = big_ ? 8 : 2;
+    const std::size_t entry_size = big_ ? 20 : 12;
+    const std::size_t ifd_size =
+        count_size + fields.size() * entry_size + OffsetSize();
+    const std::uint64_t value_pos = Size() + ifd_size;
+
+    std::vector<unsigned char> values;
+    Append(fields.size(), count_size);
+    for (const auto& field : fields) {
+      Append(field.tag, 2);
+      Append(field.type, 2);
+      AppendOffset(field.count);
+      if (field.value.size() <= inline_size) {
+        auto value = field.value;
+        value.resize(inline_size, 0);
+        buffer_.insert(buffer_.end(), value.begin(), value.end());
+      } else {
+        AppendOffset(value_pos + values.size());
+        values.insert(values.end(), field.value.begin(), field.value.end());
+        if (values.size() % 2 != 0) {
+          values.push_back(0);
+        }
+      }
+    }
+    const std::size_t next_ifd_pos = buffer_.size();
+    AppendOffset(0);
+    buffer_.insert(buffer_.end(), values.begin(), values.end());
+    return next_ifd_pos;
+  }
+
+  std::size_t OffsetSize() const { return big_ ? 8 : 4; }
+
+  void Append(std::uint64_t value, std::size_t bytes) {
+    for (std::size_t i = 0; i < bytes; i++) {
+      buffer_.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xFF));
+    }
+  }
+
+  void AppendOffset(std::uint64_t value) { Append(value, OffsetSize()); }
+
+  void PatchOffset(std::size_t pos, std::uint64_t value) {
+    for (std::size_t i = 0; i < OffsetSize(); i++) {
+      buffer_[pos + i] = static_cast<unsigned char>((value >> (8 * i)) & 0xFF);
+    }
+  }
+
+  void AlignToWord() {
+    if (Size() % 2 != 0) {
+      buffer_.push_back(0);
+    }
+  }
+
+  bool big_;
+  std::uint64_t base_offset_ = 0;
+  std::optional<std::size_t> next_ifd_pos_;
+  std::vector<unsigned char> buffer_;
+};
+
+template <typename TValueType>
+Field MakeField(std::uint16_t tag, Type type,
+                const std::vector<TValueType>& values) {
+  Field field{.tag = tag,
+              .type = static_cast<std::uint16_t>(type),
+              .count = values.size(),
+              .value = {}};
+  for (const auto value : values) {
+    for (std::size_t i = 0; i < sizeof(TValueType); i++) {
+      field.value.push_back(
+          static_cast<unsigned char>((static_cast<std::uint64_t>(value) >>
+                                      (8 * i)) &
+                                     0xFF));
+    }
+  }
+  return field;
+}
+
+Field ShortField(std::uint16_t tag, const std::vector<std::uint16_t>& values) {
+  return MakeField(tag, Type::kShort, values);
+}
+
+Field LongField(std::uint16_t tag, const std::vector<std::uint32_t>& values) {
+  return MakeField(tag, Type::kLong, values);
+}
+
+Field OffsetsField(std::uint16_t tag, const std::vector<std::uint64_t>& values,
+                   bool big) {
+  if (big) {
+    return MakeField(tag, Type::kLong8, values);
+  }
+  std::vector<std::uint32_t> values32(values.begin(), values.end());
+  return MakeField(tag, Type::kLong, values32);
+}
+
+Field RationalField(std::uint16_t tag, std::uint32_t numerator,
+                    std::uint32_t denominator) {
+  auto field = MakeField(tag, Type::kRational,
+                         std::vector<std::uint32_t>{numerator, denominator});
+  field.count = 1;
+  return field;
+}
+
+// Overrides fields with the same tag
+void Override(std::vector<Field>* fields,
+              const std::vector<Field>& extra_fields) {
+  for (const auto& extra_field : extra_fields) {
+    std::erase_if(*fields, [&extra_field](const auto& field) {
+      return field.tag == extra_field.tag;
+    });
+    fields->push_back(extra_field);
+  }
+}
+
+void AppendMetadata(Writer* writer, std::vector<Field>* fields,
+                    const Metadata& metadata) {
+  if (!metadata.exif.empty()) {
+    auto offset = writer->AppendSubIfd(metadata.exif);
+    Override(fields, {OffsetsField(kExifIfd, {offset}, writer->IsBig())});
+  }
+  if (!metadata.gps.empty()) {
+    auto offset = writer->AppendSubIfd(metadata.gps);
+    Override(fields, {OffsetsField(kGpsIfd, {offset}, writer->IsBig())});
+  }
+}
+
+// Rows in the TIFF sample order (RGB(A), little endian), optionally with
+// horizontal differencing applied
+template <typename TSampleType>
+void ConvertRows(const cv::Mat& image, int begin, int end, bool predict,
+                 std::vector<unsigned char>* output) {
+  const int channels = image.channels();
+  const int row_samples = image.cols * channels;
+  std::vector<TSampleType> row(row_samples);
+  for (int y = begin; y < end; y++) {
+    const auto* input = image.ptr<TSampleType>(y);
+    for (int col = 0; col < image.cols; col++) {
+      for (int channel = 0; channel < channels; channel++) {
+        // Swap B and R
+        int source_channel = channel;
+        if (channels >= 3 && channel < 3) {
+          source_channel = 2 - channel;
+        }
+        row[col * channels + channel] = input[col * channels + source_channel];
+      }
+    }
+    for (int i = row_samples - 1; predict && i >= channels; i--) {
+      row[i] = static_cast<TSampleType>(row[i] - row[i - channels]);
+    }
+    for (const auto sample : row) {
+      for (std::size_t i = 0; i < sizeof(TSampleType); i++) {
+        output->push_back(
+            static_cast<unsigned char>((sample >> (8 * i)) & 0xFF));
+      }
+    }
+  }
+}
+
+// Without zlib the rows are stored uncompressed
+std::vector<unsigned char> EncodeStrip(const cv::Mat& image, int begin,
+                                       int end, int compression) {
+  const bool deflate = zlib::Enabled();
+  std::vector<unsigned char> strip;
+  strip.reserve((end - begin) * image.cols * image.elemSize());
+  if (image.depth() == CV_8U) {
+    ConvertRows<std::uint8_t>(image, begin, end, deflate, &strip);
+  } else {
+    ConvertRows<std::uint16_t>(image, begin, end, deflate, &strip);
+  }
+  return deflate ? zlib::Compress(strip, compression) : strip;
+}
+
+bool IsSupported(const cv::Mat& image) {
+  const int channels = image.channels();
+  return !image.empty() && (channels == 1 || channels == 3 || channels == 4) &&
+         (image.depth() == CV_8U || image.depth() == CV_16U);
+}
+
+// Fields describing the pixel format, shared by all the images in a file
+std::vector<Field> SampleFields(const cv::Mat& image, bool deflate) {
+  const int channels = image.channels();
+  const auto bits_per_sample =
+      static_cast<std::uint16_t>(image.elemSize1() * 8);
+  std::vector<Field> fields = {
+      ShortField(kBitsPerSample,
+                 std::vector<std::uint16_t>(channels, bits_per_sample)),
+      ShortField(kCompression,
+                 {deflate ? kCompressionDeflate : kCompressionNone}),
+      ShortField(kPhotometricInterpretation,
+                 {channels == 1 ? kPhotometricMinIsBlack : kPhotometricRgb}),
+      ShortField(kSamplesPerPixel, {static_cast<std::uint16_t>(channels)}),
+      ShortField(kPlanarConfiguration, {kPlanarContiguous}),
+  };
+  if (deflate) {
+    fields.push_back(ShortField(kPredictor, {kPredictorHorizontal}));
+  }
+  if (channels == 4) {
+    fields.push_back(
+        ShortField(kExtraSamples, {kExtraSampleUnassociatedAlpha}));
+  }
+  return fields;
+}
+
+// Image fields that can be replaced by the metadata
+std::vector<Field> DefaultFields(const Metadata& metadata) {
+  std::vector<Field> fields = {
+      RationalField(kXResolution, kDefaultResolution, 1),
+      RationalField(kYResolution, kDefaultResolution, 1),
+      ShortField(kResolutionUnit, {kResolutionUnitInch}),
+  };
+  Override(&fields, metadata.image);
+  return fields;
+}
+
+struct PyramidLevel {
+  cv::Size size;
+  int rows_done = 0;
+  // Downsampled rows waiting for a full row of tiles
+  cv::Mat pending;
+  std::vector<std::uint64_t> offsets;
+  std::vector<std::uint64_t> byte_counts;
+};
+
+// Writes the levels of a pyramidal TIFF row of tiles by row of tiles, each
+// row is downsampled into the next level right after it is written, so only
+// a single row of tiles per level is kept in memory
+class PyramidWriter {
+ public:
+  PyramidWriter(std::ofstream* file, std::uint64_t offset, cv::Size size,
+                int compression, mt::Threadpool* pool,
+                mt::CancelCheck is_cancelled)
+      : file_(file),
+        offset_(offset),
+        compression_(compression),
+        pool_(pool),
+        is_cancelled_(std::move(is_cancelled)) {
+    levels_.emplace_back().size = size;
+    while (std::max(size.width, size.height) > kTileSize) {
+      size = {(size.width + 1) / 2, (size.height + 1) / 2};
+      levels_.emplace_back().size = size;
+    }
+  }
+
+  // Returns false if cancelled
+  bool Write(const cv::Mat& image) {
+    for (int row = 0; row < image.rows; row += kTileSize) {
+      if (mt::IsCancelled(is_cancelled_)) {
+        return false;
+      }
+      WriteRow(0, image.rowRange(row, std::min(row + kTileSize, image.rows)));
+    }
+    return true;
+  }
+
+  std::uint64_t Offset() const { return offset_; }
+
+  const std::vector<PyramidLevel>& Levels() const { return levels_; }
+
+ private:
+  void WriteRow(std::size_t level_id, const cv::Mat& row) {
+    auto& level = levels_[level_id];
+    mt::MultiFuture<std::vector<unsigned char>> tiles_future;
+    for (int col = 0; col < row.cols; col += kTileSize) {
+      const int width = std::min(kTileSize, row.cols - col);
+      tiles_future.push_back(pool_->submit([this, &row, col, width]() {
+        const trace::Scope scope("tiff_tile");
+        cv::Mat tile;
+        cv::copyMakeBorder(row.colRange(col, col + width), tile, 0,
+                           kTileSize - row.rows, 0, kTileSize - width,
+                           cv::BORDER_REPLICATE);
+        return EncodeStrip(tile, 0, kTileSize, compression_);
+      }));
+    }
+    tiles_future.wait();
+    for (const auto& tile : tiles_future.get()) {
+      level.offsets.push_back(offset_);
+      level.byte_counts.push_back(tile.size());
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      file_->write(reinterpret_cast<const char*>(tile.data()),
+                   static_cast<std::streamsize>(tile.size()));
+      offset_ += tile.size();
+    }
+    level.rows_done += row.rows;
+
+    if (level_id + 1 < levels_.size()) {
+      Downsample(level_id + 1, row);
+    }
+  }
+
+  void Downsample(std::size_t level_id, const cv::Mat& row) {
+    auto& level = levels_[level_id];
+    cv::Mat half;
+    cv::resize(row, half,
+               cv::Size(level.size.width, (row.rows + 1) / 2), 0, 0,
+               cv::INTER_AREA);
+    level.pending.push_back(half);
+
+    while (level.pending.rows >= kTileSize ||
+           (!level.pending.empty() &&
+            level.pending.rows == level.size.height - level.rows_done)) {
+      const int rows = std::min(kTileSize, level.pending.rows);
+      const cv::Mat tile_row = level.pending.rowRange(0, rows).clone();
+      level.pending = level.pending.rowRange(rows, level.pending.rows).clone();
+      WriteRow(level_id, tile_row);
+    }
+  }
+
+  std::ofstream* file_;
+  std::uint64_t offset_;
+  int compression_;
+  mt::Threadpool* pool_;
+  mt::CancelCheck is_cancelled_;
+  std::vector<PyramidLevel> levels_;
+};
+
+}  // namespace
+
+std::optional<std::vector<unsigned char>> EncodeParallel(
+    const cv::Mat& image, int compression, mt::Threadpool* pool,
+    const Metadata& metadata, const mt::CancelCheck& is_cancelled) {
+  if (!zlib::Enabled() || !IsSupported(image)) {
+    return {};
+  }
+
+  const std::size_t row_size = image.cols * image.elemSize();
+  const int rows_per_strip = static_cast<int>(
+      std::clamp<std::size_t>(kStripSize / row_size, 1, image.rows));
+  const int num_strips = (image.rows + rows_per_strip - 1) / rows_per_strip;
+
+  mt::MultiFuture<std::vector<unsigned char>> strips_future;
+  for (int i = 0; i < num_strips; i++) {
+    const int begin = i * rows_per_strip;
+    const int end = std::min(begin + rows_per_strip, image.rows);
+    strips_future.push_back(
+        pool->submit([&image, begin, end, compression, &is_cancelled]() {
+          if (mt::IsCancelled(is_cancelled)) {
+            return std::vector<unsigned char>{};
+          }
+          const trace::Scope scope("tiff_strip");
+          return EncodeStrip(image, begin, end, compression);
+        }));
+  }
+  strips_future.wait();
+  auto strips = strips_future.get();
+  if (mt::IsCancelled(is_cancelled)) {
+    return {};
+  }
+
+  std::size_t total_size = kIfdReserve;
+  for (const auto& strip : strips) {
+    total_size += strip.size();
+  }
+  const bool big = total_size > std::numeric_limits<std::uint32_t>::max();
+
+  Writer writer(big);
+  std::vector<std::uint64_t> offsets;
+  std::vector<std::uint64_t> byte_counts;
+  for (const auto& strip : strips) {
+    offsets.push_back(writer.Size());
+    byte_counts.push_back(strip.size());
+    writer.AppendData(strip);
+  }
+
+  auto fields = DefaultFields(metadata);
+  auto layout = SampleFields(image, true);
+  layout.insert(
+      layout.end(),
+      {LongField(kImageWidth, {static_cast<std::uint32_t>(image.cols)}),
+       LongField(kImageLength, {static_cast<std::uint32_t>(image.rows)}),
+       OffsetsField(kStripOffsets, offsets, big),
+       LongField(kRowsPerStrip, {static_cast<std::uint32_t>(rows_per_strip)}),
+       OffsetsField(kStripByteCounts, byte_counts, big)});
+  Override(&fields, layout);
+  AppendMetadata(&writer, &fields, metadata);
+  writer.AppendIfd(std::move(fields));
+  return std::move(writer).Release();
+}
+
+bool WritePyramid(const cv::Mat& image, const std::filesystem::path& path,
+                  int compression, mt::Threadpool* pool,
+                  const Metadata& metadata,
+                  const mt::CancelCheck& is_cancelled) {
+  if (!IsSupported(image)) {
+    return false;
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  auto header = std::move(Writer(true)).Release();
+  const std::uint64_t first_ifd_pos = header.size() - kBigTiffOffsetSize;
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  file.write(reinterpret_cast<const char*>(header.data()),
+             static_cast<std::streamsize>(header.size()));
+
+  PyramidWriter pyramid(&file, header.size(), image.size(), compression, pool,
+                        is_cancelled);
+  if (!pyramid.Write(image)) {
+    file.close();
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    return false;
+  }
+
+  Writer ifds(true, pyramid.Offset());
+  std::optional<std::uint64_t> first_ifd;
+  const auto& levels = pyramid.Levels();
+  for (std::size_t i = 0; i < levels.size(); i++) {
+    const auto& level = levels[i];
+    std::vector<Field> fields;
+    if (i == 0) {
+      fields = DefaultFields(metadata);
+    }
+    auto layout = SampleFields(image, zlib::Enabled());
+    layout.insert(
+        layout.end(),
+        {LongField(kNewSubfileType, {i == 0 ? 0 : kSubfileReducedImage}),
+         LongField(kImageWidth, {static_cast<std::uint32_t>(level.size.width)}),
+         LongField(kImageLength,
+                   {static_cast<std::uint32_t>(level.size.height)}),
+         ShortField(kTileWidth, {kTileSize}),
+         ShortField(kTileLength, {kTileSize}),
+         OffsetsField(kTileOffsets, level.offsets, true),
+         OffsetsField(kTileByteCounts, level.byte_counts, true)});
+    Override(&fields, layout);
+    if (i == 0) {
+      AppendMetadata(&ifds, &fields, metadata);
+    }
+    auto offset = ifds.AppendIfd(std::move(fields));
+    if (!first_ifd) {
+      first_ifd = offset;
+    }
+  }
+
+  auto ifd_data = std::move(ifds).Release();
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  file.write(reinterpret_cast<const char*>(ifd_data.data()),
+             static_cast<std::streamsize>(ifd_data.size()));
+
+  std::vector<unsigned char> first_ifd_data;
+  for (std::size_t i = 0; i < kBigTiffOffsetSize; i++) {
+    first_ifd_data.push_back(
+        static_cast<unsigned char>((*first_ifd >> (8 * i)) & 0xFF));
+  }
+  file.seekp(static_cast<std::streamoff>(first_ifd_pos));
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  file.write(reinterpret_cast<const char*>(first_ifd_data.data()),
+             static_cast<std::streamsize>(first_ifd_data.size()));
+  return file.good();
+}
+
+}  // namespace xpano::utils::tiff
@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "xpano/utils/threadpool.h"
+#include "xpano/utils/tiff_fields.h"
+
+namespace xpano::utils::tiff {
+
+// Deflates strips of the image concurrently and writes them as a single
+// image TIFF with horizontal differencing. Switches to BigTIFF if the
+// compressed data doesn't fit into 4 GB. The metadata is written into the
+// image IFD and the Exif and GPS sub-IFDs.
+//  - supports 8 and 16 bit grayscale, BGR and BGRA images
+//  - returns std::nullopt if the image format is not supported, or if the
+//    encoding was cancelled
+std::optional<std::vector<unsigned char>> EncodeParallel(
+    const cv::Mat& image, int compression, mt::Threadpool* pool,
+    const Metadata& metadata = {}, const mt::CancelCheck& is_cancelled = {});
+
+// Writes a tiled BigTIFF with the image followed by its 2x downscaled
+// overviews down to a single tile. The file is written one row of tiles at a
+// time and the overviews are built incrementally from the written rows, tiles
+// within a row are encoded concurrently.
+//  - the tiles are deflated if zlib is available, stored uncompressed
+//    otherwise
+//  - the metadata is written to the full resolution image only
+//  - a cancelled pyramid stops after the current row and the file is removed
+bool WritePyramid(const cv::Mat& image, const std::filesystem::path& path,
+                  int compression, mt::Threadpool* pool,
+                  const Metadata& metadata = {},
+                  const mt::CancelCheck& is_cancelled = {});
+
+}  // namespace xpano::utils::tiff
@@ -0,0 +1,27 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace xpano::utils::tiff {
+
+// A single IFD entry, the value is stored in little endian byte order
+struct Field {
+  std::uint16_t tag;
+  std::uint16_t type;
+  std::uint64_t count;
+  std::vector<unsigned char> value;
+};
+
+// Fields copied into the written file, the writer's own fields describing the
+// image layout take precedence
+struct Metadata {
+  std::vector<Field> image;
+  std::vector<Field> exif;
+  std::vector<Field> gps;
+};
+
+}  // namespace xpano::utils::tiff
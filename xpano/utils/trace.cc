@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "xpano/constants.h"
+#include "xpano/utils/fmt.h"
+
+namespace xpano::utils::trace {
+
+namespace {
+
+struct Event {
+  const char* name;
+  Tags tags;
+  std::chrono::steady_clock::time_point time;
+  bool begin;
+};
+
+// Written only by its own thread, the lock is contended only while exporting
+struct ThreadBuffer {
+  std::mutex mut;
+  int thread_id = 0;
+  std::vector<Event> events;
+  std::size_t next = 0;
+  bool wrapped = false;
+};
+
+std::atomic_bool enabled = false;
+
+// Buffers of finished threads are kept so that their events can be exported
+std::mutex registry_mut;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+const auto kStart = std::chrono::steady_clock::now();
+
+ThreadBuffer* CurrentThreadBuffer() {
+  thread_local const std::shared_ptr<ThreadBuffer> buffer = []() {
+    auto new_buffer = std::make_shared<ThreadBuffer>();
+    new_buffer->events.resize(kTraceEventsPerThread);
+    const std::lock_guard lock(registry_mut);
+    new_buffer->thread_id = static_cast<int>(registry.size()) + 1;
+    registry.push_back(new_buffer);
+    return new_buffer;
+  }();
+  return buffer.get();
+}
+
+void Append(const char* name, const Tags& tags, bool begin) {
+  auto* buffer = CurrentThreadBuffer();
+  const std::lock_guard lock(buffer->mut);
+  buffer->events[buffer->next] = {.name = name,
+                                  .tags = tags,
+                                  .time = std::chrono::steady_clock::now(),
+                                  .begin = begin};
+  buffer->next = (buffer->next + 1) % buffer->events.size();
+  if (buffer->next == 0) {
+    buffer->wrapped = true;
+  }
+}
+
+void AppendJson(const Event& event, int thread_id, std::string* output) {
+  const auto micros =
+      std::chrono::duration<double, std::micro>(event.time - kStart).count();
+  auto out = std::back_inserter(*output);
+  fmt::format_to(out,
+                 R"(  {{"name": "{}", "ph": "{}", "ts": {:.3f}, "pid": 1, )"
+                 R"("tid": {})",
+                 event.name, event.begin ? "B" : "E", micros, thread_id);
+  if (event.begin && (event.tags.pano_id >= 0 || event.tags.image_id >= 0)) {
+    *output += ", \"args\": {";
+    if (event.tags.pano_id >= 0) {
+      fmt::format_to(out, "\"pano_id\": {}", event.tags.pano_id);
+    }
+    if (event.tags.pano_id >= 0 && event.tags.image_id >= 0) {
+      *output += ", ";
+    }
+    if (event.tags.image_id >= 0) {
+      fmt::format_to(out, "\"image_id\": {}", event.tags.image_id);
+    }
+    *output += "}";
+  }
+  *output += "},\n";
+}
+
+// The oldest events of a full buffer may be end events whose begin events
+// were overwritten, these are skipped
+void AppendThreadJson(ThreadBuffer* buffer, std::string* output) {
+  const std::lock_guard lock(buffer->mut);
+  const std::size_t size = buffer->events.size();
+  const std::size_t first = buffer->wrapped ? buffer->next : 0;
+  const std::size_t count = buffer->wrapped ? size : buffer->next;
+  int depth = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    const auto& event = buffer->events[(first + i) % size];
+    if (event.begin) {
+      depth++;
+    } else if (depth == 0) {
+      continue;
+    } else {
+      depth--;
+    }
+    AppendJson(event, buffer->thread_id, output);
+  }
+}
+
+}  // namespace
+
+void Enable(bool enable) { enabled = enable; }
+
+bool IsEnabled() { return enabled; }
+
+void Clear() {
+  const std::lock_guard lock(registry_mut);
+  for (const auto& buffer : registry) {
+    const std::lock_guard buffer_lock(buffer->mut);
+    buffer->next = 0;
+    buffer->wrapped = false;
+  }
+}
+
+Scope::Scope(const char* name, Tags tags) : tags_(tags) {
+  if (enabled) {
+    name_ = name;
+    Append(name_, tags_, true);
+  }
+}
+
+// Ends the event even if the recording was stopped in the meantime
+Scope::~Scope() {
+  if (name_ != nullptr) {
+    Append(name_, tags_, false);
+  }
+}
+
+std::string ToChromeJson() {
+  std::string output = "{\"traceEvents\": [\n";
+  {
+    const std::lock_guard lock(registry_mut);
+    for (const auto& buffer : registry) {
+      fmt::format_to(std::back_inserter(output),
+                     R"(  {{"name": "thread_name", "ph": "M", "pid": 1, )"
+                     R"("tid": {0}, "args": {{"name": "thread {0}"}}}},)"
+                     "\n",
+                     buffer->thread_id);
+      AppendThreadJson(buffer.get(), &output);
+    }
+  }
+  // Drop the trailing comma
+  if (output.ends_with(",\n")) {
+    output.erase(output.size() - 2, 1);
+  }
+  output += "], \"displayTimeUnit\": \"ms\"}\n";
+  return output;
+}
+
+bool WriteChromeJson(const std::filesystem::path& path) {
+  std::ofstream file(path, std::ios::binary);
+  file << ToChromeJson();
+  return static_cast<bool>(file);
+}
+
+}  // namespace xpano::utils::trace
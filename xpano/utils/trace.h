@@ -0,0 +1,45 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+namespace xpano::utils::trace {
+
+// What the event worked on, -1 if not applicable
+struct Tags {
+  int pano_id = -1;
+  int image_id = -1;
+};
+
+// Recording is off by default, a disabled scope only checks an atomic flag
+void Enable(bool enable);
+[[nodiscard]] bool IsEnabled();
+
+// Drops the events recorded so far
+void Clear();
+
+// Emits a begin event now and an end event when destroyed. The name has to
+// outlive the recording, e.g. a string literal.
+class Scope {
+ public:
+  explicit Scope(const char* name, Tags tags = {});
+  ~Scope();
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+  Scope(Scope&&) = delete;
+  Scope& operator=(Scope&&) = delete;
+
+ private:
+  const char* name_ = nullptr;
+  Tags tags_;
+};
+
+// Chrome trace event format, opens in Perfetto or chrome://tracing
+std::string ToChromeJson();
+bool WriteChromeJson(const std::filesystem::path& path);
+
+}  // namespace xpano::utils::trace
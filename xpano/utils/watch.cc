@@ -0,0 +1,168 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/watch.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+#include "xpano/constants.h"
+#include "xpano/utils/path.h"
+
+namespace xpano::utils::watch {
+
+FolderWatcher::FolderWatcher(std::filesystem::path dir)
+    : dir_(std::move(dir)) {
+#ifdef __linux__
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ >= 0 &&
+      inotify_add_watch(inotify_fd_, dir_.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) < 0) {
+    close(inotify_fd_);
+    inotify_fd_ = -1;
+  }
+  if (inotify_fd_ >= 0) {
+    return;
+  }
+  spdlog::warn("Failed to set up inotify for {}, polling instead",
+               dir_.string());
+#endif
+  // Only report the files created from now on
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(dir_, error)) {
+    reported_.insert(entry.path());
+  }
+}
+
+FolderWatcher::~FolderWatcher() {
+#ifdef __linux__
+  if (inotify_fd_ >= 0) {
+    close(inotify_fd_);
+  }
+#endif
+}
+
+std::vector<std::filesystem::path> FolderWatcher::Wait(
+    std::chrono::milliseconds timeout) {
+  if (UsesInotify()) {
+    return WaitInotify(timeout);
+  }
+  std::this_thread::sleep_for(std::min<std::chrono::milliseconds>(
+      timeout, kWatchPollInterval));
+  return Poll();
+}
+
+std::vector<std::filesystem::path> FolderWatcher::WaitInotify(
+    [[maybe_unused]] std::chrono::milliseconds timeout) {
+  std::vector<std::filesystem::path> files;
+#ifdef __linux__
+  pollfd poll_fd = {.fd = inotify_fd_, .events = POLLIN, .revents = 0};
+  if (poll(&poll_fd, 1, static_cast<int>(timeout.count())) <= 0) {
+    return files;
+  }
+
+  alignas(inotify_event) std::array<char, 4096> buffer{};
+  ssize_t length = 0;
+  while ((length = read(inotify_fd_, buffer.data(), buffer.size())) > 0) {
+    for (ssize_t offset = 0; offset < length;) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      const auto* event = reinterpret_cast<inotify_event*>(&buffer[offset]);
+      if ((event->mask & IN_Q_OVERFLOW) != 0) {
+        spdlog::warn("Too many new files in {}, some were missed",
+                     dir_.string());
+      } else if (event->len > 0 && (event->mask & IN_ISDIR) == 0) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
+        files.push_back(dir_ / event->name);
+      }
+      offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+    }
+  }
+#endif
+  return files;
+}
+
+std::vector<std::filesystem::path> FolderWatcher::Poll() {
+  std::vector<std::filesystem::path> files;
+  std::map<std::filesystem::path, std::uintmax_t> growing;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(dir_, error)) {
+    if (!entry.is_regular_file(error) || reported_.contains(entry.path())) {
+      continue;
+    }
+    const auto size = entry.file_size(error);
+    if (error) {
+      continue;
+    }
+    if (auto previous = growing_.find(entry.path());
+        previous != growing_.end() && previous->second == size) {
+      files.push_back(entry.path());
+      reported_.insert(entry.path());
+    } else {
+      growing.emplace(entry.path(), size);
+    }
+  }
+  growing_ = std::move(growing);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+bool IsSentinel(const std::filesystem::path& path) {
+  return path.extension() == kWatchSentinelExtension;
+}
+
+void FileGrouper::Add(const std::filesystem::path& path,
+                      Clock::time_point now) {
+  if (IsSentinel(path)) {
+    if (!pending_.empty()) {
+      ready_.push_back(std::move(pending_));
+      pending_.clear();
+    }
+    return;
+  }
+  // Rewritten files are reported again
+  if (!path::IsExtensionSupported(path) ||
+      std::find(pending_.begin(), pending_.end(), path) != pending_.end()) {
+    return;
+  }
+  pending_.push_back(path);
+  last_added_ = now;
+}
+
+std::optional<std::vector<std::filesystem::path>> FileGrouper::TakeReady(
+    Clock::time_point now) {
+  std::vector<std::filesystem::path> files;
+  if (!ready_.empty()) {
+    files = std::move(ready_.front());
+    ready_.pop_front();
+  } else if (!pending_.empty() && now - last_added_ >= idle_timeout_) {
+    files = std::move(pending_);
+    pending_.clear();
+  } else {
+    return {};
+  }
+  // Neighboring images are matched against each other, keep the capture order
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+int FileGrouper::NumPending() const {
+  return static_cast<int>(pending_.size());
+}
+
+}  // namespace xpano::utils::watch
@@ -0,0 +1,75 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <set>
+#include <vector>
+
+namespace xpano::utils::watch {
+
+// Reports files that were completely written into a directory after the
+// watcher was created, subdirectories are not watched. Uses inotify on Linux
+// and falls back to polling elsewhere: a file is reported once its size
+// didn't change between two polls.
+class FolderWatcher {
+ public:
+  explicit FolderWatcher(std::filesystem::path dir);
+  ~FolderWatcher();
+
+  FolderWatcher(const FolderWatcher&) = delete;
+  FolderWatcher& operator=(const FolderWatcher&) = delete;
+  FolderWatcher(FolderWatcher&&) = delete;
+  FolderWatcher& operator=(FolderWatcher&&) = delete;
+
+  // Waits at most timeout for new files
+  std::vector<std::filesystem::path> Wait(std::chrono::milliseconds timeout);
+
+  [[nodiscard]] bool UsesInotify() const { return inotify_fd_ >= 0; }
+
+ private:
+  std::vector<std::filesystem::path> WaitInotify(
+      std::chrono::milliseconds timeout);
+  std::vector<std::filesystem::path> Poll();
+
+  std::filesystem::path dir_;
+  int inotify_fd_ = -1;
+
+  // Polling fallback
+  std::set<std::filesystem::path> reported_;
+  std::map<std::filesystem::path, std::uintmax_t> growing_;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Splits the incoming files into sets. A set is complete when a sentinel file
+// arrives, or when no new image arrived for the idle timeout. Files that are
+// neither supported images nor sentinels are ignored.
+class FileGrouper {
+ public:
+  explicit FileGrouper(std::chrono::milliseconds idle_timeout)
+      : idle_timeout_(idle_timeout) {}
+
+  void Add(const std::filesystem::path& path, Clock::time_point now);
+
+  std::optional<std::vector<std::filesystem::path>> TakeReady(
+      Clock::time_point now);
+
+  [[nodiscard]] int NumPending() const;
+
+ private:
+  std::chrono::milliseconds idle_timeout_;
+  std::vector<std::filesystem::path> pending_;
+  Clock::time_point last_added_;
+  std::deque<std::vector<std::filesystem::path>> ready_;
+};
+
+bool IsSentinel(const std::filesystem::path& path);
+
+}  // namespace xpano::utils::watch
@@ -0,0 +1,139 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "xpano/utils/zlib.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#ifdef XPANO_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace xpano::utils::zlib {
+
+namespace {
+constexpr int kWindowBits = 15;
+constexpr int kCompressionMethod = 8;  // deflate
+
+#ifdef XPANO_WITH_ZLIB
+constexpr int kMemLevel = 8;
+
+class Deflater {
+ public:
+  // Negative window bits produce a raw deflate stream
+  Deflater(int level, bool raw) {
+    const int window_bits = raw ? -kWindowBits : kWindowBits;
+    if (deflateInit2(&stream_, level, Z_DEFLATED, window_bits, kMemLevel,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw std::runtime_error("zlib: deflateInit2 failed");
+    }
+  }
+  ~Deflater() { deflateEnd(&stream_); }
+
+  Deflater(const Deflater&) = delete;
+  Deflater& operator=(const Deflater&) = delete;
+  Deflater(Deflater&&) = delete;
+  Deflater& operator=(Deflater&&) = delete;
+
+  std::vector<unsigned char> Run(std::span<const unsigned char> data,
+                                 int flush) {
+    // Upper bound for a single deflate call plus room for the sync marker
+    const std::size_t kFlushOverhead = 16;
+    const std::size_t bound =
+        deflateBound(&stream_, static_cast<uLong>(data.size()));
+    std::vector<unsigned char> result;
+    result.resize(bound + kFlushOverhead);
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast): zlib API
+    stream_.next_in = const_cast<Bytef*>(data.data());
+    stream_.avail_in = static_cast<uInt>(data.size());
+    stream_.next_out = result.data();
+    stream_.avail_out = static_cast<uInt>(result.size());
+
+    const int status = deflate(&stream_, flush);
+    if (status == Z_STREAM_ERROR || stream_.avail_in != 0 ||
+        (flush == Z_FINISH && status != Z_STREAM_END)) {
+      throw std::runtime_error("zlib: deflate failed");
+    }
+    result.resize(result.size() - stream_.avail_out);
+    return result;
+  }
+
+ private:
+  z_stream stream_ = {};
+};
+#endif
+}  // namespace
+
+std::array<unsigned char, 2> StreamHeader(int level) {
+  // FLEVEL is informative only, follow the values zlib itself writes
+  int flevel = 2;
+  if (level >= 0 && level < 2) {
+    flevel = 0;
+  } else if (level >= 2 && level < 6) {
+    flevel = 1;
+  } else if (level > 6) {
+    flevel = 3;
+  }
+  const int kCmf = kCompressionMethod | ((kWindowBits - 8) << 4);
+  int flg = flevel << 6;
+  const int kCheckDivisor = 31;
+  flg += (kCheckDivisor - ((kCmf << 8) + flg) % kCheckDivisor) %
+         kCheckDivisor;
+  return {static_cast<unsigned char>(kCmf), static_cast<unsigned char>(flg)};
+}
+
+std::vector<unsigned char> DeflateChunk(std::span<const unsigned char> data,
+                                        int level, bool last) {
+#ifdef XPANO_WITH_ZLIB
+  Deflater deflater(level, /*raw=*/true);
+  // A sync flush ends the chunk on a byte boundary without marking the final
+  // block, so that the next chunk can be appended directly
+  return deflater.Run(data, last ? Z_FINISH : Z_SYNC_FLUSH);
+#else
+  throw std::runtime_error("zlib support not compiled in");
+#endif
+}
+
+std::vector<unsigned char> Compress(std::span<const unsigned char> data,
+                                    int level) {
+#ifdef XPANO_WITH_ZLIB
+  Deflater deflater(level, /*raw=*/false);
+  return deflater.Run(data, Z_FINISH);
+#else
+  throw std::runtime_error("zlib support not compiled in");
+#endif
+}
+
+std::uint32_t Adler32(std::span<const unsigned char> data) {
+#ifdef XPANO_WITH_ZLIB
+  auto initial = adler32(0L, Z_NULL, 0);
+  return adler32_z(initial, data.data(), data.size());
+#else
+  throw std::runtime_error("zlib support not compiled in");
+#endif
+}
+
+std::uint32_t Adler32Combine(std::uint32_t first, std::uint32_t second,
+                             std::size_t second_size) {
+#ifdef XPANO_WITH_ZLIB
+  return adler32_combine(first, second, static_cast<z_off_t>(second_size));
+#else
+  throw std::runtime_error("zlib support not compiled in");
+#endif
+}
+
+std::uint32_t Crc32(std::uint32_t crc, std::span<const unsigned char> data) {
+#ifdef XPANO_WITH_ZLIB
+  return crc32_z(crc, data.data(), data.size());
+#else
+  throw std::runtime_error("zlib support not compiled in");
+#endif
+}
+
+}  // namespace xpano::utils::zlib
@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2024 Tomas Krupka
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace xpano::utils::zlib {
+
+constexpr bool Enabled() {
+#ifdef XPANO_WITH_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Two byte zlib stream header, see RFC 1950
+std::array<unsigned char, 2> StreamHeader(int level);
+
+// Raw deflate data without the zlib header and checksum. Chunks compressed
+// independently can be concatenated into a single deflate stream, only the
+// last chunk is marked as final.
+std::vector<unsigned char> DeflateChunk(std::span<const unsigned char> data,
+                                        int level, bool last);
+
+// Complete zlib stream including the header and checksum
+std::vector<unsigned char> Compress(std::span<const unsigned char> data,
+                                    int level);
+
+std::uint32_t Adler32(std::span<const unsigned char> data);
+
+std::uint32_t Adler32Combine(std::uint32_t first, std::uint32_t second,
+                             std::size_t second_size);
+
+std::uint32_t Crc32(std::uint32_t crc, std::span<const unsigned char> data);
+
+}  // namespace xpano::utils::zlib